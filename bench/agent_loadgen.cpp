@@ -0,0 +1,162 @@
+/*
+
+Copyright (C) 2019 Mateusz Morusiewicz
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#include <src/agent/client.h>
+
+#include <bench/percentile.h>
+
+#include <external/p-ranav/argparse/include/argparse.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+/* Drives a running hdpwm-agent with pipelined requests over several connections and reports
+ * throughput and latency percentiles */
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct LoadConfig {
+	std::string socket_path;
+	std::string type;
+	std::string path;
+	int connections;
+	int depth;
+	int requests;
+};
+
+agent::Request make_request(const LoadConfig &config, uint32_t n) {
+	agent::Request request;
+	if (config.type == "lookup") {
+		request.type = agent::RequestType::Lookup;
+		request.path = config.path;
+	} else if (config.type == "list") {
+		request.type = agent::RequestType::List;
+		request.path = config.path;
+	} else {
+		request.type = agent::RequestType::Derive;
+		request.dpath = n % 65536;
+	}
+	return request;
+}
+
+/* returns latencies in microseconds */
+std::vector<double> run_connection(const LoadConfig &config) {
+	agent::Client client(config.socket_path);
+	std::vector<double> latencies;
+	latencies.reserve(config.requests);
+
+	std::unordered_map<uint32_t, Clock::time_point> sent;
+	int issued = 0;
+	while (static_cast<int>(latencies.size()) < config.requests) {
+		while (issued < config.requests && static_cast<int>(sent.size()) < config.depth) {
+			sent[client.send(make_request(config, issued++))] = Clock::now();
+		}
+
+		agent::Response response = client.receive();
+		if (response.status != agent::Status::Ok) {
+			throw std::runtime_error("request failed: " + response.error);
+		}
+
+		auto it = sent.find(response.id);
+		latencies.push_back(
+		    std::chrono::duration<double, std::micro>(Clock::now() - it->second).count());
+		sent.erase(it);
+	}
+
+	return latencies;
+}
+
+} // namespace
+
+int main(int argc, const char *argv[]) {
+	argparse::ArgumentParser program("agent_loadgen");
+
+	program.add_argument("-s", "--socket")
+	    .help("agent socket")
+	    .default_value(agent::default_socket_path().string());
+	program.add_argument("-t", "--type")
+	    .help("derive, lookup or list")
+	    .default_value(std::string{"derive"});
+	program.add_argument("--path")
+	    .help("keychain path for lookup and list requests")
+	    .default_value(std::string{""});
+	program.add_argument("-c", "--connections")
+	    .help("concurrent connections")
+	    .default_value(4)
+	    .action([](const std::string &value) { return std::stoi(value); });
+	program.add_argument("-d", "--depth")
+	    .help("requests in flight per connection")
+	    .default_value(16)
+	    .action([](const std::string &value) { return std::stoi(value); });
+	program.add_argument("-n", "--requests")
+	    .help("requests per connection")
+	    .default_value(10000)
+	    .action([](const std::string &value) { return std::stoi(value); });
+
+	try {
+		program.parse_args(argc, argv);
+	} catch (const std::runtime_error &err) {
+		std::cout << err.what() << std::endl;
+		std::cout << program;
+		return 1;
+	}
+
+	LoadConfig config{program.get<std::string>("--socket"), program.get<std::string>("--type"),
+	    program.get<std::string>("--path"), program.get<int>("--connections"),
+	    std::max(1, program.get<int>("--depth")), program.get<int>("--requests")};
+
+	std::mutex results_mutex;
+	std::vector<double> latencies;
+	std::vector<std::thread> threads;
+
+	const auto start = Clock::now();
+	for (int c = 0; c < config.connections; ++c) {
+		threads.emplace_back([&]() {
+			try {
+				auto connection_latencies = run_connection(config);
+				std::unique_lock<std::mutex> lk(results_mutex);
+				latencies.insert(
+				    latencies.end(), connection_latencies.begin(), connection_latencies.end());
+			} catch (const std::exception &e) {
+				std::unique_lock<std::mutex> lk(results_mutex);
+				std::cerr << e.what() << std::endl;
+			}
+		});
+	}
+
+	for (auto &thread : threads) {
+		thread.join();
+	}
+	const double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+	std::sort(latencies.begin(), latencies.end());
+	std::cout << "requests: " << latencies.size() << ", seconds: " << seconds
+	          << ", requests/s: " << latencies.size() / seconds
+	          << ", p50: " << bench::percentile(latencies, 0.50) << "us"
+	          << ", p99: " << bench::percentile(latencies, 0.99) << "us" << std::endl;
+
+	return latencies.size() == static_cast<size_t>(config.connections * config.requests) ? 0 : 1;
+}
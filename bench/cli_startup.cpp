@@ -0,0 +1,187 @@
+/*
+
+Copyright (C) 2019 Mateusz Morusiewicz
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#include <src/crypto/crypto.h>
+
+#include <bench/percentile.h>
+
+#include <external/p-ranav/argparse/include/argparse.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/ioctl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+/* Compares startup-to-exit of `hdpmanager get` with the time the TUI needs to show its first
+ * screen */
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double elapsed_ms(Clock::time_point start) {
+	return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+/* hdpmanager get with the phrase on fd 3 and stdout discarded */
+double time_get(const std::string &hdpmanager, const std::string &kc_path,
+    const std::string &entry, const std::string &password) {
+	int password_pipe[2];
+	if (pipe(password_pipe) != 0) throw std::runtime_error("could not create a pipe");
+	const std::string line = password + "\n";
+	(void)!write(password_pipe[1], line.data(), line.size());
+	close(password_pipe[1]);
+
+	const auto start = Clock::now();
+	pid_t pid = fork();
+	if (pid == 0) {
+		dup2(password_pipe[0], 3);
+		int null_fd = open("/dev/null", O_WRONLY);
+		dup2(null_fd, STDOUT_FILENO);
+		execl(hdpmanager.c_str(), hdpmanager.c_str(), "get", "-p", kc_path.c_str(),
+		    "--password-fd", "3", entry.c_str(), nullptr);
+		_exit(127);
+	}
+	close(password_pipe[0]);
+
+	int status = 0;
+	waitpid(pid, &status, 0);
+	const double ms = elapsed_ms(start);
+	if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) throw std::runtime_error("get failed");
+	return ms;
+}
+
+/* the TUI on a fresh pseudo terminal, until it asks for the master password */
+double time_tui(const std::string &hdpmanager, const std::string &kc_path) {
+	int master = posix_openpt(O_RDWR | O_NOCTTY);
+	if (master < 0 || grantpt(master) != 0 || unlockpt(master) != 0) {
+		throw std::runtime_error("could not open a pseudo terminal");
+	}
+	const std::string slave_name = ptsname(master);
+
+	const auto start = Clock::now();
+	pid_t pid = fork();
+	if (pid == 0) {
+		setsid();
+		int slave = open(slave_name.c_str(), O_RDWR);
+		ioctl(slave, TIOCSCTTY, 0);
+		winsize size{24, 80, 0, 0};
+		ioctl(slave, TIOCSWINSZ, &size);
+		dup2(slave, STDIN_FILENO);
+		dup2(slave, STDOUT_FILENO);
+		dup2(slave, STDERR_FILENO);
+		close(master);
+		setenv("TERM", "xterm", 0);
+		execl(hdpmanager.c_str(), hdpmanager.c_str(), "-p", kc_path.c_str(), nullptr);
+		_exit(127);
+	}
+
+	std::string screen;
+	bool shown = false;
+	while (!shown && elapsed_ms(start) < 5000) {
+		pollfd pfd{master, POLLIN, 0};
+		if (poll(&pfd, 1, 100) <= 0) continue;
+
+		char chunk[4096];
+		ssize_t n = read(master, chunk, sizeof(chunk));
+		if (n <= 0) break;
+		screen.append(chunk, n);
+		shown = screen.find("password") != std::string::npos;
+	}
+	const double ms = elapsed_ms(start);
+
+	kill(pid, SIGKILL);
+	waitpid(pid, nullptr, 0);
+	close(master);
+
+	if (!shown) throw std::runtime_error("the TUI did not show its first screen");
+	return ms;
+}
+
+void report(const std::string &name, std::vector<double> samples) {
+	std::sort(samples.begin(), samples.end());
+	std::cout << name << ": p50 " << bench::percentile(samples, 0.50) << "ms, p99 "
+	          << bench::percentile(samples, 0.99) << "ms" << std::endl;
+}
+
+} // namespace
+
+int main(int argc, const char *argv[]) {
+	argparse::ArgumentParser program("cli_startup");
+
+	program.add_argument("--hdpmanager")
+	    .help("hdpmanager binary")
+	    .default_value(std::string{"hdpmanager"});
+	program.add_argument("-p", "--path").help("keychain data directory");
+	program.add_argument("-e", "--entry").help("entry to get");
+	program.add_argument("--password").help("encryption phrase").default_value(std::string{""});
+	program.add_argument("-n", "--runs")
+	    .help("runs of each")
+	    .default_value(50)
+	    .action([](const std::string &value) { return std::stoi(value); });
+
+	try {
+		program.parse_args(argc, argv);
+	} catch (const std::runtime_error &err) {
+		std::cout << err.what() << std::endl;
+		std::cout << program;
+		return 1;
+	}
+
+	const auto hdpmanager = program.get<std::string>("--hdpmanager");
+	const auto kc_path = program.get<std::string>("--path");
+	const auto password = program.get<std::string>("--password");
+	const int runs = program.get<int>("--runs");
+
+	try {
+		/* what `get` spends on the phrase itself, to be subtracted from its startup */
+		std::vector<double> kdf;
+		for (int i = 0; i < runs; ++i) {
+			const auto start = Clock::now();
+			crypto::hash_password(utils::sensitive_string(password));
+			kdf.push_back(elapsed_ms(start));
+		}
+
+		std::vector<double> get, tui;
+		for (int i = 0; i < runs; ++i) {
+			get.push_back(
+			    time_get(hdpmanager, kc_path, program.get<std::string>("--entry"), password));
+			tui.push_back(time_tui(hdpmanager, kc_path));
+		}
+
+		report("password kdf", kdf);
+		report("get, startup to exit", get);
+		report("tui, startup to first screen", tui);
+	} catch (const std::exception &e) {
+		std::cerr << e.what() << std::endl;
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,320 @@
+/*
+
+Copyright (C) 2019 Mateusz Morusiewicz
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+
+#include <src/crypto/crypto.h>
+#include <src/crypto/mnemonic.h>
+#include <src/keychain/keychain.h>
+#include <src/utils/metrics.h>
+#include <src/utils/trace.h>
+
+#include <external/nlohmann/json_single_include.h>
+#include <external/p-ranav/argparse/include/argparse.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <ctime>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#ifndef HDPWM_BUILD_TYPE
+#define HDPWM_BUILD_TYPE ""
+#endif
+
+/* Microbenchmarks of the crypto and codec hot paths. Every benchmark runs in batches sized to
+ * take about a millisecond, for at least --min-time; ns/op is reported per batch. */
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr int MIN_BATCHES = 5;
+constexpr std::chrono::microseconds TARGET_BATCH_TIME{1000};
+
+/* keeps the compiler from dropping a result nobody reads */
+template <typename T> void keep(const T &value) { asm volatile("" : : "g"(&value) : "memory"); }
+
+struct Result {
+	std::string name;
+	uint64_t iterations = 0;
+	size_t batches = 0;
+	double mean_ns = 0; // per operation
+	double median_ns = 0;
+	double p99_ns = 0;
+	double min_ns = 0;
+};
+
+struct Benchmark {
+	std::string name;
+	std::function<void()> op;
+};
+
+double elapsed_ns(Clock::time_point start) {
+	return std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+}
+
+Result run(const Benchmark &bench, std::chrono::milliseconds min_time) {
+	/* batch size: doubled until a batch takes long enough to be timed reliably */
+	uint64_t batch = 1;
+	for (;;) {
+		const auto start = Clock::now();
+		for (uint64_t i = 0; i < batch; ++i) bench.op();
+		if (elapsed_ns(start) >= std::chrono::nanoseconds(TARGET_BATCH_TIME).count() ||
+		    batch >= (uint64_t{1} << 30)) {
+			break;
+		}
+		batch *= 2;
+	}
+
+	Result rv;
+	rv.name = bench.name;
+
+	std::vector<double> per_op;
+	double total_ns = 0;
+	const auto end = Clock::now() + min_time;
+	while (per_op.size() < MIN_BATCHES || Clock::now() < end) {
+		const auto start = Clock::now();
+		for (uint64_t i = 0; i < batch; ++i) bench.op();
+		const double ns = elapsed_ns(start);
+
+		per_op.push_back(ns / batch);
+		total_ns += ns;
+		rv.iterations += batch;
+	}
+
+	std::sort(per_op.begin(), per_op.end());
+	rv.batches = per_op.size();
+	rv.mean_ns = total_ns / rv.iterations;
+	rv.median_ns = per_op[per_op.size() / 2];
+	rv.p99_ns = per_op[std::min(per_op.size() - 1, per_op.size() * 99 / 100)];
+	rv.min_ns = per_op.front();
+	return rv;
+}
+
+crypto::Seed test_seed() {
+	crypto::Seed seed;
+	for (size_t i = 0; i < seed.size(); ++i) seed[i] = static_cast<unsigned char>(i * 7 + 1);
+	return seed;
+}
+
+keychain::Directory::ptr test_tree(int n_entries) {
+	auto root = std::make_shared<keychain::Directory>(keychain::DirectoryMeta{"", ""}, nullptr);
+	for (int d = 0; d < 10; ++d) keychain::add_directory(root, "dir" + std::to_string(d), "");
+	for (int i = 0; i < n_entries; ++i) {
+		keychain::add_entry(root, "dir" + std::to_string(i % 10) + "/entry" + std::to_string(i),
+		    "login at https://example.com/" + std::to_string(i), {i});
+	}
+	return root;
+}
+
+std::vector<Benchmark> benchmarks() {
+	std::vector<Benchmark> rv;
+
+	const utils::sensitive_string password("correct horse battery staple");
+	rv.push_back({"hash_password", [password]() { keep(crypto::hash_password(password)); }});
+
+	const crypto::Seed seed = test_seed();
+	const crypto::PasswordHash pw_hash = crypto::hash_password(password);
+	const crypto::EncryptionKey key(seed);
+
+	const utils::sensitive_string plaintext(std::string(256, 'x'));
+	rv.push_back({"encrypt/256B", [key, plaintext]() { keep(crypto::encrypt(key, plaintext)); }});
+	const crypto::Ciphertext ciphertext = crypto::encrypt(key, plaintext);
+	rv.push_back({"decrypt/256B", [key, ciphertext]() { keep(crypto::decrypt(key, ciphertext)); }});
+
+	rv.push_back(
+	    {"encrypt_seed", [seed, pw_hash]() { keep(crypto::encrypt_seed(seed, pw_hash)); }});
+	const crypto::EncryptedSeed encrypted_seed = crypto::encrypt_seed(seed, pw_hash);
+	rv.push_back({"decrypt_seed",
+	    [encrypted_seed, pw_hash]() { keep(crypto::decrypt_seed(encrypted_seed, pw_hash)); }});
+
+	rv.push_back({"derive_child", [seed]() { keep(crypto::derive_child(seed, {42})); }});
+	rv.push_back({"derive_child/encrypted", [pw_hash, encrypted_seed]() {
+		              keep(crypto::derive_child(pw_hash, encrypted_seed, {42}));
+	              }});
+
+	rv.push_back({"encode_secret", [seed]() {
+		              crypto::Seed copy = seed;
+		              keep(keychain::Keychain::encode_secret(copy.data(), copy.size(), 10));
+	              }});
+
+	rv.push_back({"serialize/seed", [seed]() { keep(crypto::serialize(seed)); }});
+	const std::string seed_hex = crypto::serialize(seed);
+	rv.push_back({"deserialize/seed",
+	    [seed_hex]() { keep(crypto::deserialize<crypto::Seed>(seed_hex)); }});
+
+	const auto tree = test_tree(1000);
+	rv.push_back(
+	    {"serialize_directory/1000", [tree]() { keep(keychain::serialize_directory(tree)); }});
+	const nlohmann::json tree_json = keychain::serialize_directory(tree);
+	rv.push_back({"deserialize_directory/1000", [tree_json]() {
+		              keep(keychain::deserialize_directory(tree_json, nullptr));
+	              }});
+	const std::string tree_text = tree_json.dump();
+	rv.push_back({"json_dump/1000", [tree_json]() { keep(tree_json.dump()); }});
+	rv.push_back({"json_parse/1000", [tree_text]() { keep(nlohmann::json::parse(tree_text)); }});
+
+	const utils::sensitive_string blob(std::string(1024, 'b'));
+	rv.push_back({"base64_encode/1KiB", [blob]() { keep(crypto::base64_encode(blob)); }});
+	const crypto::B64EncodedText encoded = crypto::base64_encode(blob);
+	rv.push_back({"base64_decode/1KiB", [encoded]() { keep(crypto::base64_decode(encoded)); }});
+	rv.push_back({"base64_decode_ciphertext/1KiB",
+	    [encoded]() { keep(crypto::base64_decode_ciphertext(encoded)); }});
+
+	const utils::sensitive_string mnemonic(
+	    "abandon ability able about above absent absorb abstract absurd abuse access accident");
+	rv.push_back({"split_mnemonic_words/12", [mnemonic]() {
+		              keep(crypto::split_mnemonic_words(mnemonic));
+	              }});
+	rv.push_back({"mnemonic_to_seed/12", [mnemonic]() {
+		              keep(crypto::mnemonic_to_seed(crypto::split_mnemonic_words(mnemonic)));
+	              }});
+
+	rv.push_back({"sensitive_string/alloc", []() { keep(utils::sensitive_string(64)); }});
+	rv.push_back({"sensitive_string/push_back_1KiB", []() {
+		              utils::sensitive_string s;
+		              for (int i = 0; i < 1024; ++i) s.push_back('a');
+		              keep(s);
+	              }});
+	rv.push_back({"sensitive_string/resize_4KiB", []() {
+		              utils::sensitive_string s;
+		              s.resize(4096);
+		              keep(s);
+	              }});
+	rv.push_back({"sensitive_string/copy_256B",
+	    [plaintext]() { keep(utils::sensitive_string(plaintext)); }});
+
+	/* a span while tracing is off, and what an enabled one records on closing */
+	rv.push_back({"trace/span_disabled", []() { TRACE_SPAN("bench", "span"); }});
+	rv.push_back({"trace/record", []() {
+		              const int64_t start = utils::trace::now_ns();
+		              utils::trace::record("bench", "span", start, utils::trace::now_ns());
+	              }});
+	rv.push_back({"metrics/latency", []() { METRICS_LATENCY("bench"); }});
+
+	return rv;
+}
+
+nlohmann::json to_json(const std::vector<Result> &results, std::chrono::milliseconds min_time) {
+	char host[256] = {};
+	gethostname(host, sizeof(host) - 1);
+
+	char date[32] = {};
+	const std::time_t now = std::time(nullptr);
+	std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%SZ", std::gmtime(&now));
+
+	nlohmann::json rv;
+	rv["context"] = {
+	    {"date", date},
+	    {"host", host},
+	    {"build_type", HDPWM_BUILD_TYPE},
+	    {"compiler", __VERSION__},
+#ifdef NDEBUG
+	    {"assertions", false},
+#else
+	    {"assertions", true},
+#endif
+	    {"min_time_ms", min_time.count()},
+	};
+
+	rv["benchmarks"] = nlohmann::json::array();
+	for (const auto &r : results) {
+		rv["benchmarks"].push_back({
+		    {"name", r.name},
+		    {"iterations", r.iterations},
+		    {"batches", r.batches},
+		    {"mean_ns", r.mean_ns},
+		    {"median_ns", r.median_ns},
+		    {"p99_ns", r.p99_ns},
+		    {"min_ns", r.min_ns},
+		});
+	}
+	return rv;
+}
+
+} // namespace
+
+int main(int argc, const char *argv[]) {
+	argparse::ArgumentParser program("hdpwm_bench");
+
+	program.add_argument("-f", "--filter")
+	    .help("only benchmarks whose name contains this")
+	    .default_value(std::string{""});
+	program.add_argument("-t", "--min-time")
+	    .help("milliseconds per benchmark")
+	    .default_value(200)
+	    .action([](const std::string &value) { return std::stoi(value); });
+	program.add_argument("--json")
+	    .help("print JSON instead of a table")
+	    .default_value(false)
+	    .implicit_value(true);
+	program.add_argument("-o", "--output")
+	    .help("also write the JSON to this file")
+	    .default_value(std::string{""});
+	program.add_argument("-l", "--list")
+	    .help("list the benchmarks")
+	    .default_value(false)
+	    .implicit_value(true);
+
+	try {
+		program.parse_args(argc, argv);
+	} catch (const std::runtime_error &err) {
+		std::cout << err.what() << std::endl;
+		std::cout << program;
+		return 1;
+	}
+
+	const auto filter = program.get<std::string>("--filter");
+	const std::chrono::milliseconds min_time(program.get<int>("--min-time"));
+	const bool json_output = program.get<bool>("--json");
+	const auto output_path = program.get<std::string>("--output");
+
+	try {
+		std::vector<Result> results;
+		for (const auto &bench : benchmarks()) {
+			if (bench.name.find(filter) == std::string::npos) continue;
+			if (program.get<bool>("--list")) {
+				std::cout << bench.name << std::endl;
+				continue;
+			}
+
+			results.push_back(run(bench, min_time));
+			if (!json_output) {
+				const auto &r = results.back();
+				std::printf("%-32s %14.1f ns/op  median %12.1f  p99 %12.1f  (%llu ops)\n",
+				    r.name.c_str(), r.mean_ns, r.median_ns, r.p99_ns,
+				    static_cast<unsigned long long>(r.iterations));
+			}
+		}
+
+		const auto json = to_json(results, min_time);
+		if (json_output) std::cout << json.dump(2) << std::endl;
+		if (!output_path.empty()) std::ofstream(output_path) << json.dump(2) << std::endl;
+	} catch (const std::exception &e) {
+		std::cerr << e.what() << std::endl;
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,273 @@
+/*
+
+Copyright (C) 2019 Mateusz Morusiewicz
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+
+#include <src/keychain/keychain.h>
+#include <src/keychain/synthetic.h>
+
+#include <src/crypto/locked_memory.h>
+
+#include <external/nlohmann/json_single_include.h>
+#include <external/p-ranav/argparse/include/argparse.hpp>
+
+#include <sys/resource.h>
+
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+/* How the keychain operations scale with its size: every operation runs once on synthetic
+ * keychains of growing size and records wall time, peak RSS, locked bytes and bytes written */
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Sample {
+	size_t n_entries;
+	std::string operation;
+	double wall_ms;
+	size_t peak_rss_kb;  // during the operation, or of the whole process if it can't be reset
+	size_t locked_bytes; // locked memory after the operation
+	uint64_t written_bytes;
+};
+
+/* a field of a /proc/self file in "name: value" form */
+uint64_t proc_field(const char *file, const std::string &name) {
+	std::ifstream in(file);
+	std::string line;
+	while (std::getline(in, line)) {
+		if (line.compare(0, name.size() + 1, name + ":") == 0) {
+			return std::stoull(line.substr(name.size() + 1));
+		}
+	}
+	return 0;
+}
+
+/* resets VmHWM to the current RSS, not possible on every kernel */
+void reset_peak_rss() { std::ofstream("/proc/self/clear_refs") << "5"; }
+
+size_t peak_rss_kb() {
+	if (auto hwm = proc_field("/proc/self/status", "VmHWM")) return hwm;
+	rusage usage{};
+	getrusage(RUSAGE_SELF, &usage);
+	return usage.ru_maxrss;
+}
+
+uint64_t written_bytes() { return proc_field("/proc/self/io", "wchar"); }
+
+Sample measure(size_t n_entries, const std::string &operation, const std::function<void()> &fn) {
+	reset_peak_rss();
+	const uint64_t written_before = written_bytes();
+	const auto start = Clock::now();
+	fn();
+	const double wall_ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+	return {n_entries, operation, wall_ms, peak_rss_kb(),
+	    crypto::locked_memory_stats().locked_bytes, written_bytes() - written_before};
+}
+
+std::vector<size_t> parse_sizes(const std::string &text) {
+	std::vector<size_t> rv;
+	std::stringstream ss(text);
+	std::string size;
+	while (std::getline(ss, size, ',')) rv.push_back(std::stoull(size));
+	return rv;
+}
+
+void open_all(keychain::Directory::ptr dir) {
+	dir->is_open = true;
+	for (auto &subdir : dir->dirs) open_all(subdir);
+}
+
+std::vector<Sample> run_size(keychain::KeychainShape shape, const std::filesystem::path &dir) {
+	const size_t n = shape.n_entries;
+	const auto path = dir / ("kc" + std::to_string(n));
+	const auto export_path = dir / ("export" + std::to_string(n));
+	const auto pw_hash = crypto::hash_password("");
+	std::vector<Sample> rv;
+
+	keychain::Directory::ptr tree;
+	rv.push_back(measure(n, "generate", [&]() { tree = keychain::generate_tree(shape); }));
+
+	rv.push_back(measure(n, "initialize", [&]() {
+		auto kc = keychain::Keychain::initialize_with_seed(path, crypto::Seed{}, pw_hash);
+		kc->save_entries(tree);
+	}));
+	tree.reset();
+
+	std::unique_ptr<keychain::Keychain> kc;
+	rv.push_back(measure(n, "open", [&]() { kc = keychain::Keychain::open(path, pw_hash); }));
+
+	keychain::Directory::ptr root;
+	rv.push_back(measure(n, "get_root_dir", [&]() { root = kc->get_root_dir(); }));
+
+	open_all(root);
+	rv.push_back(measure(n, "flatten_dirs", [&]() {
+		if (keychain::flatten_dirs(root).size() < n) {
+			throw std::runtime_error("entries went missing");
+		}
+	}));
+
+	rv.push_back(measure(n, "save_entries", [&]() { kc->save_entries(root); }));
+	root.reset();
+
+	rv.push_back(measure(n, "export_to_uri", [&]() { kc->export_to_uri(export_path); }));
+	rv.push_back(measure(n, "import_from_uri", [&]() { kc->import_from_uri(export_path); }));
+
+	kc.reset();
+	std::filesystem::remove_all(path);
+	std::filesystem::remove(export_path);
+	return rv;
+}
+
+nlohmann::json to_json(const keychain::KeychainShape &shape, const std::vector<Sample> &samples) {
+	auto distribution = [](const keychain::LengthDistribution &d) -> nlohmann::json {
+		if (d.kind == keychain::LengthDistribution::Kind::Uniform) {
+			return {{"kind", "uniform"}, {"min", d.a}, {"max", d.b}};
+		}
+		return {{"kind", "normal"}, {"mean", d.a}, {"stddev", d.b}};
+	};
+
+	nlohmann::json rv;
+	rv["shape"] = {
+	    {"depth", shape.depth},
+	    {"fan_out", shape.fan_out},
+	    {"name_length", distribution(shape.name_length)},
+	    {"details_length", distribution(shape.details_length)},
+	    {"seed", shape.seed},
+	};
+
+	rv["samples"] = nlohmann::json::array();
+	for (const auto &s : samples) {
+		rv["samples"].push_back({
+		    {"entries", s.n_entries},
+		    {"operation", s.operation},
+		    {"wall_ms", s.wall_ms},
+		    {"peak_rss_kb", s.peak_rss_kb},
+		    {"locked_bytes", s.locked_bytes},
+		    {"written_bytes", s.written_bytes},
+		});
+	}
+	return rv;
+}
+
+} // namespace
+
+int main(int argc, const char *argv[]) {
+	argparse::ArgumentParser program("keychain_scaling");
+
+	program.add_argument("-s", "--sizes")
+	    .help("comma separated entry counts")
+	    .default_value(std::string{"1000,10000,100000"});
+	program.add_argument("--depth")
+	    .help("directory levels")
+	    .default_value(3)
+	    .action([](const std::string &value) { return std::stoi(value); });
+	program.add_argument("--fan-out")
+	    .help("subdirectories per directory")
+	    .default_value(10)
+	    .action([](const std::string &value) { return std::stoi(value); });
+	program.add_argument("--name-length")
+	    .help("uniform name length range, min:max")
+	    .default_value(std::string{"6:24"});
+	program.add_argument("--details-length")
+	    .help("normal details length, mean:stddev")
+	    .default_value(std::string{"40:20"});
+	program.add_argument("--seed")
+	    .help("generator seed")
+	    .default_value(1)
+	    .action([](const std::string &value) { return std::stoi(value); });
+	program.add_argument("-d", "--dir")
+	    .help("where to put the keychains, a temporary directory by default")
+	    .default_value(std::string{""});
+	program.add_argument("--json")
+	    .help("print JSON instead of a table")
+	    .default_value(false)
+	    .implicit_value(true);
+	program.add_argument("-o", "--output")
+	    .help("also write the JSON to this file")
+	    .default_value(std::string{""});
+
+	try {
+		program.parse_args(argc, argv);
+	} catch (const std::runtime_error &err) {
+		std::cout << err.what() << std::endl;
+		std::cout << program;
+		return 1;
+	}
+
+	auto pair_of = [](const std::string &text) {
+		const auto colon = text.find(':');
+		if (colon == std::string::npos) throw std::runtime_error("expected a:b, got " + text);
+		return std::make_pair(std::stod(text.substr(0, colon)), std::stod(text.substr(colon + 1)));
+	};
+
+	const bool json_output = program.get<bool>("--json");
+	const auto output_path = program.get<std::string>("--output");
+	std::filesystem::path dir = program.get<std::string>("--dir");
+	const bool temporary_dir = dir.empty();
+	if (temporary_dir) dir = std::tmpnam(nullptr);
+
+	try {
+		keychain::KeychainShape shape;
+		shape.depth = program.get<int>("--depth");
+		shape.fan_out = program.get<int>("--fan-out");
+		shape.seed = program.get<int>("--seed");
+		const auto [name_min, name_max] = pair_of(program.get<std::string>("--name-length"));
+		shape.name_length = keychain::LengthDistribution::uniform(name_min, name_max);
+		const auto [mean, stddev] = pair_of(program.get<std::string>("--details-length"));
+		shape.details_length = keychain::LengthDistribution::normal(mean, stddev);
+
+		std::filesystem::create_directories(dir);
+
+		std::vector<Sample> samples;
+		if (!json_output) {
+			std::printf("%10s  %-16s %12s %14s %14s %14s\n", "entries", "operation", "wall ms",
+			    "peak RSS kB", "locked B", "written B");
+		}
+		for (size_t n : parse_sizes(program.get<std::string>("--sizes"))) {
+			shape.n_entries = n;
+			for (const auto &s : run_size(shape, dir)) {
+				samples.push_back(s);
+				if (json_output) continue;
+				std::printf("%10zu  %-16s %12.2f %14zu %14zu %14llu\n", s.n_entries,
+				    s.operation.c_str(), s.wall_ms, s.peak_rss_kb, s.locked_bytes,
+				    static_cast<unsigned long long>(s.written_bytes));
+			}
+		}
+
+		const auto json = to_json(shape, samples);
+		if (json_output) std::cout << json.dump(2) << std::endl;
+		if (!output_path.empty()) std::ofstream(output_path) << json.dump(2) << std::endl;
+	} catch (const std::exception &e) {
+		std::cerr << e.what() << std::endl;
+		if (temporary_dir) std::filesystem::remove_all(dir);
+		return 1;
+	}
+
+	if (temporary_dir) std::filesystem::remove_all(dir);
+	return 0;
+}
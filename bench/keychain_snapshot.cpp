@@ -0,0 +1,133 @@
+/*
+
+Copyright (C) 2019 Mateusz Morusiewicz
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#include <src/keychain/keychain.h>
+
+#include <external/p-ranav/argparse/include/argparse.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+/* Snapshot read throughput of a Keychain with 1 to 64 reader threads while a writer keeps
+ * publishing new versions */
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Result {
+	size_t reads;
+	size_t writes;
+};
+
+Result run(keychain::Keychain &kc, size_t n_readers, int n_entries,
+    std::chrono::milliseconds duration, std::chrono::milliseconds write_interval) {
+	std::atomic<bool> done{false};
+	std::atomic<size_t> reads{0};
+
+	std::vector<std::thread> readers;
+	for (size_t r = 0; r < n_readers; ++r) {
+		readers.emplace_back([&, r]() {
+			size_t local_reads = 0;
+			for (size_t i = r; !done; ++i) {
+				const auto snapshot = kc.snapshot();
+				const auto path = "dir/entry" + std::to_string(i % n_entries);
+				if (!keychain::find_by_path(snapshot->root, path)) std::abort();
+				++local_reads;
+			}
+			reads += local_reads;
+		});
+	}
+
+	size_t writes = 0;
+	const auto end = Clock::now() + duration;
+	while (Clock::now() < end) {
+		kc.update([](keychain::Directory::ptr root, keychain::EntryChanges &) {
+			root->meta.details += ".";
+		});
+		++writes;
+		std::this_thread::sleep_for(write_interval);
+	}
+
+	done = true;
+	for (auto &reader : readers) reader.join();
+	return {reads, writes};
+}
+
+} // namespace
+
+int main(int argc, const char *argv[]) {
+	argparse::ArgumentParser program("keychain_snapshot");
+
+	program.add_argument("-e", "--entries")
+	    .help("entries in the keychain")
+	    .default_value(1000)
+	    .action([](const std::string &value) { return std::stoi(value); });
+	program.add_argument("-d", "--duration")
+	    .help("milliseconds per reader count")
+	    .default_value(1000)
+	    .action([](const std::string &value) { return std::stoi(value); });
+	program.add_argument("-w", "--write-interval")
+	    .help("milliseconds between published versions")
+	    .default_value(10)
+	    .action([](const std::string &value) { return std::stoi(value); });
+
+	try {
+		program.parse_args(argc, argv);
+	} catch (const std::runtime_error &err) {
+		std::cout << err.what() << std::endl;
+		std::cout << program;
+		return 1;
+	}
+
+	const int n_entries = program.get<int>("--entries");
+	const std::chrono::milliseconds duration(program.get<int>("--duration"));
+	const std::chrono::milliseconds write_interval(program.get<int>("--write-interval"));
+
+	const std::filesystem::path dir = std::tmpnam(nullptr);
+	std::filesystem::create_directory(dir);
+
+	{
+		crypto::Seed seed;
+		auto kc =
+		    keychain::Keychain::initialize_with_seed(dir / "kc", seed, crypto::hash_password(""));
+		kc->update([n_entries](keychain::Directory::ptr root) {
+			keychain::add_directory(root, "dir", "");
+			for (int i = 0; i < n_entries; ++i) {
+				keychain::add_entry(root, "dir/entry" + std::to_string(i), "", {i});
+			}
+		});
+
+		for (size_t n_readers = 1; n_readers <= 64; n_readers *= 2) {
+			auto result = run(*kc, n_readers, n_entries, duration, write_interval);
+			const double seconds = std::chrono::duration<double>(duration).count();
+			std::cout << "readers: " << n_readers << ", reads/s: " << result.reads / seconds
+			          << ", versions published: " << result.writes << std::endl;
+		}
+	}
+
+	std::filesystem::remove_all(dir);
+	return 0;
+}
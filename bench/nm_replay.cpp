@@ -0,0 +1,147 @@
+/*
+
+Copyright (C) 2019 Mateusz Morusiewicz
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#include <src/nmhost/messaging.h>
+
+#include <bench/percentile.h>
+
+#include <external/p-ranav/argparse/include/argparse.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+/* Replays a request trace recorded with HDPWM_NM_TRACE against a freshly started hdpwm-nm-host
+ * and reports per-request round trip latencies */
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Child {
+	pid_t pid;
+	int to_host;
+	int from_host;
+};
+
+Child spawn(const std::string &host_path) {
+	int in[2], out[2];
+	if (pipe(in) != 0 || pipe(out) != 0) throw std::runtime_error("could not create pipes");
+
+	pid_t pid = fork();
+	if (pid < 0) throw std::runtime_error("could not fork");
+	if (pid == 0) {
+		dup2(in[0], STDIN_FILENO);
+		dup2(out[1], STDOUT_FILENO);
+		close(in[0]);
+		close(in[1]);
+		close(out[0]);
+		close(out[1]);
+		execlp(host_path.c_str(), host_path.c_str(), "chrome-extension://replay/", nullptr);
+		_exit(127);
+	}
+
+	close(in[0]);
+	close(out[1]);
+	return {pid, in[1], out[0]};
+}
+
+} // namespace
+
+int main(int argc, const char *argv[]) {
+	argparse::ArgumentParser program("nm_replay");
+
+	program.add_argument("trace").help("file with one JSON request per line");
+	program.add_argument("--host")
+	    .help("native messaging host to start")
+	    .default_value(std::string{"hdpwm-nm-host"});
+	program.add_argument("-r", "--repeat")
+	    .help("times to replay the whole trace")
+	    .default_value(100)
+	    .action([](const std::string &value) { return std::stoi(value); });
+
+	try {
+		program.parse_args(argc, argv);
+	} catch (const std::runtime_error &err) {
+		std::cout << err.what() << std::endl;
+		std::cout << program;
+		return 1;
+	}
+
+	std::vector<std::string> requests;
+	std::ifstream trace(program.get<std::string>("trace"));
+	for (std::string line; std::getline(trace, line);) {
+		if (!line.empty()) requests.push_back(line);
+	}
+	if (requests.empty()) {
+		std::cerr << "empty trace" << std::endl;
+		return 1;
+	}
+
+	signal(SIGPIPE, SIG_IGN);
+	Child child = spawn(program.get<std::string>("--host"));
+
+	std::vector<double> latencies;
+	size_t errors = 0;
+	try {
+		/* the first request connects to the agent and builds the index, it's reported apart */
+		auto start = Clock::now();
+		nmhost::write_message(child.to_host, requests.front());
+		if (!nmhost::read_message(child.from_host)) throw std::runtime_error("host exited");
+		std::cout << "first request: "
+		          << std::chrono::duration<double, std::micro>(Clock::now() - start).count() << "us"
+		          << std::endl;
+
+		const int repeat = program.get<int>("--repeat");
+		latencies.reserve(requests.size() * repeat);
+		for (int r = 0; r < repeat; ++r) {
+			for (const auto &request : requests) {
+				start = Clock::now();
+				nmhost::write_message(child.to_host, request);
+				auto response = nmhost::read_message(child.from_host);
+				latencies.push_back(
+				    std::chrono::duration<double, std::micro>(Clock::now() - start).count());
+
+				if (!response) throw std::runtime_error("host exited");
+				if (response->find("\"type\":\"error\"") != std::string::npos) ++errors;
+			}
+		}
+	} catch (const std::exception &e) {
+		std::cerr << e.what() << std::endl;
+	}
+
+	close(child.to_host);
+	close(child.from_host);
+	waitpid(child.pid, nullptr, 0);
+
+	std::sort(latencies.begin(), latencies.end());
+	std::cout << "requests: " << latencies.size() << ", errors: " << errors
+	          << ", p50: " << bench::percentile(latencies, 0.50) << "us"
+	          << ", p99: " << bench::percentile(latencies, 0.99) << "us"
+	          << ", max: " << (latencies.empty() ? 0 : latencies.back()) << "us" << std::endl;
+
+	return latencies.empty() ? 1 : 0;
+}
@@ -0,0 +1,126 @@
+/*
+
+Copyright (C) 2019 Mateusz Morusiewicz
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+
+#include <src/keychain/persistence_writer.h>
+
+#include <external/p-ranav/argparse/include/argparse.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+/* What a burst of edits costs the UI thread: saving the tree after every edit, as the main screen
+ * used to, against handing the edits to a PersistenceWriter */
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double elapsed_ms(Clock::time_point start) {
+	return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+/* latency of every call and of the whole burst */
+void run_burst(const std::string &name, int n_edits, const std::function<void(int)> &edit) {
+	std::vector<double> samples;
+	const auto burst_start = Clock::now();
+	for (int i = 0; i < n_edits; ++i) {
+		const auto start = Clock::now();
+		edit(i);
+		samples.push_back(elapsed_ms(start) * 1000);
+	}
+	const double total = elapsed_ms(burst_start);
+
+	std::sort(samples.begin(), samples.end());
+	std::cout << name << ": p50 " << samples[samples.size() / 2] << "us, p99 "
+	          << samples[samples.size() * 99 / 100] << "us, max " << samples.back()
+	          << "us, whole burst " << total << "ms" << std::endl;
+}
+
+} // namespace
+
+int main(int argc, const char *argv[]) {
+	argparse::ArgumentParser program("persistence_writer");
+
+	program.add_argument("-e", "--entries")
+	    .help("entries in the keychain")
+	    .default_value(1000)
+	    .action([](const std::string &value) { return std::stoi(value); });
+	program.add_argument("-n", "--edits")
+	    .help("edits in the burst")
+	    .default_value(1000)
+	    .action([](const std::string &value) { return std::stoi(value); });
+
+	try {
+		program.parse_args(argc, argv);
+	} catch (const std::runtime_error &err) {
+		std::cout << err.what() << std::endl;
+		std::cout << program;
+		return 1;
+	}
+
+	const int n_entries = program.get<int>("--entries");
+	const int n_edits = program.get<int>("--edits");
+
+	const std::filesystem::path dir = std::tmpnam(nullptr);
+	std::filesystem::create_directory(dir);
+
+	{
+		crypto::Seed seed;
+		std::shared_ptr<keychain::Keychain> kc = keychain::Keychain::initialize_with_seed(
+		    dir / "kc", seed, crypto::hash_password(""));
+		kc->update([n_entries](keychain::Directory::ptr root) {
+			for (int i = 0; i < n_entries; ++i) {
+				keychain::add_entry(root, "entry" + std::to_string(i), "", {i});
+			}
+		});
+
+		uint64_t version = kc->snapshot()->version;
+		auto root = kc->get_root_dir();
+		/* details only, nothing the tag index has to follow */
+		auto change = [&root, n_entries](int i) {
+			root->entries[i % n_entries]->meta.details = "edit " + std::to_string(i);
+		};
+
+		run_burst("save after every edit", n_edits, [&](int i) {
+			change(i);
+			version = kc->save_entries(root, version, keychain::EntryChanges{});
+		});
+
+		keychain::PersistenceWriter writer(kc);
+		root = writer.root();
+		run_burst("persistence writer", n_edits, [&](int i) {
+			writer.modify([&](keychain::EntryChanges &) { change(i); });
+		});
+
+		const auto start = Clock::now();
+		writer.flush();
+		std::cout << "flush: " << elapsed_ms(start) << "ms, " << writer.writes() << " writes"
+		          << std::endl;
+	}
+
+	std::filesystem::remove_all(dir);
+	return 0;
+}
@@ -0,0 +1,201 @@
+/*
+
+Copyright (C) 2019 Mateusz Morusiewicz
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+
+#include <src/keychain/keychain.h>
+
+#include <external/p-ranav/argparse/include/argparse.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/ioctl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+/* Bytes the TUI writes to its terminal for every arrow key on the keychain main screen, i.e. what
+ * each keystroke costs over a slow link */
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr unsigned short TERMINAL_LINES = 24;
+constexpr unsigned short TERMINAL_COLS = 80;
+constexpr int VISIBLE_ENTRIES = TERMINAL_LINES - 4; // see KeychainMainScreen::draw_entries_box
+
+const std::string PASSWORD = "bench";
+
+class Tui {
+	int master = -1;
+	pid_t pid = -1;
+
+  public:
+	Tui(const std::string &hdpmanager, const std::string &kc_path) {
+		master = posix_openpt(O_RDWR | O_NOCTTY);
+		if (master < 0 || grantpt(master) != 0 || unlockpt(master) != 0) {
+			throw std::runtime_error("could not open a pseudo terminal");
+		}
+		const std::string slave_name = ptsname(master);
+
+		pid = fork();
+		if (pid == 0) {
+			setsid();
+			int slave = open(slave_name.c_str(), O_RDWR);
+			ioctl(slave, TIOCSCTTY, 0);
+			winsize size{TERMINAL_LINES, TERMINAL_COLS, 0, 0};
+			ioctl(slave, TIOCSWINSZ, &size);
+			dup2(slave, STDIN_FILENO);
+			dup2(slave, STDOUT_FILENO);
+			dup2(slave, STDERR_FILENO);
+			close(master);
+			setenv("TERM", "xterm", 0);
+			execl(hdpmanager.c_str(), hdpmanager.c_str(), "-p", kc_path.c_str(), "--cache-timeout",
+			    "0", nullptr);
+			_exit(127);
+		}
+	}
+
+	~Tui() {
+		kill(pid, SIGKILL);
+		waitpid(pid, nullptr, 0);
+		close(master);
+	}
+
+	void type(const std::string &keys) { (void)!write(master, keys.data(), keys.size()); }
+
+	/* everything written until the terminal has been quiet for a while */
+	std::string read_until_quiet(std::chrono::milliseconds quiet = std::chrono::milliseconds(50)) {
+		std::string output;
+		const auto deadline = Clock::now() + std::chrono::seconds(5);
+		while (Clock::now() < deadline) {
+			pollfd pfd{master, POLLIN, 0};
+			if (poll(&pfd, 1, quiet.count()) <= 0) break;
+
+			char chunk[4096];
+			ssize_t n = read(master, chunk, sizeof(chunk));
+			if (n <= 0) break;
+			output.append(chunk, n);
+		}
+		return output;
+	}
+
+	/* reads until needle shows up */
+	void wait_for(const std::string &needle) {
+		std::string output;
+		const auto deadline = Clock::now() + std::chrono::seconds(10);
+		while (output.find(needle) == std::string::npos) {
+			if (Clock::now() > deadline) throw std::runtime_error("the TUI did not show " + needle);
+			output += read_until_quiet();
+		}
+	}
+};
+
+void report(const std::string &name, std::vector<size_t> samples) {
+	if (samples.empty()) return;
+	std::sort(samples.begin(), samples.end());
+	size_t total = 0;
+	for (size_t bytes : samples) total += bytes;
+	std::cout << name << ": " << samples.size() << " keys, p50 " << samples[samples.size() / 2]
+	          << "B, mean " << total / samples.size() << "B, max " << samples.back() << "B"
+	          << std::endl;
+}
+
+} // namespace
+
+int main(int argc, const char *argv[]) {
+	argparse::ArgumentParser program("tui_output");
+
+	program.add_argument("--hdpmanager")
+	    .help("hdpmanager binary")
+	    .default_value(std::string{"hdpmanager"});
+	program.add_argument("-e", "--entries")
+	    .help("entries in the keychain")
+	    .default_value(100)
+	    .action([](const std::string &value) { return std::stoi(value); });
+	program.add_argument("-k", "--keys")
+	    .help("arrow keys to send")
+	    .default_value(60)
+	    .action([](const std::string &value) { return std::stoi(value); });
+
+	try {
+		program.parse_args(argc, argv);
+	} catch (const std::runtime_error &err) {
+		std::cout << err.what() << std::endl;
+		std::cout << program;
+		return 1;
+	}
+
+	const auto hdpmanager = program.get<std::string>("--hdpmanager");
+	const int n_entries = program.get<int>("--entries");
+	const int n_keys = program.get<int>("--keys");
+
+	const std::filesystem::path dir = std::tmpnam(nullptr);
+	std::filesystem::create_directory(dir);
+
+	try {
+		{
+			crypto::Seed seed;
+			auto kc = keychain::Keychain::initialize_with_seed(
+			    dir / "kc", seed, crypto::hash_password(utils::sensitive_string(PASSWORD)));
+			kc->update([n_entries](keychain::Directory::ptr root) {
+				for (int i = 0; i < n_entries; ++i) {
+					keychain::add_entry(root, "entry" + std::to_string(i),
+					    "details of entry " + std::to_string(i), {i});
+				}
+			});
+		}
+
+		Tui tui(hdpmanager, dir / "kc");
+		tui.wait_for("password");
+		tui.type(PASSWORD + "\n");
+		tui.wait_for("Open keychain");
+		tui.type("\n");
+		const size_t first_screen = tui.read_until_quiet(std::chrono::milliseconds(200)).size();
+
+		/* the root directory is the first row, entries follow */
+		std::vector<size_t> moves, scrolls;
+		for (int k = 0; k < n_keys; ++k) {
+			tui.type("\x1bOB");
+			const size_t bytes = tui.read_until_quiet().size();
+			const int selected = (k + 1) % (n_entries + 1);
+			(selected < VISIBLE_ENTRIES && selected > 0 ? moves : scrolls).push_back(bytes);
+		}
+
+		std::cout << "main screen: " << first_screen << "B" << std::endl;
+		report("selection moves", moves);
+		report("list scrolls", scrolls);
+	} catch (const std::exception &e) {
+		std::cerr << e.what() << std::endl;
+		std::filesystem::remove_all(dir);
+		return 1;
+	}
+
+	std::filesystem::remove_all(dir);
+	return 0;
+}
@@ -0,0 +1,260 @@
+/*
+
+Copyright (C) 2019 Mateusz Morusiewicz
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+
+
+#include <src/keychain/keychain.h>
+#include <src/keychain/synthetic.h>
+#include <src/tui/headless.h>
+#include <src/tui/key_trace.h>
+#include <src/tui/keychain_main_screen.h>
+
+#include <bench/percentile.h>
+
+#include <external/nlohmann/json_single_include.h>
+#include <external/p-ranav/argparse/include/argparse.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <optional>
+#include <string>
+#include <vector>
+
+/* Replays a key trace recorded with HDPWM_KEY_TRACE on a headless terminal, starting from the main
+ * screen of a synthetic keychain, and reports how long every key took to show on the screen and
+ * how many bytes it cost on the terminal */
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Sample {
+	int key;
+	double latency_us; // from writing the key until the first frame drawn after it was handled
+	uint64_t bytes;    // written until the loop had nothing left to do
+};
+
+class FrameClock : public WindowObserver {
+	bool key_handled = false;
+	std::optional<Clock::time_point> first_frame;
+
+  public:
+	void on_key(int, const ScreenController &) override { key_handled = true; }
+	void on_frame() override {
+		if (key_handled && !first_frame) first_frame = Clock::now();
+	}
+
+	void reset() {
+		key_handled = false;
+		first_frame.reset();
+	}
+	Clock::time_point frame_or(Clock::time_point fallback) const {
+		return first_frame.value_or(fallback);
+	}
+};
+
+double microseconds(Clock::duration d) {
+	return std::chrono::duration<double, std::micro>(d).count();
+}
+
+struct Summary {
+	size_t keys = 0;
+	double p50_us = 0;
+	double p99_us = 0;
+	double max_us = 0;
+	uint64_t total_bytes = 0;
+	uint64_t max_bytes = 0;
+};
+
+Summary summarize(const std::vector<const Sample *> &samples) {
+	Summary rv;
+	std::vector<double> latencies;
+	for (const auto *s : samples) {
+		latencies.push_back(s->latency_us);
+		rv.total_bytes += s->bytes;
+		rv.max_bytes = std::max(rv.max_bytes, s->bytes);
+	}
+	std::sort(latencies.begin(), latencies.end());
+
+	rv.keys = samples.size();
+	rv.p50_us = bench::percentile(latencies, 0.50);
+	rv.p99_us = bench::percentile(latencies, 0.99);
+	rv.max_us = latencies.empty() ? 0 : latencies.back();
+	return rv;
+}
+
+nlohmann::json to_json(const Summary &s) {
+	return {{"keys", s.keys}, {"p50_us", s.p50_us}, {"p99_us", s.p99_us}, {"max_us", s.max_us},
+	    {"total_bytes", s.total_bytes}, {"max_bytes", s.max_bytes}};
+}
+
+void print_row(const std::string &name, const Summary &s) {
+	std::printf("%-14s %7zu %10.1f %10.1f %10.1f %10.1f %10llu\n", name.c_str(), s.keys, s.p50_us,
+	    s.p99_us, s.max_us, s.keys ? static_cast<double>(s.total_bytes) / s.keys : 0.0,
+	    static_cast<unsigned long long>(s.max_bytes));
+}
+
+} // namespace
+
+int main(int argc, const char *argv[]) {
+	argparse::ArgumentParser program("tui_replay");
+
+	program.add_argument("trace").help("file with one key per line");
+	program.add_argument("-e", "--entries")
+	    .help("entries in the synthetic keychain")
+	    .default_value(1000)
+	    .action([](const std::string &value) { return std::stoi(value); });
+	program.add_argument("--depth")
+	    .help("directory levels")
+	    .default_value(3)
+	    .action([](const std::string &value) { return std::stoi(value); });
+	program.add_argument("--fan-out")
+	    .help("subdirectories per directory")
+	    .default_value(10)
+	    .action([](const std::string &value) { return std::stoi(value); });
+	program.add_argument("--seed")
+	    .help("generator seed")
+	    .default_value(1)
+	    .action([](const std::string &value) { return std::stoi(value); });
+	program.add_argument("--lines")
+	    .help("terminal lines")
+	    .default_value(24)
+	    .action([](const std::string &value) { return std::stoi(value); });
+	program.add_argument("--cols")
+	    .help("terminal columns")
+	    .default_value(80)
+	    .action([](const std::string &value) { return std::stoi(value); });
+	program.add_argument("--json")
+	    .help("print JSON instead of a table")
+	    .default_value(false)
+	    .implicit_value(true);
+	program.add_argument("-o", "--output")
+	    .help("also write the JSON to this file")
+	    .default_value(std::string{""});
+
+	try {
+		program.parse_args(argc, argv);
+	} catch (const std::runtime_error &err) {
+		std::cout << err.what() << std::endl;
+		std::cout << program;
+		return 1;
+	}
+
+	const bool json_output = program.get<bool>("--json");
+	const auto output_path = program.get<std::string>("--output");
+	const std::filesystem::path dir = std::tmpnam(nullptr);
+
+	try {
+		keychain::KeychainShape shape;
+		shape.n_entries = program.get<int>("--entries");
+		shape.depth = program.get<int>("--depth");
+		shape.fan_out = program.get<int>("--fan-out");
+		shape.seed = program.get<int>("--seed");
+
+		std::filesystem::create_directories(dir);
+		std::shared_ptr<keychain::Keychain> kc = keychain::Keychain::initialize_with_seed(
+		    dir / "kc", crypto::Seed{}, crypto::hash_password(""));
+		kc->save_entries(keychain::generate_tree(shape));
+
+		std::vector<Sample> samples;
+		uint64_t first_screen_bytes = 0;
+		double first_screen_us = 0;
+		{
+			HeadlessTerminal terminal(program.get<int>("--lines"), program.get<int>("--cols"));
+			/* curses has to be there to look up the key names */
+			const auto keys = read_key_trace(program.get<std::string>("trace"));
+
+			FrameClock clock;
+			terminal.manager().set_observer(&clock);
+
+			auto start = Clock::now();
+			terminal.start(std::make_shared<KeychainMainScreen>(&terminal.manager(), kc));
+			terminal.settle();
+			first_screen_us = microseconds(Clock::now() - start);
+			first_screen_bytes = terminal.bytes_written();
+
+			for (int key : keys) {
+				clock.reset();
+				const uint64_t bytes_before = terminal.bytes_written();
+				start = Clock::now();
+				terminal.press(key);
+				const bool running = terminal.settle();
+
+				const auto frame = clock.frame_or(Clock::now());
+				samples.push_back(
+				    {key, microseconds(frame - start), terminal.bytes_written() - bytes_before});
+				if (!running) break;
+			}
+
+			if (samples.size() < keys.size()) {
+				std::cerr << "the TUI quit after " << samples.size() << " of " << keys.size()
+				          << " keys" << std::endl;
+			}
+		}
+
+		std::vector<const Sample *> all;
+		std::map<std::string, std::vector<const Sample *>> by_key;
+		for (const auto &s : samples) {
+			all.push_back(&s);
+			by_key[key_name(s.key)].push_back(&s);
+		}
+
+		nlohmann::json json;
+		json["shape"] = {{"entries", shape.n_entries}, {"depth", shape.depth},
+		    {"fan_out", shape.fan_out}, {"seed", shape.seed}};
+		json["terminal"] = {{"lines", program.get<int>("--lines")},
+		    {"cols", program.get<int>("--cols")}, {"type", HeadlessTerminal::TERM}};
+		json["first_screen"] = {{"us", first_screen_us}, {"bytes", first_screen_bytes}};
+		json["summary"] = to_json(summarize(all));
+		for (const auto &[name, key_samples] : by_key) {
+			json["by_key"][name] = to_json(summarize(key_samples));
+		}
+		json["samples"] = nlohmann::json::array();
+		for (const auto &s : samples) {
+			json["samples"].push_back(
+			    {{"key", key_name(s.key)}, {"latency_us", s.latency_us}, {"bytes", s.bytes}});
+		}
+
+		if (json_output) {
+			std::cout << json.dump(2) << std::endl;
+		} else {
+			std::printf("first screen: %.1fus, %lluB\n", first_screen_us,
+			    static_cast<unsigned long long>(first_screen_bytes));
+			std::printf("%-14s %7s %10s %10s %10s %10s %10s\n", "key", "count", "p50 us", "p99 us",
+			    "max us", "mean B", "max B");
+			for (const auto &[name, key_samples] : by_key) {
+				print_row(name, summarize(key_samples));
+			}
+			print_row("all", summarize(all));
+		}
+		if (!output_path.empty()) std::ofstream(output_path) << json.dump(2) << std::endl;
+	} catch (const std::exception &e) {
+		std::cerr << e.what() << std::endl;
+		std::filesystem::remove_all(dir);
+		return 1;
+	}
+
+	std::filesystem::remove_all(dir);
+	return 0;
+}
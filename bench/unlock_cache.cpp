@@ -0,0 +1,122 @@
+/*
+
+Copyright (C) 2019 Mateusz Morusiewicz
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#include <src/keychain/unlock_cache.h>
+
+#include <external/p-ranav/argparse/include/argparse.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+/* Unlock latency of a keychain with and without the unlock cache, for every cache backend
+ * available. Uncached unlocks hash the phrase, open and verify; cached ones open and compare the
+ * tag stored with the hash. */
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Percentiles {
+	double p50_us;
+	double p99_us;
+};
+
+Percentiles measure(int iterations, const std::function<void()> &fn) {
+	std::vector<double> samples;
+	samples.reserve(iterations);
+	for (int i = 0; i < iterations; ++i) {
+		const auto start = Clock::now();
+		fn();
+		samples.push_back(std::chrono::duration<double, std::micro>(Clock::now() - start).count());
+	}
+
+	std::sort(samples.begin(), samples.end());
+	return {samples[samples.size() / 2], samples[samples.size() * 99 / 100]};
+}
+
+void report(const std::string &label, const Percentiles &p) {
+	std::cout << label << ": p50 " << p.p50_us << "us, p99 " << p.p99_us << "us" << std::endl;
+}
+
+} // namespace
+
+int main(int argc, const char *argv[]) {
+	argparse::ArgumentParser program("unlock_cache");
+
+	program.add_argument("-n", "--iterations")
+	    .help("unlocks per measurement")
+	    .default_value(200)
+	    .action([](const std::string &value) { return std::stoi(value); });
+
+	try {
+		program.parse_args(argc, argv);
+	} catch (const std::runtime_error &err) {
+		std::cout << err.what() << std::endl;
+		std::cout << program;
+		return 1;
+	}
+
+	const int iterations = program.get<int>("--iterations");
+	const std::filesystem::path dir = std::tmpnam(nullptr);
+	std::filesystem::create_directory(dir);
+	const auto kc_path = dir / "kc";
+
+	crypto::Seed seed;
+	keychain::Keychain::initialize_with_seed(kc_path, seed, crypto::hash_password("pw"));
+
+	const utils::sensitive_string password("pw");
+	report("hash only", measure(iterations, [&]() { crypto::hash_password(password); }));
+
+	std::vector<std::pair<std::string, std::unique_ptr<crypto::KeyCache>>> backends;
+	if (auto cache = crypto::make_kernel_keyring_cache()) {
+		backends.emplace_back("kernel keyring", std::move(cache));
+	} else {
+		std::cout << "kernel keyring: not available" << std::endl;
+	}
+	backends.emplace_back("runtime directory", crypto::make_runtime_dir_cache(dir / "cache"));
+
+	for (auto &[name, backend] : backends) {
+		backend->store("bench", crypto::CachedKey{crypto::hash_password(password), {}},
+		    std::chrono::seconds(60));
+		report(name + ", lookup only", measure(iterations, [&backend = backend]() {
+			if (!backend->load("bench")) std::abort();
+		}));
+		backend->forget("bench");
+
+		keychain::UnlockCache cache(std::chrono::seconds(60), std::move(backend));
+
+		report(name + ", uncached", measure(iterations, [&]() {
+			if (!cache.open(kc_path, crypto::hash_password(password))) std::abort();
+		}));
+		report(name + ", cached", measure(iterations, [&]() {
+			if (!cache.open(kc_path)) std::abort();
+		}));
+
+		cache.forget(kc_path);
+	}
+
+	std::filesystem::remove_all(dir);
+	return 0;
+}
@@ -0,0 +1,146 @@
+/*
+
+Copyright (C) 2019 Mateusz Morusiewicz
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#include <src/agent/client.h>
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace agent {
+
+namespace {
+
+Response checked(Response response) {
+	if (response.status != Status::Ok) throw std::runtime_error(response.error);
+	return response;
+}
+
+} // namespace
+
+Client::Client(const std::filesystem::path &socket_path) {
+	sockaddr_un addr{};
+	addr.sun_family = AF_UNIX;
+	if (socket_path.string().size() >= sizeof(addr.sun_path)) {
+		throw std::runtime_error("socket path too long: " + socket_path.string());
+	}
+	std::strncpy(addr.sun_path, socket_path.c_str(), sizeof(addr.sun_path) - 1);
+
+	fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (fd < 0 || connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0) {
+		std::string reason = std::strerror(errno);
+		if (fd >= 0) close(fd);
+		throw std::runtime_error("could not connect to agent at " + socket_path.string() + ": " +
+		                         reason);
+	}
+}
+
+Client::~Client() {
+	if (fd >= 0) close(fd);
+}
+
+uint32_t Client::send(Request request) {
+	request.id = next_id++;
+	encode(request, out);
+	return request.id;
+}
+
+void Client::flush() {
+	size_t offset = 0;
+	while (offset < out.size()) {
+		ssize_t n = ::send(fd, out.data() + offset, out.size() - offset, MSG_NOSIGNAL);
+		if (n < 0) {
+			if (errno == EINTR) continue;
+			throw std::runtime_error(
+			    std::string("could not send request: ") + std::strerror(errno));
+		}
+		offset += n;
+	}
+
+	out.clear();
+}
+
+Response Client::read_response() {
+	std::array<char, 16 * 1024> chunk;
+	while (true) {
+		if (auto payload = reader.next()) return decode_response(*payload);
+
+		ssize_t n = read(fd, chunk.data(), chunk.size());
+		if (n < 0 && errno == EINTR) continue;
+		if (n <= 0) throw std::runtime_error("agent closed the connection");
+
+		reader.feed(chunk.data(), n);
+		utils::secure_zero(chunk.data(), n);
+	}
+}
+
+Response Client::receive() {
+	flush();
+	if (!stashed.empty()) {
+		Response response = std::move(stashed.front());
+		stashed.pop_front();
+		return response;
+	}
+
+	return read_response();
+}
+
+Response Client::receive(uint32_t id) {
+	flush();
+	auto it = std::find_if(stashed.begin(), stashed.end(),
+	    [id](const Response &response) { return response.id == id; });
+	if (it != stashed.end()) {
+		Response response = std::move(*it);
+		stashed.erase(it);
+		return response;
+	}
+
+	while (true) {
+		Response response = read_response();
+		if (response.id == id) return response;
+		stashed.push_back(std::move(response));
+	}
+}
+
+utils::sensitive_string Client::derive(uint32_t dpath) {
+	Request request;
+	request.type = RequestType::Derive;
+	request.dpath = dpath;
+	return checked(receive(send(std::move(request)))).secret;
+}
+
+utils::sensitive_string Client::lookup(const std::string &path) {
+	return checked(receive(send({0, RequestType::Lookup, path, 0}))).secret;
+}
+
+std::vector<ListItem> Client::list(const std::string &path) {
+	return checked(receive(send({0, RequestType::List, path, 0}))).items;
+}
+
+std::vector<EntryInfo> Client::entries() {
+	return checked(receive(send({0, RequestType::Entries, "", 0}))).entries;
+}
+
+} // namespace agent
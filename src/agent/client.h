@@ -0,0 +1,64 @@
+/*
+
+Copyright (C) 2019 Mateusz Morusiewicz
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#pragma once
+
+#include <src/agent/protocol.h>
+
+#include <deque>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+namespace agent {
+
+/* Blocking client. Requests are buffered by send() and written on flush() or the next receive(),
+ * so any number of them can be pipelined over one round trip. */
+class Client {
+	int fd = -1;
+	uint32_t next_id = 1;
+	FrameReader reader;
+	std::vector<char> out;
+	std::deque<Response> stashed; // received while waiting for another id
+
+	Response read_response();
+
+  public:
+	explicit Client(const std::filesystem::path &socket_path = default_socket_path());
+	~Client();
+
+	Client(const Client &) = delete;
+	Client &operator=(const Client &) = delete;
+
+	/* assigns and returns the request id */
+	uint32_t send(Request request);
+	void flush();
+
+	/* the next response, in whatever order the agent completes them */
+	Response receive();
+	Response receive(uint32_t id);
+
+	/* single round trips, throw std::runtime_error for anything but Status::Ok */
+	utils::sensitive_string derive(uint32_t dpath);
+	utils::sensitive_string lookup(const std::string &path);
+	std::vector<ListItem> list(const std::string &path);
+	std::vector<EntryInfo> entries();
+};
+
+} // namespace agent
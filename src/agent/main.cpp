@@ -0,0 +1,101 @@
+/*
+
+Copyright (C) 2019 Mateusz Morusiewicz
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#include <src/agent/server.h>
+
+#include <src/cli/password_prompt.h>
+#include <src/crypto/crypto.h>
+#include <src/keychain/keychain.h>
+#include <src/keychain/utils.h>
+#include <src/utils/diagnostics.h>
+
+#include <external/p-ranav/argparse/include/argparse.hpp>
+
+#include <csignal>
+#include <iostream>
+
+namespace {
+
+agent::Server *running_server = nullptr;
+
+void on_signal(int) {
+	if (running_server) running_server->stop();
+}
+
+} // namespace
+
+int main(int argc, const char *argv[]) {
+	utils::Diagnostics diagnostics(argc, argv);
+
+	argparse::ArgumentParser program("hdpwm-agent");
+
+	program.add_argument("-p", "--path")
+	    .help("path to keychain data directory")
+	    .default_value(std::string{"~/.hdpwm"});
+	program.add_argument("-s", "--socket")
+	    .help("path of the socket to listen on")
+	    .default_value(agent::default_socket_path().string());
+	program.add_argument("-j", "--workers")
+	    .help("number of worker threads, 0 for one per core")
+	    .default_value(0)
+	    .action([](const std::string &value) { return std::stoi(value); });
+
+	try {
+		program.parse_args(argc, argv);
+	} catch (const std::runtime_error &err) {
+		if (err.what() == std::string_view{"help called"}) {
+			std::cout << program;
+			return 0;
+		}
+		std::cout << err.what() << std::endl;
+		std::cout << program;
+		return 1;
+	}
+
+	auto kc_path = keychain::expand_path(program.get<std::string>("--path"));
+	if (!keychain::can_import_db_from_path(kc_path)) {
+		std::cerr << "No keychain at " << kc_path << std::endl;
+		return 1;
+	}
+
+	agent::ServerOptions options;
+	options.socket_path = program.get<std::string>("--socket");
+	options.n_workers = program.get<int>("--workers");
+
+	try {
+		auto pw_hash = crypto::hash_password(cli::prompt_password("Encryption phrase: "));
+		agent::Server server(keychain::Keychain::open(kc_path, std::move(pw_hash)), options);
+
+		running_server = &server;
+		std::signal(SIGINT, on_signal);
+		std::signal(SIGTERM, on_signal);
+
+		/* same shape as ssh-agent, so that the output can be eval'd */
+		std::cout << "HDPWM_AGENT_SOCK=" << server.socket_path().string()
+		          << "; export HDPWM_AGENT_SOCK;" << std::endl;
+
+		server.run();
+		running_server = nullptr;
+	} catch (const std::exception &e) {
+		std::cerr << e.what() << std::endl;
+		return 1;
+	}
+
+	return 0;
+}
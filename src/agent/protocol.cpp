@@ -0,0 +1,249 @@
+/*
+
+Copyright (C) 2019 Mateusz Morusiewicz
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#include <src/agent/protocol.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+
+#include <unistd.h>
+
+namespace agent {
+
+namespace {
+
+void put_u8(std::vector<char> &out, uint8_t v) { out.push_back(static_cast<char>(v)); }
+
+void put_u16(std::vector<char> &out, uint16_t v) {
+	put_u8(out, v >> 8);
+	put_u8(out, v & 0xff);
+}
+
+void put_u32(std::vector<char> &out, uint32_t v) {
+	put_u16(out, v >> 16);
+	put_u16(out, v & 0xffff);
+}
+
+void put_bytes(std::vector<char> &out, const char *data, size_t size) {
+	out.insert(out.end(), data, data + size);
+}
+
+/* names and paths carry a u16 length, longer ones can't be sent rather than being cut */
+void put_short_string(std::vector<char> &out, const std::string &str) {
+	if (str.size() > std::numeric_limits<uint16_t>::max()) throw ProtocolError("name too long");
+	put_u16(out, str.size());
+	put_bytes(out, str.data(), str.size());
+}
+
+/* reserves the length prefix and fills it in once the payload is written */
+template <typename F> void put_frame(std::vector<char> &out, F &&write_payload) {
+	const size_t header = out.size();
+	put_u32(out, 0);
+	try {
+		write_payload();
+	} catch (...) {
+		out.resize(header);
+		throw;
+	}
+
+	const size_t size = out.size() - header - FRAME_HEADER_SIZE;
+	if (size > MAX_FRAME_SIZE) {
+		out.resize(header);
+		throw ProtocolError("frame too large");
+	}
+
+	for (int i = 0; i < 4; ++i) {
+		out[header + i] = static_cast<char>((size >> (8 * (3 - i))) & 0xff);
+	}
+}
+
+class Cursor {
+	std::string_view data;
+
+  public:
+	explicit Cursor(std::string_view data) : data(data) {}
+
+	bool empty() const { return data.empty(); }
+
+	std::string_view bytes(size_t n) {
+		if (data.size() < n) throw ProtocolError("truncated message");
+		auto rv = data.substr(0, n);
+		data.remove_prefix(n);
+		return rv;
+	}
+
+	std::string_view rest() { return bytes(data.size()); }
+
+	uint8_t u8() { return static_cast<uint8_t>(bytes(1)[0]); }
+
+	uint16_t u16() {
+		const uint16_t high = u8();
+		return (high << 8) | u8();
+	}
+
+	uint32_t u32() {
+		const uint32_t high = u16();
+		return (high << 16) | u16();
+	}
+};
+
+RequestType request_type(uint8_t type) {
+	if (type < static_cast<uint8_t>(RequestType::Lookup) ||
+	    type > static_cast<uint8_t>(RequestType::Entries)) {
+		throw ProtocolError("unknown request type");
+	}
+
+	return static_cast<RequestType>(type);
+}
+
+} // namespace
+
+void encode(const Request &request, std::vector<char> &out) {
+	put_frame(out, [&]() {
+		put_u32(out, request.id);
+		put_u8(out, static_cast<uint8_t>(request.type));
+		if (request.type == RequestType::Derive) {
+			put_u32(out, request.dpath);
+		} else if (request.type != RequestType::Entries) {
+			put_bytes(out, request.path.data(), request.path.size());
+		}
+	});
+}
+
+void encode(const Response &response, std::vector<char> &out) {
+	put_frame(out, [&]() {
+		put_u32(out, response.id);
+		put_u8(out, static_cast<uint8_t>(response.type));
+		put_u8(out, static_cast<uint8_t>(response.status));
+
+		if (response.status != Status::Ok) {
+			put_bytes(out, response.error.data(), response.error.size());
+		} else if (response.type == RequestType::List) {
+			put_u32(out, response.items.size());
+			for (const auto &item : response.items) {
+				put_u8(out, item.is_dir);
+				put_short_string(out, item.name);
+			}
+		} else if (response.type == RequestType::Entries) {
+			put_u32(out, response.entries.size());
+			for (const auto &entry : response.entries) {
+				put_u32(out, entry.dpath);
+				put_short_string(out, entry.path);
+				put_u32(out, entry.details.size());
+				put_bytes(out, entry.details.data(), entry.details.size());
+			}
+		} else {
+			put_bytes(out, response.secret.data(), response.secret.size());
+		}
+	});
+}
+
+Request decode_request(std::string_view payload) {
+	Cursor cursor(payload);
+
+	Request request;
+	request.id = cursor.u32();
+	request.type = request_type(cursor.u8());
+	if (request.type == RequestType::Derive) {
+		request.dpath = cursor.u32();
+		if (!cursor.empty()) throw ProtocolError("trailing bytes");
+	} else if (request.type == RequestType::Entries) {
+		if (!cursor.empty()) throw ProtocolError("trailing bytes");
+	} else {
+		request.path = std::string(cursor.rest());
+	}
+
+	return request;
+}
+
+Response decode_response(std::string_view payload) {
+	Cursor cursor(payload);
+
+	Response response;
+	response.id = cursor.u32();
+	response.type = request_type(cursor.u8());
+	response.status = static_cast<Status>(cursor.u8());
+
+	if (response.status != Status::Ok) {
+		response.error = std::string(cursor.rest());
+	} else if (response.type == RequestType::List) {
+		const uint32_t count = cursor.u32();
+		for (uint32_t i = 0; i < count; ++i) {
+			const bool is_dir = cursor.u8();
+			const uint16_t size = cursor.u16();
+			response.items.push_back({is_dir, std::string(cursor.bytes(size))});
+		}
+	} else if (response.type == RequestType::Entries) {
+		const uint32_t count = cursor.u32();
+		for (uint32_t i = 0; i < count; ++i) {
+			EntryInfo entry;
+			entry.dpath = cursor.u32();
+			entry.path = std::string(cursor.bytes(cursor.u16()));
+			entry.details = std::string(cursor.bytes(cursor.u32()));
+			response.entries.push_back(std::move(entry));
+		}
+	} else {
+		auto secret = cursor.rest();
+		response.secret = utils::sensitive_string(secret.data(), secret.size());
+	}
+
+	return response;
+}
+
+FrameReader::~FrameReader() { utils::secure_zero(buffer.data(), buffer.size()); }
+
+void FrameReader::feed(const char *data, size_t size) {
+	/* compact once the consumed prefix dominates the buffer */
+	if (consumed > 0 && consumed * 2 >= buffer.size()) {
+		const size_t remaining = buffer.size() - consumed;
+		std::memmove(buffer.data(), buffer.data() + consumed, remaining);
+		utils::secure_zero(buffer.data() + remaining, consumed);
+		buffer.resize(remaining);
+		consumed = 0;
+	}
+
+	buffer.insert(buffer.end(), data, data + size);
+}
+
+std::optional<std::string_view> FrameReader::next() {
+	const size_t available = buffer.size() - consumed;
+	if (available < FRAME_HEADER_SIZE) return std::nullopt;
+
+	const auto *header = reinterpret_cast<const unsigned char *>(buffer.data() + consumed);
+	const uint32_t size = (uint32_t{header[0]} << 24) | (uint32_t{header[1]} << 16) |
+	                      (uint32_t{header[2]} << 8) | uint32_t{header[3]};
+	if (size > MAX_FRAME_SIZE) throw ProtocolError("frame too large");
+	if (available < FRAME_HEADER_SIZE + size) return std::nullopt;
+
+	std::string_view payload(buffer.data() + consumed + FRAME_HEADER_SIZE, size);
+	consumed += FRAME_HEADER_SIZE + size;
+	return payload;
+}
+
+std::filesystem::path default_socket_path() {
+	if (const char *sock = std::getenv("HDPWM_AGENT_SOCK"); sock && *sock) return sock;
+	if (const char *runtime_dir = std::getenv("XDG_RUNTIME_DIR"); runtime_dir && *runtime_dir) {
+		return std::filesystem::path(runtime_dir) / "hdpwm-agent.sock";
+	}
+
+	return std::filesystem::path("/tmp") / ("hdpwm-agent-" + std::to_string(getuid()) + ".sock");
+}
+
+} // namespace agent
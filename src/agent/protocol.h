@@ -0,0 +1,119 @@
+/*
+
+Copyright (C) 2019 Mateusz Morusiewicz
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#pragma once
+
+#include <src/crypto/utils.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/* Every message is a frame: a big-endian u32 payload length followed by the payload.
+ *
+ *   request:  u32 id | u8 type | body
+ *   response: u32 id | u8 type | u8 status | body
+ *
+ * Lookup and List bodies are the path, Derive carries a u32 derivation path and Entries is empty.
+ * Secrets come back as raw bytes, listings as u32 count followed by (u8 is_dir, u16 length, name)
+ * items, entry indexes as u32 count followed by (u32 dpath, u16 length, path, u32 length, details)
+ * items and errors as a message. Requests can be pipelined, responses carry the id of their
+ * request and may arrive out of order. */
+namespace agent {
+
+constexpr uint32_t MAX_FRAME_SIZE = 1024 * 1024;
+constexpr size_t FRAME_HEADER_SIZE = 4;
+
+enum class RequestType : uint8_t { Lookup = 1, Derive = 2, List = 3, Entries = 4 };
+enum class Status : uint8_t { Ok = 0, NotFound = 1, BadRequest = 2, Error = 3 };
+
+struct Request {
+	uint32_t id = 0;
+	RequestType type = RequestType::Derive;
+	std::string path{}; // Lookup, List
+	uint32_t dpath = 0; // Derive
+};
+
+struct ListItem {
+	bool is_dir;
+	std::string name;
+
+	bool operator==(const ListItem &other) const {
+		return is_dir == other.is_dir && name == other.name;
+	}
+};
+
+/* metadata of every entry in the keychain, secrets are derived separately */
+struct EntryInfo {
+	std::string path;
+	std::string details;
+	uint32_t dpath;
+
+	bool operator==(const EntryInfo &other) const {
+		return path == other.path && details == other.details && dpath == other.dpath;
+	}
+};
+
+struct Response {
+	uint32_t id = 0;
+	RequestType type = RequestType::Derive;
+	Status status = Status::Ok;
+	utils::sensitive_string secret{}; // Lookup, Derive
+	std::vector<ListItem> items{};    // List
+	std::vector<EntryInfo> entries{}; // Entries
+	std::string error{};              // any non-Ok status
+};
+
+class ProtocolError : public std::runtime_error {
+	using std::runtime_error::runtime_error;
+};
+
+/* append a whole frame to out, throw ProtocolError and leave out as it was when the message
+ * does not fit into a frame */
+void encode(const Request &request, std::vector<char> &out);
+void encode(const Response &response, std::vector<char> &out);
+
+/* payload without the length prefix, throw ProtocolError when malformed */
+Request decode_request(std::string_view payload);
+Response decode_response(std::string_view payload);
+
+/* Reassembles frames from a byte stream read in arbitrary chunks */
+class FrameReader {
+	std::vector<char> buffer;
+	size_t consumed = 0;
+
+  public:
+	~FrameReader();
+
+	void feed(const char *data, size_t size);
+
+	/* the next complete payload, valid until the next feed; throws ProtocolError on oversized
+	 * frames */
+	std::optional<std::string_view> next();
+};
+
+/* $HDPWM_AGENT_SOCK, else hdpwm-agent.sock in $XDG_RUNTIME_DIR or /tmp */
+std::filesystem::path default_socket_path();
+
+} // namespace agent
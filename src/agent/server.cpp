@@ -0,0 +1,401 @@
+/*
+
+Copyright (C) 2019 Mateusz Morusiewicz
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#include <src/agent/server.h>
+
+#include <array>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace agent {
+
+namespace {
+
+constexpr uint64_t LISTEN_ID = 0;
+constexpr uint64_t WAKE_ID = 1;
+constexpr int MAX_EVENTS = 64;
+constexpr size_t READ_CHUNK = 16 * 1024;
+
+void collect_entries(const keychain::Directory::ptr &dir, const std::string &prefix,
+    std::vector<EntryInfo> &out) {
+	for (const auto &entry : dir->entries) {
+		out.push_back({prefix + entry->meta.name, entry->meta.details,
+		    static_cast<uint32_t>(entry->meta.dpath.seed)});
+	}
+	for (const auto &child : dir->dirs) {
+		collect_entries(child, prefix + child->meta.name + "/", out);
+	}
+}
+
+/* the first entry found with each derivation path, pasted copies share it */
+void collect_dpaths(
+    const keychain::Directory::ptr &dir, std::unordered_map<int, keychain::Entry::ptr> &out) {
+	for (const auto &entry : dir->entries) {
+		out.emplace(entry->meta.dpath.seed, entry);
+	}
+	for (const auto &child : dir->dirs) {
+		collect_dpaths(child, out);
+	}
+}
+
+std::runtime_error system_error(const std::string &what) {
+	return std::runtime_error(what + ": " + std::strerror(errno));
+}
+
+sockaddr_un socket_address(const std::filesystem::path &path) {
+	sockaddr_un addr{};
+	addr.sun_family = AF_UNIX;
+	if (path.string().size() >= sizeof(addr.sun_path)) {
+		throw std::runtime_error("socket path too long: " + path.string());
+	}
+
+	std::strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+	return addr;
+}
+
+/* refuses to replace the socket of an agent that is still running */
+void remove_stale_socket(const std::filesystem::path &path) {
+	if (!std::filesystem::exists(path)) return;
+
+	int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (fd < 0) return; // the listening socket can't be created either, and says why
+	sockaddr_un addr = socket_address(path);
+	bool alive = connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) == 0;
+	close(fd);
+
+	if (alive) throw std::runtime_error("an agent is already listening on " + path.string());
+	std::filesystem::remove(path);
+}
+
+} // namespace
+
+Server::Descriptor::~Descriptor() {
+	if (fd >= 0) close(fd);
+}
+
+int Server::Descriptor::reset(int fd) {
+	if (this->fd >= 0) close(this->fd);
+	return this->fd = fd;
+}
+
+Server::SocketFile::~SocketFile() {
+	std::error_code ec;
+	if (!path.empty()) std::filesystem::remove(path, ec);
+}
+
+Server::Server(std::unique_ptr<keychain::Keychain> kc, ServerOptions options) :
+    kc(std::move(kc)), options(std::move(options)),
+    next_connection_id(WAKE_ID + 1),
+    pool(std::make_unique<utils::WorkStealingPool>(this->options.n_workers)) {
+	this->kc->snapshot(); // fail early on an unreadable keychain
+
+	remove_stale_socket(this->options.socket_path);
+
+	if (listen_fd.reset(socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0)) < 0) {
+		throw system_error("could not create socket");
+	}
+
+	sockaddr_un addr = socket_address(this->options.socket_path);
+	mode_t old_umask = umask(0177); // owner only, like ssh-agent
+	int bound = bind(listen_fd.get(), reinterpret_cast<sockaddr *>(&addr), sizeof(addr));
+	umask(old_umask);
+	if (bound == 0) socket_file.path = this->options.socket_path;
+
+	if (bound != 0 || listen(listen_fd.get(), SOMAXCONN) != 0) {
+		throw system_error("could not listen on " + this->options.socket_path.string());
+	}
+
+	if (epoll_fd.reset(epoll_create1(EPOLL_CLOEXEC)) < 0 ||
+	    wake_fd.reset(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) < 0) {
+		throw system_error("could not set up the reactor");
+	}
+
+	epoll_event ev{};
+	ev.events = EPOLLIN;
+	ev.data.u64 = LISTEN_ID;
+	epoll_ctl(epoll_fd.get(), EPOLL_CTL_ADD, listen_fd.get(), &ev);
+	ev.data.u64 = WAKE_ID;
+	epoll_ctl(epoll_fd.get(), EPOLL_CTL_ADD, wake_fd.get(), &ev);
+}
+
+Server::~Server() {
+	pool.reset();
+
+	for (auto &[id, connection] : connections) {
+		utils::secure_zero(connection.out.data(), connection.out.size());
+		close(connection.fd);
+	}
+}
+
+void Server::stop() {
+	stopping = true;
+	uint64_t one = 1;
+	(void)!write(wake_fd.get(), &one, sizeof(one));
+}
+
+void Server::run() {
+	std::array<epoll_event, MAX_EVENTS> events;
+
+	while (!stopping) {
+		int n = epoll_wait(epoll_fd.get(), events.data(), events.size(), -1);
+		if (n < 0) {
+			if (errno == EINTR) continue;
+			throw system_error("epoll_wait failed");
+		}
+
+		for (int i = 0; i < n; ++i) {
+			const uint64_t id = events[i].data.u64;
+			const uint32_t flags = events[i].events;
+
+			if (id == LISTEN_ID) {
+				accept_connections();
+			} else if (id == WAKE_ID) {
+				uint64_t count;
+				(void)!read(wake_fd.get(), &count, sizeof(count));
+				deliver_completed();
+			} else {
+				if (flags & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) read_requests(id);
+				if (flags & EPOLLOUT) flush(id);
+			}
+		}
+	}
+}
+
+void Server::accept_connections() {
+	while (true) {
+		int fd = accept4(listen_fd.get(), nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+		if (fd < 0) return; // EAGAIN, or the client went away already
+
+		const uint64_t id = next_connection_id++;
+		connections.emplace(id, Connection{fd, {}, {}, 0, false});
+
+		epoll_event ev{};
+		ev.events = EPOLLIN | EPOLLRDHUP;
+		ev.data.u64 = id;
+		epoll_ctl(epoll_fd.get(), EPOLL_CTL_ADD, fd, &ev);
+	}
+}
+
+void Server::read_requests(uint64_t id) {
+	auto it = connections.find(id);
+	if (it == connections.end()) return;
+	Connection &connection = it->second;
+
+	std::array<char, READ_CHUNK> chunk;
+	bool closed = false;
+	while (true) {
+		ssize_t n = read(connection.fd, chunk.data(), chunk.size());
+		if (n > 0) {
+			connection.reader.feed(chunk.data(), n);
+			continue;
+		}
+
+		closed = n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR);
+		break;
+	}
+	utils::secure_zero(chunk.data(), chunk.size());
+
+	try {
+		while (auto payload = connection.reader.next()) {
+			pool->submit([this, id, request = decode_request(*payload)]() {
+				std::vector<char> frame;
+				try {
+					encode(handle(request), frame);
+				} catch (const std::exception &e) {
+					/* e.g. a listing too large for a frame, the agent has to survive it */
+					Response response;
+					response.id = request.id;
+					response.type = request.type;
+					response.status = Status::Error;
+					response.error = e.what();
+					encode(response, frame);
+				}
+
+				{
+					std::unique_lock<std::mutex> lk(completed_mutex);
+					completed.emplace_back(id, std::move(frame));
+				}
+
+				uint64_t one = 1;
+				(void)!write(wake_fd.get(), &one, sizeof(one));
+			});
+		}
+	} catch (const ProtocolError &) {
+		closed = true; // there is no way to resynchronize with the stream
+	}
+
+	/* responses still in flight are dropped with the connection */
+	if (closed) close_connection(id);
+}
+
+void Server::deliver_completed() {
+	decltype(completed) batch;
+	{
+		std::unique_lock<std::mutex> lk(completed_mutex);
+		batch.swap(completed);
+	}
+
+	for (auto &[id, frame] : batch) {
+		if (auto it = connections.find(id); it != connections.end()) {
+			auto &out = it->second.out;
+			out.insert(out.end(), frame.begin(), frame.end());
+		}
+		utils::secure_zero(frame.data(), frame.size());
+	}
+
+	/* one write per connection for everything that completed meanwhile */
+	for (auto &[id, frame] : batch) {
+		flush(id);
+	}
+}
+
+void Server::flush(uint64_t id) {
+	auto it = connections.find(id);
+	if (it == connections.end()) return;
+	Connection &connection = it->second;
+
+	while (connection.out_offset < connection.out.size()) {
+		ssize_t n = send(connection.fd, connection.out.data() + connection.out_offset,
+		    connection.out.size() - connection.out_offset, MSG_NOSIGNAL);
+		if (n >= 0) {
+			connection.out_offset += n;
+			continue;
+		}
+
+		if (errno == EINTR) continue;
+		if (errno == EAGAIN || errno == EWOULDBLOCK) return watch(id, true);
+		return close_connection(id);
+	}
+
+	utils::secure_zero(connection.out.data(), connection.out.size());
+	connection.out.clear();
+	connection.out_offset = 0;
+	watch(id, false);
+}
+
+void Server::watch(uint64_t id, bool want_write) {
+	Connection &connection = connections.at(id);
+	if (connection.want_write == want_write) return;
+
+	connection.want_write = want_write;
+	epoll_event ev{};
+	ev.events = EPOLLIN | EPOLLRDHUP;
+	if (want_write) ev.events |= EPOLLOUT;
+	ev.data.u64 = id;
+	epoll_ctl(epoll_fd.get(), EPOLL_CTL_MOD, connection.fd, &ev);
+}
+
+void Server::close_connection(uint64_t id) {
+	auto it = connections.find(id);
+	if (it == connections.end()) return;
+
+	epoll_ctl(epoll_fd.get(), EPOLL_CTL_DEL, it->second.fd, nullptr);
+	close(it->second.fd);
+	utils::secure_zero(it->second.out.data(), it->second.out.size());
+	connections.erase(it);
+}
+
+keychain::Entry::ptr Server::entry_with_dpath(int dpath) {
+	const auto snapshot = kc->snapshot();
+
+	std::shared_ptr<const DpathIndex> index;
+	{
+		/* built by the first derivation that sees a new snapshot, the others wait for it */
+		std::lock_guard<std::mutex> lock(dpath_index_mutex);
+		if (!dpath_index || dpath_index->version < snapshot->version) {
+			auto fresh = std::make_shared<DpathIndex>();
+			fresh->version = snapshot->version;
+			collect_dpaths(snapshot->root, fresh->entries);
+			dpath_index = std::move(fresh);
+		}
+		index = dpath_index;
+	}
+
+	auto it = index->entries.find(dpath);
+	return it == index->entries.end() ? nullptr : it->second;
+}
+
+Response Server::handle(const Request &request) {
+	Response response;
+	response.id = request.id;
+	response.type = request.type;
+
+	auto fail = [&response](Status status, std::string error) {
+		response.status = status;
+		response.error = std::move(error);
+		return std::move(response);
+	};
+
+	try {
+		if (request.type == RequestType::Derive) {
+			const crypto::DerivationPath dpath{static_cast<int>(request.dpath)};
+			response.secret = kc->derive_secret(dpath);
+
+			/* paths of no entry would only push entries out of the access log */
+			if (auto entry = entry_with_dpath(dpath.seed)) {
+				kc->access_log().record(dpath, keychain::path_of(entry));
+			}
+			return response;
+		}
+
+		/* lookups never touch the db, they see whatever version is current */
+		const auto snapshot = kc->snapshot();
+		if (request.type == RequestType::Entries) {
+			collect_entries(snapshot->root, "", response.entries);
+			return response;
+		}
+
+		auto node = keychain::find_by_path(snapshot->root, request.path);
+		if (!node) return fail(Status::NotFound, "no such path: " + request.path);
+
+		if (request.type == RequestType::Lookup) {
+			auto entry = std::get_if<keychain::Entry::ptr>(&*node);
+			if (!entry) return fail(Status::BadRequest, "not an entry: " + request.path);
+
+			response.secret = kc->derive_secret((*entry)->meta.dpath);
+			kc->access_log().record((*entry)->meta.dpath, keychain::path_of(*entry));
+			return response;
+		}
+
+		auto dir = std::get_if<keychain::Directory::ptr>(&*node);
+		if (!dir) return fail(Status::BadRequest, "not a directory: " + request.path);
+
+		for (const auto &child : (*dir)->dirs) {
+			response.items.push_back({true, child->meta.name});
+		}
+		for (const auto &child : (*dir)->entries) {
+			response.items.push_back({false, child->meta.name});
+		}
+		return response;
+	} catch (const std::exception &e) {
+		return fail(Status::Error, e.what());
+	}
+}
+
+} // namespace agent
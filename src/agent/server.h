@@ -0,0 +1,128 @@
+/*
+
+Copyright (C) 2019 Mateusz Morusiewicz
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#pragma once
+
+#include <src/agent/protocol.h>
+
+#include <src/keychain/keychain.h>
+#include <src/utils/thread_pool.h>
+
+#include <atomic>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace agent {
+
+struct ServerOptions {
+	std::filesystem::path socket_path = default_socket_path();
+	size_t n_workers = 0; // 0 means one per core
+};
+
+/* Serves secrets of an unlocked keychain over a Unix socket. A single epoll reactor owns all
+ * connections; requests are decoded on it and handed to the worker pool, workers post encoded
+ * responses back and wake the reactor through an eventfd. */
+class Server {
+	struct Connection {
+		int fd;
+		FrameReader reader;
+		std::vector<char> out;
+		size_t out_offset = 0;
+		bool want_write = false;
+	};
+
+	/* closed when the server goes away, or when its constructor throws halfway */
+	class Descriptor {
+		int fd = -1;
+
+	  public:
+		Descriptor() = default;
+		~Descriptor();
+
+		Descriptor(const Descriptor &) = delete;
+		Descriptor &operator=(const Descriptor &) = delete;
+
+		/* takes ownership, -1 is kept as is so that errno can be checked */
+		int reset(int fd);
+		int get() const { return fd; }
+	};
+
+	/* the socket file, removed once the listening socket is closed */
+	struct SocketFile {
+		std::filesystem::path path;
+		~SocketFile();
+	};
+
+	std::unique_ptr<keychain::Keychain> kc;
+	ServerOptions options;
+
+	SocketFile socket_file;
+	Descriptor listen_fd;
+	Descriptor epoll_fd;
+	Descriptor wake_fd;
+	std::atomic<bool> stopping{false};
+
+	uint64_t next_connection_id;
+	std::unordered_map<uint64_t, Connection> connections; // reactor thread only
+
+	std::mutex completed_mutex;
+	std::vector<std::pair<uint64_t, std::vector<char>>> completed;
+
+	/* entries by derivation path, for logging derivations without walking the tree each time */
+	struct DpathIndex {
+		uint64_t version;
+		std::unordered_map<int, keychain::Entry::ptr> entries;
+	};
+	std::mutex dpath_index_mutex;
+	std::shared_ptr<const DpathIndex> dpath_index; // of the newest snapshot seen
+
+	/* joined first thing in the destructor, workers use everything above */
+	std::unique_ptr<utils::WorkStealingPool> pool;
+
+	keychain::Entry::ptr entry_with_dpath(int dpath);
+	Response handle(const Request &request);
+
+	void accept_connections();
+	void read_requests(uint64_t id);
+	void deliver_completed();
+	void flush(uint64_t id);
+	void close_connection(uint64_t id);
+	void watch(uint64_t id, bool want_write);
+
+  public:
+	Server(std::unique_ptr<keychain::Keychain> kc, ServerOptions options = {});
+	~Server();
+
+	Server(const Server &) = delete;
+	Server &operator=(const Server &) = delete;
+
+	const std::filesystem::path &socket_path() const { return options.socket_path; }
+
+	/* blocks until stop() */
+	void run();
+
+	/* async-signal-safe, may be called from any thread */
+	void stop();
+};
+
+} // namespace agent
@@ -0,0 +1,397 @@
+/*
+
+Copyright (C) 2019 Mateusz Morusiewicz
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#include <src/cli/commands.h>
+
+#include <src/cli/common.h>
+#include <src/cli/derive.h>
+
+#include <src/crypto/locked_memory.h>
+#include <src/keychain/tag_index.h>
+#include <src/keychain/utils.h>
+#include <src/utils/memory.h>
+
+#include <external/nlohmann/json_single_include.h>
+
+#include <array>
+#include <filesystem>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace cli {
+
+namespace {
+
+using json = nlohmann::json;
+
+constexpr std::array<std::pair<std::string_view, Command>, 10> COMMANDS{{
+    {"ls", ls_command},
+    {"get", get_command},
+    {"add", add_command},
+    {"mv", mv_command},
+    {"rm", rm_command},
+    {"export", export_command},
+    {"import", import_command},
+    {"derive", derive_command},
+    {"lock", lock_command},
+    {"stats", stats_command},
+}};
+
+/* one record per line, so tabs and newlines in free text are escaped */
+std::string tsv_escape(const std::string &field) {
+	std::string rv;
+	rv.reserve(field.size());
+	for (char c : field) {
+		switch (c) {
+		case '\t': rv += "\\t"; break;
+		case '\n': rv += "\\n"; break;
+		case '\\': rv += "\\\\"; break;
+		default: rv += c;
+		}
+	}
+	return rv;
+}
+
+std::string join_path(const std::string &prefix, const std::string &name) {
+	return prefix.empty() ? name : prefix + "/" + name;
+}
+
+json entry_item(const keychain::Entry::ptr &entry, const std::string &path) {
+	json rv = {{"type", "entry"}, {"path", path}, {"dpath", entry->meta.dpath.seed},
+	    {"details", entry->meta.details}};
+	if (!entry->meta.tags.empty()) rv["tags"] = entry->meta.tags;
+	return rv;
+}
+
+/* with ids set only the entries among them are listed, and no directories */
+void list_directory(const keychain::Directory::ptr &dir, const std::string &prefix, bool recursive,
+    const utils::RoaringBitmap *ids, json &out) {
+	for (const auto &child : dir->dirs) {
+		const auto path = join_path(prefix, child->meta.name);
+		if (!ids) {
+			out.push_back({{"type", "dir"}, {"path", path}, {"details", child->meta.details}});
+		}
+		if (recursive) list_directory(child, path, recursive, ids, out);
+	}
+	for (const auto &entry : dir->entries) {
+		if (ids && !ids->contains(entry->meta.id)) continue;
+		out.push_back(entry_item(entry, join_path(prefix, entry->meta.name)));
+	}
+}
+
+keychain::Entry::ptr find_entry(const keychain::Directory::ptr &root, const std::string &path) {
+	auto node = keychain::find_by_path(root, path);
+	auto entry = node ? std::get_if<keychain::Entry::ptr>(&*node) : nullptr;
+	if (!entry) throw std::runtime_error((node ? "not an entry: " : "no such entry: ") + path);
+	return *entry;
+}
+
+/* runs body and turns exceptions into an error message and exit code 1 */
+template <typename F> int guarded(F &&body) {
+	try {
+		body();
+		return 0;
+	} catch (const std::exception &e) {
+		std::cerr << e.what() << std::endl;
+		return 1;
+	}
+}
+
+} // namespace
+
+std::optional<Command> find_command(std::string_view name) {
+	for (const auto &[command_name, command] : COMMANDS) {
+		if (command_name == name) return command;
+	}
+	return std::nullopt;
+}
+
+int ls_command(int argc, const char *argv[]) {
+	argparse::ArgumentParser program("hdpmanager ls");
+	add_keychain_arguments(program);
+	add_format_argument(program);
+	program.add_argument("keychain_path").help("directory to list").default_value(std::string{});
+	program.add_argument("-r", "--recursive")
+	    .help("list subdirectories too")
+	    .default_value(false)
+	    .implicit_value(true);
+	program.add_argument("--filter")
+	    .help("only entries with matching tags, e.g. \"prod & !legacy\"; implies -r")
+	    .default_value(std::string{});
+
+	if (auto exit_code = parse_arguments(program, argc, argv)) return *exit_code;
+
+	return guarded([&program]() {
+		const auto format = get_format(program);
+		const auto path = program.get<std::string>("keychain_path");
+		const auto filter = program.get<std::string>("--filter");
+
+		auto kc = unlock_keychain(program);
+		const auto snapshot = kc->snapshot();
+		auto node = keychain::find_by_path(snapshot->root, path);
+		if (!node) throw std::runtime_error("no such path: " + path);
+
+		std::optional<utils::RoaringBitmap> ids;
+		if (!filter.empty()) ids = snapshot->tags->query(filter);
+
+		json items = json::array();
+		if (auto dir = std::get_if<keychain::Directory::ptr>(&*node)) {
+			std::string prefix = path;
+			while (!prefix.empty() && prefix.front() == '/') prefix.erase(0, 1);
+			while (!prefix.empty() && prefix.back() == '/') prefix.pop_back();
+			const bool recursive = ids || program.get<bool>("--recursive");
+			list_directory(*dir, prefix, recursive, ids ? &*ids : nullptr, items);
+		} else {
+			const auto &entry = std::get<keychain::Entry::ptr>(*node);
+			if (!ids || ids->contains(entry->meta.id)) {
+				items.push_back(entry_item(entry, path));
+			}
+		}
+
+		if (format == Format::Json) {
+			std::cout << items.dump() << std::endl;
+			return;
+		}
+
+		for (const auto &item : items) {
+			std::cout << item["type"].get<std::string>() << '\t'
+			          << tsv_escape(item["path"].get<std::string>()) << '\t'
+			          << (item.contains("dpath") ? std::to_string(item["dpath"].get<int>()) : "")
+			          << '\t' << tsv_escape(item["details"].get<std::string>()) << '\n';
+		}
+	});
+}
+
+int get_command(int argc, const char *argv[]) {
+	argparse::ArgumentParser program("hdpmanager get");
+	add_keychain_arguments(program);
+	add_format_argument(program);
+	program.add_argument("keychain_path").help("entry to derive the secret of");
+
+	if (auto exit_code = parse_arguments(program, argc, argv)) return *exit_code;
+
+	return guarded([&program]() {
+		const auto format = get_format(program);
+		const auto path = program.get<std::string>("keychain_path");
+
+		auto kc = unlock_keychain(program);
+		const auto entry = find_entry(kc->snapshot()->root, path);
+		auto secret = kc->derive_secret(entry->meta.dpath);
+		kc->access_log().record(entry->meta.dpath, keychain::path_of(entry));
+
+		if (format == Format::Json) {
+			json out = {{"path", path}, {"secret", std::string(secret.c_str(), secret.size())}};
+			std::string serialized = out.dump();
+			std::cout << serialized << std::endl;
+			utils::secure_zero_string(std::move(serialized));
+			utils::secure_zero_string(std::move(out["secret"].get_ref<std::string &>()));
+		} else {
+			std::cout.write(secret.c_str(), secret.size());
+			std::cout << std::endl;
+		}
+	});
+}
+
+int add_command(int argc, const char *argv[]) {
+	argparse::ArgumentParser program("hdpmanager add");
+	add_keychain_arguments(program);
+	program.add_argument("keychain_path").help("path of the new entry or directory");
+	program.add_argument("-d", "--details").help("free text details").default_value(std::string{});
+	program.add_argument("-t", "--tags")
+	    .help("comma or space separated tags of the entry")
+	    .default_value(std::string{});
+	program.add_argument("--dir")
+	    .help("create a directory instead of an entry")
+	    .default_value(false)
+	    .implicit_value(true);
+
+	if (auto exit_code = parse_arguments(program, argc, argv)) return *exit_code;
+
+	return guarded([&program]() {
+		const auto path = program.get<std::string>("keychain_path");
+		const auto details = program.get<std::string>("--details");
+		auto tags = keychain::parse_tags(program.get<std::string>("--tags"));
+
+		const bool is_dir = program.get<bool>("--dir");
+		if (is_dir && !tags.empty()) throw std::runtime_error("directories can't be tagged");
+
+		auto kc = unlock_keychain(program);
+		if (is_dir) {
+			kc->update([&](keychain::Directory::ptr root, keychain::EntryChanges &) {
+				keychain::add_directory(root, path, details);
+			});
+		} else {
+			const auto dpath = kc->get_next_derivation_path();
+			kc->update([&](keychain::Directory::ptr root, keychain::EntryChanges &changes) {
+				auto entry = keychain::add_entry(root, path, details, dpath);
+				entry->meta.tags = std::move(tags);
+				changes.changed(*entry);
+			});
+		}
+	});
+}
+
+int mv_command(int argc, const char *argv[]) {
+	argparse::ArgumentParser program("hdpmanager mv");
+	add_keychain_arguments(program);
+	program.add_argument("source").help("entry or directory to move");
+	program.add_argument("destination").help("directory to move into, or the new path");
+
+	if (auto exit_code = parse_arguments(program, argc, argv)) return *exit_code;
+
+	return guarded([&program]() {
+		const auto source = program.get<std::string>("source");
+		const auto destination = program.get<std::string>("destination");
+
+		auto kc = unlock_keychain(program);
+		/* entries keep their ids and tags wherever they go */
+		kc->update([&](keychain::Directory::ptr root, keychain::EntryChanges &) {
+			keychain::move_by_path(root, source, destination);
+		});
+	});
+}
+
+int rm_command(int argc, const char *argv[]) {
+	argparse::ArgumentParser program("hdpmanager rm");
+	add_keychain_arguments(program);
+	program.add_argument("keychain_path").help("entry or directory to remove");
+	program.add_argument("-r", "--recursive")
+	    .help("remove non-empty directories")
+	    .default_value(false)
+	    .implicit_value(true);
+
+	if (auto exit_code = parse_arguments(program, argc, argv)) return *exit_code;
+
+	return guarded([&program]() {
+		const auto path = program.get<std::string>("keychain_path");
+		const bool recursive = program.get<bool>("--recursive");
+
+		auto kc = unlock_keychain(program);
+		kc->update([&](keychain::Directory::ptr root, keychain::EntryChanges &changes) {
+			std::visit([&changes](const auto &node) { changes.removed(*node); },
+			    keychain::remove_by_path(root, path, recursive));
+		});
+	});
+}
+
+int export_command(int argc, const char *argv[]) {
+	argparse::ArgumentParser program("hdpmanager export");
+	add_keychain_arguments(program);
+	program.add_argument("file").help("where to write the encrypted entries");
+
+	if (auto exit_code = parse_arguments(program, argc, argv)) return *exit_code;
+
+	return guarded([&program]() {
+		const std::filesystem::path file = program.get<std::string>("file");
+		if (!keychain::can_export_to_uri(file)) {
+			throw std::runtime_error("cannot export to " + file.string());
+		}
+
+		auto kc = unlock_keychain(program);
+		kc->export_to_uri(file);
+	});
+}
+
+int import_command(int argc, const char *argv[]) {
+	argparse::ArgumentParser program("hdpmanager import");
+	add_keychain_arguments(program);
+	program.add_argument("file").help("entries exported from a keychain with the same seed");
+
+	if (auto exit_code = parse_arguments(program, argc, argv)) return *exit_code;
+
+	return guarded([&program]() {
+		const std::filesystem::path file = program.get<std::string>("file");
+		if (!keychain::can_import_from_uri(file)) {
+			throw std::runtime_error("cannot import from " + file.string());
+		}
+
+		auto kc = unlock_keychain(program);
+		kc->import_from_uri(file);
+	});
+}
+
+int lock_command(int argc, const char *argv[]) {
+	argparse::ArgumentParser program("hdpmanager lock");
+	program.add_argument("-p", "--path")
+	    .help("path to keychain data directory")
+	    .default_value(std::string{"~/.hdpwm"});
+
+	if (auto exit_code = parse_arguments(program, argc, argv)) return *exit_code;
+
+	return guarded([&program]() { lock_keychain(program); });
+}
+
+int stats_command(int argc, const char *argv[]) {
+	argparse::ArgumentParser program("hdpmanager stats");
+	add_keychain_arguments(program);
+	add_format_argument(program);
+
+	if (auto exit_code = parse_arguments(program, argc, argv)) return *exit_code;
+
+	return guarded([&program]() {
+		const auto format = get_format(program);
+
+		/* what the TUI holds once it shows the keychain: the snapshot and a working copy of it */
+		auto kc = unlock_keychain(program);
+		auto root = kc->get_root_dir();
+		size_t n_dirs = 0, n_entries = 0; // root not included
+		std::vector<keychain::Directory::ptr> to_visit{root};
+		while (!to_visit.empty()) {
+			auto dir = to_visit.back();
+			to_visit.pop_back();
+			n_dirs += dir->dirs.size();
+			n_entries += dir->entries.size();
+			to_visit.insert(to_visit.end(), dir->dirs.begin(), dir->dirs.end());
+		}
+
+		json out = {{"directories", n_dirs}, {"entries", n_entries}};
+		for (auto category : utils::memory::CATEGORIES) {
+			const auto usage = utils::memory::usage(category);
+			out["memory"][utils::memory::to_string(category)] = {
+			    {"current", usage.current}, {"peak", usage.peak}};
+		}
+
+		const auto rss = utils::memory::process_rss();
+		out["memory"]["process_rss"] = {{"current", rss.current}, {"peak", rss.peak}};
+
+		const auto locked = crypto::locked_memory_stats();
+		out["locked_pages"] = {{"locked", locked.locked_bytes}, {"peak", locked.peak_locked_bytes},
+		    {"limit", locked.limit}, {"degraded", locked.degraded_pages}};
+
+		if (format == Format::Json) {
+			std::cout << out.dump() << std::endl;
+			return;
+		}
+
+		std::cout << "directories\t" << n_dirs << "\nentries\t" << n_entries << '\n';
+		for (auto category : utils::memory::CATEGORIES) {
+			const auto usage = utils::memory::usage(category);
+			std::cout << utils::memory::to_string(category) << '\t' << usage.current << '\t'
+			          << usage.peak << '\n';
+		}
+		std::cout << "process_rss\t" << rss.current << '\t' << rss.peak << '\n';
+		std::cout << "locked_pages\t" << locked.locked_bytes << '\t' << locked.peak_locked_bytes
+		          << '\n';
+	});
+}
+
+} // namespace cli
@@ -0,0 +1,46 @@
+/*
+
+Copyright (C) 2019 Mateusz Morusiewicz
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#pragma once
+
+#include <optional>
+#include <string_view>
+
+/* hdpmanager subcommands. They work on the keychain directly and never initialise curses, so
+ * they can be used from scripts. */
+namespace cli {
+
+using Command = int (*)(int argc, const char *argv[]);
+
+/* argv[0] of a command is its name */
+std::optional<Command> find_command(std::string_view name);
+
+int ls_command(int argc, const char *argv[]);
+int get_command(int argc, const char *argv[]);
+int add_command(int argc, const char *argv[]);
+int mv_command(int argc, const char *argv[]);
+int rm_command(int argc, const char *argv[]);
+int export_command(int argc, const char *argv[]);
+int import_command(int argc, const char *argv[]);
+/* forgets the cached encryption phrase, the next command asks for it again */
+int lock_command(int argc, const char *argv[]);
+/* bytes held per memory category once the keychain is loaded, current and peak */
+int stats_command(int argc, const char *argv[]);
+
+} // namespace cli
@@ -0,0 +1,106 @@
+/*
+
+Copyright (C) 2019 Mateusz Morusiewicz
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#include <src/cli/common.h>
+
+#include <src/cli/password_prompt.h>
+
+#include <src/keychain/unlock_cache.h>
+#include <src/keychain/utils.h>
+
+#include <chrono>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+namespace cli {
+
+void add_keychain_arguments(argparse::ArgumentParser &program) {
+	program.add_argument("-p", "--path")
+	    .help("path to keychain data directory")
+	    .default_value(std::string{"~/.hdpwm"});
+	program.add_argument("--password-fd")
+	    .help("read the encryption phrase from this file descriptor")
+	    .default_value(-1)
+	    .action([](const std::string &value) { return std::stoi(value); });
+	program.add_argument("--cache-timeout")
+	    .help("seconds the unlocked keychain is remembered for, 0 disables it")
+	    .default_value(static_cast<int>(keychain::DEFAULT_UNLOCK_CACHE_TIMEOUT.count()))
+	    .action([](const std::string &value) { return std::stoi(value); });
+}
+
+void add_format_argument(argparse::ArgumentParser &program) {
+	program.add_argument("-f", "--format")
+	    .help("output format, tsv or json")
+	    .default_value(std::string{"tsv"});
+}
+
+Format get_format(argparse::ArgumentParser &program) {
+	const auto format = program.get<std::string>("--format");
+	if (format == "json") return Format::Json;
+	if (format == "tsv") return Format::Tsv;
+	throw std::runtime_error("unknown format: " + format);
+}
+
+std::optional<int> parse_arguments(
+    argparse::ArgumentParser &program, int argc, const char *argv[]) {
+	try {
+		program.parse_args(argc, argv);
+	} catch (const std::runtime_error &err) {
+		if (err.what() == std::string_view{"help called"}) {
+			std::cout << program;
+			return 0;
+		}
+		std::cerr << err.what() << std::endl;
+		std::cerr << program;
+		return 1;
+	}
+
+	return std::nullopt;
+}
+
+std::unique_ptr<keychain::Keychain> unlock_keychain(
+    argparse::ArgumentParser &program, bool stdin_is_data) {
+	auto kc_path = keychain::expand_path(program.get<std::string>("--path"));
+	if (!keychain::can_import_db_from_path(kc_path)) {
+		throw std::runtime_error("No keychain at " + kc_path.string());
+	}
+
+	keychain::UnlockCache cache(std::chrono::seconds(program.get<int>("--cache-timeout")));
+
+	/* an explicitly passed phrase wins over the cached one */
+	const int password_fd = program.get<int>("--password-fd");
+	if (password_fd < 0) {
+		if (auto kc = cache.open(kc_path)) return kc;
+	}
+
+	const std::string prompt = "Encryption phrase: ";
+	auto password = password_fd >= 0 ? prompt_password(prompt, password_fd)
+	                : stdin_is_data  ? prompt_password_on_tty(prompt)
+	                                 : prompt_password(prompt);
+
+	return cache.open(kc_path, crypto::hash_password(password));
+}
+
+void lock_keychain(argparse::ArgumentParser &program) {
+	auto kc_path = keychain::expand_path(program.get<std::string>("--path"));
+	keychain::UnlockCache().forget(kc_path);
+}
+
+} // namespace cli
@@ -0,0 +1,53 @@
+/*
+
+Copyright (C) 2019 Mateusz Morusiewicz
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#pragma once
+
+#include <src/keychain/keychain.h>
+
+#include <external/p-ranav/argparse/include/argparse.hpp>
+
+#include <memory>
+#include <optional>
+
+/* Argument handling shared by the hdpmanager subcommands */
+namespace cli {
+
+enum class Format { Tsv, Json };
+
+/* -p/--path, --password-fd and --cache-timeout */
+void add_keychain_arguments(argparse::ArgumentParser &program);
+
+/* -f/--format tsv|json */
+void add_format_argument(argparse::ArgumentParser &program);
+Format get_format(argparse::ArgumentParser &program);
+
+/* exit code if the command should not go on (--help or bad arguments, usage already printed) */
+std::optional<int> parse_arguments(argparse::ArgumentParser &program, int argc, const char *argv[]);
+
+/* Opens the keychain at --path. The encryption phrase is read from --password-fd if given, else
+ * taken from the unlock cache, else read from stdin, or from the terminal for commands whose stdin
+ * carries data. Throws std::runtime_error if there is no keychain there or the phrase is wrong. */
+std::unique_ptr<keychain::Keychain> unlock_keychain(
+    argparse::ArgumentParser &program, bool stdin_is_data = false);
+
+/* drops the keychain at --path from the unlock cache */
+void lock_keychain(argparse::ArgumentParser &program);
+
+} // namespace cli
@@ -0,0 +1,235 @@
+/*
+
+Copyright (C) 2019 Mateusz Morusiewicz
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#include <src/cli/derive.h>
+
+#include <src/cli/common.h>
+
+#include <src/utils/thread_pool.h>
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <deque>
+#include <future>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace cli {
+
+namespace {
+
+struct Chunk {
+	size_t first_line = 1;
+	std::vector<std::string> items;
+};
+
+struct ChunkResult {
+	std::vector<char> records;
+	std::vector<std::string> errors;
+	size_t derived = 0;
+};
+
+std::optional<crypto::DerivationPath> resolve(
+    const keychain::Directory::ptr &root, const std::string &item, std::string &error) {
+	auto is_digit = [](unsigned char c) { return std::isdigit(c) != 0; };
+	if (!item.empty() && std::all_of(item.begin(), item.end(), is_digit)) {
+		try {
+			return crypto::DerivationPath{std::stoi(item)};
+		} catch (const std::out_of_range &) {
+			error = "derivation path out of range";
+			return std::nullopt;
+		}
+	}
+
+	auto node = keychain::find_by_path(root, item);
+	auto entry = node ? std::get_if<keychain::Entry::ptr>(&*node) : nullptr;
+	if (!entry) {
+		error = node ? "not an entry" : "no such entry";
+		return std::nullopt;
+	}
+	return (*entry)->meta.dpath;
+}
+
+ChunkResult derive_chunk(const keychain::Keychain &kc, const keychain::Directory::ptr &root,
+    const Chunk &chunk, char delimiter) {
+	ChunkResult result;
+
+	std::vector<crypto::DerivationPath> dpaths;
+	std::vector<const std::string *> items;
+	dpaths.reserve(chunk.items.size());
+	items.reserve(chunk.items.size());
+
+	for (size_t i = 0; i < chunk.items.size(); ++i) {
+		std::string error;
+		if (auto dpath = resolve(root, chunk.items[i], error)) {
+			dpaths.push_back(*dpath);
+			items.push_back(&chunk.items[i]);
+		} else {
+			result.errors.push_back("item " + std::to_string(chunk.first_line + i) + " (" +
+			                         chunk.items[i] + "): " + error);
+		}
+	}
+
+	const auto secrets = kc.derive_secrets(dpaths);
+
+	/* sized up front, so that no reallocation leaves secrets behind */
+	size_t size = 0;
+	for (size_t i = 0; i < secrets.size(); ++i) {
+		size += items[i]->size() + secrets[i].size() + 2;
+	}
+	result.records.reserve(size);
+
+	for (size_t i = 0; i < secrets.size(); ++i) {
+		result.records.insert(result.records.end(), items[i]->begin(), items[i]->end());
+		result.records.push_back('\t');
+		result.records.insert(
+		    result.records.end(), secrets[i].c_str(), secrets[i].c_str() + secrets[i].size());
+		result.records.push_back(delimiter);
+	}
+	result.derived = secrets.size();
+
+	return result;
+}
+
+void emit(ChunkResult &&result, std::ostream &out, std::ostream &err, DeriveStats &stats) {
+	out.write(result.records.data(), result.records.size());
+	utils::secure_zero(result.records.data(), result.records.size());
+
+	for (const auto &error : result.errors) {
+		err << error << '\n';
+	}
+
+	stats.records += result.derived;
+	stats.errors += result.errors.size();
+}
+
+bool read_item(std::istream &in, std::string &item, char delimiter) {
+	if (!std::getline(in, item, delimiter)) return false;
+	if (delimiter == '\n' && !item.empty() && item.back() == '\r') item.pop_back();
+	return true;
+}
+
+} // namespace
+
+DeriveStats derive_stream(const keychain::Keychain &kc, keychain::Directory::ptr root,
+    std::istream &in, std::ostream &out, std::ostream &err, const DeriveOptions &options) {
+	const auto start = std::chrono::steady_clock::now();
+	DeriveStats stats;
+	std::string item;
+	size_t line = 0;
+
+	if (!options.batch) {
+		while (read_item(in, item, options.delimiter)) {
+			Chunk chunk{++line, {item}};
+			emit(derive_chunk(kc, root, chunk, options.delimiter), out, err, stats);
+			out.flush();
+		}
+	} else {
+		std::deque<std::future<ChunkResult>> in_flight; // in input order
+		utils::WorkStealingPool pool(options.n_threads);
+
+		/* enough chunks to keep every worker busy while the oldest one is written out */
+		const size_t max_in_flight = 2 * pool.size() + 1;
+		const size_t chunk_size = std::max<size_t>(1, options.chunk_size);
+
+		auto submit = [&](Chunk chunk) {
+			auto task = std::make_shared<std::packaged_task<ChunkResult()>>(
+			    [&kc, root, chunk = std::move(chunk), delimiter = options.delimiter]() {
+				    return derive_chunk(kc, root, chunk, delimiter);
+			    });
+			in_flight.push_back(task->get_future());
+			pool.submit([task]() { (*task)(); });
+
+			if (in_flight.size() >= max_in_flight) {
+				emit(in_flight.front().get(), out, err, stats);
+				in_flight.pop_front();
+			}
+		};
+
+		Chunk chunk;
+		while (read_item(in, item, options.delimiter)) {
+			if (chunk.items.empty()) chunk.first_line = line + 1;
+			chunk.items.push_back(std::move(item));
+			++line;
+
+			if (chunk.items.size() == chunk_size) submit(std::exchange(chunk, Chunk{}));
+		}
+		if (!chunk.items.empty()) submit(std::move(chunk));
+
+		while (!in_flight.empty()) {
+			emit(in_flight.front().get(), out, err, stats);
+			in_flight.pop_front();
+		}
+	}
+
+	out.flush();
+	stats.seconds =
+	    std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	return stats;
+}
+
+int derive_command(int argc, const char *argv[]) {
+	argparse::ArgumentParser program("hdpmanager derive");
+
+	add_keychain_arguments(program);
+	program.add_argument("--batch")
+	    .help("derive on all cores and report throughput, records are still written in order")
+	    .default_value(false)
+	    .implicit_value(true);
+	program.add_argument("-0", "--null")
+	    .help("items and records are NUL-terminated instead of newline-terminated")
+	    .default_value(false)
+	    .implicit_value(true);
+	program.add_argument("-j", "--jobs")
+	    .help("worker threads for --batch, 0 for one per core")
+	    .default_value(0)
+	    .action([](const std::string &value) { return std::stoi(value); });
+
+	if (auto exit_code = parse_arguments(program, argc, argv)) return *exit_code;
+
+	DeriveOptions options;
+	options.delimiter = program.get<bool>("--null") ? '\0' : '\n';
+	options.batch = program.get<bool>("--batch");
+	options.n_threads = std::max(0, program.get<int>("--jobs"));
+
+	try {
+		/* stdin carries the items */
+		auto kc = unlock_keychain(program, true);
+		auto root = kc->snapshot()->root;
+
+		std::ios::sync_with_stdio(false);
+		auto stats = derive_stream(*kc, root, std::cin, std::cout, std::cerr, options);
+
+		if (options.batch) {
+			std::cerr << "derived " << stats.records << " secrets in " << stats.seconds << "s ("
+			          << static_cast<size_t>(stats.records / std::max(stats.seconds, 1e-9))
+			          << "/s), " << stats.errors << " errors" << std::endl;
+		}
+		return stats.errors == 0 ? 0 : 1;
+	} catch (const std::exception &e) {
+		std::cerr << e.what() << std::endl;
+		return 1;
+	}
+}
+
+} // namespace cli
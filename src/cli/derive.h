@@ -0,0 +1,53 @@
+/*
+
+Copyright (C) 2019 Mateusz Morusiewicz
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#pragma once
+
+#include <src/keychain/keychain.h>
+
+#include <cstddef>
+#include <iosfwd>
+
+namespace cli {
+
+struct DeriveOptions {
+	char delimiter = '\n';
+	// derive on a worker pool, otherwise every record is flushed right away
+	bool batch = false;
+	size_t n_threads = 0;     // 0 means one per core
+	size_t chunk_size = 1024; // items per pool task
+};
+
+struct DeriveStats {
+	size_t records = 0;
+	size_t errors = 0;
+	double seconds = 0;
+};
+
+/* Reads delimited items from in and writes "item<TAB>secret" records, terminated by the same
+ * delimiter, to out in input order. An item is either a keychain path or a plain derivation path
+ * number; prefix a path with '/' if the entry's name is a number. Items that can't be resolved are
+ * reported on err and skipped. */
+DeriveStats derive_stream(const keychain::Keychain &kc, keychain::Directory::ptr root,
+    std::istream &in, std::ostream &out, std::ostream &err, const DeriveOptions &options = {});
+
+/* hdpmanager derive [--batch] [-0] [-j N] [--password-fd FD] */
+int derive_command(int argc, const char *argv[]);
+
+} // namespace cli
@@ -0,0 +1,77 @@
+/*
+
+Copyright (C) 2019 Mateusz Morusiewicz
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#include <src/cli/password_prompt.h>
+
+#include <cstdio>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <termios.h>
+#include <unistd.h>
+
+namespace cli {
+
+utils::sensitive_string prompt_password(const std::string &prompt, int fd) {
+	const bool is_tty = isatty(fd);
+
+	termios old_attrs{};
+	if (is_tty) {
+		std::fputs(prompt.c_str(), stderr);
+		std::fflush(stderr);
+
+		tcgetattr(fd, &old_attrs);
+		termios new_attrs = old_attrs;
+		new_attrs.c_lflag &= ~ECHO;
+		tcsetattr(fd, TCSAFLUSH, &new_attrs);
+	}
+
+	/* read byte by byte, so that the password never lands in a stdio buffer */
+	utils::sensitive_string password;
+	char c;
+	ssize_t n;
+	while ((n = read(fd, &c, 1)) == 1 && c != '\n') {
+		password.push_back(c);
+	}
+	utils::secure_zero(&c, 1);
+
+	if (is_tty) {
+		tcsetattr(fd, TCSAFLUSH, &old_attrs);
+		std::fputc('\n', stderr);
+	}
+
+	if (n < 0) throw std::runtime_error("could not read password");
+	return password;
+}
+
+utils::sensitive_string prompt_password_on_tty(const std::string &prompt) {
+	int fd = open("/dev/tty", O_RDWR | O_CLOEXEC);
+	if (fd < 0) throw std::runtime_error("no terminal to ask for the encryption phrase on");
+
+	try {
+		auto password = prompt_password(prompt, fd);
+		close(fd);
+		return password;
+	} catch (...) {
+		close(fd);
+		throw;
+	}
+}
+
+} // namespace cli
@@ -0,0 +1,36 @@
+/*
+
+Copyright (C) 2019 Mateusz Morusiewicz
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#pragma once
+
+#include <src/crypto/utils.h>
+
+#include <string>
+
+#include <unistd.h>
+
+namespace cli {
+
+/* Reads a line from fd with echo turned off, the prompt is only shown if fd is a terminal */
+utils::sensitive_string prompt_password(const std::string &prompt, int fd = STDIN_FILENO);
+
+/* For commands that read data from stdin: asks on the controlling terminal instead */
+utils::sensitive_string prompt_password_on_tty(const std::string &prompt);
+
+} // namespace cli
@@ -19,16 +19,27 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
 #include <src/crypto/crypto.h>
 
+#include <src/utils/metrics.h>
+
 #include <external/cryptopp/base64.h>
+#include <external/cryptopp/hmac.h>
 #include <external/cryptopp/modes.h>
+#include <external/cryptopp/misc.h>
 #include <external/cryptopp/osrng.h>
+#include <external/cryptopp/pwdbased.h>
 #include <external/cryptopp/sha.h>
 
+#include <array>
+#include <optional>
+#include <string_view>
+#include <vector>
+
 // constexpr static std::array<unsigned int, 256> secp256k1_n{0xFF, 0xFF 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFE, 0xBA, 0xAE, 0xDC, 0xE6, 0xAF, 0x48, 0xA0, 0x3B, 0xBF, 0xD2, 0x5E, 0x8C, 0xD0, 0x36, 0x41, 0x41};
 
 namespace crypto {
 
 PasswordHash hash_password(const utils::sensitive_string &password) {
+	METRICS_LATENCY("crypto::hash_password");
 	PasswordHash pw_hash;
 
 	CryptoPP::SHA256 sha;
@@ -40,6 +51,108 @@ PasswordHash hash_password(const utils::sensitive_string &password) {
 
 namespace {
 
+constexpr char PASSWORD_CHECK_SCHEME[] = "pbkdf2-sha256";
+constexpr size_t PASSWORD_CHECK_SALT_SIZE = 16;
+
+std::string to_hex(const CryptoPP::byte *data, size_t size) {
+	constexpr char hex[] = "0123456789abcdef";
+	std::string rv;
+	rv.reserve(2 * size);
+	for (size_t i = 0; i < size; ++i) {
+		rv += hex[data[i] >> 4];
+		rv += hex[data[i] & 0xf];
+	}
+	return rv;
+}
+
+std::optional<std::vector<CryptoPP::byte>> from_hex(std::string_view hex) {
+	auto nibble = [](char c) -> int {
+		if (c >= '0' && c <= '9') return c - '0';
+		if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+		return -1;
+	};
+
+	if (hex.size() % 2) return std::nullopt;
+	std::vector<CryptoPP::byte> rv;
+	for (size_t i = 0; i < hex.size(); i += 2) {
+		const int high = nibble(hex[i]), low = nibble(hex[i + 1]);
+		if (high < 0 || low < 0) return std::nullopt;
+		rv.push_back(high << 4 | low);
+	}
+	return rv;
+}
+
+std::array<CryptoPP::byte, CryptoPP::SHA256::DIGESTSIZE> stretch_password(
+    const PasswordHash &pw_hash, const std::vector<CryptoPP::byte> &salt, unsigned iterations) {
+	std::array<CryptoPP::byte, CryptoPP::SHA256::DIGESTSIZE> rv;
+	CryptoPP::PKCS5_PBKDF2_HMAC<CryptoPP::SHA256> pbkdf;
+	pbkdf.DeriveKey(rv.data(), rv.size(), 0, pw_hash.data(), pw_hash.size(), salt.data(),
+	    salt.size(), iterations);
+	return rv;
+}
+
+} // namespace
+
+std::string fingerprint_seed(const Seed &seed) {
+	CryptoPP::byte digest[CryptoPP::SHA256::DIGESTSIZE];
+	CryptoPP::SHA256 sha;
+	sha.CalculateDigest(digest, reinterpret_cast<const CryptoPP::byte *>(seed.data()), seed.size());
+	return to_hex(digest, sizeof(digest));
+}
+
+std::string make_password_check(const PasswordHash &pw_hash, unsigned iterations) {
+	METRICS_LATENCY("crypto::make_password_check");
+	std::vector<CryptoPP::byte> salt(PASSWORD_CHECK_SALT_SIZE);
+	CryptoPP::NonblockingRng rng;
+	rng.GenerateBlock(salt.data(), salt.size());
+
+	const auto key = stretch_password(pw_hash, salt, iterations);
+	return std::string(PASSWORD_CHECK_SCHEME) + ":" + std::to_string(iterations) + ":" +
+	       to_hex(salt.data(), salt.size()) + ":" + to_hex(key.data(), key.size());
+}
+
+std::optional<bool> verify_password_check(const PasswordHash &pw_hash, std::string_view check) {
+	METRICS_LATENCY("crypto::verify_password_check");
+	std::vector<std::string_view> fields;
+	for (size_t start = 0;;) {
+		const size_t end = check.find(':', start);
+		fields.push_back(check.substr(start, end - start));
+		if (end == std::string_view::npos) break;
+		start = end + 1;
+	}
+	if (fields.size() != 4 || fields[0] != PASSWORD_CHECK_SCHEME) return std::nullopt;
+
+	const std::string iterations_str(fields[1]);
+	const auto salt = from_hex(fields[2]);
+	const auto expected = from_hex(fields[3]);
+	if (iterations_str.empty() || iterations_str.size() > 9 ||
+	    iterations_str.find_first_not_of("0123456789") != std::string::npos || !salt || !expected ||
+	    expected->size() != CryptoPP::SHA256::DIGESTSIZE) {
+		return std::nullopt;
+	}
+
+	const auto key = stretch_password(pw_hash, *salt, std::stoul(iterations_str));
+	return CryptoPP::VerifyBufsEqual(key.data(), expected->data(), key.size());
+}
+
+std::optional<PasswordCheckTag> tag_password_check(
+    const PasswordHash &pw_hash, std::string_view check) {
+	if (check.substr(0, check.find(':')) != PASSWORD_CHECK_SCHEME) return std::nullopt;
+
+	PasswordCheckTag rv;
+	static_assert(sizeof(rv) == CryptoPP::HMAC<CryptoPP::SHA256>::DIGESTSIZE);
+	CryptoPP::HMAC<CryptoPP::SHA256> hmac(pw_hash.data(), pw_hash.size());
+	hmac.CalculateDigest(
+	    rv.data(), reinterpret_cast<const CryptoPP::byte *>(check.data()), check.size());
+	return rv;
+}
+
+bool tags_equal(const PasswordCheckTag &lhs, const PasswordCheckTag &rhs) {
+	return CryptoPP::VerifyBufsEqual(lhs.data(), rhs.data(), lhs.size());
+}
+
+namespace {
+
 B64EncodedText base64_encode(const CryptoPP::byte *data, size_t size) {
 	if (size == 0) return {};
 
@@ -59,19 +172,14 @@ B64EncodedText base64_encode(const CryptoPP::byte *data, size_t size) {
 
 } // namespace
 
-B64EncodedText as_encoded(const std::string &encoded_text) {
-	B64EncodedText ret;
-	ret.reserve(encoded_text.size());
-	for (auto c : encoded_text) {
-		ret.push_back(c);
-	}
-	return ret;
+B64EncodedText as_encoded(std::string_view encoded_text) {
+	return B64EncodedText(encoded_text.data(), encoded_text.size());
 }
 
-Ciphertext as_ciphertext(const std::string &encoded_text) { return as_encoded(encoded_text); }
+Ciphertext as_ciphertext(std::string_view encoded_text) { return as_encoded(encoded_text); }
 
-std::string as_string(const B64EncodedText &encoded_text) {
-	return static_cast<std::string>(encoded_text);
+std::string as_string(utils::sensitive_string_view encoded_text) {
+	return std::string(encoded_text.data(), encoded_text.size());
 }
 
 B64EncodedText base64_encode(const std::string &to_encode) {
@@ -79,12 +187,12 @@ B64EncodedText base64_encode(const std::string &to_encode) {
 	    reinterpret_cast<const CryptoPP::byte *>(to_encode.c_str()), to_encode.size());
 }
 
-B64EncodedText base64_encode(const Ciphertext &to_encode) {
+B64EncodedText base64_encode(utils::sensitive_string_view to_encode) {
 	return base64_encode(
 	    reinterpret_cast<const CryptoPP::byte *>(to_encode.data()), to_encode.size());
 }
 
-std::string base64_decode(const B64EncodedText &to_decode) {
+std::string base64_decode(utils::sensitive_string_view to_decode) {
 	std::string decoded;
 	CryptoPP::Base64Decoder decoder(new CryptoPP::StringSink(decoded));
 	decoder.Put(reinterpret_cast<const CryptoPP::byte *>(to_decode.data()), to_decode.size());
@@ -92,7 +200,22 @@ std::string base64_decode(const B64EncodedText &to_decode) {
 	return decoded;
 }
 
-Ciphertext encrypt(const EncryptionKey &key, const B64EncodedText &to_encrypt) {
+Ciphertext base64_decode_ciphertext(utils::sensitive_string_view to_decode) {
+	CryptoPP::Base64Decoder decoder;
+	decoder.Put(reinterpret_cast<const CryptoPP::byte *>(to_decode.data()), to_decode.size());
+	decoder.MessageEnd();
+
+	auto out_size = decoder.MaxRetrievable();
+	if (!out_size) return {};
+
+	Ciphertext decoded(out_size);
+	decoder.Get(reinterpret_cast<CryptoPP::byte *>(decoded.data()), out_size);
+	decoded.index = out_size;
+
+	return decoded;
+}
+
+Ciphertext encrypt(const EncryptionKey &key, utils::sensitive_string_view to_encrypt) {
 	Ciphertext ciphertext_block(to_encrypt.size());
 
 	CryptoPP::byte iv[CryptoPP::AES::BLOCKSIZE];
@@ -108,7 +231,7 @@ Ciphertext encrypt(const EncryptionKey &key, const B64EncodedText &to_encrypt) {
 	return ciphertext_block;
 }
 
-B64EncodedText decrypt(const EncryptionKey &key, const Ciphertext &to_decrypt) {
+B64EncodedText decrypt(const EncryptionKey &key, utils::sensitive_string_view to_decrypt) {
 	B64EncodedText plaintext_block(to_decrypt.size());
 
 	CryptoPP::byte iv[CryptoPP::AES::BLOCKSIZE];
@@ -117,7 +240,7 @@ B64EncodedText decrypt(const EncryptionKey &key, const Ciphertext &to_decrypt) {
 	CryptoPP::CFB_Mode<CryptoPP::AES>::Decryption cfbDecryption(
 	    reinterpret_cast<const CryptoPP::byte *>(key.data()), EncryptionKey::Size, iv);
 	cfbDecryption.ProcessData(reinterpret_cast<CryptoPP::byte *>(plaintext_block.data()),
-	    reinterpret_cast<const CryptoPP::byte *>(to_decrypt.c_str()), to_decrypt.size());
+	    reinterpret_cast<const CryptoPP::byte *>(to_decrypt.data()), to_decrypt.size());
 	plaintext_block.index = to_decrypt.size();
 
 	return plaintext_block;
@@ -154,7 +277,11 @@ Seed decrypt_seed(const EncryptedSeed &encrypted_seed, const PasswordHash &passw
 Seed derive_child(const PasswordHash &pw_hash, const EncryptedSeed &encrypted_parent_key,
     const DerivationPath &path) {
 	Seed decrypted_parent_key = decrypt_seed(encrypted_parent_key, pw_hash);
+	return derive_child(decrypted_parent_key, path);
+}
 
+Seed derive_child(const Seed &decrypted_parent_key, const DerivationPath &path) {
+	METRICS_LATENCY("crypto::derive_child");
 	ChildDerivationData cdd;
 	cdd[0] = 0x00;
 	std::strncpy(reinterpret_cast<char *>(cdd.data() + 1),
@@ -165,7 +292,7 @@ Seed derive_child(const PasswordHash &pw_hash, const EncryptedSeed &encrypted_pa
 	cdd[36] = path.seed & 0xff;
 
 	CryptoPP::SHA512 sha;
-	sha.Update(reinterpret_cast<CryptoPP::byte *>(decrypted_parent_key.data()), 32);
+	sha.Update(reinterpret_cast<const CryptoPP::byte *>(decrypted_parent_key.data()), 32);
 	sha.Update(reinterpret_cast<CryptoPP::byte *>(cdd.data()), cdd.size());
 
 	Seed derived_seed;
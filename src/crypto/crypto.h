@@ -21,27 +21,56 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
 #include <src/crypto/structs.h>
 
+#include <array>
+#include <optional>
+#include <string>
+#include <string_view>
+
 namespace crypto {
 
 struct DerivationPath {
 	int seed;
 };
 
-B64EncodedText as_encoded(const std::string &encoded_text);
-Ciphertext as_ciphertext(const std::string &encoded_text);
-std::string as_string(const B64EncodedText &encoded_text);
+B64EncodedText as_encoded(std::string_view encoded_text);
+Ciphertext as_ciphertext(std::string_view encoded_text);
+std::string as_string(utils::sensitive_string_view encoded_text);
 
 B64EncodedText base64_encode(const std::string &to_encode);
-B64EncodedText base64_encode(const Ciphertext &to_encode);
-std::string base64_decode(const B64EncodedText &to_decode);
+B64EncodedText base64_encode(utils::sensitive_string_view to_encode);
+std::string base64_decode(utils::sensitive_string_view to_decode);
+/* decodes straight into locked memory */
+Ciphertext base64_decode_ciphertext(utils::sensitive_string_view to_decode);
 
-Ciphertext encrypt(const EncryptionKey &key, const B64EncodedText &to_encrypt);
-B64EncodedText decrypt(const EncryptionKey &key, const Ciphertext &to_decrypt);
+Ciphertext encrypt(const EncryptionKey &key, utils::sensitive_string_view to_encrypt);
+B64EncodedText decrypt(const EncryptionKey &key, utils::sensitive_string_view to_decrypt);
 
 EncryptedSeed encrypt_seed(const Seed &seed, const PasswordHash &password_hash);
 Seed decrypt_seed(const EncryptedSeed &encrypted_seed, const PasswordHash &password_hash);
 PasswordHash hash_password(const utils::sensitive_string &password);
+/* hex digest of the seed, how keychains created before password checks told a wrong phrase apart;
+ * cheap to test guesses against, so it is only read to replace it */
+std::string fingerprint_seed(const Seed &seed);
+
+constexpr unsigned PASSWORD_CHECK_ITERATIONS = 100000;
+
+/* A value that can be stored in the open to tell whether a phrase is the right one: a random salt
+ * and the phrase hash stretched with PBKDF2, so every guess tested against it costs as many
+ * hashes as there are iterations. */
+std::string make_password_check(
+    const PasswordHash &pw_hash, unsigned iterations = PASSWORD_CHECK_ITERATIONS);
+/* nullopt if check is not one of make_password_check */
+std::optional<bool> verify_password_check(const PasswordHash &pw_hash, std::string_view check);
+
+/* An HMAC of a password check keyed with the phrase hash, cheap to compute. Kept with a hash that
+ * was verified against check, it tells that the hash was verified against that very check
+ * without stretching it again. nullopt if check is not one of make_password_check. */
+using PasswordCheckTag = std::array<unsigned char, 32>;
+std::optional<PasswordCheckTag> tag_password_check(
+    const PasswordHash &pw_hash, std::string_view check);
+bool tags_equal(const PasswordCheckTag &lhs, const PasswordCheckTag &rhs);
 
+Seed derive_child(const Seed &parent_key, const DerivationPath &path);
 Seed derive_child(const PasswordHash &pw_hash, const EncryptedSeed &encrypted_parent_key,
     const DerivationPath &path);
 
@@ -0,0 +1,244 @@
+/*
+
+Copyright (C) 2019 Mateusz Morusiewicz
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#include <src/crypto/key_cache.h>
+
+#include <src/crypto/utils.h>
+
+#include <external/cryptopp/sha.h>
+
+#include <fcntl.h>
+#include <linux/keyctl.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+
+namespace crypto {
+
+namespace {
+
+/* keyutils.h is not needed for a handful of syscalls, its permission bits are spelled out here */
+constexpr uint32_t KEY_POS_VIEW = 0x01000000;
+constexpr uint32_t KEY_POS_READ = 0x02000000;
+constexpr uint32_t KEY_POS_WRITE = 0x04000000;
+constexpr uint32_t KEY_POS_SEARCH = 0x08000000;
+constexpr uint32_t KEY_POS_SETATTR = 0x20000000;
+
+constexpr char KEY_TYPE[] = "user";
+constexpr char KEY_PREFIX[] = "hdpwm:";
+
+long keyctl(int operation, unsigned long arg2, unsigned long arg3 = 0, unsigned long arg4 = 0,
+    unsigned long arg5 = 0) {
+	return syscall(SYS_keyctl, operation, arg2, arg3, arg4, arg5);
+}
+
+/* The payload carries the timeout too, as the kernel can't tell what it was set to. Payloads of
+ * another size, e.g. left by versions without tags, are not loaded. */
+struct KeyringPayload {
+	int64_t timeout;
+	std::array<unsigned char, PasswordHash::Size> pw_hash;
+	PasswordCheckTag check_tag;
+};
+
+class KernelKeyringCache : public KeyCache {
+	static long find(const std::string &id) {
+		const std::string description = KEY_PREFIX + id;
+		return keyctl(KEYCTL_SEARCH, KEY_SPEC_SESSION_KEYRING,
+		    reinterpret_cast<unsigned long>(KEY_TYPE),
+		    reinterpret_cast<unsigned long>(description.c_str()));
+	}
+
+  public:
+	std::optional<CachedKey> load(const std::string &id) override {
+		long key = find(id);
+		if (key < 0) return std::nullopt; // ENOKEY, or EKEYEXPIRED once the timeout passed
+
+		KeyringPayload payload;
+		long size =
+		    keyctl(KEYCTL_READ, key, reinterpret_cast<unsigned long>(&payload), sizeof(payload));
+
+		std::optional<CachedKey> rv;
+		if (size == sizeof(payload)) {
+			rv.emplace();
+			std::copy(payload.pw_hash.begin(), payload.pw_hash.end(), rv->pw_hash.data());
+			rv->check_tag = payload.check_tag;
+			keyctl(KEYCTL_SET_TIMEOUT, key, payload.timeout);
+		}
+
+		utils::secure_zero(payload.pw_hash.data(), payload.pw_hash.size());
+		return rv;
+	}
+
+	void store(
+	    const std::string &id, const CachedKey &cached, std::chrono::seconds timeout) override {
+		if (timeout.count() <= 0) return forget(id);
+
+		KeyringPayload payload{timeout.count(), {}, cached.check_tag};
+		std::copy(cached.pw_hash.begin(), cached.pw_hash.end(), payload.pw_hash.begin());
+
+		/* replaces the key of the same description, if there is one */
+		const std::string description = KEY_PREFIX + id;
+		long key = syscall(SYS_add_key, KEY_TYPE, description.c_str(), &payload, sizeof(payload),
+		    KEY_SPEC_SESSION_KEYRING);
+		utils::secure_zero(payload.pw_hash.data(), payload.pw_hash.size());
+		if (key < 0) throw std::runtime_error(std::string("could not add key: ") + strerror(errno));
+
+		keyctl(KEYCTL_SETPERM, key,
+		    KEY_POS_VIEW | KEY_POS_READ | KEY_POS_WRITE | KEY_POS_SEARCH | KEY_POS_SETATTR);
+		keyctl(KEYCTL_SET_TIMEOUT, key, timeout.count());
+	}
+
+	void forget(const std::string &id) override {
+		if (long key = find(id); key >= 0) {
+			if (keyctl(KEYCTL_INVALIDATE, key) < 0)
+				keyctl(KEYCTL_UNLINK, key, KEY_SPEC_SESSION_KEYRING);
+		}
+	}
+
+	const char *name() const override { return "kernel keyring"; }
+};
+
+/* One file per keychain, named after a hash of its id and holding a Record */
+class RuntimeDirCache : public KeyCache {
+	std::filesystem::path dir;
+
+	struct Record {
+		int64_t expires;
+		std::array<unsigned char, PasswordHash::Size> pw_hash;
+		PasswordCheckTag check_tag;
+	};
+
+	static int64_t now() {
+		using namespace std::chrono;
+		return duration_cast<seconds>(system_clock::now().time_since_epoch()).count();
+	}
+
+	std::filesystem::path file_for(const std::string &id) const {
+		CryptoPP::SHA256 sha;
+		unsigned char digest[CryptoPP::SHA256::DIGESTSIZE];
+		sha.CalculateDigest(digest, reinterpret_cast<const unsigned char *>(id.data()), id.size());
+
+		constexpr char hex[] = "0123456789abcdef";
+		std::string name;
+		for (unsigned char c : digest) {
+			name += hex[c >> 4];
+			name += hex[c & 0xf];
+		}
+		return dir / name;
+	}
+
+	void write_record(const std::filesystem::path &path, const Record &record) {
+		if (::mkdir(dir.c_str(), 0700) < 0 && errno != EEXIST) {
+			throw std::runtime_error("could not create " + dir.string());
+		}
+
+		/* written aside and renamed, so that a reader never sees half a record */
+		const std::string tmp_path = path.string() + ".tmp";
+		int fd =
+		    ::open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_NOFOLLOW | O_CLOEXEC, 0600);
+		if (fd < 0) throw std::runtime_error("could not write " + tmp_path);
+
+		bool ok = ::write(fd, &record, sizeof(record)) == sizeof(record);
+		ok = ::close(fd) == 0 && ok;
+		if (!ok || ::rename(tmp_path.c_str(), path.c_str()) < 0) {
+			::unlink(tmp_path.c_str());
+			throw std::runtime_error("could not write " + path.string());
+		}
+	}
+
+  public:
+	explicit RuntimeDirCache(std::filesystem::path dir) : dir(std::move(dir)) {}
+
+	std::optional<CachedKey> load(const std::string &id) override {
+		const auto path = file_for(id);
+		int fd = ::open(path.c_str(), O_RDONLY | O_NOFOLLOW | O_CLOEXEC);
+		if (fd < 0) return std::nullopt;
+
+		/* anything not private to this user is not trusted */
+		struct stat st;
+		Record record;
+		bool ok = ::fstat(fd, &st) == 0 && st.st_uid == ::getuid() && (st.st_mode & 077) == 0 &&
+		          ::read(fd, &record, sizeof(record)) == sizeof(record);
+		::close(fd);
+
+		std::optional<CachedKey> rv;
+		if (ok && record.expires > now()) {
+			rv.emplace();
+			std::copy(record.pw_hash.begin(), record.pw_hash.end(), rv->pw_hash.data());
+			rv->check_tag = record.check_tag;
+		} else {
+			::unlink(path.c_str());
+		}
+
+		utils::secure_zero(record.pw_hash.data(), record.pw_hash.size());
+		return rv;
+	}
+
+	void store(
+	    const std::string &id, const CachedKey &cached, std::chrono::seconds timeout) override {
+		if (timeout.count() <= 0) return forget(id);
+
+		Record record{now() + timeout.count(), {}, cached.check_tag};
+		std::copy(cached.pw_hash.begin(), cached.pw_hash.end(), record.pw_hash.begin());
+		try {
+			write_record(file_for(id), record);
+		} catch (...) {
+			utils::secure_zero(record.pw_hash.data(), record.pw_hash.size());
+			throw;
+		}
+		utils::secure_zero(record.pw_hash.data(), record.pw_hash.size());
+	}
+
+	void forget(const std::string &id) override { ::unlink(file_for(id).c_str()); }
+
+	const char *name() const override { return "runtime directory"; }
+};
+
+} // namespace
+
+std::unique_ptr<KeyCache> make_kernel_keyring_cache() {
+	/* fails with ENOSYS without CONFIG_KEYS and with EPERM under seccomp filters that drop it */
+	if (keyctl(KEYCTL_GET_KEYRING_ID, KEY_SPEC_SESSION_KEYRING, 0) < 0) return nullptr;
+	return std::make_unique<KernelKeyringCache>();
+}
+
+std::unique_ptr<KeyCache> make_runtime_dir_cache(std::filesystem::path dir) {
+	return std::make_unique<RuntimeDirCache>(std::move(dir));
+}
+
+std::unique_ptr<KeyCache> make_default_key_cache() {
+	if (auto rv = make_kernel_keyring_cache()) return rv;
+
+	/* plain files only when asked for */
+	if (const char *cache_dir = std::getenv("HDPWM_UNLOCK_CACHE_DIR"); cache_dir && *cache_dir) {
+		return make_runtime_dir_cache(cache_dir);
+	}
+
+	return nullptr;
+}
+
+} // namespace crypto
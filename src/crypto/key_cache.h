@@ -0,0 +1,65 @@
+/*
+
+Copyright (C) 2019 Mateusz Morusiewicz
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#pragma once
+
+#include <src/crypto/crypto.h>
+#include <src/crypto/structs.h>
+
+#include <chrono>
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <string>
+
+namespace crypto {
+
+/* A password hash and the tag of the password check it was verified against */
+struct CachedKey {
+	PasswordHash pw_hash;
+	PasswordCheckTag check_tag;
+};
+
+/* Password hashes of unlocked keychains, kept between invocations until they time out. The kernel
+ * keyring restarts the timeout on every successful load, files keep the expiry they were stored
+ * with, as loading never writes. */
+class KeyCache {
+  public:
+	virtual ~KeyCache() = default;
+
+	virtual std::optional<CachedKey> load(const std::string &id) = 0;
+	virtual void store(
+	    const std::string &id, const CachedKey &key, std::chrono::seconds timeout) = 0;
+	virtual void forget(const std::string &id) = 0;
+
+	virtual const char *name() const = 0;
+};
+
+/* Linux session keyring, nullptr if the kernel has no keyring support (or it is filtered out) */
+std::unique_ptr<KeyCache> make_kernel_keyring_cache();
+
+/* Owner-only files in dir, meant for a tmpfs. The hashes are the keys the seed is encrypted
+ * with, in plain files, so this is never picked without being asked for. */
+std::unique_ptr<KeyCache> make_runtime_dir_cache(std::filesystem::path dir);
+
+/* The kernel keyring if there is one, else the files in $HDPWM_UNLOCK_CACHE_DIR if it is set,
+ * else nullptr (no caching) */
+std::unique_ptr<KeyCache> make_default_key_cache();
+
+} // namespace crypto
@@ -0,0 +1,337 @@
+/*
+
+Copyright (C) 2019 Mateusz Morusiewicz
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#include <src/crypto/locked_memory.h>
+#include <src/crypto/utils.h>
+#include <src/utils/memory.h>
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <deque>
+#include <limits>
+#include <mutex>
+#include <new>
+#include <unordered_map>
+
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+namespace crypto {
+
+namespace {
+
+constexpr size_t POOL_MIN_SLOT = 16;
+constexpr size_t POOL_MAX_SLOT = 2048; // larger allocations get pages of their own
+constexpr size_t POOL_CLASSES = 8;     // 16, 32, ..., 2048
+
+size_t page_size() {
+	static const size_t size = sysconf(_SC_PAGESIZE);
+	return size;
+}
+
+size_t memlock_rlimit() {
+	rlimit rl;
+	if (getrlimit(RLIMIT_MEMLOCK, &rl) != 0 || rl.rlim_cur == RLIM_INFINITY) {
+		return std::numeric_limits<size_t>::max();
+	}
+
+	return rl.rlim_cur;
+}
+
+size_t pool_class(size_t size) {
+	size_t cls = 0;
+	for (size_t slot = POOL_MIN_SLOT; slot < size; slot <<= 1) ++cls;
+	return cls;
+}
+
+class LockedMemory {
+	enum class PageMode : uint8_t { Locked, DontDump };
+
+	struct Page {
+		uint32_t refs = 0;
+		PageMode mode = PageMode::Locked;
+		bool mapped = false; // by secure_alloc, which releases it rather than the last unref
+	};
+
+	struct PoolPage {
+		size_t cls;
+		size_t used;
+	};
+
+	struct FreeSlot {
+		FreeSlot *next;
+	};
+
+	std::mutex mutex;
+	LockedMemoryStats stats;
+	size_t rlimit;
+
+	std::unordered_map<uintptr_t, Page> pages;
+	std::deque<uintptr_t> idle; // released locked pool pages, unmapped first when over budget
+
+	std::unordered_map<uintptr_t, PoolPage> pool_pages;
+	std::array<FreeSlot *, POOL_CLASSES> free_slots{};
+	std::array<size_t, POOL_CLASSES> empty_pool_pages{};
+
+	bool evict_idle_page() {
+		if (idle.empty()) return false;
+
+		const uintptr_t addr = idle.front();
+		idle.pop_front();
+
+		pages.erase(addr);
+		stats.locked_bytes -= page_size();
+		munmap(reinterpret_cast<void *>(addr), page_size());
+		return true;
+	}
+
+	bool try_lock_page(uintptr_t addr) {
+		while (stats.locked_bytes + page_size() > stats.limit) {
+			if (!evict_idle_page()) return false;
+		}
+
+#ifdef _POSIX_MEMLOCK_RANGE
+		if (mlock(reinterpret_cast<void *>(addr), page_size()) != 0) return false;
+#endif
+
+		stats.locked_bytes += page_size();
+		stats.peak_locked_bytes = std::max(stats.peak_locked_bytes, stats.locked_bytes);
+		return true;
+	}
+
+	void ref_page(uintptr_t addr) {
+		auto [it, inserted] = pages.try_emplace(addr);
+		Page &page = it->second;
+
+		if (inserted && !try_lock_page(addr)) {
+			page.mode = PageMode::DontDump;
+			++stats.degraded_pages;
+#ifdef MADV_DONTDUMP
+			(void)madvise(reinterpret_cast<void *>(addr), page_size(), MADV_DONTDUMP);
+#endif
+		}
+
+		++page.refs;
+	}
+
+	void unref_page(uintptr_t addr) {
+		auto it = pages.find(addr);
+		if (it == pages.end() || it->second.refs == 0) return;
+
+		Page &page = it->second;
+		if (--page.refs > 0 || page.mapped) return;
+
+		/* memory of someone else, which may be reused for anything once it's released */
+		if (page.mode == PageMode::Locked) {
+#ifdef _POSIX_MEMLOCK_RANGE
+			(void)munlock(reinterpret_cast<void *>(addr), page_size());
+#endif
+			stats.locked_bytes -= page_size();
+		} else {
+#ifdef MADV_DODUMP
+			(void)madvise(reinterpret_cast<void *>(addr), page_size(), MADV_DODUMP);
+#endif
+		}
+		pages.erase(it);
+	}
+
+	template <typename F> void for_each_page(const void *mem, size_t size, F &&f) {
+		const uintptr_t first = reinterpret_cast<uintptr_t>(mem) & ~(page_size() - 1);
+		const uintptr_t last = reinterpret_cast<uintptr_t>(mem) + size - 1;
+		for (uintptr_t addr = first; addr <= last; addr += page_size()) {
+			f(addr);
+		}
+	}
+
+	void *map_pages(size_t size) {
+		void *mem = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (mem == MAP_FAILED) throw std::bad_alloc();
+
+		for_each_page(mem, size, [this](uintptr_t addr) {
+			ref_page(addr);
+			pages[addr].mapped = true;
+		});
+		return mem;
+	}
+
+	void unmap_pages(void *mem, size_t size) {
+		for_each_page(mem, size, [this](uintptr_t addr) {
+			auto it = pages.find(addr);
+			if (it == pages.end() || it->second.refs == 0 || --it->second.refs > 0) return;
+
+			if (it->second.mode == PageMode::Locked) stats.locked_bytes -= page_size();
+			pages.erase(it);
+		});
+		munmap(mem, size);
+	}
+
+	void add_pool_page(size_t cls) {
+		const size_t slot_size = POOL_MIN_SLOT << cls;
+
+		/* the most recently released page first, it's the likeliest to be cached */
+		char *mem;
+		if (!idle.empty()) {
+			mem = reinterpret_cast<char *>(idle.back());
+			idle.pop_back();
+			++pages[reinterpret_cast<uintptr_t>(mem)].refs;
+		} else {
+			mem = static_cast<char *>(map_pages(page_size()));
+		}
+
+		pool_pages[reinterpret_cast<uintptr_t>(mem)] = PoolPage{cls, 0};
+		stats.pooled_bytes += page_size();
+		++empty_pool_pages[cls];
+
+		for (size_t offset = page_size(); offset >= slot_size; offset -= slot_size) {
+			auto *slot = reinterpret_cast<FreeSlot *>(mem + offset - slot_size);
+			slot->next = free_slots[cls];
+			free_slots[cls] = slot;
+		}
+	}
+
+	/* keeps a single empty page per class around, so that alternating allocations and frees
+	 * don't map and lock a page every time */
+	void release_pool_page(uintptr_t addr, size_t cls) {
+		if (++empty_pool_pages[cls] == 1) return;
+
+		FreeSlot **link = &free_slots[cls];
+		while (*link) {
+			if ((reinterpret_cast<uintptr_t>(*link) & ~(page_size() - 1)) == addr) {
+				*link = (*link)->next;
+			} else {
+				link = &(*link)->next;
+			}
+		}
+
+		--empty_pool_pages[cls];
+		pool_pages.erase(addr);
+		stats.pooled_bytes -= page_size();
+
+		/* a locked page stays mapped and locked for the next pool page, of any class */
+		auto it = pages.find(addr);
+		if (it != pages.end() && it->second.refs == 1 && it->second.mode == PageMode::Locked) {
+			it->second.refs = 0;
+			idle.push_back(addr);
+			return;
+		}
+		unmap_pages(reinterpret_cast<void *>(addr), page_size());
+	}
+
+  public:
+	LockedMemory() : rlimit(memlock_rlimit()) { stats.limit = rlimit; }
+
+	static LockedMemory &instance() {
+		/* never destroyed, sensitive objects with static storage may outlive any other object */
+		static LockedMemory *memory = new LockedMemory();
+		return *memory;
+	}
+
+	void lock(const void *mem, size_t size) {
+		if (size == 0) return;
+
+		std::unique_lock<std::mutex> lk(mutex);
+		for_each_page(mem, size, [this](uintptr_t addr) { ref_page(addr); });
+	}
+
+	void unlock(const void *mem, size_t size) {
+		if (size == 0) return;
+
+		std::unique_lock<std::mutex> lk(mutex);
+		for_each_page(mem, size, [this](uintptr_t addr) { unref_page(addr); });
+	}
+
+	void *alloc(size_t size) {
+		if (size == 0) return nullptr;
+
+		std::unique_lock<std::mutex> lk(mutex);
+		if (size > POOL_MAX_SLOT) {
+			return map_pages((size + page_size() - 1) & ~(page_size() - 1));
+		}
+
+		const size_t cls = pool_class(size);
+		if (!free_slots[cls]) add_pool_page(cls);
+
+		FreeSlot *slot = free_slots[cls];
+		free_slots[cls] = slot->next;
+
+		PoolPage &page = pool_pages[reinterpret_cast<uintptr_t>(slot) & ~(page_size() - 1)];
+		if (page.used++ == 0) --empty_pool_pages[cls];
+
+		std::memset(slot, 0, POOL_MIN_SLOT << cls);
+		return slot;
+	}
+
+	void free(void *ptr, size_t size) {
+		if (!ptr) return;
+
+		utils::secure_zero(ptr, size);
+
+		std::unique_lock<std::mutex> lk(mutex);
+		if (size > POOL_MAX_SLOT) {
+			return unmap_pages(ptr, (size + page_size() - 1) & ~(page_size() - 1));
+		}
+
+		const uintptr_t addr = reinterpret_cast<uintptr_t>(ptr) & ~(page_size() - 1);
+		PoolPage &page = pool_pages[addr];
+
+		auto *slot = static_cast<FreeSlot *>(ptr);
+		slot->next = free_slots[page.cls];
+		free_slots[page.cls] = slot;
+
+		if (--page.used == 0) release_pool_page(addr, page.cls);
+	}
+
+	LockedMemoryStats get_stats() {
+		std::unique_lock<std::mutex> lk(mutex);
+		stats.idle_pages = idle.size();
+		return stats;
+	}
+
+	void set_limit(size_t limit) {
+		std::unique_lock<std::mutex> lk(mutex);
+		stats.limit = limit ? limit : rlimit;
+		while (stats.locked_bytes > stats.limit && evict_idle_page()) {
+		}
+	}
+};
+
+} // namespace
+
+void lock_mem(const void *mem, size_t size) { LockedMemory::instance().lock(mem, size); }
+
+void unlock_mem(const void *mem, size_t size) { LockedMemory::instance().unlock(mem, size); }
+
+LockedMemoryStats locked_memory_stats() { return LockedMemory::instance().get_stats(); }
+
+void set_locked_memory_limit(size_t limit) { LockedMemory::instance().set_limit(limit); }
+
+void *secure_alloc(size_t size) {
+	void *rv = LockedMemory::instance().alloc(size);
+	utils::memory::add(utils::memory::Category::LockedSecrets, size);
+	return rv;
+}
+
+void secure_free(void *ptr, size_t size) {
+	LockedMemory::instance().free(ptr, size);
+	utils::memory::sub(utils::memory::Category::LockedSecrets, size);
+}
+
+} // namespace crypto
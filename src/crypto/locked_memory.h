@@ -0,0 +1,51 @@
+/*
+
+Copyright (C) 2019 Mateusz Morusiewicz
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace crypto {
+
+/* Locked memory is accounted per page against RLIMIT_MEMLOCK. Pages are reference counted, so
+ * objects sharing a page keep it locked until the last one goes away. Pool pages released by
+ * secure_free stay locked for reuse until the budget is needed elsewhere, memory locked with
+ * lock_mem is unlocked right away. Once the budget is exhausted pages are only excluded from core
+ * dumps and counted as degraded, nothing throws. */
+struct LockedMemoryStats {
+	size_t limit = 0;             // bytes that may be locked
+	size_t locked_bytes = 0;      // including released pages kept for reuse
+	size_t peak_locked_bytes = 0;
+	size_t pooled_bytes = 0;      // pages carved into small secure_alloc slots
+	size_t idle_pages = 0;        // released pool pages kept for reuse
+	uint64_t degraded_pages = 0;  // pages that could not be locked
+};
+
+LockedMemoryStats locked_memory_stats();
+
+/* overrides the limit taken from RLIMIT_MEMLOCK, 0 goes back to the rlimit */
+void set_locked_memory_limit(size_t limit);
+
+/* Small allocations share locked pages, larger ones get pages of their own. The memory is zeroed
+ * when freed, size has to match the allocation. */
+void *secure_alloc(size_t size);
+void secure_free(void *ptr, size_t size);
+
+} // namespace crypto
@@ -19,14 +19,15 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
 #include <src/crypto/mnemonic.h>
 
-#include <src/crypto/mnemonic-wordlist.cpp>
 #include <src/crypto/utils.h>
+#include <src/utils/metrics.h>
 #include <src/utils/utils.h>
 
 #include <external/cryptopp/osrng.h>
 #include <external/cryptopp/pwdbased.h>
 #include <external/cryptopp/sha.h>
 
+#include <array>
 #include <stdexcept>
 
 namespace crypto {
@@ -39,17 +40,18 @@ uint8_t extract_bit(const CryptoPP::byte *buffer, int cb) {
 	return byte & mask;
 }
 
-utils::sensitive_string word_at(int index) {
-	return mnemonic_dictionary[index % mnemonic_dictionary.size()];
+utils::sensitive_string word_at(int index, Language language) {
+	std::string_view word = wordlist(language).at(index);
+	return utils::sensitive_string(word.data(), word.size());
 }
 
-int find_word_index(const utils::sensitive_string &word) {
-	auto it = std::lower_bound(mnemonic_dictionary.begin(), mnemonic_dictionary.end(), word);
-	if (it == mnemonic_dictionary.end() || *it != word) {
+int find_word_index(utils::sensitive_string_view word, Language language) {
+	auto index = wordlist(language).find(std::string_view(word));
+	if (!index) {
 		throw std::runtime_error("unknown word");
 	}
 
-	return it - mnemonic_dictionary.begin();
+	return *index;
 }
 
 std::vector<int> bitsplit_11(const CryptoPP::byte *buffer, int size) {
@@ -68,25 +70,53 @@ std::vector<int> bitsplit_11(const CryptoPP::byte *buffer, int size) {
 	return rv;
 }
 
-std::vector<utils::sensitive_string> get_words_from_indices(const std::vector<int> &indices) {
+bool verify_mnemonic_checksum(const std::vector<int> &indices) {
+	const int n_words = indices.size();
+	if (n_words < 12 || n_words > 24 || n_words % 3 != 0) return false;
+
+	const int total_bits = n_words * 11;
+	const int entropy_bytes = total_bits * 32 / 33 / 8;
+	const int checksum_bits = entropy_bytes / 4;
+
+	std::array<CryptoPP::byte, 33> buffer{};
+	for (int w = 0; w < n_words; ++w) {
+		for (int b = 0; b < 11; ++b) {
+			if (indices[w] & (1 << (10 - b))) {
+				const int cb = w * 11 + b;
+				buffer[cb / 8] |= 1 << (7 - (cb % 8));
+			}
+		}
+	}
+
+	CryptoPP::byte digest;
+	CryptoPP::SHA256 checksum_digester;
+	checksum_digester.CalculateTruncatedDigest(&digest, 1, buffer.data(), entropy_bytes);
+
+	const int expected = digest >> (8 - checksum_bits);
+	const int actual = buffer[entropy_bytes] >> (8 - checksum_bits);
+	return expected == actual;
+}
+
+std::vector<utils::sensitive_string> get_words_from_indices(
+    const std::vector<int> &indices, Language language) {
 	std::vector<utils::sensitive_string> rv;
 	rv.reserve(indices.size());
 	for (auto index : indices) {
-		rv.push_back(word_at(index));
+		rv.push_back(word_at(index, language));
 	}
 
 	return rv;
 }
 
-utils::sensitive_string get_random_word() {
+utils::sensitive_string get_random_word(Language language) {
 	CryptoPP::byte seed[2];
 	CryptoPP::NonblockingRng rng;
 	rng.GenerateBlock(seed, sizeof(seed));
 	uint16_t random_index = seed[0] << 8 | seed[1];
-	return word_at(random_index);
+	return word_at(random_index, language);
 }
 
-std::vector<utils::sensitive_string> generate_mnemonic(int entropy_size) {
+std::vector<utils::sensitive_string> generate_mnemonic(int entropy_size, Language language) {
 
 	constexpr int CHECKSUM_MAX_SIZE = 1;
 
@@ -99,26 +129,27 @@ std::vector<utils::sensitive_string> generate_mnemonic(int entropy_size) {
 	checksum_digester.CalculateTruncatedDigest(seed + entropy_size, 1, seed, entropy_size);
 
 	auto indices = bitsplit_11(seed, entropy_size * 8 + entropy_size / 4);
-	auto words = get_words_from_indices(indices);
+	auto words = get_words_from_indices(indices, language);
 
-	utils::sensitive_string extra_word = get_random_word();
+	utils::sensitive_string extra_word = get_random_word(language);
 	words.push_back(extra_word);
 
 	delete[] seed;
 	return words;
 }
 
-Seed mnemonic_to_seed(const std::vector<utils::sensitive_string> &words) {
-	int words_len = 0;
-	for (auto word : words) {
+Seed mnemonic_to_seed(const std::vector<utils::sensitive_string_view> &words) {
+	METRICS_LATENCY("crypto::mnemonic_to_seed");
+	size_t words_len = 0;
+	for (const auto &word : words) {
 		words_len += word.size();
 	}
 
-	CryptoPP::byte *mnemonic = new CryptoPP::byte[words_len];
-	CryptoPP::byte *pw_ptr = mnemonic;
-	for (auto word : words) {
-		std::strncpy(reinterpret_cast<char *>(pw_ptr), word.c_str(), word.size());
-		pw_ptr += word.size();
+	utils::sensitive_string mnemonic(words_len);
+	for (const auto &word : words) {
+		for (char c : word) {
+			mnemonic.push_back(c);
+		}
 	}
 
 	const CryptoPP::byte salt[] = "ob1Ofabex?reg+ojAfKosh89OkEgUsvojbeurOv7knok";
@@ -128,26 +159,44 @@ Seed mnemonic_to_seed(const std::vector<utils::sensitive_string> &words) {
 	CryptoPP::byte unused = 0;
 
 	pbkdf.DeriveKey(reinterpret_cast<CryptoPP::byte *>(seed.data()), CryptoPP::SHA512::DIGESTSIZE,
-	    unused, mnemonic, words_len, salt, sizeof(salt), PBKDF2_ITERATION_COUNT);
+	    unused, reinterpret_cast<const CryptoPP::byte *>(mnemonic.c_str()), mnemonic.size(), salt,
+	    sizeof(salt), PBKDF2_ITERATION_COUNT);
 
-	delete[] mnemonic;
 	return seed;
 }
 
-std::vector<utils::sensitive_string> split_mnemonic_words(const utils::sensitive_string &mnemonic) {
-	std::vector<utils::sensitive_string> ret;
+Seed mnemonic_to_seed(const std::vector<utils::sensitive_string> &words) {
+	return mnemonic_to_seed(std::vector<utils::sensitive_string_view>(words.begin(), words.end()));
+}
+
+std::future<Seed> mnemonic_to_seed_async(
+    std::vector<utils::sensitive_string> words, utils::OperationOptions options) {
+	auto on_done = options.on_done;
+	return utils::run_async(
+	    [words = std::move(words), options = std::move(options)]() {
+		    utils::StageReporter stages(options, 1);
+		    stages.begin("Deriving seed");
+		    Seed rv = mnemonic_to_seed(words);
+		    stages.finish();
+		    return rv;
+	    },
+	    std::move(on_done));
+}
+
+std::vector<utils::sensitive_string_view> split_mnemonic_words(
+    utils::sensitive_string_view mnemonic) {
+	std::vector<utils::sensitive_string_view> ret;
 	ret.reserve(25); // enough for longest allowed mnemonic
-	utils::sensitive_string c_word(12);
+
+	size_t word_start = 0;
 	for (size_t i = 0; i < mnemonic.size(); ++i) {
 		if (mnemonic[i] == ' ') {
-			ret.push_back(std::move(c_word));
-			c_word = utils::sensitive_string(12);
-		} else {
-			c_word.push_back(mnemonic[i]);
+			ret.push_back(mnemonic.substr(word_start, i - word_start));
+			word_start = i + 1;
 		}
 	}
 
-	ret.push_back(std::move(c_word));
+	ret.push_back(mnemonic.substr(word_start, mnemonic.size() - word_start));
 	return ret;
 }
 
@@ -20,6 +20,11 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #pragma once
 
 #include <src/crypto/structs.h>
+#include <src/crypto/wordlist.h>
+
+#include <src/utils/async.h>
+
+#include <future>
 
 #include <string>
 #include <vector>
@@ -28,10 +33,24 @@ namespace crypto {
 
 struct sensitive_string;
 
-std::vector<utils::sensitive_string> generate_mnemonic(int entropy_size);
-std::vector<utils::sensitive_string> split_mnemonic_words(const utils::sensitive_string &mnemonic);
+constexpr int MNEMONIC_DICTIONARY_SIZE = 2048;
+
+std::vector<utils::sensitive_string> generate_mnemonic(
+    int entropy_size, Language language = Language::English);
+/* words are views into the mnemonic, which has to outlive them */
+std::vector<utils::sensitive_string_view> split_mnemonic_words(
+    utils::sensitive_string_view mnemonic);
+Seed mnemonic_to_seed(const std::vector<utils::sensitive_string_view> &words);
 Seed mnemonic_to_seed(const std::vector<utils::sensitive_string> &words);
+/* runs on utils::default_pool() */
+std::future<Seed> mnemonic_to_seed_async(
+    std::vector<utils::sensitive_string> words, utils::OperationOptions options = {});
+
+/* throws std::runtime_error for words outside of the dictionary */
+int find_word_index(utils::sensitive_string_view word, Language language = Language::English);
+utils::sensitive_string word_at(int index, Language language = Language::English);
 
-int find_word_index(const utils::sensitive_string &word);
+/* indices must cover the checksummed words only (12, 15, 18, 21 or 24 of them) */
+bool verify_mnemonic_checksum(const std::vector<int> &indices);
 
 } // namespace crypto
@@ -0,0 +1,205 @@
+/*
+
+Copyright (C) 2019 Mateusz Morusiewicz
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#include <src/crypto/mnemonic_recovery.h>
+
+#include <src/crypto/mnemonic.h>
+
+#include <algorithm>
+#include <mutex>
+#include <numeric>
+#include <stdexcept>
+#include <string_view>
+
+namespace crypto {
+
+namespace {
+
+/* ~2^40 candidates is far beyond what can be derived in reasonable time anyway */
+constexpr uint64_t MAX_CANDIDATES = uint64_t{1} << 40;
+constexpr uint64_t CANDIDATES_PER_CHUNK = 4096;
+
+int edit_distance(std::string_view lhs, std::string_view rhs) {
+	std::vector<int> row(rhs.size() + 1);
+	std::iota(row.begin(), row.end(), 0);
+
+	for (size_t i = 1; i <= lhs.size(); ++i) {
+		int diagonal = row[0];
+		row[0] = i;
+		for (size_t j = 1; j <= rhs.size(); ++j) {
+			int above = row[j];
+			int substitution = diagonal + (lhs[i - 1] != rhs[j - 1]);
+			row[j] = std::min({row[j] + 1, row[j - 1] + 1, substitution});
+			diagonal = above;
+		}
+	}
+
+	return row[rhs.size()];
+}
+
+/* generated mnemonics carry one extra, unchecksummed word */
+size_t checksummed_words(size_t n_words) {
+	if (n_words % 3 == 1) --n_words;
+	if (n_words < 12 || n_words > 24 || n_words % 3 != 0) return 0;
+	return n_words;
+}
+
+std::vector<int> all_word_indices() {
+	std::vector<int> rv(MNEMONIC_DICTIONARY_SIZE);
+	std::iota(rv.begin(), rv.end(), 0);
+	return rv;
+}
+
+} // namespace
+
+std::vector<std::vector<int>> mnemonic_candidates(
+    const std::vector<utils::sensitive_string_view> &words, int max_edit_distance) {
+	std::vector<std::vector<int>> rv;
+	rv.reserve(words.size());
+
+	const Wordlist &dictionary = wordlist();
+	for (const auto &word : words) {
+		const std::string_view typed(word);
+		if (typed == MNEMONIC_WILDCARD) {
+			rv.push_back(all_word_indices());
+			continue;
+		}
+
+		if (auto index = dictionary.find(typed)) {
+			rv.push_back({*index});
+			continue;
+		}
+
+		std::vector<std::pair<int, int>> neighbours; // (distance, index)
+		for (int i = 0; i < MNEMONIC_DICTIONARY_SIZE; ++i) {
+			if (int distance = edit_distance(typed, dictionary.at(i));
+			    distance <= max_edit_distance) {
+				neighbours.emplace_back(distance, i);
+			}
+		}
+
+		if (neighbours.empty()) {
+			rv.push_back(all_word_indices());
+			continue;
+		}
+
+		/* closest words first, the search stops on first match */
+		std::stable_sort(neighbours.begin(), neighbours.end(),
+		    [](const auto &lhs, const auto &rhs) { return lhs.first < rhs.first; });
+
+		std::vector<int> indices;
+		indices.reserve(neighbours.size());
+		for (const auto &neighbour : neighbours) {
+			indices.push_back(neighbour.second);
+		}
+		rv.push_back(std::move(indices));
+	}
+
+	return rv;
+}
+
+bool is_mnemonic_complete(const std::vector<utils::sensitive_string_view> &words) {
+	const Wordlist &dictionary = wordlist();
+	return std::all_of(words.begin(), words.end(), [&dictionary](const auto &word) {
+		return dictionary.find(std::string_view(word)).has_value();
+	});
+}
+
+std::optional<std::vector<utils::sensitive_string>> recover_mnemonic(
+    const std::vector<utils::sensitive_string_view> &words, const SeedMatcher &matcher,
+    const RecoveryOptions &options) {
+	const Wordlist &dictionary = wordlist();
+	const auto candidates = mnemonic_candidates(words, options.max_edit_distance);
+	const size_t n_checksummed = checksummed_words(words.size());
+
+	uint64_t total = 1;
+	for (const auto &position : candidates) {
+		total *= position.size();
+		if (total > MAX_CANDIDATES) {
+			throw std::runtime_error("too many unknown words to recover");
+		}
+	}
+
+	if (options.progress) options.progress->total = total;
+
+	std::mutex result_mutex;
+	std::optional<std::vector<utils::sensitive_string>> result;
+	std::atomic<bool> found{false};
+
+	auto process_range = [&](uint64_t begin, uint64_t end) {
+		std::vector<int> indices(candidates.size());
+		std::vector<int> checksummed_indices(n_checksummed);
+		uint64_t checked = 0;
+
+		for (uint64_t combination = begin; combination < end; ++combination) {
+			if (found || options.cancel_token.is_cancelled()) break;
+
+			/* mixed radix decoding, the last position changes the fastest */
+			uint64_t rest = combination;
+			for (size_t p = candidates.size(); p-- > 0;) {
+				indices[p] = candidates[p][rest % candidates[p].size()];
+				rest /= candidates[p].size();
+			}
+
+			++checked;
+			if (n_checksummed) {
+				std::copy_n(indices.begin(), n_checksummed, checksummed_indices.begin());
+				if (!verify_mnemonic_checksum(checksummed_indices)) continue;
+			}
+
+			/* views into the static wordlist, no word is copied until there is a match */
+			std::vector<utils::sensitive_string_view> mnemonic;
+			mnemonic.reserve(indices.size());
+			for (int index : indices) {
+				std::string_view word = dictionary.at(index);
+				mnemonic.emplace_back(word.data(), word.size());
+			}
+
+			Seed seed = mnemonic_to_seed(mnemonic);
+			if (options.progress) ++options.progress->derived;
+
+			if (matcher(seed) && !found.exchange(true)) {
+				std::unique_lock<std::mutex> lk(result_mutex);
+				result.emplace(mnemonic.begin(), mnemonic.end());
+			}
+		}
+
+		if (options.progress) options.progress->checked += checked;
+		if (options.on_progress) options.on_progress();
+	};
+
+	/* one task per thread pulling chunks, so no task is queued before it can be worked on and
+	 * nothing new is started once the search is over */
+	std::atomic<uint64_t> cursor{0};
+	auto pull_chunks = [&](size_t, size_t) {
+		while (!found && !options.cancel_token.is_cancelled()) {
+			const uint64_t begin = cursor.fetch_add(CANDIDATES_PER_CHUNK);
+			if (begin >= total) return;
+			process_range(begin, std::min<uint64_t>(total, begin + CANDIDATES_PER_CHUNK));
+		}
+	};
+
+	utils::WorkStealingPool pool(options.n_threads);
+	pool.parallel_for(0, pool.size(), 1, pull_chunks);
+
+	std::unique_lock<std::mutex> lk(result_mutex);
+	return result;
+}
+
+} // namespace crypto
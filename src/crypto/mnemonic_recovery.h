@@ -0,0 +1,66 @@
+/*
+
+Copyright (C) 2019 Mateusz Morusiewicz
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#pragma once
+
+#include <src/crypto/structs.h>
+
+#include <src/utils/thread_pool.h>
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <vector>
+
+namespace crypto {
+
+constexpr char MNEMONIC_WILDCARD[] = "?";
+
+struct RecoveryProgress {
+	std::atomic<uint64_t> total{0};   // candidate combinations to go through
+	std::atomic<uint64_t> checked{0}; // combinations gone through so far, checksum failures too
+	std::atomic<uint64_t> derived{0}; // checksum survivors run through mnemonic_to_seed
+};
+
+struct RecoveryOptions {
+	int max_edit_distance = 2;
+	size_t n_threads = 0; // 0 means one per core
+	utils::CancellationToken cancel_token{};
+	RecoveryProgress *progress = nullptr;
+	std::function<void()> on_progress{}; // called from worker threads after each chunk
+};
+
+using SeedMatcher = std::function<bool(const Seed &)>;
+
+/* Dictionary indices to try at each position: the word itself if it's known, its closest
+ * neighbours (by edit distance) if it's not and the whole dictionary for wildcards */
+std::vector<std::vector<int>> mnemonic_candidates(
+    const std::vector<utils::sensitive_string_view> &words, int max_edit_distance);
+
+/* Whether every word is in the dictionary, i.e. there is nothing to recover */
+bool is_mnemonic_complete(const std::vector<utils::sensitive_string_view> &words);
+
+/* Returns the first mnemonic whose seed is accepted by the matcher. Words are checksum-filtered
+ * before the expensive seed derivation unless the mnemonic has no checksum at all */
+std::optional<std::vector<utils::sensitive_string>> recover_mnemonic(
+    const std::vector<utils::sensitive_string_view> &words, const SeedMatcher &matcher,
+    const RecoveryOptions &options = {});
+
+} // namespace crypto
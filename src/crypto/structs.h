@@ -34,18 +34,20 @@ template <int S, typename CV> struct ByteArray {
 	using UnderlyingType = std::array<unsigned char, Size>;
 	UnderlyingType _data;
 
+	/* every constructor locks, as the destructor unlocks unconditionally */
 	ByteArray() {
 		lock_mem(_data.data(), Size);
 	}
 
 	~ByteArray() {
+		utils::secure_zero(_data.data(), Size);
 		unlock_mem(_data.data(), Size);
 	}
 
-	ByteArray(UnderlyingType &&other) : _data(std::move(other)) {}
+	ByteArray(UnderlyingType &&other) : _data(std::move(other)) { lock_mem(_data.data(), Size); }
 
-	ByteArray(const ByteArray &other) : _data(other._data) {}
-	ByteArray(ByteArray &&other) { this->_data = std::move(other._data); }
+	ByteArray(const ByteArray &other) : _data(other._data) { lock_mem(_data.data(), Size); }
+	ByteArray(ByteArray &&other) : _data(std::move(other._data)) { lock_mem(_data.data(), Size); }
 
 	ByteArray &operator=(const ByteArray &other) {
 		this->_data = other._data;
@@ -25,7 +25,7 @@ namespace crypto {
 
 // TODO: should clear the encryption key if not used for <x> (e.g. 3 minutes)
 // TODO: should use secret-service if available (via e.g. libsecret)
-// else should use kernel key management if available (should be)
+// kernel key management keeps the hash between invocations, see key_cache.h
 class TimedEncryptionKey {
 	bool valid = false;
 	PasswordHash ec;
@@ -17,36 +17,11 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
 */
 
+#include <src/crypto/locked_memory.h>
 #include <src/crypto/utils.h>
 
+#include <algorithm>
 #include <cstring>
-#include <unistd.h>
-
-#ifdef _POSIX_MEMLOCK_RANGE
-#include <stdexcept>
-#include <cerrno>
-#include <sys/mman.h>
-#endif
-
-namespace crypto {
-
-void lock_mem(const void *mem, size_t size) {
-#ifdef _POSIX_MEMLOCK_RANGE
-	if (int ret = mlock(mem, size); ret != 0) {
-		throw std::runtime_error(std::string("could not lock memory: ") + std::strerror(errno));
-	}
-#endif
-}
-
-void unlock_mem(const void *mem, size_t size) {
-#ifdef _POSIX_MEMLOCK_RANGE
-	if (int ret = munlock(mem, size); ret != 0) {
-		throw std::runtime_error(std::string("could not unlock memory: ") + std::strerror(errno));
-	}
-#endif
-}
-
-} // namespace crypto
 
 namespace utils {
 
@@ -55,8 +30,7 @@ sensitive_string::sensitive_string() : sensitive_string(32) {}
 sensitive_string::sensitive_string(int size) : index(0), max_size(size) {
 	if (size == 0) return;
 
-	_data = new char[size];
-	crypto::lock_mem(_data, max_size);
+	_data = static_cast<char *>(crypto::secure_alloc(size));
 }
 
 sensitive_string::sensitive_string(sensitive_string &&other) {
@@ -69,6 +43,9 @@ sensitive_string::sensitive_string(sensitive_string &&other) {
 }
 
 sensitive_string &sensitive_string::operator=(sensitive_string &&other) {
+	if (this == &other) return *this;
+
+	crypto::secure_free(this->_data, this->max_size);
 	this->index = other.index;
 	this->max_size = other.max_size;
 	this->_data = other._data;
@@ -83,31 +60,40 @@ sensitive_string::sensitive_string(const sensitive_string &other) {
 	this->max_size = other.max_size;
 	if (this->max_size == 0) return;
 
-	this->_data = new char[this->max_size];
-	crypto::lock_mem(this->_data, this->max_size);
+	this->_data = static_cast<char *>(crypto::secure_alloc(this->max_size));
 	std::memcpy(this->_data, other._data, other.index);
 }
 
 sensitive_string &sensitive_string::operator=(const sensitive_string &other) {
+	if (this == &other) return *this;
+
+	char *data = static_cast<char *>(crypto::secure_alloc(other.max_size));
+	if (data) std::memcpy(data, other._data, other.index);
+
+	crypto::secure_free(this->_data, this->max_size);
+	this->_data = data;
 	this->index = other.index;
 	this->max_size = other.max_size;
-	if (this->max_size == 0) return *this;
-
-	this->_data = new char[max_size];
-	crypto::lock_mem(this->_data, this->max_size);
-	std::memcpy(this->_data, other._data, other.index);
 	return *this;
 }
 
 sensitive_string::sensitive_string(const char *str) {
 	size_t len = std::strlen(str);
 	this->index = len;
-	if (len == 0) return;
+	if (len == 0) {
+		this->max_size = 0; // nothing allocated, push_back has to allocate
+		return;
+	}
 	this->resize(len);
 	std::strncpy(this->_data, str, len);
 }
 
 sensitive_string::sensitive_string(const char *data, size_t size) {
+	if (size == 0) {
+		this->max_size = 0;
+		return;
+	}
+
 	this->resize(size);
 	std::memcpy(this->_data, data, size);
 	this->index = size;
@@ -116,8 +102,7 @@ sensitive_string::sensitive_string(const char *data, size_t size) {
 sensitive_string::sensitive_string(const std::string &str) {
 	this->index = str.size();
 	this->max_size = std::max(static_cast<size_t>(32), str.size());
-	this->_data = new char[this->max_size];
-	crypto::lock_mem(this->_data, this->max_size);
+	this->_data = static_cast<char *>(crypto::secure_alloc(this->max_size));
 	std::memcpy(_data, str.c_str(), str.size());
 }
 
@@ -125,40 +110,27 @@ sensitive_string::sensitive_string(std::string &&str) {
 	this->index = str.size();
 	this->max_size = std::max(static_cast<size_t>(32), str.size());
 	// _data = str.data(); ?
-	this->_data = new char[max_size];
-	crypto::lock_mem(this->_data, this->max_size);
+	this->_data = static_cast<char *>(crypto::secure_alloc(this->max_size));
 	std::memcpy(_data, str.c_str(), str.size());
 	secure_zero(str.data(), str.size());
 }
 
-sensitive_string::~sensitive_string() {
-	// delete _data
-	if (!this->_data) return;
-	secure_zero(this->_data, this->max_size);
-	crypto::unlock_mem(_data, max_size);
-	delete[] this->_data;
-}
-
-sensitive_string::operator std::string() const {
-	std::string rs;
-	const auto size = this->size();
-	rs.reserve(size + 1); // additional space for null char
-	for (auto i = 0; i < size; ++i) {
-		rs.push_back(this->_data[i]);
-	}
-	rs[size] = '\0';
+sensitive_string::sensitive_string(sensitive_string_view view) :
+    sensitive_string(view.data(), view.size()) {}
 
-	return rs;
+sensitive_string::~sensitive_string() {
+	crypto::secure_free(this->_data, this->max_size); // zeroes the buffer
 }
 
+sensitive_string::operator std::string() const { return std::string(this->_data, this->index); }
+
 size_t sensitive_string::size() const { return this->index; }
 
 void sensitive_string::resize(size_t new_size) {
 	if (new_size == 0) return;
 
 	index = std::min(index, new_size);
-	char *new_ptr = new char[new_size];
-	crypto::lock_mem(new_ptr, new_size);
+	char *new_ptr = static_cast<char *>(crypto::secure_alloc(new_size));
 	auto old_ptr = _data;
 	auto old_size = max_size;
 	if (old_ptr) {
@@ -168,11 +140,7 @@ void sensitive_string::resize(size_t new_size) {
 	_data = new_ptr;
 	max_size = new_size;
 
-	if (old_ptr) {
-		secure_zero(old_ptr, old_size);
-		crypto::unlock_mem(old_ptr, old_size);
-		delete[] old_ptr;
-	}
+	crypto::secure_free(old_ptr, old_size);
 }
 
 void sensitive_string::reserve(size_t new_size) {
@@ -217,6 +185,19 @@ bool operator<(const sensitive_string &lhs, const sensitive_string &rhs) {
 	return false;
 }
 
+sensitive_string_view sensitive_string_view::substr(size_t pos, size_t count) const {
+	pos = std::min(pos, _size);
+	return sensitive_string_view(_data + pos, std::min(count, _size - pos));
+}
+
+bool operator==(sensitive_string_view lhs, sensitive_string_view rhs) {
+	if (lhs.size() != rhs.size()) return false;
+	if (lhs.empty() || lhs.data() == rhs.data()) return true;
+	return std::memcmp(lhs.data(), rhs.data(), lhs.size()) == 0;
+}
+
+bool operator!=(sensitive_string_view lhs, sensitive_string_view rhs) { return !(lhs == rhs); }
+
 void secure_zero(void *s, size_t n) {
 	volatile char *p = reinterpret_cast<char *>(s);
 	while (n--) *p++ = 0;
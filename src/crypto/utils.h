@@ -21,6 +21,7 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
 #include <cstddef>
 #include <string>
+#include <string_view>
 
 namespace crypto {
 
@@ -31,6 +32,8 @@ void unlock_mem(const void *mem, size_t size);
 
 namespace utils {
 
+struct sensitive_string_view;
+
 struct sensitive_string {
 	size_t index = 0;
 	size_t max_size = 32;
@@ -48,6 +51,7 @@ struct sensitive_string {
 	sensitive_string(const char *data, size_t size);
 	explicit sensitive_string(const std::string &);
 	explicit sensitive_string(std::string &&);
+	explicit sensitive_string(sensitive_string_view);
 
 	~sensitive_string();
 
@@ -70,6 +74,33 @@ bool operator==(const sensitive_string &lhs, const sensitive_string &rhs);
 bool operator!=(const sensitive_string &lhs, const sensitive_string &rhs);
 bool operator<(const sensitive_string &lhs, const sensitive_string &rhs);
 
+/* Non-owning, read-only view into a sensitive_string (or any other buffer), nothing is copied or
+ * locked. The viewed memory has to outlive the view. */
+struct sensitive_string_view {
+	const char *_data = nullptr;
+	size_t _size = 0;
+
+	constexpr sensitive_string_view() = default;
+	constexpr sensitive_string_view(const char *data, size_t size) : _data(data), _size(size) {}
+	sensitive_string_view(const sensitive_string &str) : _data(str.data()), _size(str.size()) {}
+
+	explicit operator std::string_view() const { return std::string_view(_data, _size); }
+
+	const char &operator[](size_t index) const { return _data[index]; }
+
+	const char *data() const { return _data; }
+	const char *begin() const { return _data; }
+	const char *end() const { return _data + _size; }
+
+	size_t size() const { return _size; }
+	bool empty() const { return _size == 0; }
+
+	sensitive_string_view substr(size_t pos, size_t count) const;
+};
+
+bool operator==(sensitive_string_view lhs, sensitive_string_view rhs);
+bool operator!=(sensitive_string_view lhs, sensitive_string_view rhs);
+
 void secure_zero(void *s, size_t n);
 void secure_zero_string(std::string &&s);
 
@@ -0,0 +1,95 @@
+/*
+
+Copyright (C) 2019 Mateusz Morusiewicz
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#include <src/crypto/wordlist.h>
+
+#include <src/crypto/wordlists/english.h>
+
+namespace crypto {
+
+namespace {
+
+using namespace wordlist_detail;
+
+template <size_t N>
+constexpr bool is_perfect(const std::array<std::string_view, N> &words, const PerfectHash<N> &ph) {
+	for (size_t i = 0; i < N; ++i) {
+		if (ph.slots[ph.slot_of(words[i])] != i) return false;
+	}
+	return true;
+}
+
+template <size_t N>
+constexpr bool has_unique_prefixes(const std::array<std::string_view, N> &words) {
+	for (size_t i = 1; i < N; ++i) {
+		if (common_prefix(words[i - 1], words[i]) >= WORDLIST_UNIQUE_PREFIX) return false;
+	}
+	return true;
+}
+
+static_assert(is_sorted(wordlists::ENGLISH), "wordlist has to be sorted");
+static_assert(has_unique_prefixes(wordlists::ENGLISH), "wordlist prefixes have to be unique");
+
+constexpr auto ENGLISH_HASH = build_perfect_hash(wordlists::ENGLISH);
+static_assert(is_perfect(wordlists::ENGLISH, ENGLISH_HASH));
+
+constexpr auto ENGLISH_TRIE =
+    build_trie<count_trie_nodes(wordlists::ENGLISH)>(wordlists::ENGLISH);
+
+constexpr Wordlist ENGLISH{wordlists::ENGLISH, ENGLISH_HASH, ENGLISH_TRIE};
+
+} // namespace
+
+std::optional<int> Wordlist::find(std::string_view word) const {
+	const size_t bucket = hash(word, 0) % n_buckets;
+	const uint16_t index = slots[hash(word, displacements[bucket]) % n_slots];
+	if (index == EMPTY_SLOT || words[index] != word) return std::nullopt;
+	return index;
+}
+
+std::pair<int, int> Wordlist::prefix_range(std::string_view prefix) const {
+	const TrieNode *node = &trie[0];
+	for (char c : prefix) {
+		const TrieNode *child = &trie[node->first_child];
+		const TrieNode *end = child + node->n_children;
+		while (child != end && child->ch != c) ++child;
+
+		if (child == end) return {0, 0};
+		node = child;
+	}
+
+	return {node->lo, node->hi};
+}
+
+std::optional<int> Wordlist::complete(std::string_view prefix) const {
+	auto [lo, hi] = prefix_range(prefix);
+	if (hi - lo != 1) return std::nullopt;
+	return lo;
+}
+
+const Wordlist &wordlist(Language language) {
+	switch (language) {
+	case Language::English:
+		return ENGLISH;
+	}
+
+	return ENGLISH;
+}
+
+} // namespace crypto
@@ -0,0 +1,218 @@
+/*
+
+Copyright (C) 2019 Mateusz Morusiewicz
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+#include <utility>
+
+namespace crypto {
+
+enum class Language { English };
+
+/* BIP-39 words are unique within their first four letters */
+constexpr size_t WORDLIST_UNIQUE_PREFIX = 4;
+
+namespace wordlist_detail {
+
+constexpr uint16_t EMPTY_SLOT = 0xffff;
+
+constexpr uint32_t hash(std::string_view word, uint32_t seed) {
+	uint32_t h = 2166136261u ^ (seed * 0x9e3779b9u);
+	for (char c : word) {
+		h ^= static_cast<unsigned char>(c);
+		h *= 16777619u;
+	}
+	return h ^ (h >> 15);
+}
+
+/* Hash-and-displace: words are grouped into buckets by hash(w, 0) and every bucket gets the
+ * smallest displacement that sends all of its words to free slots */
+template <size_t N> struct PerfectHash {
+	static constexpr size_t Buckets = N / 4 > 0 ? N / 4 : 1;
+	static constexpr size_t Slots = 2 * N;
+
+	std::array<uint16_t, Buckets> displacements{};
+	std::array<uint16_t, Slots> slots{};
+
+	constexpr size_t bucket_of(std::string_view word) const { return hash(word, 0) % Buckets; }
+	constexpr size_t slot_of(std::string_view word) const {
+		return hash(word, displacements[bucket_of(word)]) % Slots;
+	}
+};
+
+template <size_t N>
+constexpr PerfectHash<N> build_perfect_hash(const std::array<std::string_view, N> &words) {
+	using PH = PerfectHash<N>;
+	PH ph{};
+	for (auto &slot : ph.slots) slot = EMPTY_SLOT;
+
+	/* counting sort of words by bucket */
+	std::array<size_t, PH::Buckets + 1> bucket_start{};
+	for (size_t i = 0; i < N; ++i) ++bucket_start[ph.bucket_of(words[i]) + 1];
+	size_t max_bucket = 0;
+	for (size_t b = 0; b < PH::Buckets; ++b) {
+		if (bucket_start[b + 1] > max_bucket) max_bucket = bucket_start[b + 1];
+		bucket_start[b + 1] += bucket_start[b];
+	}
+
+	std::array<size_t, PH::Buckets> filled{};
+	std::array<uint16_t, N> members{};
+	for (size_t i = 0; i < N; ++i) {
+		size_t b = ph.bucket_of(words[i]);
+		members[bucket_start[b] + filled[b]++] = static_cast<uint16_t>(i);
+	}
+
+	/* largest buckets first, while the table is still mostly empty */
+	for (size_t size = max_bucket; size > 0; --size) {
+		for (size_t b = 0; b < PH::Buckets; ++b) {
+			if (bucket_start[b + 1] - bucket_start[b] != size) continue;
+
+			for (uint32_t d = 1;; ++d) {
+				std::array<size_t, 64> taken{};
+				bool fits = true;
+				for (size_t m = 0; m < size && fits; ++m) {
+					size_t slot = hash(words[members[bucket_start[b] + m]], d) % PH::Slots;
+					fits = ph.slots[slot] == EMPTY_SLOT;
+					for (size_t t = 0; t < m && fits; ++t) fits = taken[t] != slot;
+					taken[m] = slot;
+				}
+
+				if (!fits) continue;
+
+				ph.displacements[b] = static_cast<uint16_t>(d);
+				for (size_t m = 0; m < size; ++m) {
+					ph.slots[taken[m]] = members[bucket_start[b] + m];
+				}
+				break;
+			}
+		}
+	}
+
+	return ph;
+}
+
+/* Trie over a sorted wordlist: children of a node are stored next to each other and every node
+ * knows the [lo, hi) range of words sharing its prefix */
+struct TrieNode {
+	char ch;
+	uint8_t n_children;
+	uint16_t lo, hi;
+	uint16_t first_child;
+};
+
+constexpr size_t common_prefix(std::string_view lhs, std::string_view rhs) {
+	size_t i = 0;
+	while (i < lhs.size() && i < rhs.size() && lhs[i] == rhs[i]) ++i;
+	return i;
+}
+
+template <size_t N>
+constexpr size_t count_trie_nodes(const std::array<std::string_view, N> &words) {
+	size_t count = 1; // root
+	for (size_t i = 0; i < N; ++i) {
+		count += words[i].size() - (i > 0 ? common_prefix(words[i - 1], words[i]) : 0);
+	}
+	return count;
+}
+
+template <size_t N> constexpr bool is_sorted(const std::array<std::string_view, N> &words) {
+	for (size_t i = 1; i < N; ++i) {
+		if (!(words[i - 1] < words[i])) return false;
+	}
+	return true;
+}
+
+template <size_t NodeCount, size_t N>
+constexpr std::array<TrieNode, NodeCount> build_trie(const std::array<std::string_view, N> &words) {
+	std::array<TrieNode, NodeCount> nodes{};
+	std::array<uint8_t, NodeCount> depth{};
+
+	nodes[0] = TrieNode{'\0', 0, 0, static_cast<uint16_t>(N), 0};
+	size_t n_nodes = 1;
+
+	/* breadth-first, so the nodes array doubles as the queue */
+	for (size_t k = 0; k < n_nodes; ++k) {
+		const size_t d = depth[k];
+		nodes[k].first_child = static_cast<uint16_t>(n_nodes);
+
+		for (size_t i = nodes[k].lo; i < nodes[k].hi;) {
+			if (words[i].size() <= d) {
+				++i;
+				continue;
+			}
+
+			size_t j = i + 1;
+			while (j < nodes[k].hi && words[j].size() > d && words[j][d] == words[i][d]) ++j;
+
+			nodes[n_nodes] = TrieNode{
+			    words[i][d], 0, static_cast<uint16_t>(i), static_cast<uint16_t>(j), 0};
+			depth[n_nodes] = static_cast<uint8_t>(d + 1);
+			++n_nodes;
+			++nodes[k].n_children;
+			i = j;
+		}
+	}
+
+	return nodes;
+}
+
+} // namespace wordlist_detail
+
+class Wordlist {
+	const std::string_view *words;
+	size_t n_words;
+
+	const uint16_t *displacements;
+	size_t n_buckets;
+	const uint16_t *slots;
+	size_t n_slots;
+
+	const wordlist_detail::TrieNode *trie;
+
+  public:
+	template <size_t N, size_t NodeCount>
+	constexpr Wordlist(const std::array<std::string_view, N> &words,
+	    const wordlist_detail::PerfectHash<N> &ph,
+	    const std::array<wordlist_detail::TrieNode, NodeCount> &trie) :
+	    words(words.data()),
+	    n_words(N), displacements(ph.displacements.data()),
+	    n_buckets(wordlist_detail::PerfectHash<N>::Buckets), slots(ph.slots.data()),
+	    n_slots(wordlist_detail::PerfectHash<N>::Slots), trie(trie.data()) {}
+
+	size_t size() const { return n_words; }
+	std::string_view at(size_t index) const { return words[index % n_words]; }
+
+	/* exact lookup through the perfect hash */
+	std::optional<int> find(std::string_view word) const;
+
+	/* [lo, hi) range of the words starting with prefix, empty if there are none */
+	std::pair<int, int> prefix_range(std::string_view prefix) const;
+
+	/* the only word starting with prefix, if there is exactly one */
+	std::optional<int> complete(std::string_view prefix) const;
+};
+
+const Wordlist &wordlist(Language language = Language::English);
+
+} // namespace crypto
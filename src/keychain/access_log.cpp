@@ -0,0 +1,288 @@
+/*
+
+Copyright (C) 2019 Mateusz Morusiewicz
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#include <src/keychain/access_log.h>
+
+#include <src/keychain/db.h>
+
+#include <external/nlohmann/json_single_include.h>
+using json = nlohmann::json;
+
+#include <leveldb/db.h>
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+namespace keychain {
+
+namespace {
+
+constexpr char DB_KEY_ACCESS[] = "access";
+
+} // namespace
+
+void FrecencyHeap::swap_slots(size_t a, size_t b) {
+	std::swap(heap[a], heap[b]);
+	index[heap[a].dpath] = a;
+	index[heap[b].dpath] = b;
+}
+
+void FrecencyHeap::sift_up(size_t slot) {
+	while (slot > 0) {
+		const size_t parent = (slot - 1) / 2;
+		if (heap[parent].rank <= heap[slot].rank) return;
+		swap_slots(parent, slot);
+		slot = parent;
+	}
+}
+
+void FrecencyHeap::sift_down(size_t slot) {
+	while (true) {
+		size_t lowest = slot;
+		for (size_t child : {2 * slot + 1, 2 * slot + 2}) {
+			if (child < heap.size() && heap[child].rank < heap[lowest].rank) lowest = child;
+		}
+		if (lowest == slot) return;
+		swap_slots(lowest, slot);
+		slot = lowest;
+	}
+}
+
+void FrecencyHeap::offer(int dpath, double rank) {
+	if (auto it = index.find(dpath); it != index.end()) {
+		const size_t slot = it->second;
+		heap[slot].rank = rank;
+		sift_down(slot);
+		sift_up(slot);
+		return;
+	}
+
+	if (heap.size() < capacity) {
+		heap.push_back({rank, dpath});
+		index[dpath] = heap.size() - 1;
+		sift_up(heap.size() - 1);
+		return;
+	}
+
+	if (heap.empty() || rank <= heap[0].rank) return;
+	index.erase(heap[0].dpath);
+	heap[0] = {rank, dpath};
+	index[dpath] = 0;
+	sift_down(0);
+}
+
+void FrecencyHeap::clear() {
+	heap.clear();
+	index.clear();
+}
+
+std::vector<int> FrecencyHeap::ranked() const {
+	auto slots = heap;
+	std::sort(slots.begin(), slots.end(), [](const Slot &lhs, const Slot &rhs) {
+		return lhs.rank != rhs.rank ? lhs.rank > rhs.rank : lhs.dpath < rhs.dpath;
+	});
+
+	std::vector<int> rv;
+	rv.reserve(slots.size());
+	for (const auto &slot : slots) rv.push_back(slot.dpath);
+	return rv;
+}
+
+AccessLog::AccessLog(DB *db, size_t top_size, std::chrono::seconds half_life) :
+    db(db), half_life_s(half_life.count()), top_ranked(top_size) {
+	load();
+	worker = std::thread([this]() { worker_loop(); });
+}
+
+AccessLog::~AccessLog() {
+	{
+		std::unique_lock<std::mutex> lk(mutex);
+		stopping = true;
+	}
+	cv.notify_all();
+	worker.join();
+}
+
+int64_t AccessLog::unix_now() {
+	using namespace std::chrono;
+	return duration_cast<seconds>(system_clock::now().time_since_epoch()).count();
+}
+
+/* a log that can't be read is started over, it only ever saves some navigation */
+void AccessLog::load() {
+	std::string data;
+	if (auto s = db->Get(leveldb::ReadOptions(), DB_KEY_ACCESS, &data); !s.ok()) return;
+
+	try {
+		for (const auto &item : json::parse(data)) {
+			AccessRecord record{item["dpath"].get<int>(), item["path"].get<std::string>(),
+			    item["count"].get<uint32_t>(), item["last_access"].get<int64_t>(),
+			    item["rank"].get<double>()};
+			records.emplace(record.dpath, std::move(record));
+		}
+	} catch (const json::exception &) {
+		records.clear();
+	}
+
+	rebuild_top();
+}
+
+void AccessLog::rebuild_top() {
+	top_ranked.clear();
+	for (const auto &[dpath, record] : records) top_ranked.offer(dpath, record.rank);
+}
+
+void AccessLog::worker_loop() {
+	using Clock = std::chrono::steady_clock;
+	Clock::time_point last_write{};
+
+	std::unique_lock<std::mutex> lk(mutex);
+	while (true) {
+		cv.wait(lk, [this]() { return stopping || dirty_generation != saved_generation; });
+		if (dirty_generation == saved_generation) return;
+
+		/* accesses coming in quick succession are written together */
+		while (!stopping && !flush_requested) {
+			const auto deadline = last_write + ACCESS_WRITE_INTERVAL;
+			if (Clock::now() >= deadline) break;
+			cv.wait_until(lk, deadline);
+		}
+
+		flush_requested = false;
+		const uint64_t generation = dirty_generation;
+		json data = json::array();
+		for (const auto &[dpath, record] : records) {
+			data.push_back({{"dpath", dpath}, {"path", record.path}, {"count", record.count},
+			    {"last_access", record.last_access}, {"rank", record.rank}});
+		}
+		lk.unlock();
+
+		/* a failed write is not retried, the next access brings another one */
+		db->Put(leveldb::WriteOptions(), DB_KEY_ACCESS, data.dump());
+		last_write = Clock::now();
+
+		lk.lock();
+		saved_generation = generation;
+		cv.notify_all();
+	}
+}
+
+void AccessLog::record(const crypto::DerivationPath &dpath, std::string path, int64_t now) {
+	{
+		std::unique_lock<std::mutex> lk(mutex);
+		auto &record = records.try_emplace(dpath.seed, AccessRecord{dpath.seed, {}}).first->second;
+		if (!path.empty()) record.path = std::move(path);
+
+		const double t = now / half_life_s;
+		record.rank = record.count == 0 ? t : std::log2(std::exp2(record.rank - t) + 1) + t;
+		++record.count;
+		record.last_access = now;
+		top_ranked.offer(record.dpath, record.rank);
+
+		if (records.size() > MAX_ACCESS_RECORDS) {
+			auto least = std::min_element(records.begin(), records.end(),
+			    [](const auto &lhs, const auto &rhs) { return lhs.second.rank < rhs.second.rank; });
+			records.erase(least);
+		}
+
+		++dirty_generation;
+	}
+	cv.notify_all();
+}
+
+std::vector<AccessRecord> AccessLog::top() const {
+	std::unique_lock<std::mutex> lk(mutex);
+	std::vector<AccessRecord> rv;
+	for (int dpath : top_ranked.ranked()) rv.push_back(records.at(dpath));
+	return rv;
+}
+
+double AccessLog::score(const AccessRecord &record, int64_t now) const {
+	return record.count == 0 ? 0 : std::exp2(record.rank - now / half_life_s);
+}
+
+void AccessLog::reconcile(const Directory::ptr &root) {
+	std::unordered_map<int, std::string> recorded;
+	{
+		std::unique_lock<std::mutex> lk(mutex);
+		for (const auto &[dpath, record] : records) recorded.emplace(dpath, record.path);
+	}
+
+	std::unordered_map<int, std::string> paths;
+
+	std::vector<std::pair<Directory::ptr, std::string>> to_visit{{root, ""}};
+	while (!to_visit.empty()) {
+		auto [dir, prefix] = std::move(to_visit.back());
+		to_visit.pop_back();
+
+		for (const auto &entry : dir->entries) {
+			const int dpath = entry->meta.dpath.seed;
+			auto it = recorded.find(dpath);
+			if (it == recorded.end()) continue;
+
+			std::string path = prefix + entry->meta.name;
+			if (path == it->second || !paths.count(dpath)) paths[dpath] = std::move(path);
+		}
+		for (const auto &child : dir->dirs) {
+			to_visit.emplace_back(child, prefix + child->meta.name + "/");
+		}
+	}
+
+	{
+		std::unique_lock<std::mutex> lk(mutex);
+		bool changed = false;
+		for (auto it = records.begin(); it != records.end();) {
+			/* recorded since the walk started */
+			if (!recorded.count(it->first)) {
+				++it;
+				continue;
+			}
+
+			auto path = paths.find(it->first);
+			if (path == paths.end()) {
+				it = records.erase(it);
+				changed = true;
+				continue;
+			}
+			if (it->second.path != path->second) {
+				it->second.path = std::move(path->second);
+				changed = true;
+			}
+			++it;
+		}
+
+		if (!changed) return;
+		rebuild_top();
+		++dirty_generation;
+	}
+	cv.notify_all();
+}
+
+void AccessLog::flush() {
+	std::unique_lock<std::mutex> lk(mutex);
+	const uint64_t target = dirty_generation;
+	if (saved_generation < target) {
+		flush_requested = true;
+		cv.notify_all();
+	}
+	cv.wait(lk, [this, target]() { return saved_generation >= target; });
+}
+
+} // namespace keychain
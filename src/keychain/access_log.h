@@ -0,0 +1,137 @@
+/*
+
+Copyright (C) 2019 Mateusz Morusiewicz
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#pragma once
+
+#include <src/keychain/keychain_entry.h>
+
+#include <src/crypto/structs.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace keychain {
+
+class DB;
+
+constexpr std::chrono::hours DEFAULT_FRECENCY_HALF_LIFE{24 * 7};
+constexpr size_t DEFAULT_QUICK_ACCESS_SIZE = 20;
+constexpr size_t MAX_ACCESS_RECORDS = 1000; // the least frecent ones are forgotten past this
+constexpr std::chrono::milliseconds ACCESS_WRITE_INTERVAL{1000};
+
+/* Every access weighs 1 and halves every half-life. The decayed sum is kept as
+ * rank = log2(sum) + t / half-life at the time t of the last access, which does not change as
+ * time passes, so records are compared by rank and stay in order until the next access. */
+struct AccessRecord {
+	int dpath;
+	std::string path; // as of the last access, may be stale until reconcile
+	uint32_t count = 0;
+	int64_t last_access = 0; // unix seconds
+	double rank = 0;
+};
+
+/* Bounded min-heap of the k highest ranks. Ranks only grow, so an id that is not among the top k
+ * can only get in when it is accessed, which is when it is offered. */
+class FrecencyHeap {
+	struct Slot {
+		double rank;
+		int dpath;
+	};
+
+	size_t capacity;
+	std::vector<Slot> heap;                // lowest rank on top
+	std::unordered_map<int, size_t> index; // dpath to its slot
+
+	void swap_slots(size_t a, size_t b);
+	void sift_down(size_t slot);
+	void sift_up(size_t slot);
+
+  public:
+	explicit FrecencyHeap(size_t capacity) : capacity(capacity) {}
+
+	/* a new rank for dpath, kept if it is among the top ones */
+	void offer(int dpath, double rank);
+	void clear();
+
+	size_t size() const { return heap.size(); }
+	bool contains(int dpath) const { return index.count(dpath); }
+
+	/* highest rank first */
+	std::vector<int> ranked() const;
+};
+
+/* Counts and times of views and derivations of entries, with the most frecent of them ready for
+ * quick access. Kept in the keychain db next to the tree but apart from it, so they can be read
+ * without loading the tree, and written from a background thread at most once per
+ * ACCESS_WRITE_INTERVAL. Thread-safe. */
+class AccessLog {
+	DB *db;
+	const double half_life_s;
+
+	mutable std::mutex mutex;
+	std::condition_variable cv;
+	std::unordered_map<int, AccessRecord> records;
+	FrecencyHeap top_ranked;
+
+	uint64_t dirty_generation = 0;
+	uint64_t saved_generation = 0;
+	bool flush_requested = false;
+	bool stopping = false;
+	std::thread worker;
+
+	void load();
+	void rebuild_top();
+	void worker_loop();
+
+  public:
+	AccessLog(DB *db, size_t top_size = DEFAULT_QUICK_ACCESS_SIZE,
+	    std::chrono::seconds half_life = DEFAULT_FRECENCY_HALF_LIFE);
+	/* whatever is pending is written out */
+	~AccessLog();
+
+	AccessLog(const AccessLog &) = delete;
+	AccessLog &operator=(const AccessLog &) = delete;
+
+	static int64_t unix_now();
+
+	/* path may be empty when it is not known, the one recorded before is kept then */
+	void record(const crypto::DerivationPath &dpath, std::string path, int64_t now = unix_now());
+
+	/* the most frecent entries, most frecent first */
+	std::vector<AccessRecord> top() const;
+
+	/* the decayed number of accesses at now */
+	double score(const AccessRecord &record, int64_t now = unix_now()) const;
+
+	/* Updates paths to the ones in root and forgets entries that are not there anymore. Of entries
+	 * sharing a derivation path the recorded one is kept if it is still there. */
+	void reconcile(const Directory::ptr &root);
+
+	/* blocks until everything recorded so far is written */
+	void flush();
+};
+
+} // namespace keychain
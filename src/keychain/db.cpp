@@ -19,21 +19,53 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
 #include <src/keychain/db.h>
 
+#include <src/utils/metrics.h>
+
 #include <leveldb/db.h>
 
 namespace keychain {
 
+constexpr std::chrono::milliseconds CACHE_ACCOUNTING_INTERVAL{100};
+
+void DB::account_cache(bool force) {
+	std::unique_lock<std::mutex> lk(cache_mutex, std::try_to_lock);
+	if (!lk) return;
+
+	const auto now = std::chrono::steady_clock::now();
+	if (!force && now - cache_accounted_at < CACHE_ACCOUNTING_INTERVAL) return;
+	cache_accounted_at = now;
+
+	std::string usage;
+	if (this->db->GetProperty("leveldb.approximate-memory-usage", &usage)) {
+		cache_bytes.set(std::stoull(usage));
+	}
+}
+
 DB::~DB() {
 	if (this->db) delete this->db;
 	this->db = nullptr;
 }
 
 leveldb::Status DB::Get(const leveldb::ReadOptions& options, const leveldb::Slice& key, std::string* value) {
-	return this->db->Get(options, key, value);
+	static utils::metrics::Counter &read_bytes =
+	    utils::metrics::counter("db_read_bytes", "Bytes of values read from the database");
+	METRICS_LATENCY("DB::Get");
+
+	auto status = this->db->Get(options, key, value);
+	if (status.ok()) read_bytes.add(value->size());
+	account_cache(false);
+	return status;
 }
 
 leveldb::Status DB::Put(const leveldb::WriteOptions& options, const leveldb::Slice& key, const leveldb::Slice& value) {
-	return this->db->Put(options, key, value);
+	static utils::metrics::Counter &written_bytes = utils::metrics::counter(
+	    "db_written_bytes", "Bytes of keys and values written to the database");
+	METRICS_LATENCY("DB::Put");
+
+	written_bytes.add(key.size() + value.size());
+	auto status = this->db->Put(options, key, value);
+	account_cache(true);
+	return status;
 }
 
 std::unique_ptr<DB> DB::Open(const leveldb::Options& options, const std::string& name) {
@@ -42,6 +74,7 @@ std::unique_ptr<DB> DB::Open(const leveldb::Options& options, const std::string&
 	if (!status.ok()) {
 		throw std::runtime_error("could not open db");
 	}
+	db->account_cache(true);
 
 	return db;
 }
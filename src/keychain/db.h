@@ -19,8 +19,12 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
 #pragma once
 
+#include <src/utils/memory.h>
+
+#include <chrono>
 #include <string>
 #include <memory>
+#include <mutex>
 
 namespace leveldb {
 class DB;
@@ -36,6 +40,13 @@ namespace keychain {
 class DB {
 	leveldb::DB *db;
 
+	/* memtables and block cache, looked at after every write and every 100ms of reads */
+	std::mutex cache_mutex;
+	utils::memory::Accounted cache_bytes{utils::memory::Category::StorageCache};
+	std::chrono::steady_clock::time_point cache_accounted_at{};
+
+	void account_cache(bool force);
+
 public:
 	virtual ~DB();
 
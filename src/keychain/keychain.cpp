@@ -21,6 +21,10 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
 #include <src/keychain/db.h>
 
+#include <src/utils/memory.h>
+#include <src/utils/metrics.h>
+#include <src/utils/trace.h>
+
 #include <external/nlohmann/json_single_include.h>
 using json = nlohmann::json;
 
@@ -37,16 +41,64 @@ namespace keychain {
 constexpr char DB_KEY_SEED[] = "seed";
 constexpr char DB_KEY_DPATH[] = "dpath";
 constexpr char DB_KEY_ENTRIES[] = "entries";
+constexpr char DB_KEY_SEED_CHECK[] = "seed_check";
+constexpr char DB_KEY_TAGS[] = "tags";
+
+namespace {
+
+/* FNV-1a, ties the stored tag index to the entries it was built from */
+uint64_t entries_checksum(const std::string &entries) {
+	uint64_t rv = 0xcbf29ce484222325;
+	for (unsigned char c : entries) {
+		rv ^= c;
+		rv *= 0x100000001b3;
+	}
+	return rv;
+}
+
+std::string checksum_prefix(uint64_t checksum) {
+	std::string rv;
+	for (int shift = 56; shift >= 0; shift -= 8) rv.push_back(static_cast<char>(checksum >> shift));
+	return rv;
+}
+
+/* nullptr if the index is missing, broken or was saved for other entries */
+std::shared_ptr<const TagIndex> load_tag_index(DB &db, const std::string &entries) {
+	std::string db_tags;
+	const std::string prefix = checksum_prefix(entries_checksum(entries));
+	if (auto s = db.Get(leveldb::ReadOptions(), DB_KEY_TAGS, &db_tags);
+	    !s.ok() || db_tags.compare(0, prefix.size(), prefix) != 0) {
+		return nullptr;
+	}
+
+	try {
+		return std::make_shared<const TagIndex>(
+		    TagIndex::deserialize(std::string_view(db_tags).substr(prefix.size())));
+	} catch (const std::runtime_error &) {
+		return nullptr;
+	}
+}
+
+} // namespace
 
 Keychain::Keychain(Keychain &&other) {
+	this->current = std::atomic_exchange(&other.current, {});
+	this->save_tickets = other.save_tickets.load();
+	this->last_saved_ticket = other.last_saved_ticket;
 	this->data_path = std::move(other.data_path);
 	this->db = std::move(other.db);
 	other.db = nullptr;
 	this->tec = std::move(other.tec);
+	this->m_access_log = std::move(other.m_access_log);
 }
 
 Keychain &Keychain::operator=(Keychain &&other) {
+	std::atomic_store(&this->current, std::atomic_exchange(&other.current, {}));
+	this->save_tickets = other.save_tickets.load();
+	this->last_saved_ticket = other.last_saved_ticket;
 	this->data_path = std::move(other.data_path);
+	/* ours is written out while its db is still there */
+	this->m_access_log = std::move(other.m_access_log);
 	this->db = std::move(other.db);
 	other.db = nullptr;
 	this->tec = std::move(other.tec);
@@ -59,25 +111,32 @@ std::string get_default_db_layout() {
 	return empty_db.dump();
 }
 
-std::unique_ptr<Keychain> Keychain::initialize_with_seed(
-    std::filesystem::path path, crypto::Seed seed, crypto::PasswordHash pw_hash) {
+std::unique_ptr<Keychain> Keychain::initialize_with_seed(std::filesystem::path path,
+    crypto::Seed seed, crypto::PasswordHash pw_hash, const utils::OperationOptions &options) {
+	TRACE_SPAN("keychain", "Keychain::initialize_with_seed");
+	METRICS_LATENCY("Keychain::initialize_with_seed");
+	utils::StageReporter stages(options, 3);
+
+	stages.begin("Creating database");
+	stages.commit();
 	std::unique_ptr<Keychain> kc = std::make_unique<Keychain>();
 	kc->data_path = std::move(path);
 	kc->tec = crypto::TimedEncryptionKey(std::move(pw_hash));
 
-	leveldb::Options options;
-	options.create_if_missing = true;
+	leveldb::Options db_options;
+	db_options.create_if_missing = true;
 
 	if (!std::filesystem::create_directory(kc->data_path)) {
 		throw std::runtime_error("could not create directory at given path");
 	}
 
 	auto db_path = kc->data_path / "db";
-	kc->db = DB::Open(options, db_path.string());
+	kc->db = DB::Open(db_options, db_path.string());
 	if (!kc->db) {
 		throw std::runtime_error("could not initialize db");
 	}
 
+	stages.begin("Storing seed");
 	crypto::EncryptedSeed encrypted_seed;
 	kc->tec.encrypt(encrypted_seed.data(), seed.data(), crypto::Seed::Size);
 
@@ -87,6 +146,13 @@ std::unique_ptr<Keychain> Keychain::initialize_with_seed(
 		throw std::runtime_error("could not save seed in the database");
 	}
 
+	if (auto s = kc->db->Put(leveldb::WriteOptions(), DB_KEY_SEED_CHECK,
+	        crypto::make_password_check(kc->tec.getPasswordHash()));
+	    !s.ok()) {
+		throw std::runtime_error("could not save seed in the database");
+	}
+
+	stages.begin("Writing initial layout");
 	if (auto s = kc->db->Put(leveldb::WriteOptions(), DB_KEY_ENTRIES, get_default_db_layout());
 	    !s.ok()) {
 		throw std::runtime_error("could not save default layout in the database");
@@ -96,10 +162,17 @@ std::unique_ptr<Keychain> Keychain::initialize_with_seed(
 		throw std::runtime_error("could not save default layout in the database");
 	}
 
+	stages.finish();
 	return kc;
 }
 
-std::unique_ptr<Keychain> Keychain::open(std::filesystem::path path, crypto::PasswordHash pw_hash) {
+std::unique_ptr<Keychain> Keychain::open(std::filesystem::path path, crypto::PasswordHash pw_hash,
+    const utils::OperationOptions &options) {
+	TRACE_SPAN("keychain", "Keychain::open");
+	METRICS_LATENCY("Keychain::open");
+	utils::StageReporter stages(options, 1);
+
+	stages.begin("Opening database");
 	std::unique_ptr<Keychain> kc = std::make_unique<Keychain>();
 	kc->data_path = path.string();
 	kc->tec = crypto::TimedEncryptionKey(std::move(pw_hash));
@@ -110,10 +183,17 @@ std::unique_ptr<Keychain> Keychain::open(std::filesystem::path path, crypto::Pas
 		throw std::runtime_error("could not open db");
 	}
 
+	/* the tree is loaded by the first snapshot(), what is shown first may not need it */
+	stages.finish();
 	return kc;
 }
 
-void Keychain::import_from_uri(const UriLocator &uri) {
+void Keychain::import_from_uri(const UriLocator &uri, const utils::OperationOptions &options) {
+	TRACE_SPAN("keychain", "Keychain::import_from_uri");
+	METRICS_LATENCY("Keychain::import_from_uri");
+	utils::StageReporter stages(options, 4);
+
+	stages.begin("Reading export");
 	std::optional<utils::sensitive_string> encoded_encrypted_entries{};
 
 	if (auto import_path = std::get_if<std::filesystem::path>(&uri)) {
@@ -128,24 +208,44 @@ void Keychain::import_from_uri(const UriLocator &uri) {
 	}
 
 	assert(encoded_encrypted_entries);
+
+	stages.begin("Decrypting entries");
 	crypto::Ciphertext encrypted_entries =
-	    crypto::as_ciphertext(crypto::base64_decode(*encoded_encrypted_entries));
+	    crypto::base64_decode_ciphertext(*encoded_encrypted_entries);
 
 	crypto::EncryptionKey key(derive_child(standard_export_dpath));
 
 	crypto::B64EncodedText decrypted_entries = crypto::decrypt(key, encrypted_entries);
 	std::string entries = crypto::base64_decode(decrypted_entries);
+	/* the encoded and encrypted forms are locked secrets */
+	utils::memory::Accounted accounted(utils::memory::Category::Serialization, entries.size());
+
+	stages.begin("Parsing entries");
 	auto parsed_entries = json::parse(entries);
 	auto root = deserialize_directory(parsed_entries, nullptr);
-	this->save_entries(root);
+
+	stages.begin("Saving entries");
+	stages.commit();
+	root->is_open = true;
+	/* an import replaces the tree, in order with every other write */
+	commit(
+	    [&root](EntryChanges &changes) {
+		    changes = EntryChanges::unknown();
+		    return std::move(root);
+	    },
+	    ++save_tickets);
+	stages.finish();
 }
 
-void Keychain::export_to_uri(const UriLocator &uri) const {
-	std::string db_entries;
-	if (auto s = db->Get(leveldb::ReadOptions(), DB_KEY_ENTRIES, &db_entries); !s.ok()) {
-		throw std::runtime_error("could not get entries from db");
-	}
+void Keychain::export_to_uri(const UriLocator &uri, const utils::OperationOptions &options) {
+	TRACE_SPAN("keychain", "Keychain::export_to_uri");
+	METRICS_LATENCY("Keychain::export_to_uri");
+	utils::StageReporter stages(options, 3);
 
+	stages.begin("Serializing entries");
+	const std::string db_entries = serialize_directory(snapshot()->root).dump();
+
+	stages.begin("Encrypting entries");
 	crypto::B64EncodedText encoded_entries = crypto::base64_encode(db_entries);
 
 	crypto::EncryptionKey key(derive_child(standard_export_dpath));
@@ -153,6 +253,11 @@ void Keychain::export_to_uri(const UriLocator &uri) const {
 	crypto::Ciphertext encrypted_entries = crypto::encrypt(key, encoded_entries);
 	std::string encoded_encrypted_entries =
 	    crypto::as_string(crypto::base64_encode(encrypted_entries));
+	utils::memory::Accounted accounted(utils::memory::Category::Serialization,
+	    db_entries.size() + encoded_encrypted_entries.size());
+
+	stages.begin("Writing export");
+	stages.commit();
 	if (auto path = std::get_if<std::filesystem::path>(&uri)) {
 		std::ofstream export_file;
 		export_file.open(*path, std::ios::out);
@@ -161,21 +266,103 @@ void Keychain::export_to_uri(const UriLocator &uri) const {
 	} else {
 		assert(!"unexpected uri type");
 	}
+	stages.finish();
+}
+
+std::future<std::unique_ptr<Keychain>> Keychain::initialize_with_seed_async(
+    std::filesystem::path path, crypto::Seed seed, crypto::PasswordHash pw_hash,
+    utils::OperationOptions options) {
+	auto on_done = options.on_done;
+	return utils::run_async(
+	    [path = std::move(path), seed = std::move(seed), pw_hash = std::move(pw_hash),
+	        options = std::move(options)]() mutable {
+		    return initialize_with_seed(
+		        std::move(path), std::move(seed), std::move(pw_hash), options);
+	    },
+	    std::move(on_done));
+}
+
+std::future<std::unique_ptr<Keychain>> Keychain::open_async(
+    std::filesystem::path path, crypto::PasswordHash pw_hash, utils::OperationOptions options) {
+	auto on_done = options.on_done;
+	return utils::run_async(
+	    [path = std::move(path), pw_hash = std::move(pw_hash),
+	        options = std::move(options)]() mutable {
+		    return open(std::move(path), std::move(pw_hash), options);
+	    },
+	    std::move(on_done));
+}
+
+std::future<void> Keychain::import_from_uri_async(UriLocator uri, utils::OperationOptions options) {
+	auto on_done = options.on_done;
+	return utils::run_async(
+	    [this, uri = std::move(uri), options = std::move(options)]() {
+		    import_from_uri(uri, options);
+	    },
+	    std::move(on_done));
+}
+
+std::future<void> Keychain::export_to_uri_async(UriLocator uri, utils::OperationOptions options) {
+	auto on_done = options.on_done;
+	return utils::run_async(
+	    [this, uri = std::move(uri), options = std::move(options)]() {
+		    export_to_uri(uri, options);
+	    },
+	    std::move(on_done));
 }
 
-Directory::ptr Keychain::get_root_dir() const {
+std::shared_ptr<const KeychainSnapshot> Keychain::snapshot() {
+	if (auto rv = std::atomic_load_explicit(&current, std::memory_order_acquire)) return rv;
+
+	std::unique_lock<std::mutex> lk(write_mutex);
+	return locked_snapshot();
+}
+
+std::shared_ptr<const KeychainSnapshot> Keychain::locked_snapshot() {
+	if (auto rv = std::atomic_load_explicit(&current, std::memory_order_acquire)) return rv;
+
 	std::string db_entries;
 	if (auto s = db->Get(leveldb::ReadOptions(), DB_KEY_ENTRIES, &db_entries); !s.ok()) {
 		throw std::runtime_error("could not get entries from db");
 	}
+	utils::memory::Accounted accounted(utils::memory::Category::Serialization, db_entries.size());
 
 	auto root = deserialize_directory(json::parse(db_entries), nullptr);
 	root->is_open = true;
+	/* the ids are kept from the next save on, an index stored before then doesn't use them */
+	const bool new_ids = assign_entry_ids(root);
+
+	/* keychains without tags have no index stored and nothing to look up */
+	std::shared_ptr<const TagIndex> tags;
+	if (!new_ids && db_entries.find("\"tags\"") != std::string::npos) {
+		tags = load_tag_index(*db, db_entries);
+	}
+	if (!tags) tags = std::make_shared<const TagIndex>(TagIndex::build(root));
+
+	auto rv = std::make_shared<const KeychainSnapshot>(
+	    KeychainSnapshot{1, std::move(root), std::move(tags)});
+	std::atomic_store_explicit(&current, rv, std::memory_order_release);
+	return rv;
+}
+
+AccessLog &Keychain::access_log() {
+	std::unique_lock<std::mutex> lk(access_log_mutex);
+	if (!m_access_log) m_access_log = std::make_unique<AccessLog>(db.get());
+	return *m_access_log;
+}
+
+Directory::ptr Keychain::get_root_dir() {
+	TRACE_SPAN("keychain", "Keychain::get_root_dir");
+	METRICS_LATENCY("Keychain::get_root_dir");
+	auto root = deep_copy_directory(snapshot()->root, nullptr);
+	root->is_open = true;
 	return root;
 }
 
-// TODO: make it thread-safe if needed
 crypto::DerivationPath Keychain::get_next_derivation_path() {
+	METRICS_LATENCY("Keychain::get_next_derivation_path");
+	std::unique_lock<std::mutex> lk(dpath_mutex);
+
 	std::string c_dpath_str{};
 	if (auto s = db->Get(leveldb::ReadOptions(), DB_KEY_DPATH, &c_dpath_str); !s.ok()) {
 		throw std::runtime_error("could not load seed from db");
@@ -192,11 +379,124 @@ crypto::DerivationPath Keychain::get_next_derivation_path() {
 	return {current_seed};
 }
 
-void Keychain::save_entries(Directory::ptr root) {
-	json new_entries = serialize_directory(root);
-	if (auto s = db->Put(leveldb::WriteOptions(), DB_KEY_ENTRIES, new_entries.dump()); !s.ok()) {
+uint64_t Keychain::persist_and_publish(Directory::ptr root, const EntryChanges &changes) {
+	auto previous = std::atomic_load_explicit(&current, std::memory_order_acquire);
+	const bool rebuild = changes.is_unknown() || !previous;
+	if (rebuild) assign_entry_ids(root);
+
+	const std::string new_entries = serialize_directory(root).dump();
+	utils::memory::Accounted accounted(utils::memory::Category::Serialization, new_entries.size());
+	if (auto s = db->Put(leveldb::WriteOptions(), DB_KEY_ENTRIES, new_entries); !s.ok()) {
 		throw std::runtime_error("could not save entries");
 	}
+
+	/* the copy shares all bitmaps but those of changed tags with the published index */
+	std::shared_ptr<TagIndex> tags;
+	if (rebuild) {
+		tags = std::make_shared<TagIndex>(TagIndex::build(root));
+	} else {
+		tags = std::make_shared<TagIndex>(*previous->tags);
+		tags->apply(changes);
+	}
+
+	/* a failure here only costs a rebuild on the next load, as does a stale index */
+	if (!tags->tags().empty()) {
+		const std::string db_tags =
+		    checksum_prefix(entries_checksum(new_entries)) + tags->serialize();
+		db->Put(leveldb::WriteOptions(), DB_KEY_TAGS, db_tags);
+	}
+
+	const uint64_t version = previous ? previous->version + 1 : 1;
+	auto next = std::make_shared<const KeychainSnapshot>(
+	    KeychainSnapshot{version, std::move(root), std::move(tags)});
+	std::atomic_store_explicit(&current, std::move(next), std::memory_order_release);
+	return version;
+}
+
+uint64_t Keychain::commit(
+    const std::function<Directory::ptr(EntryChanges &changes)> &next, uint64_t ticket) {
+	std::unique_lock<std::mutex> lk(write_mutex);
+	if (!ticket) ticket = ++save_tickets;
+	if (ticket <= last_saved_ticket) return locked_snapshot()->version;
+
+	EntryChanges changes;
+	auto root = next(changes);
+	const uint64_t version = persist_and_publish(std::move(root), changes);
+	last_saved_ticket = ticket;
+	return version;
+}
+
+uint64_t Keychain::save_entries(
+    Directory::ptr root, uint64_t base_version, const EntryChanges &changes) {
+	TRACE_SPAN("keychain", "Keychain::save_entries");
+	METRICS_LATENCY("Keychain::save_entries");
+	/* the caller keeps modifying its tree, the snapshot gets a copy of its own */
+	auto published = deep_copy_directory(root, nullptr);
+	published->is_open = true;
+
+	return commit([this, &published, base_version, &changes](EntryChanges &published_changes) {
+		if (locked_snapshot()->version != base_version) {
+			throw StaleTreeError("entries were changed since this copy was taken");
+		}
+		published_changes = changes;
+		return std::move(published);
+	});
+}
+
+void Keychain::save_entries(Directory::ptr root) {
+	TRACE_SPAN("keychain", "Keychain::save_entries");
+	METRICS_LATENCY("Keychain::save_entries");
+	auto published = deep_copy_directory(root, nullptr);
+	published->is_open = true;
+
+	commit(
+	    [&published](EntryChanges &changes) {
+		    changes = EntryChanges::unknown();
+		    return std::move(published);
+	    },
+	    ++save_tickets);
+}
+
+std::future<void> Keychain::save_entries_async(
+    Directory::ptr root, utils::OperationOptions options) {
+	auto published = deep_copy_directory(root, nullptr);
+	published->is_open = true;
+	const uint64_t ticket = ++save_tickets;
+
+	auto on_done = options.on_done;
+	return utils::run_async(
+	    [this, published = std::move(published), ticket, options = std::move(options)]() mutable {
+		    TRACE_SPAN("keychain", "Keychain::save_entries");
+		    METRICS_LATENCY("Keychain::save_entries");
+		    utils::StageReporter stages(options, 1);
+		    stages.begin("Saving entries");
+		    commit(
+		        [&published](EntryChanges &changes) {
+			        changes = EntryChanges::unknown();
+			        return std::move(published);
+		        },
+		        ticket);
+		    stages.finish();
+	    },
+	    std::move(on_done));
+}
+
+void Keychain::update(
+    const std::function<void(Directory::ptr root, EntryChanges &changes)> &mutate) {
+	METRICS_LATENCY("Keychain::update");
+	commit([this, &mutate](EntryChanges &changes) {
+		auto root = deep_copy_directory(locked_snapshot()->root, nullptr);
+		root->is_open = true;
+		mutate(root, changes);
+		return root;
+	});
+}
+
+void Keychain::update(const std::function<void(Directory::ptr root)> &mutate) {
+	update([&mutate](Directory::ptr root, EntryChanges &changes) {
+		mutate(root);
+		changes = EntryChanges::unknown();
+	});
 }
 
 constexpr static char allowed_chars[] =
@@ -218,7 +518,7 @@ utils::sensitive_string Keychain::encode_secret(
 	return secret;
 }
 
-crypto::Seed Keychain::derive_child(const crypto::DerivationPath &dpath) const {
+crypto::Seed Keychain::load_seed() const {
 	std::string seed_str{};
 	seed_str.reserve(crypto::Seed::Size * 2 + 1); // reserve to avoid leaving seed in memory
 	if (auto s = db->Get(leveldb::ReadOptions(), DB_KEY_SEED, &seed_str); !s.ok()) {
@@ -228,10 +528,13 @@ crypto::Seed Keychain::derive_child(const crypto::DerivationPath &dpath) const {
 	crypto::EncryptedSeed encrypted_seed = crypto::deserialize<crypto::EncryptedSeed>(seed_str);
 	utils::secure_zero_string(std::move(seed_str));
 
-	crypto::Seed derived_seed =
-	    crypto::derive_child(this->tec.getPasswordHash(), encrypted_seed, dpath);
+	return crypto::decrypt_seed(encrypted_seed, this->tec.getPasswordHash());
+}
 
-	return derived_seed;
+crypto::Seed Keychain::derive_child(const crypto::DerivationPath &dpath) const {
+	TRACE_SPAN("keychain", "Keychain::derive_child");
+	METRICS_LATENCY("Keychain::derive_child");
+	return crypto::derive_child(load_seed(), dpath);
 }
 
 utils::sensitive_string Keychain::derive_secret(const crypto::DerivationPath &dpath) {
@@ -239,4 +542,101 @@ utils::sensitive_string Keychain::derive_secret(const crypto::DerivationPath &dp
 	return Keychain::encode_secret(derived_seed.data(), derived_seed.size(), 10);
 }
 
+std::vector<utils::sensitive_string> Keychain::derive_secrets(
+    const std::vector<crypto::DerivationPath> &dpaths) const {
+	TRACE_SPAN("keychain", "Keychain::derive_secrets");
+	METRICS_LATENCY("Keychain::derive_secrets");
+	const crypto::Seed seed = load_seed();
+
+	std::vector<utils::sensitive_string> rv;
+	rv.reserve(dpaths.size());
+	for (const auto &dpath : dpaths) {
+		crypto::Seed derived_seed = crypto::derive_child(seed, dpath);
+		rv.push_back(Keychain::encode_secret(derived_seed.data(), derived_seed.size(), 10));
+	}
+	return rv;
+}
+
+std::optional<bool> Keychain::check_password() const {
+	METRICS_LATENCY("Keychain::check_password");
+	std::string expected;
+	if (auto s = db->Get(leveldb::ReadOptions(), DB_KEY_SEED_CHECK, &expected); s.IsNotFound()) {
+		return std::nullopt;
+	} else if (!s.ok()) {
+		throw std::runtime_error("could not load seed check from db");
+	}
+
+	if (auto matches = crypto::verify_password_check(tec.getPasswordHash(), expected)) {
+		return *matches;
+	}
+
+	/* a bare seed fingerprint, checked once more and replaced so guesses can't be tested cheaply */
+	if (crypto::fingerprint_seed(load_seed()) != expected) {
+		return false;
+	}
+	if (auto s = db->Put(leveldb::WriteOptions(), DB_KEY_SEED_CHECK,
+	        crypto::make_password_check(tec.getPasswordHash()));
+	    !s.ok()) {
+		throw std::runtime_error("could not save seed check in the database");
+	}
+	return true;
+}
+
+std::optional<crypto::PasswordCheckTag> Keychain::password_check_tag() const {
+	std::string check;
+	if (auto s = db->Get(leveldb::ReadOptions(), DB_KEY_SEED_CHECK, &check); s.IsNotFound()) {
+		return std::nullopt;
+	} else if (!s.ok()) {
+		throw std::runtime_error("could not load seed check from db");
+	}
+	return crypto::tag_password_check(tec.getPasswordHash(), check);
+}
+
+std::function<bool(const crypto::Seed &)> Keychain::seed_matcher() const {
+	std::string seed_str{};
+	seed_str.reserve(crypto::Seed::Size * 2 + 1); // reserve to avoid leaving seed in memory
+	if (auto s = db->Get(leveldb::ReadOptions(), DB_KEY_SEED, &seed_str); !s.ok()) {
+		throw std::runtime_error("could not load seed from db");
+	}
+
+	crypto::EncryptedSeed stored_seed = crypto::deserialize<crypto::EncryptedSeed>(seed_str);
+	utils::secure_zero_string(std::move(seed_str));
+
+	return [this, stored_seed](const crypto::Seed &seed) {
+		METRICS_LATENCY("Keychain::matches_seed");
+		crypto::EncryptedSeed encrypted_candidate;
+		this->tec.encrypt(encrypted_candidate.data(), seed.data(), crypto::Seed::Size);
+		return encrypted_candidate == stored_seed;
+	};
+}
+
+std::function<bool(const crypto::Seed &)> Keychain::export_seed_matcher(const UriLocator &uri) {
+	std::string encoded_encrypted_entries;
+	if (auto import_path = std::get_if<std::filesystem::path>(&uri)) {
+		std::ifstream import_file(*import_path, std::ios::in);
+		import_file >> encoded_encrypted_entries;
+	} else {
+		assert(!"unexpected uri type");
+	}
+
+	crypto::Ciphertext encrypted_entries = crypto::base64_decode_ciphertext(
+	    utils::sensitive_string_view(
+	        encoded_encrypted_entries.data(), encoded_encrypted_entries.size()));
+
+	/* serialized directories always start with the same key, see serialize_directory */
+	crypto::B64EncodedText expected_prefix = crypto::base64_encode(std::string(R"({"details":")"));
+	if (encrypted_entries.size() < expected_prefix.size()) {
+		throw std::runtime_error("export is too short to be matched against");
+	}
+
+	/* CFB decrypts a prefix independently of the rest of the stream */
+	auto encrypted_prefix = std::make_shared<crypto::Ciphertext>(
+	    utils::sensitive_string_view(encrypted_entries).substr(0, expected_prefix.size()));
+
+	return [encrypted_prefix, expected_prefix](const crypto::Seed &seed) {
+		crypto::EncryptionKey key(crypto::derive_child(seed, standard_export_dpath));
+		return crypto::decrypt(key, *encrypted_prefix) == expected_prefix;
+	};
+}
+
 } // namespace keychain
@@ -19,27 +19,80 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
 #pragma once
 
+#include <src/keychain/access_log.h>
 #include <src/keychain/db.h>
 #include <src/keychain/keychain_entry.h>
+#include <src/keychain/tag_index.h>
 #include <src/keychain/utils.h>
 
 #include <src/crypto/structs.h>
 #include <src/crypto/timed_encryption_key.h>
 
+#include <src/utils/async.h>
+
+#include <atomic>
+#include <cstdint>
 #include <filesystem>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
 
 namespace keychain {
 
+class StaleTreeError : public std::runtime_error {
+	using std::runtime_error::runtime_error;
+};
+
+/* A published version of the entries tree. Nothing in it is modified after publication, so
+ * readers can hold on to it for as long as they like without locking. */
+struct KeychainSnapshot {
+	uint64_t version;
+	Directory::ptr root;
+	std::shared_ptr<const TagIndex> tags;
+};
+
+/* Thread-safe. Readers take the current snapshot with an atomic load and never block; writers are
+ * serialized, persist the new tree and then publish it as the next snapshot. */
 class Keychain {
 	// TODO: should be predefined and reserved m/0/0
 	static constexpr crypto::DerivationPath standard_export_dpath{255};
 
+	std::shared_ptr<const KeychainSnapshot> current; // atomic_load / atomic_store only
+	std::mutex write_mutex;
+	std::mutex dpath_mutex;
+
+	/* saves are numbered when requested, so that a late asynchronous one can't undo a newer one */
+	std::atomic<uint64_t> save_tickets{0};
+	uint64_t last_saved_ticket = 0; // under write_mutex
+
+	crypto::Seed load_seed() const;
+
+	/* with write_mutex held */
+	std::shared_ptr<const KeychainSnapshot> locked_snapshot();
+	/* the tag index follows changes, or is built again if they are unknown */
+	uint64_t persist_and_publish(Directory::ptr root, const EntryChanges &changes);
+
+	/* The path every write takes: next runs with write_mutex held, so it may look at
+	 * locked_snapshot(), and returns the tree to publish along with what it changed since the
+	 * current one. A write with a ticket taken earlier is skipped if a newer one went in first,
+	 * any other takes the newest ticket, so that no save requested before it can undo it.
+	 * Returns the current version. */
+	uint64_t commit(
+	    const std::function<Directory::ptr(EntryChanges &changes)> &next, uint64_t ticket = 0);
+
   protected:
 	std::filesystem::path data_path;
 
 	std::unique_ptr<DB> db;
 	crypto::TimedEncryptionKey tec;
 
+	/* after db, it writes to it until it is destroyed */
+	std::mutex access_log_mutex;
+	std::unique_ptr<AccessLog> m_access_log;
+
   public:
 	Keychain() = default;
 	~Keychain() = default;
@@ -50,24 +103,83 @@ class Keychain {
 	Keychain(Keychain &&other);
 	Keychain &operator=(Keychain &&other);
 
-	static std::unique_ptr<Keychain> initialize_with_seed(
-	    std::filesystem::path path, crypto::Seed seed, crypto::PasswordHash pw_hash);
-	static std::unique_ptr<Keychain> open(std::filesystem::path path, crypto::PasswordHash pw_hash);
+	/* Long operations take options to report their stages and to be cancelled between them. A
+	 * cancelled operation throws utils::OperationCancelled and leaves no partial result behind. */
+	static std::unique_ptr<Keychain> initialize_with_seed(std::filesystem::path path,
+	    crypto::Seed seed, crypto::PasswordHash pw_hash,
+	    const utils::OperationOptions &options = {});
+	/* only opens the db, the tree is loaded on first use */
+	static std::unique_ptr<Keychain> open(std::filesystem::path path, crypto::PasswordHash pw_hash,
+	    const utils::OperationOptions &options = {});
+
+	void import_from_uri(const UriLocator &uri, const utils::OperationOptions &options = {});
+	void export_to_uri(const UriLocator &uri, const utils::OperationOptions &options = {});
 
-	void import_from_uri(const UriLocator &uri);
-	void export_to_uri(const UriLocator &uri) const;
+	/* Same operations run on utils::default_pool(). The keychain has to outlive the futures. */
+	static std::future<std::unique_ptr<Keychain>> initialize_with_seed_async(
+	    std::filesystem::path path, crypto::Seed seed, crypto::PasswordHash pw_hash,
+	    utils::OperationOptions options = {});
+	static std::future<std::unique_ptr<Keychain>> open_async(std::filesystem::path path,
+	    crypto::PasswordHash pw_hash, utils::OperationOptions options = {});
+
+	std::future<void> import_from_uri_async(UriLocator uri, utils::OperationOptions options = {});
+	std::future<void> export_to_uri_async(UriLocator uri, utils::OperationOptions options = {});
 
 	std::string get_data_dir_path() const { return data_path.string(); }
-	Directory::ptr get_root_dir() const;
+
+	/* the current tree, loaded from the db on first use; must not be modified */
+	std::shared_ptr<const KeychainSnapshot> snapshot();
+
+	/* views and derivations of entries, read from the db on first use without loading the tree */
+	AccessLog &access_log();
+
+	/* a private, modifiable copy of the current tree, to be handed back to save_entries */
+	Directory::ptr get_root_dir();
 
 	crypto::DerivationPath get_next_derivation_path();
 
+	/* Persists root, a copy of the tree of base_version, and publishes a copy of it. Throws
+	 * StaleTreeError when another version was published since, rather than losing its changes.
+	 * Returns the new version, for the next save of the same copy. Changes are what was done to
+	 * the copy since, the tag index is built again from root without them. */
+	uint64_t save_entries(Directory::ptr root, uint64_t base_version,
+	    const EntryChanges &changes = EntryChanges::unknown());
+
+	/* Replaces the whole tree with root, whatever was published in the meantime included. For
+	 * trees that are not edited copies, e.g. generated ones. */
 	void save_entries(Directory::ptr root);
 
+	/* the copy is taken right away, so root can be modified as soon as this returns */
+	std::future<void> save_entries_async(Directory::ptr root, utils::OperationOptions options = {});
+
+	/* The one writer path: mutate runs on a copy of the current tree, with other writers waiting,
+	 * and records what it did to entries in changes. Without them the tag index is built again
+	 * from the whole tree. */
+	void update(const std::function<void(Directory::ptr root, EntryChanges &changes)> &mutate);
+	void update(const std::function<void(Directory::ptr root)> &mutate);
+
 	static utils::sensitive_string encode_secret(
 	    unsigned char *in_data, size_t in_size, size_t out_size);
 	crypto::Seed derive_child(const crypto::DerivationPath &dpath) const;
 	utils::sensitive_string derive_secret(const crypto::DerivationPath &dpath);
+
+	/* reads and decrypts the master seed once for the whole batch */
+	std::vector<utils::sensitive_string> derive_secrets(
+	    const std::vector<crypto::DerivationPath> &dpaths) const;
+
+	/* whether the encryption phrase is the right one, nullopt for keychains created before
+	 * password checks were stored, where there is no way to tell. Slow on purpose, see
+	 * crypto::make_password_check. */
+	std::optional<bool> check_password() const;
+
+	/* crypto::tag_password_check of the stored check with this keychain's phrase hash, nullopt
+	 * where there is no salted check to tag */
+	std::optional<crypto::PasswordCheckTag> password_check_tag() const;
+
+	/* fingerprints used to recognize the right seed when recovering a mnemonic, the stored seed
+	 * is read once and the matcher must not outlive the keychain */
+	std::function<bool(const crypto::Seed &)> seed_matcher() const;
+	static std::function<bool(const crypto::Seed &)> export_seed_matcher(const UriLocator &uri);
 };
 
 } // namespace keychain
@@ -22,8 +22,24 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include <external/nlohmann/json_single_include.h>
 using json = nlohmann::json;
 
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <unordered_set>
+
 namespace keychain {
 
+namespace {
+
+uint32_t max_entry_id(const Directory &dir) {
+	uint32_t rv = 0;
+	for (const auto &entry : dir.entries) rv = std::max(rv, entry->meta.id);
+	for (const auto &child_dir : dir.dirs) rv = std::max(rv, max_entry_id(*child_dir));
+	return rv;
+}
+
+} // namespace
+
 Entry::ptr deserialize_entry(const json &data, std::weak_ptr<Directory> parent) {
 	EntryMeta meta{
 	    data["name"].get<std::string>(),
@@ -33,6 +49,11 @@ Entry::ptr deserialize_entry(const json &data, std::weak_ptr<Directory> parent)
 	    },
 	};
 
+	if (auto tags = data.find("tags"); tags != data.end()) {
+		meta.tags = tags->get<std::vector<std::string>>();
+	}
+	if (auto id = data.find("id"); id != data.end()) meta.id = id->get<uint32_t>();
+
 	return std::make_shared<Entry>(meta, parent);
 }
 
@@ -52,12 +73,17 @@ Directory::ptr deserialize_directory(const json &data, Directory::ptr parent_ptr
 		dir->dirs.push_back(deserialize_directory(child_dir, dir));
 	}
 
+	/* ids of removed entries may be handed out again, nothing refers to them any more */
+	if (!parent_ptr) dir->next_entry_id = max_entry_id(*dir) + 1;
 	return dir;
 }
 
 json serialize_entry(Entry::ptr entry) {
-	return {{"name", entry->meta.name}, {"details", entry->meta.details},
+	json rv = {{"name", entry->meta.name}, {"details", entry->meta.details},
 	    {"derivation_path", entry->meta.dpath.seed}};
+	if (!entry->meta.tags.empty()) rv["tags"] = entry->meta.tags;
+	if (entry->meta.id) rv["id"] = entry->meta.id;
+	return rv;
 }
 
 json serialize_directory(Directory::ptr dir) {
@@ -82,6 +108,48 @@ Directory::ptr deep_copy_directory(Directory::ptr dir, Directory::ptr parent_dir
 
 namespace {
 
+std::string_view trim_slashes(std::string_view path) {
+	while (!path.empty() && path.front() == '/') path.remove_prefix(1);
+	while (!path.empty() && path.back() == '/') path.remove_suffix(1);
+	return path;
+}
+
+/* existing parent directory and the new name of the last path component */
+std::pair<Directory::ptr, std::string> resolve_parent(Directory::ptr root, std::string_view path) {
+	path = trim_slashes(path);
+	const size_t separator = path.rfind('/');
+	const std::string_view parent_path =
+	    separator == std::string_view::npos ? std::string_view{} : path.substr(0, separator);
+	const std::string_view name = path.substr(separator + 1);
+	if (name.empty()) throw std::runtime_error("empty name");
+
+	auto parent = find_by_path(root, parent_path);
+	auto dir = parent ? std::get_if<Directory::ptr>(&*parent) : nullptr;
+	if (!dir) throw std::runtime_error("no such directory: " + std::string(parent_path));
+
+	return {*dir, std::string(name)};
+}
+
+bool name_taken(const Directory::ptr &dir, const std::string &name) {
+	auto same_name = [&name](const auto &child) { return child->meta.name == name; };
+	return std::any_of(dir->dirs.begin(), dir->dirs.end(), same_name) ||
+	       std::any_of(dir->entries.begin(), dir->entries.end(), same_name);
+}
+
+void ensure_free(const Directory::ptr &dir, const std::string &name) {
+	if (name_taken(dir, name)) throw std::runtime_error("name already taken: " + name);
+}
+
+AnyKeychainPtr find_existing(Directory::ptr root, std::string_view path) {
+	auto node = find_by_path(root, path);
+	if (!node) throw std::runtime_error("no such path: " + std::string(path));
+	return *node;
+}
+
+template <typename T> void detach(std::vector<T> &children, const T &child) {
+	children.erase(std::remove(children.begin(), children.end(), child), children.end());
+}
+
 void process_flatten_dir(std::list<AnyKeychainPtr> *to_visit, Directory::ptr dir) {
 	if (!dir->is_open) {
 		return;
@@ -96,6 +164,12 @@ void process_flatten_dir(std::list<AnyKeychainPtr> *to_visit, Directory::ptr dir
 
 } // namespace
 
+size_t node_bytes(size_t node_size, const std::string &name, const std::string &details) {
+	constexpr size_t CONTROL_BLOCK = sizeof(void *) + 2 * sizeof(int); // vptr and use counts
+	return node_size + CONTROL_BLOCK + sizeof(std::shared_ptr<void>) +
+	       utils::memory::heap_bytes(name) + utils::memory::heap_bytes(details);
+}
+
 std::vector<AnyKeychainPtr> flatten_dirs(Directory::ptr root) {
 	std::vector<AnyKeychainPtr> rv;
 	std::list<AnyKeychainPtr> to_visit{root};
@@ -114,4 +188,152 @@ std::vector<AnyKeychainPtr> flatten_dirs(Directory::ptr root) {
 	return rv;
 }
 
+uint32_t new_entry_id(Directory &root) {
+	if (root.next_entry_id == 0) throw std::runtime_error("out of entry ids");
+	return root.next_entry_id++;
+}
+
+bool assign_entry_ids(const Directory::ptr &root) {
+	std::unordered_set<uint32_t> seen;
+	std::vector<Entry::ptr> missing;
+
+	std::vector<Directory::ptr> to_visit{root};
+	while (!to_visit.empty()) {
+		auto dir = std::move(to_visit.back());
+		to_visit.pop_back();
+
+		for (const auto &entry : dir->entries) {
+			if (!entry->meta.id || !seen.insert(entry->meta.id).second) missing.push_back(entry);
+		}
+		to_visit.insert(to_visit.end(), dir->dirs.begin(), dir->dirs.end());
+	}
+
+	/* a counter behind the ids in use would hand out one of them again */
+	for (uint32_t id : seen) root->next_entry_id = std::max(root->next_entry_id, id + 1);
+	for (const auto &entry : missing) entry->meta.id = new_entry_id(*root);
+	return !missing.empty();
+}
+
+void renumber_entries(const Directory::ptr &dir, Directory &root) {
+	for (const auto &entry : dir->entries) entry->meta.id = new_entry_id(root);
+	for (const auto &child_dir : dir->dirs) renumber_entries(child_dir, root);
+}
+
+std::string path_of(const Entry::ptr &entry) {
+	std::string rv = entry->meta.name;
+	for (auto dir = entry->parent_dir.lock(); dir && dir->parent_dir.lock();
+	     dir = dir->parent_dir.lock()) {
+		rv = dir->meta.name + "/" + rv;
+	}
+	return rv;
+}
+
+std::optional<AnyKeychainPtr> find_by_path(Directory::ptr root, std::string_view path) {
+	Directory::ptr dir = root;
+	while (!path.empty() && path.front() == '/') path.remove_prefix(1);
+
+	while (!path.empty()) {
+		const size_t separator = path.find('/');
+		const std::string_view name = path.substr(0, separator);
+		path =
+		    separator == std::string_view::npos ? std::string_view{} : path.substr(separator + 1);
+
+		auto child_dir = std::find_if(dir->dirs.begin(), dir->dirs.end(),
+		    [name](const Directory::ptr &child) { return child->meta.name == name; });
+		if (child_dir != dir->dirs.end()) {
+			dir = *child_dir;
+			continue;
+		}
+
+		if (!path.empty()) return std::nullopt;
+
+		auto entry = std::find_if(dir->entries.begin(), dir->entries.end(),
+		    [name](const Entry::ptr &child) { return child->meta.name == name; });
+		if (entry == dir->entries.end()) return std::nullopt;
+		return *entry;
+	}
+
+	return dir;
+}
+
+
+Entry::ptr add_entry(Directory::ptr root, std::string_view path, std::string details,
+    crypto::DerivationPath dpath) {
+	auto [parent, name] = resolve_parent(root, path);
+	ensure_free(parent, name);
+
+	EntryMeta meta{name, std::move(details), dpath};
+	meta.id = new_entry_id(*root);
+	auto entry = std::make_shared<Entry>(meta, parent);
+	parent->entries.push_back(entry);
+	return entry;
+}
+
+Directory::ptr add_directory(Directory::ptr root, std::string_view path, std::string details) {
+	auto [parent, name] = resolve_parent(root, path);
+	ensure_free(parent, name);
+
+	auto dir = std::make_shared<Directory>(DirectoryMeta{name, std::move(details)}, parent);
+	parent->dirs.push_back(dir);
+	return dir;
+}
+
+void move_by_path(Directory::ptr root, std::string_view from, std::string_view to) {
+	if (trim_slashes(from).empty()) throw std::runtime_error("cannot move the root directory");
+	const AnyKeychainPtr node = find_existing(root, from);
+
+	Directory::ptr target;
+	std::string name;
+	auto existing = find_by_path(root, to);
+	if (auto dir = existing ? std::get_if<Directory::ptr>(&*existing) : nullptr) {
+		target = *dir;
+		name = std::visit([](const auto &ptr) { return ptr->meta.name; }, node);
+	} else {
+		std::tie(target, name) = resolve_parent(root, to);
+	}
+
+	if (auto entry = std::get_if<Entry::ptr>(&node)) {
+		auto parent = (*entry)->parent_dir.lock();
+		if (parent == target && (*entry)->meta.name == name) return;
+		ensure_free(target, name);
+
+		detach(parent->entries, *entry);
+		(*entry)->meta.name = name;
+		(*entry)->parent_dir = target;
+		target->entries.push_back(*entry);
+		return;
+	}
+
+	auto dir = std::get<Directory::ptr>(node);
+	auto parent = dir->parent_dir.lock();
+	if (parent == target && dir->meta.name == name) return;
+	for (auto d = target; d; d = d->parent_dir.lock()) {
+		if (d == dir) throw std::runtime_error("cannot move a directory into itself");
+	}
+	ensure_free(target, name);
+
+	/* copied, so that levels of the whole subtree follow the new parent */
+	auto moved = deep_copy_directory(dir, target);
+	moved->meta.name = name;
+	detach(parent->dirs, dir);
+	target->dirs.push_back(moved);
+}
+
+AnyKeychainPtr remove_by_path(Directory::ptr root, std::string_view path, bool recursive) {
+	if (trim_slashes(path).empty()) throw std::runtime_error("cannot remove the root directory");
+	const AnyKeychainPtr node = find_existing(root, path);
+
+	if (auto entry = std::get_if<Entry::ptr>(&node)) {
+		detach((*entry)->parent_dir.lock()->entries, *entry);
+		return node;
+	}
+
+	auto dir = std::get<Directory::ptr>(node);
+	if (!recursive && !(dir->dirs.empty() && dir->entries.empty())) {
+		throw std::runtime_error("directory not empty: " + std::string(path));
+	}
+	detach(dir->parent_dir.lock()->dirs, dir);
+	return node;
+}
+
 } // namespace keychain
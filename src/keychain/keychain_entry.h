@@ -20,11 +20,14 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #pragma once
 
 #include <src/crypto/crypto.h>
+#include <src/utils/memory.h>
 
 #include <external/nlohmann/json_fwd.hpp>
 
 #include <list>
 #include <memory>
+#include <optional>
+#include <string_view>
 #include <variant>
 #include <vector>
 
@@ -38,6 +41,8 @@ struct EntryMeta {
 	std::string name;
 	std::string details;
 	crypto::DerivationPath dpath;
+	std::vector<std::string> tags = {}; // sorted and unique, see parse_tags
+	uint32_t id = 0; // unique within the tree, unlike dpath which pasted copies share; 0 if unset
 };
 
 struct DirectoryMeta {
@@ -49,14 +54,21 @@ struct DirectoryMeta {
 
 struct Directory;
 
+/* What a node is accounted for: itself, its shared_ptr control block and slot in the parent and
+ * its strings as they were when it was created */
+size_t node_bytes(size_t node_size, const std::string &name, const std::string &details);
+
 struct Entry {
 	using ptr = std::shared_ptr<Entry>;
 
 	EntryMeta meta;
 	std::weak_ptr<Directory> parent_dir;
+	utils::memory::Accounted accounted;
 
 	Entry(const EntryMeta &meta, std::weak_ptr<Directory> parent_dir) :
-	    meta(meta), parent_dir(parent_dir) {}
+	    meta(meta), parent_dir(parent_dir),
+	    accounted(utils::memory::Category::TreeNodes,
+	        node_bytes(sizeof(Entry), this->meta.name, this->meta.details)) {}
 };
 
 struct Directory {
@@ -71,8 +83,14 @@ struct Directory {
 	int dir_level;
 	bool is_open = false;
 
+	uint32_t next_entry_id = 1; // only kept on the root, past the ids in the tree when loaded
+
+	utils::memory::Accounted accounted;
+
 	Directory(const DirectoryMeta &meta, Directory::ptr parent_dir) :
-	    meta(meta), parent_dir(parent_dir) {
+	    meta(meta), parent_dir(parent_dir),
+	    accounted(utils::memory::Category::TreeNodes,
+	        node_bytes(sizeof(Directory), this->meta.name, this->meta.details)) {
 		dir_level = parent_dir ? parent_dir->dir_level + 1 : 0;
 	}
 };
@@ -88,4 +106,31 @@ nlohmann::json serialize_directory(Directory::ptr dir);
 Directory::ptr deep_copy_directory(Directory::ptr dir, Directory::ptr parent_dir);
 std::vector<AnyKeychainPtr> flatten_dirs(Directory::ptr root);
 
+/* Entry ids are handed out by the root, see EntryMeta::id */
+uint32_t new_entry_id(Directory &root);
+/* Gives an id to entries that miss one or share it with an entry before them, returns whether
+ * any was given. Trees saved before entries had ids get them this way. */
+bool assign_entry_ids(const Directory::ptr &root);
+/* new ids for every entry below dir, for copies pasted into the tree of root */
+void renumber_entries(const Directory::ptr &dir, Directory &root);
+
+/* Resolves a '/'-separated path of names below root; the root itself is "" or "/". Directories
+ * are matched before entries of the same name. */
+std::optional<AnyKeychainPtr> find_by_path(Directory::ptr root, std::string_view path);
+
+/* the path find_by_path takes to the entry, without the root */
+std::string path_of(const Entry::ptr &entry);
+
+/* Edits addressed the same way. They throw std::runtime_error if the parent directory doesn't
+ * exist or the name is already taken in it. */
+Entry::ptr add_entry(Directory::ptr root, std::string_view path, std::string details,
+    crypto::DerivationPath dpath);
+Directory::ptr add_directory(Directory::ptr root, std::string_view path, std::string details);
+
+/* moves into `to` if it is a directory, otherwise moves and renames to `to` */
+void move_by_path(Directory::ptr root, std::string_view from, std::string_view to);
+
+/* non-empty directories are only removed if recursive is set, returns what was removed */
+AnyKeychainPtr remove_by_path(Directory::ptr root, std::string_view path, bool recursive);
+
 } // namespace keychain
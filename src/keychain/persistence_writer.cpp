@@ -0,0 +1,274 @@
+/*
+
+Copyright (C) 2019 Mateusz Morusiewicz
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+
+#include <src/keychain/persistence_writer.h>
+
+#include <algorithm>
+#include <unordered_map>
+#include <utility>
+
+namespace keychain {
+
+namespace {
+
+std::unordered_map<uint32_t, Entry::ptr> entries_by_id(const Directory::ptr &root) {
+	std::unordered_map<uint32_t, Entry::ptr> rv;
+	std::vector<Directory::ptr> to_visit{root};
+	while (!to_visit.empty()) {
+		auto dir = std::move(to_visit.back());
+		to_visit.pop_back();
+
+		for (const auto &entry : dir->entries) rv.emplace(entry->meta.id, entry);
+		to_visit.insert(to_visit.end(), dir->dirs.begin(), dir->dirs.end());
+	}
+	return rv;
+}
+
+bool same_meta(const EntryMeta &lhs, const EntryMeta &rhs) {
+	return lhs.name == rhs.name && lhs.details == rhs.details &&
+	       lhs.dpath.seed == rhs.dpath.seed && lhs.tags == rhs.tags;
+}
+
+/* the directory of ours at the path of dir in another tree, created if it's missing */
+Directory::ptr directory_like(const Directory::ptr &ours, const Directory::ptr &dir) {
+	auto parent = dir->parent_dir.lock();
+	if (!parent) return ours;
+
+	auto our_parent = directory_like(ours, parent);
+	for (const auto &child : our_parent->dirs) {
+		if (child->meta.name == dir->meta.name) return child;
+	}
+	our_parent->dirs.push_back(std::make_shared<Directory>(dir->meta, our_parent));
+	return our_parent->dirs.back();
+}
+
+void replace_entry(const Entry::ptr &entry, Entry::ptr replacement) {
+	auto &siblings = entry->parent_dir.lock()->entries;
+	std::replace(siblings.begin(), siblings.end(), entry, replacement);
+}
+
+void remove_entry(const Entry::ptr &entry) {
+	auto &siblings = entry->parent_dir.lock()->entries;
+	siblings.erase(std::remove(siblings.begin(), siblings.end(), entry), siblings.end());
+}
+
+} // namespace
+
+void rebase_tree(const Directory::ptr &base, const Directory::ptr &published,
+    const Directory::ptr &ours, EntryChanges &changes) {
+	const auto base_entries = entries_by_id(base);
+	const auto published_entries = entries_by_id(published);
+	const auto our_entries = entries_by_id(ours);
+
+	for (const auto &[id, entry] : base_entries) {
+		auto our = our_entries.find(id);
+		if (our == our_entries.end()) continue;
+
+		auto now = published_entries.find(id);
+		if (now == published_entries.end()) {
+			remove_entry(our->second);
+			changes.removed(*our->second);
+		} else if (!same_meta(now->second->meta, entry->meta) &&
+		           same_meta(our->second->meta, entry->meta)) {
+			auto replacement = std::make_shared<Entry>(now->second->meta, our->second->parent_dir);
+			replace_entry(our->second, replacement);
+			changes.changed(*replacement);
+		}
+	}
+
+	for (const auto &[id, entry] : published_entries) {
+		if (base_entries.count(id)) continue;
+
+		auto dir = directory_like(ours, entry->parent_dir.lock());
+		EntryMeta meta = entry->meta;
+		meta.id = new_entry_id(*ours);
+		dir->entries.push_back(std::make_shared<Entry>(meta, dir));
+		changes.changed(*dir->entries.back());
+	}
+}
+
+PersistenceWriter::PersistenceWriter(std::shared_ptr<Keychain> kc,
+    std::chrono::milliseconds delay, std::chrono::milliseconds max_staleness,
+    WriterCallbacks callbacks) :
+    kc(std::move(kc)),
+    callbacks(std::move(callbacks)), delay(delay), max_staleness(max_staleness) {
+	const auto snapshot = this->kc->snapshot();
+	m_root = deep_copy_directory(snapshot->root, nullptr);
+	m_root->is_open = true;
+	base_root = snapshot->root;
+	base_version = snapshot->version;
+	m_tags = snapshot->tags;
+
+	worker = std::thread([this]() { worker_loop(); });
+}
+
+PersistenceWriter::~PersistenceWriter() {
+	{
+		std::unique_lock<std::mutex> lk(mutex);
+		stopping = true;
+	}
+	cv.notify_all();
+	worker.join();
+}
+
+void PersistenceWriter::worker_loop() {
+	std::unique_lock<std::mutex> lk(mutex);
+	while (true) {
+		cv.wait(lk, [this]() { return stopping || dirty_generation != saved_generation; });
+		if (dirty_generation == saved_generation) return;
+
+		/* until the burst is over, but not past the staleness bound */
+		while (!stopping && !flush_requested) {
+			const auto deadline = std::min(last_dirty + delay, first_dirty + max_staleness);
+			if (Clock::now() >= deadline) break;
+			cv.wait_until(lk, deadline);
+		}
+
+		flush_requested = false;
+		const uint64_t generation = dirty_generation;
+		lk.unlock();
+
+		std::exception_ptr failure;
+		try {
+			write();
+		} catch (...) {
+			failure = std::current_exception();
+			if (callbacks.on_failure) callbacks.on_failure(failure);
+		}
+
+		lk.lock();
+		/* a failed write is only tried again with the next edit, the next flush rethrows it */
+		saved_generation = generation;
+		if (failure) error = failure;
+		cv.notify_all();
+	}
+}
+
+void PersistenceWriter::write() {
+	for (int rebases = 0;; ++rebases) {
+		EntryChanges changes;
+		try {
+			Directory::ptr copy;
+			{
+				std::unique_lock<std::mutex> tree_lk(tree_mutex);
+				changes = std::exchange(pending_changes, {});
+				/* given here rather than to the copy, so that later changes can refer to them */
+				if (changes.is_unknown()) assign_entry_ids(m_root);
+				copy = deep_copy_directory(m_root, nullptr);
+			}
+
+			base_version = kc->save_entries(copy, base_version, changes);
+			base_root = std::move(copy);
+			++n_writes;
+			return;
+		} catch (const StaleTreeError &) {
+			requeue(std::move(changes));
+			if (rebases == MAX_REBASES) throw;
+		} catch (...) {
+			requeue(std::move(changes));
+			throw;
+		}
+
+		rebase();
+	}
+}
+
+/* the next write still has to tell the index about these */
+void PersistenceWriter::requeue(EntryChanges changes) {
+	std::unique_lock<std::mutex> tree_lk(tree_mutex);
+	changes.merge(std::exchange(pending_changes, {}));
+	pending_changes = std::move(changes);
+}
+
+void PersistenceWriter::rebase() {
+	const auto snapshot = kc->snapshot();
+	{
+		std::unique_lock<std::mutex> tree_lk(tree_mutex);
+		EntryChanges changes;
+		rebase_tree(base_root, snapshot->root, m_root, changes);
+		if (m_tags && !changes.empty()) {
+			auto tags = std::make_shared<TagIndex>(*m_tags);
+			tags->apply(changes);
+			m_tags = std::move(tags);
+		}
+		/* relative to the published version, like the pending ones once it is the base */
+		pending_changes.merge(std::move(changes));
+	}
+	base_root = snapshot->root;
+	base_version = snapshot->version;
+
+	if (callbacks.on_rebased) callbacks.on_rebased();
+}
+
+void PersistenceWriter::modify(const std::function<void(EntryChanges &changes)> &mutate) {
+	{
+		std::unique_lock<std::mutex> tree_lk(tree_mutex);
+		EntryChanges changes;
+		mutate(changes);
+		if (changes.is_unknown()) {
+			m_tags.reset();
+		} else if (m_tags && !changes.empty()) {
+			auto tags = std::make_shared<TagIndex>(*m_tags);
+			tags->apply(changes);
+			m_tags = std::move(tags);
+		}
+		pending_changes.merge(std::move(changes));
+	}
+
+	{
+		std::unique_lock<std::mutex> lk(mutex);
+		const auto now = Clock::now();
+		if (dirty_generation == saved_generation) first_dirty = now;
+		last_dirty = now;
+		++dirty_generation;
+	}
+	cv.notify_all();
+}
+
+void PersistenceWriter::modify(const std::function<void()> &mutate) {
+	modify([&mutate](EntryChanges &changes) {
+		mutate();
+		changes = EntryChanges::unknown();
+	});
+}
+
+std::shared_ptr<const TagIndex> PersistenceWriter::tags() {
+	std::unique_lock<std::mutex> tree_lk(tree_mutex);
+	if (!m_tags) {
+		/* the ids are kept, the pending changes being unknown the next write indexes them all */
+		assign_entry_ids(m_root);
+		m_tags = std::make_shared<const TagIndex>(TagIndex::build(m_root));
+	}
+	return m_tags;
+}
+
+void PersistenceWriter::flush() {
+	std::unique_lock<std::mutex> lk(mutex);
+	const uint64_t target = dirty_generation;
+	if (saved_generation < target) {
+		flush_requested = true;
+		cv.notify_all();
+	}
+	cv.wait(lk, [this, target]() { return saved_generation >= target; });
+
+	if (error) std::rethrow_exception(std::exchange(error, nullptr));
+}
+
+} // namespace keychain
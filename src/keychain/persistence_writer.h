@@ -0,0 +1,133 @@
+/*
+
+Copyright (C) 2019 Mateusz Morusiewicz
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+
+#pragma once
+
+#include <src/keychain/keychain.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace keychain {
+
+constexpr std::chrono::milliseconds DEFAULT_WRITE_DELAY{100};
+constexpr std::chrono::milliseconds DEFAULT_MAX_STALENESS{1000};
+constexpr int MAX_REBASES = 3; // per write, before it is given up
+
+/* Both are called on the writer's thread */
+struct WriterCallbacks {
+	std::function<void()> on_rebased{}; // root took changes published by someone else
+	/* a write failed for good, the last one on destruction too; its edits go with the next one */
+	std::function<void(std::exception_ptr error)> on_failure{};
+};
+
+/* What published changed since base is done to ours as well, with changes recording it. Entries
+ * are matched by id: those it added go to the directory of the same path, created if need be,
+ * with ids of ours; those it removed are removed; those it edited take its edits, unless ours
+ * edited them too. Entries are replaced rather than modified. Changes to directories alone are
+ * not taken. */
+void rebase_tree(const Directory::ptr &base, const Directory::ptr &published,
+    const Directory::ptr &ours, EntryChanges &changes);
+
+/* Persists a tree that is being edited from a background thread. Bursts of edits are coalesced
+ * into one write once no edit came for delay, and no edit waits longer than max_staleness to be
+ * written. Whatever is pending is written out on flush() and on destruction.
+ *
+ * The tree is a copy of the current one taken on construction. A write that finds another version
+ * published in the meantime takes its changes into the tree, see rebase_tree, and is retried.
+ * Writes that fail anyway are reported by flush() and to on_failure. */
+class PersistenceWriter {
+	using Clock = std::chrono::steady_clock;
+
+	std::shared_ptr<Keychain> kc;
+	WriterCallbacks callbacks;
+	Directory::ptr m_root;
+	/* the tree as last written, and its version; writer thread only once constructed */
+	Directory::ptr base_root;
+	uint64_t base_version;
+	const std::chrono::milliseconds delay;
+	const std::chrono::milliseconds max_staleness;
+
+	/* held while root is modified, and by the writer while it copies root */
+	std::mutex tree_mutex;
+	EntryChanges pending_changes; // since the last write, under tree_mutex
+	/* of root with every modification applied, nullptr once an unknown change made it stale;
+	 * under tree_mutex */
+	std::shared_ptr<const TagIndex> m_tags;
+
+	std::mutex mutex;
+	std::condition_variable cv;
+	uint64_t dirty_generation = 0;
+	uint64_t saved_generation = 0;
+	Clock::time_point first_dirty, last_dirty;
+	bool flush_requested = false;
+	bool stopping = false;
+	std::exception_ptr error;
+	std::atomic<uint64_t> n_writes{0};
+	std::thread worker;
+
+	void worker_loop();
+	void write();
+	void requeue(EntryChanges changes);
+	void rebase();
+
+  public:
+	PersistenceWriter(std::shared_ptr<Keychain> kc,
+	    std::chrono::milliseconds delay = DEFAULT_WRITE_DELAY,
+	    std::chrono::milliseconds max_staleness = DEFAULT_MAX_STALENESS,
+	    WriterCallbacks callbacks = {});
+	~PersistenceWriter();
+
+	PersistenceWriter(const PersistenceWriter &) = delete;
+	PersistenceWriter &operator=(const PersistenceWriter &) = delete;
+
+	/* The tree to edit, only through modify(). The writer's thread changes it as well when it
+	 * rebases, under lock_tree(): it adds, removes and replaces entries and adds directories, but
+	 * never modifies a node other than by adding or removing its children. */
+	Directory::ptr root() const { return m_root; }
+
+	/* Runs mutate, which may modify anything under root and records what it did to entries in
+	 * changes, and schedules a write. Without them the tag index is built again from the whole
+	 * tree on the write. */
+	void modify(const std::function<void(EntryChanges &changes)> &mutate);
+	void modify(const std::function<void()> &mutate);
+
+	/* The tag index of root with every modification made so far, whether written or not. Takes
+	 * the tree lock itself. */
+	std::shared_ptr<const TagIndex> tags();
+
+	/* for changes that are not persisted, e.g. opening a directory */
+	std::unique_lock<std::mutex> lock_tree() { return std::unique_lock<std::mutex>(tree_mutex); }
+
+	/* Blocks until every modification made so far is written. Rethrows the error of a write that
+	 * failed since the last flush. */
+	void flush();
+
+	uint64_t writes() const { return n_writes; }
+};
+
+} // namespace keychain
@@ -0,0 +1,162 @@
+/*
+
+Copyright (C) 2019 Mateusz Morusiewicz
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+
+#include <src/keychain/secret_prefetcher.h>
+
+#include <algorithm>
+
+namespace keychain {
+
+SecretPrefetcher::SecretPrefetcher(
+    std::shared_ptr<Keychain> kc, std::chrono::milliseconds ttl, size_t capacity) :
+    kc(std::move(kc)),
+    ttl(ttl), capacity(std::max<size_t>(capacity, 1)) {
+	worker = std::thread([this]() { worker_loop(); });
+}
+
+SecretPrefetcher::~SecretPrefetcher() {
+	{
+		std::unique_lock<std::mutex> lk(mutex);
+		stopping = true;
+	}
+	cv.notify_all();
+	worker.join();
+	wipe();
+}
+
+SecretPrefetcher::Cached *SecretPrefetcher::find(int dpath) {
+	auto it = std::find_if(
+	    cache.begin(), cache.end(), [dpath](const Cached &c) { return c.dpath == dpath; });
+	return it == cache.end() ? nullptr : &*it;
+}
+
+/* called with the mutex held, evicts whatever expires first when full */
+void SecretPrefetcher::store(int dpath, utils::sensitive_string secret) {
+	const auto expires = Clock::now() + ttl;
+	if (Cached *cached = find(dpath)) {
+		cached->secret = std::move(secret);
+		cached->expires = expires;
+		return;
+	}
+
+	if (cache.size() >= capacity) {
+		auto oldest = std::min_element(cache.begin(), cache.end(),
+		    [](const Cached &lhs, const Cached &rhs) { return lhs.expires < rhs.expires; });
+		cache.erase(oldest);
+	}
+	/* the secret itself is locked memory as well */
+	utils::memory::Accounted accounted(
+	    utils::memory::Category::Caches, sizeof(Cached) + secret.size());
+	cache.push_back(Cached{dpath, std::move(secret), expires, std::move(accounted)});
+}
+
+/* called with the mutex held */
+void SecretPrefetcher::drop_expired() {
+	const auto now = Clock::now();
+	cache.erase(std::remove_if(cache.begin(), cache.end(),
+	                [now](const Cached &c) { return c.expires <= now; }),
+	    cache.end());
+}
+
+void SecretPrefetcher::worker_loop() {
+	std::unique_lock<std::mutex> lk(mutex);
+	while (!stopping) {
+		drop_expired();
+
+		/* the nearest target that is not cached yet */
+		auto next = std::find_if(targets.begin(), targets.end(),
+		    [this](const crypto::DerivationPath &dpath) { return !find(dpath.seed); });
+
+		if (next == targets.end()) {
+			targets.clear();
+
+			/* sleep until there is something to derive or to drop */
+			auto expires = std::min_element(cache.begin(), cache.end(),
+			    [](const Cached &lhs, const Cached &rhs) { return lhs.expires < rhs.expires; });
+			if (expires == cache.end()) {
+				cv.wait(lk);
+			} else {
+				cv.wait_until(lk, expires->expires);
+			}
+			continue;
+		}
+
+		const crypto::DerivationPath dpath = *next;
+		in_flight = dpath.seed;
+		lk.unlock();
+
+		std::optional<utils::sensitive_string> secret;
+		try {
+			secret = kc->derive_secret(dpath);
+		} catch (const std::exception &) {
+			/* get() derives it again and reports the error where it can be shown */
+		}
+
+		lk.lock();
+		in_flight.reset();
+		if (secret) {
+			store(dpath.seed, std::move(*secret));
+		} else {
+			targets.erase(std::remove_if(targets.begin(), targets.end(),
+			                  [&dpath](const auto &t) { return t.seed == dpath.seed; }),
+			    targets.end());
+		}
+		cv.notify_all();
+	}
+}
+
+void SecretPrefetcher::prefetch(std::vector<crypto::DerivationPath> dpaths) {
+	if (dpaths.size() > capacity) dpaths.resize(capacity);
+	{
+		std::unique_lock<std::mutex> lk(mutex);
+		targets = std::move(dpaths);
+	}
+	cv.notify_all();
+}
+
+utils::sensitive_string SecretPrefetcher::get(const crypto::DerivationPath &dpath) {
+	{
+		std::unique_lock<std::mutex> lk(mutex);
+		cv.wait(lk, [this, &dpath]() { return in_flight != dpath.seed; });
+
+		drop_expired();
+		if (Cached *cached = find(dpath.seed)) return cached->secret;
+	}
+
+	auto secret = kc->derive_secret(dpath);
+
+	std::unique_lock<std::mutex> lk(mutex);
+	store(dpath.seed, secret);
+	return secret;
+}
+
+bool SecretPrefetcher::is_cached(const crypto::DerivationPath &dpath) {
+	std::unique_lock<std::mutex> lk(mutex);
+	drop_expired();
+	return find(dpath.seed) != nullptr;
+}
+
+void SecretPrefetcher::wipe() {
+	std::unique_lock<std::mutex> lk(mutex);
+	targets.clear();
+	cache.clear();
+}
+
+} // namespace keychain
@@ -0,0 +1,94 @@
+/*
+
+Copyright (C) 2019 Mateusz Morusiewicz
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+
+#pragma once
+
+#include <src/keychain/keychain.h>
+
+#include <src/utils/memory.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+
+namespace keychain {
+
+constexpr std::chrono::seconds DEFAULT_PREFETCH_TTL{60};
+constexpr size_t DEFAULT_PREFETCH_CAPACITY = 8;
+
+/* Derives secrets ahead of time on a background thread, so that showing one is instant. Secrets
+ * live in locked memory, are dropped once their ttl passes and wiped when the prefetcher goes
+ * away. */
+class SecretPrefetcher {
+	using Clock = std::chrono::steady_clock;
+
+	struct Cached {
+		int dpath;
+		utils::sensitive_string secret;
+		Clock::time_point expires;
+		utils::memory::Accounted accounted;
+	};
+
+	std::shared_ptr<Keychain> kc;
+	const std::chrono::milliseconds ttl;
+	const size_t capacity;
+
+	std::mutex mutex;
+	std::condition_variable cv;
+	std::vector<Cached> cache;
+	std::vector<crypto::DerivationPath> targets; // nearest to the cursor first
+	std::optional<int> in_flight;
+	bool stopping = false;
+	std::thread worker;
+
+	Cached *find(int dpath);
+	void store(int dpath, utils::sensitive_string secret);
+	void drop_expired();
+	void worker_loop();
+
+  public:
+	SecretPrefetcher(std::shared_ptr<Keychain> kc,
+	    std::chrono::milliseconds ttl = DEFAULT_PREFETCH_TTL,
+	    size_t capacity = DEFAULT_PREFETCH_CAPACITY);
+	~SecretPrefetcher();
+
+	SecretPrefetcher(const SecretPrefetcher &) = delete;
+	SecretPrefetcher &operator=(const SecretPrefetcher &) = delete;
+
+	/* Replaces the paths to derive, whatever is left of the previous ones is abandoned. At most
+	 * capacity of them are taken. */
+	void prefetch(std::vector<crypto::DerivationPath> dpaths);
+
+	/* the cached secret, waits for it if it is being derived and derives it right away otherwise */
+	utils::sensitive_string get(const crypto::DerivationPath &dpath);
+
+	/* whether the secret can be had without deriving it */
+	bool is_cached(const crypto::DerivationPath &dpath);
+
+	/* drops every cached secret and pending path */
+	void wipe();
+};
+
+} // namespace keychain
@@ -0,0 +1,123 @@
+/*
+
+Copyright (C) 2019 Mateusz Morusiewicz
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+
+#include <src/keychain/synthetic.h>
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace keychain {
+
+namespace {
+
+constexpr char NAME_CHARS[] = "abcdefghijklmnopqrstuvwxyz";
+constexpr char DETAILS_CHARS[] = "abcdefghijklmnopqrstuvwxyz0123456789 ./:-";
+
+class Generator {
+	std::mt19937_64 rng;
+
+	int sample(const LengthDistribution &lengths) {
+		double length;
+		if (lengths.kind == LengthDistribution::Kind::Uniform) {
+			const int min = static_cast<int>(lengths.a);
+			const int max = std::max(min, static_cast<int>(lengths.b));
+			length = std::uniform_int_distribution<int>(min, max)(rng);
+		} else {
+			length = std::round(std::normal_distribution<double>(lengths.a, lengths.b)(rng));
+		}
+		return std::clamp(static_cast<int>(length), 1, LengthDistribution::MAX_LENGTH);
+	}
+
+	template <size_t N> char pick(const char (&chars)[N]) {
+		return chars[std::uniform_int_distribution<size_t>(0, N - 2)(rng)];
+	}
+
+  public:
+	explicit Generator(uint64_t seed) : rng(seed) {}
+
+	/* random letters ending with index in width base 26 digits, which keeps siblings apart */
+	std::string name(const LengthDistribution &lengths, size_t index, int width) {
+		std::string rv(std::max(sample(lengths), width), ' ');
+		for (size_t i = rv.size(); i-- > 0;) {
+			if (rv.size() - i <= static_cast<size_t>(width)) {
+				rv[i] = NAME_CHARS[index % 26];
+				index /= 26;
+			} else {
+				rv[i] = pick(NAME_CHARS);
+			}
+		}
+		return rv;
+	}
+
+	std::string details(const LengthDistribution &lengths) {
+		std::string rv(sample(lengths), ' ');
+		for (char &c : rv) c = pick(DETAILS_CHARS);
+		return rv;
+	}
+};
+
+/* base 26 digits needed for 0..n-1 */
+int digits_for(size_t n) {
+	int rv = 1;
+	for (size_t limit = 26; limit < n; limit *= 26) ++rv;
+	return rv;
+}
+
+} // namespace
+
+Directory::ptr generate_tree(const KeychainShape &shape) {
+	Generator generator(shape.seed);
+
+	auto root = std::make_shared<Directory>(DirectoryMeta{"", ""}, nullptr);
+	root->is_open = true;
+
+	/* breadth-first, the last level gets the entries */
+	std::vector<Directory::ptr> level{root};
+	const int dir_width = digits_for(shape.fan_out);
+	for (int d = 0; d < shape.depth && shape.fan_out > 0; ++d) {
+		std::vector<Directory::ptr> next;
+		next.reserve(level.size() * shape.fan_out);
+		for (const auto &parent : level) {
+			for (int i = 0; i < shape.fan_out; ++i) {
+				auto dir = std::make_shared<Directory>(
+				    DirectoryMeta{generator.name(shape.name_length, i, dir_width), ""}, parent);
+				parent->dirs.push_back(dir);
+				next.push_back(std::move(dir));
+			}
+		}
+		level = std::move(next);
+	}
+
+	const int entry_width = digits_for((shape.n_entries + level.size() - 1) / level.size());
+	for (size_t i = 0; i < shape.n_entries; ++i) {
+		const auto &parent = level[i % level.size()];
+		EntryMeta meta{generator.name(shape.name_length, i / level.size(), entry_width),
+		    generator.details(shape.details_length), {static_cast<int>(i)}};
+		meta.id = new_entry_id(*root);
+		parent->entries.push_back(std::make_shared<Entry>(meta, parent));
+	}
+
+	return root;
+}
+
+} // namespace keychain
@@ -0,0 +1,60 @@
+/*
+
+Copyright (C) 2019 Mateusz Morusiewicz
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+
+#pragma once
+
+#include <src/keychain/keychain_entry.h>
+
+#include <cstddef>
+#include <cstdint>
+
+namespace keychain {
+
+/* Lengths of generated names and details, clamped to [1, MAX_LENGTH] */
+struct LengthDistribution {
+	static constexpr int MAX_LENGTH = 4096;
+
+	enum class Kind { Uniform, Normal } kind = Kind::Uniform;
+	double a = 8;  // min for Uniform, mean for Normal
+	double b = 16; // max for Uniform, standard deviation for Normal
+
+	static LengthDistribution uniform(int min, int max) {
+		return {Kind::Uniform, static_cast<double>(min), static_cast<double>(max)};
+	}
+	static LengthDistribution normal(double mean, double stddev) {
+		return {Kind::Normal, mean, stddev};
+	}
+};
+
+struct KeychainShape {
+	size_t n_entries = 1000;
+	int depth = 3;    // directory levels below the root, entries go into the deepest ones
+	int fan_out = 10; // subdirectories of every directory above them
+	LengthDistribution name_length = LengthDistribution::uniform(6, 24);
+	LengthDistribution details_length = LengthDistribution::normal(40, 20);
+	uint64_t seed = 1; // the same shape and seed give the same tree
+};
+
+/* A synthetic tree for tests and benchmarks. The last letters of a name number it within its
+ * directory, so names are unique there and never shorter than that number. Derivation paths are
+ * 0..n_entries-1. */
+Directory::ptr generate_tree(const KeychainShape &shape);
+
+} // namespace keychain
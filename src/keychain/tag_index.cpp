@@ -0,0 +1,361 @@
+/*
+
+Copyright (C) 2019 Mateusz Morusiewicz
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#include <src/keychain/tag_index.h>
+
+#include <algorithm>
+#include <cstring>
+#include <optional>
+#include <stdexcept>
+
+namespace keychain {
+
+namespace {
+
+bool is_tag_char(char c) {
+	const unsigned char u = c;
+	return (u >= 'a' && u <= 'z') || (u >= 'A' && u <= 'Z') || (u >= '0' && u <= '9') ||
+	       u >= 0x80 || (c != '\0' && std::strchr("-_.:/=+@", c));
+}
+
+bool is_space(char c) { return c == ' ' || c == '\t' || c == '\n' || c == '\r'; }
+
+void put_u32(std::string &out, uint32_t v) {
+	for (int shift = 24; shift >= 0; shift -= 8) {
+		out.push_back(static_cast<char>((v >> shift) & 0xff));
+	}
+}
+
+uint32_t take_u32(std::string_view &data) {
+	if (data.size() < 4) throw std::runtime_error("truncated tag index");
+	uint32_t rv = 0;
+	for (int i = 0; i < 4; ++i) rv = (rv << 8) | static_cast<uint8_t>(data[i]);
+	data.remove_prefix(4);
+	return rv;
+}
+
+/* recursive descent over the expression, one bitmap per subexpression */
+class QueryParser {
+	const TagIndex &index;
+	std::string_view text;
+	size_t pos = 0;
+
+	void skip_space() {
+		while (pos < text.size() && is_space(text[pos])) ++pos;
+	}
+
+	bool consume(char c) {
+		skip_space();
+		if (pos >= text.size() || text[pos] != c) return false;
+		++pos;
+		return true;
+	}
+
+	bool at_operand() {
+		skip_space();
+		if (pos >= text.size()) return false;
+		return text[pos] == '!' || text[pos] == '(' || is_tag_char(text[pos]);
+	}
+
+	[[noreturn]] void fail(const std::string &what) {
+		throw std::runtime_error(what + " at position " + std::to_string(pos + 1));
+	}
+
+	utils::RoaringBitmap parse_operand() {
+		if (consume('!')) return index.entries().andnot(parse_operand());
+		if (consume('(')) {
+			auto rv = parse_or();
+			if (!consume(')')) fail("expected ')'");
+			return rv;
+		}
+
+		skip_space();
+		const size_t begin = pos;
+		while (pos < text.size() && is_tag_char(text[pos])) ++pos;
+		if (pos == begin) fail("expected a tag");
+
+		auto bitmap = index.find(text.substr(begin, pos - begin));
+		return bitmap ? *bitmap : utils::RoaringBitmap{};
+	}
+
+	utils::RoaringBitmap parse_and() {
+		auto rv = parse_operand();
+		while (consume('&') || at_operand()) rv = rv & parse_operand();
+		return rv;
+	}
+
+	utils::RoaringBitmap parse_or() {
+		auto rv = parse_and();
+		while (consume('|')) rv = rv | parse_and();
+		return rv;
+	}
+
+  public:
+	QueryParser(const TagIndex &index, std::string_view text) : index(index), text(text) {}
+
+	utils::RoaringBitmap parse() {
+		auto rv = parse_or();
+		skip_space();
+		if (pos < text.size()) fail(std::string("unexpected '") + text[pos] + "'");
+		return rv;
+	}
+};
+
+/* whether anything under dir matched; dir is taken back out of rv if not */
+bool collect_filtered(
+    std::vector<AnyKeychainPtr> &rv, const Directory::ptr &dir, const utils::RoaringBitmap &ids) {
+	const size_t dir_row = rv.size();
+	rv.push_back(dir);
+
+	bool matched = false;
+	for (const auto &child_dir : dir->dirs) matched |= collect_filtered(rv, child_dir, ids);
+	for (const auto &entry : dir->entries) {
+		if (!ids.contains(entry->meta.id)) continue;
+		rv.push_back(entry);
+		matched = true;
+	}
+
+	if (!matched) rv.resize(dir_row);
+	return matched;
+}
+
+} // namespace
+
+bool is_valid_tag(std::string_view tag) {
+	return !tag.empty() && std::all_of(tag.begin(), tag.end(), is_tag_char);
+}
+
+std::vector<std::string> parse_tags(std::string_view text) {
+	std::vector<std::string> rv;
+	size_t pos = 0;
+	while (pos < text.size()) {
+		if (is_space(text[pos]) || text[pos] == ',') {
+			++pos;
+			continue;
+		}
+
+		const size_t begin = pos;
+		while (pos < text.size() && !is_space(text[pos]) && text[pos] != ',') ++pos;
+		std::string tag(text.substr(begin, pos - begin));
+		if (!is_valid_tag(tag)) throw std::runtime_error("invalid tag: " + tag);
+		rv.push_back(std::move(tag));
+	}
+
+	std::sort(rv.begin(), rv.end());
+	rv.erase(std::unique(rv.begin(), rv.end()), rv.end());
+	return rv;
+}
+
+std::string join_tags(const std::vector<std::string> &tags) {
+	std::string rv;
+	for (const auto &tag : tags) {
+		if (!rv.empty()) rv += ' ';
+		rv += tag;
+	}
+	return rv;
+}
+
+EntryChanges EntryChanges::unknown() {
+	EntryChanges rv;
+	rv.unknown_changes = true;
+	return rv;
+}
+
+void EntryChanges::changed(const Entry &entry) {
+	if (!entry.meta.id) throw std::runtime_error("entry without an id: " + entry.meta.name);
+	gone.erase(entry.meta.id);
+	present[entry.meta.id] = entry.meta.tags;
+}
+
+void EntryChanges::removed(const Entry &entry) {
+	present.erase(entry.meta.id);
+	gone.insert(entry.meta.id);
+}
+
+void EntryChanges::changed(const Directory &dir) {
+	for (const auto &entry : dir.entries) changed(*entry);
+	for (const auto &child_dir : dir.dirs) changed(*child_dir);
+}
+
+void EntryChanges::removed(const Directory &dir) {
+	for (const auto &entry : dir.entries) removed(*entry);
+	for (const auto &child_dir : dir.dirs) removed(*child_dir);
+}
+
+void EntryChanges::merge(EntryChanges later) {
+	unknown_changes |= later.unknown_changes;
+	for (uint32_t id : later.gone) {
+		present.erase(id);
+		gone.insert(id);
+	}
+	for (auto &[id, tags] : later.present) {
+		gone.erase(id);
+		present[id] = std::move(tags);
+	}
+}
+
+TagIndex::TagIndex() : all(std::make_shared<const utils::RoaringBitmap>()) {}
+
+void TagIndex::account() {
+	size_t bytes = all->heap_bytes();
+	for (const auto &[tag, bitmap] : by_tag) {
+		bytes += sizeof(tag) + utils::memory::heap_bytes(tag);
+		bytes += sizeof(*bitmap) + bitmap->heap_bytes();
+	}
+	accounted.set(bytes);
+}
+
+TagIndex TagIndex::build(const Directory::ptr &root) {
+	utils::RoaringBitmap present;
+	std::map<std::string, utils::RoaringBitmap, std::less<>> bitmaps;
+
+	std::vector<Directory::ptr> to_visit{root};
+	while (!to_visit.empty()) {
+		auto dir = std::move(to_visit.back());
+		to_visit.pop_back();
+
+		for (const auto &entry : dir->entries) {
+			present.add(entry->meta.id);
+			for (const auto &tag : entry->meta.tags) bitmaps[tag].add(entry->meta.id);
+		}
+		to_visit.insert(to_visit.end(), dir->dirs.begin(), dir->dirs.end());
+	}
+
+	TagIndex rv;
+	rv.all = std::make_shared<const utils::RoaringBitmap>(std::move(present));
+	for (auto &[tag, bitmap] : bitmaps) {
+		rv.by_tag.emplace(tag, std::make_shared<const utils::RoaringBitmap>(std::move(bitmap)));
+	}
+	rv.account();
+	return rv;
+}
+
+void TagIndex::apply(const EntryChanges &changes) {
+	if (changes.unknown_changes) throw std::runtime_error("unknown changes can't be applied");
+
+	/* copies of the bitmaps being edited, the shared ones are left alone */
+	std::map<std::string, utils::RoaringBitmap, std::less<>> edited;
+	auto edit = [this, &edited](const std::string &tag) -> utils::RoaringBitmap & {
+		if (auto it = edited.find(tag); it != edited.end()) return it->second;
+		auto current = by_tag.find(tag);
+		auto bitmap = current != by_tag.end() ? *current->second : utils::RoaringBitmap{};
+		return edited.emplace(tag, std::move(bitmap)).first->second;
+	};
+	auto untag = [this, &edit](uint32_t id) {
+		for (const auto &[tag, bitmap] : by_tag) {
+			if (bitmap->contains(id)) edit(tag).remove(id);
+		}
+	};
+
+	std::optional<utils::RoaringBitmap> edited_all;
+	for (uint32_t id : changes.gone) {
+		untag(id);
+		if (!all->contains(id)) continue;
+		if (!edited_all) edited_all = *all;
+		edited_all->remove(id);
+	}
+	for (const auto &[id, tags] : changes.present) {
+		untag(id);
+		for (const auto &tag : tags) edit(tag).add(id);
+		if (all->contains(id)) continue;
+		if (!edited_all) edited_all = *all;
+		edited_all->add(id);
+	}
+
+	for (auto &[tag, bitmap] : edited) {
+		if (bitmap.empty()) {
+			by_tag.erase(tag);
+		} else {
+			by_tag[tag] = std::make_shared<const utils::RoaringBitmap>(std::move(bitmap));
+		}
+	}
+	if (edited_all) all = std::make_shared<const utils::RoaringBitmap>(std::move(*edited_all));
+	account();
+}
+
+utils::RoaringBitmap TagIndex::query(std::string_view expression) const {
+	if (std::all_of(expression.begin(), expression.end(), is_space)) return *all;
+	return QueryParser(*this, expression).parse();
+}
+
+const utils::RoaringBitmap *TagIndex::find(std::string_view tag) const {
+	auto it = by_tag.find(tag);
+	return it != by_tag.end() ? it->second.get() : nullptr;
+}
+
+std::vector<std::string> TagIndex::tags() const {
+	std::vector<std::string> rv;
+	rv.reserve(by_tag.size());
+	for (const auto &[tag, bitmap] : by_tag) rv.push_back(tag);
+	return rv;
+}
+
+bool TagIndex::operator==(const TagIndex &other) const {
+	auto same_bitmap = [](const auto &a, const auto &b) {
+		return a.first == b.first && *a.second == *b.second;
+	};
+	return *all == *other.all && by_tag.size() == other.by_tag.size() &&
+	       std::equal(by_tag.begin(), by_tag.end(), other.by_tag.begin(), same_bitmap);
+}
+
+std::string TagIndex::serialize() const {
+	std::string rv;
+	all->serialize(rv);
+	put_u32(rv, by_tag.size());
+	for (const auto &[tag, bitmap] : by_tag) {
+		put_u32(rv, tag.size());
+		rv += tag;
+		bitmap->serialize(rv);
+	}
+	return rv;
+}
+
+TagIndex TagIndex::deserialize(std::string_view data) {
+	TagIndex rv;
+	rv.all = std::make_shared<const utils::RoaringBitmap>(utils::RoaringBitmap::deserialize(data));
+
+	const uint32_t n_tags = take_u32(data);
+	for (uint32_t i = 0; i < n_tags; ++i) {
+		const uint32_t size = take_u32(data);
+		if (data.size() < size) throw std::runtime_error("truncated tag index");
+		std::string tag(data.substr(0, size));
+		data.remove_prefix(size);
+
+		auto bitmap = utils::RoaringBitmap::deserialize(data);
+		if (!is_valid_tag(tag) || bitmap.empty() || bitmap.andnot(*rv.all).cardinality() > 0 ||
+		    rv.by_tag.count(tag)) {
+			throw std::runtime_error("bad tag index");
+		}
+
+		rv.by_tag.emplace(
+		    std::move(tag), std::make_shared<const utils::RoaringBitmap>(std::move(bitmap)));
+	}
+
+	if (!data.empty()) throw std::runtime_error("bad tag index");
+	rv.account();
+	return rv;
+}
+
+std::vector<AnyKeychainPtr> flatten_filtered(Directory::ptr root, const utils::RoaringBitmap &ids) {
+	std::vector<AnyKeychainPtr> rv;
+	if (!collect_filtered(rv, root, ids)) rv.push_back(root);
+	return rv;
+}
+
+} // namespace keychain
@@ -0,0 +1,115 @@
+/*
+
+Copyright (C) 2019 Mateusz Morusiewicz
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#pragma once
+
+#include <src/keychain/keychain_entry.h>
+
+#include <src/utils/memory.h>
+#include <src/utils/roaring.h>
+
+#include <map>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace keychain {
+
+/* Tags are non-empty and made of letters, digits, non-ASCII characters and "-_.:/=+@"; anything
+ * else would clash with the query syntax. */
+bool is_valid_tag(std::string_view tag);
+
+/* Splits on whitespace and commas, sorted and without duplicates. Throws std::runtime_error on an
+ * invalid tag. */
+std::vector<std::string> parse_tags(std::string_view text);
+std::string join_tags(const std::vector<std::string> &tags);
+
+/* What an edit of the tree did to its entries, by id, so that the tag index can follow without
+ * walking the tree. Recorded after the edit, with the entries as they are left. */
+class EntryChanges {
+	std::unordered_map<uint32_t, std::vector<std::string>> present; // added or retagged
+	std::unordered_set<uint32_t> gone;
+	bool unknown_changes = false;
+
+	friend class TagIndex;
+
+  public:
+	/* for edits that don't tell what they did, the index is then built again from the tree */
+	static EntryChanges unknown();
+
+	/* an entry added or with its tags changed; throws std::runtime_error if it has no id */
+	void changed(const Entry &entry);
+	void removed(const Entry &entry);
+	/* the same for every entry below dir */
+	void changed(const Directory &dir);
+	void removed(const Directory &dir);
+
+	/* adds changes made after these */
+	void merge(EntryChanges later);
+
+	bool is_unknown() const { return unknown_changes; }
+	bool empty() const { return !unknown_changes && present.empty() && gone.empty(); }
+};
+
+/* A bitmap of entry ids (EntryMeta::id) for every tag. Bitmaps are shared between copies, so a
+ * copy updated with apply only costs the bitmaps of the tags that changed. */
+class TagIndex {
+	using Bitmap = std::shared_ptr<const utils::RoaringBitmap>;
+
+	std::map<std::string, Bitmap, std::less<>> by_tag;
+	Bitmap all; // ids of all entries, for negation
+
+	utils::memory::Accounted accounted{utils::memory::Category::Caches};
+	void account();
+
+  public:
+	TagIndex();
+
+	static TagIndex build(const Directory::ptr &root);
+
+	/* Brings the index up to date with changes, which must not be unknown. Only the bitmaps of
+	 * tags the changed entries had or have now are copied. */
+	void apply(const EntryChanges &changes);
+
+	/* Evaluates a filter expression: tags combined with & (and), | (or), ! (not) and
+	 * parentheses, binding in that order, tightest first. Tags next to each other are and-ed.
+	 * Unknown tags match nothing, a blank expression matches every entry. Throws
+	 * std::runtime_error on a syntax error. */
+	utils::RoaringBitmap query(std::string_view expression) const;
+
+	const utils::RoaringBitmap &entries() const { return *all; }
+	/* nullptr if no entry has the tag */
+	const utils::RoaringBitmap *find(std::string_view tag) const;
+	std::vector<std::string> tags() const;
+
+	bool operator==(const TagIndex &other) const;
+
+	std::string serialize() const;
+	/* throws std::runtime_error on bad input */
+	static TagIndex deserialize(std::string_view data);
+};
+
+/* Like flatten_dirs, but with only the entries in ids, and the directories leading to them shown
+ * whether they are open or not. The root is always there. */
+std::vector<AnyKeychainPtr> flatten_filtered(Directory::ptr root, const utils::RoaringBitmap &ids);
+
+} // namespace keychain
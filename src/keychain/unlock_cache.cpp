@@ -0,0 +1,84 @@
+/*
+
+Copyright (C) 2019 Mateusz Morusiewicz
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#include <src/keychain/unlock_cache.h>
+
+#include <stdexcept>
+
+namespace keychain {
+
+UnlockCache::UnlockCache(std::chrono::seconds timeout, std::unique_ptr<crypto::KeyCache> cache) :
+    cache(std::move(cache)), timeout(timeout) {}
+
+bool UnlockCache::enabled() const {
+	return cache && timeout.count() > 0;
+}
+
+/* the same keychain reached through different paths shares its entry */
+std::string UnlockCache::id_for(const std::filesystem::path &path) {
+	return std::filesystem::weakly_canonical(path).string();
+}
+
+std::unique_ptr<Keychain> UnlockCache::open(const std::filesystem::path &path) {
+	if (!enabled()) return nullptr;
+
+	auto cached = cache->load(id_for(path));
+	if (!cached) return nullptr;
+
+	/* The hash was verified before it was stored; the tag tells it still goes with the stored
+	 * check, without the slow verification. A changed check, e.g. a new phrase, drops it. */
+	auto kc = Keychain::open(path, cached->pw_hash);
+	const auto tag = kc->password_check_tag();
+	if (!tag || !crypto::tags_equal(*tag, cached->check_tag)) {
+		forget(path);
+		return nullptr;
+	}
+	return kc;
+}
+
+std::unique_ptr<Keychain> UnlockCache::open(
+    const std::filesystem::path &path, crypto::PasswordHash pw_hash) {
+	auto kc = Keychain::open(path, pw_hash);
+	const auto verified = kc->check_password();
+	if (verified == false) {
+		throw std::runtime_error("wrong encryption phrase");
+	}
+
+	/* a phrase that can't be verified is never remembered, a typo would be used for the whole
+	 * timeout to derive wrong secrets */
+	if (enabled() && verified == true) {
+		try {
+			if (auto tag = kc->password_check_tag()) {
+				cache->store(id_for(path), {pw_hash, *tag}, timeout);
+			}
+		} catch (const std::exception &) {
+			/* the keychain is open either way, it will just be asked for again next time; a
+			 * half written entry must not outlive the failure */
+			forget(path);
+		}
+	}
+
+	return kc;
+}
+
+void UnlockCache::forget(const std::filesystem::path &path) {
+	if (cache) cache->forget(id_for(path));
+}
+
+} // namespace keychain
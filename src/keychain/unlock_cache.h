@@ -0,0 +1,64 @@
+/*
+
+Copyright (C) 2019 Mateusz Morusiewicz
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#pragma once
+
+#include <src/keychain/keychain.h>
+
+#include <src/crypto/key_cache.h>
+
+#include <chrono>
+#include <filesystem>
+#include <memory>
+
+namespace keychain {
+
+/* off unless asked for with --cache-timeout */
+constexpr std::chrono::seconds DEFAULT_UNLOCK_CACHE_TIMEOUT{0};
+
+/* Lets later invocations open a keychain without asking for its encryption phrase again, for as
+ * long as it keeps being used within the timeout. A zero timeout disables caching. Only phrases
+ * the keychain has verified are cached, so keychains created before password checks were stored
+ * always ask. */
+class UnlockCache {
+	std::unique_ptr<crypto::KeyCache> cache;
+	std::chrono::seconds timeout;
+
+	static std::string id_for(const std::filesystem::path &path);
+	bool enabled() const;
+
+  public:
+	explicit UnlockCache(std::chrono::seconds timeout = DEFAULT_UNLOCK_CACHE_TIMEOUT,
+	    std::unique_ptr<crypto::KeyCache> cache = crypto::make_default_key_cache());
+
+	/* nullptr if nothing is cached for path (any more) */
+	std::unique_ptr<Keychain> open(const std::filesystem::path &path);
+
+	/* Throws std::runtime_error on a wrong encryption phrase where the keychain can tell, caches it
+	 * if it is verified right. Failing to cache is not an error. */
+	std::unique_ptr<Keychain> open(const std::filesystem::path &path, crypto::PasswordHash pw_hash);
+
+	/* also clears what was cached while caching was still enabled */
+	void forget(const std::filesystem::path &path);
+
+	/* name of the backend in use, nullptr if there is none or caching is disabled */
+	const char *backend() const { return enabled() ? cache->name() : nullptr; }
+};
+
+} // namespace keychain
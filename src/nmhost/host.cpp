@@ -0,0 +1,153 @@
+/*
+
+Copyright (C) 2019 Mateusz Morusiewicz
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#include <src/nmhost/host.h>
+
+#include <external/nlohmann/json_single_include.h>
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace nmhost {
+
+namespace {
+
+class RequestError : public std::runtime_error {
+	using std::runtime_error::runtime_error;
+};
+
+const std::string &string_member(const nlohmann::json &request, const char *name) {
+	auto it = request.find(name);
+	if (it == request.end() || !it->is_string()) {
+		throw RequestError(std::string("missing string member: ") + name);
+	}
+	return it->get_ref<const std::string &>();
+}
+
+} // namespace
+
+Host::Host(std::filesystem::path socket_path) : socket_path(std::move(socket_path)) {}
+
+Host::~Host() = default;
+
+agent::Client &Host::connect() {
+	if (!client) {
+		client = std::make_unique<agent::Client>(socket_path);
+		try {
+			index = OriginIndex(client->entries());
+		} catch (...) {
+			client.reset();
+			throw;
+		}
+	}
+	return *client;
+}
+
+/* a failed status is the request's fault, anything thrown on the way means the agent is gone */
+agent::Response Host::round_trip(agent::Request request) {
+	agent::Client &agent = connect();
+	try {
+		agent::Response response = agent.receive(agent.send(std::move(request)));
+		if (response.status != agent::Status::Ok) throw RequestError(response.error);
+		return response;
+	} catch (const RequestError &) {
+		throw;
+	} catch (...) {
+		client.reset();
+		index = OriginIndex();
+		throw;
+	}
+}
+
+void Host::dispatch(const nlohmann::json &request, nlohmann::json &response) {
+	const std::string &type = string_member(request, "type");
+	response["type"] = type;
+
+	if (type == "ping") {
+		connect();
+		response["type"] = "pong";
+		response["entries"] = index.size();
+	} else if (type == "refresh") {
+		client.reset();
+		connect();
+		response["entries"] = index.size();
+	} else if (type == "lookup") {
+		connect();
+		auto matches = nlohmann::json::array();
+		for (const auto *entry : index.lookup(string_member(request, "origin"))) {
+			matches.push_back({{"path", entry->path}});
+		}
+		response["matches"] = std::move(matches);
+	} else if (type == "fill") {
+		connect();
+		const auto matches = index.lookup(string_member(request, "origin"));
+
+		const IndexedEntry *entry = nullptr;
+		if (request.contains("path")) {
+			const std::string &path = string_member(request, "path");
+			auto it = std::find_if(matches.begin(), matches.end(),
+			    [&path](const IndexedEntry *match) { return match->path == path; });
+			if (it == matches.end()) throw RequestError("entry does not match the origin");
+			entry = *it;
+		} else if (matches.size() == 1) {
+			entry = matches.front();
+		} else {
+			throw RequestError(matches.empty() ? "no entry matches the origin"
+			                                   : "several entries match the origin");
+		}
+
+		agent::Request derive;
+		derive.type = agent::RequestType::Derive;
+		derive.dpath = entry->dpath;
+		agent::Response derived = round_trip(std::move(derive));
+
+		response["path"] = entry->path;
+		response["secret"] = std::string(derived.secret.c_str(), derived.secret.size());
+	} else {
+		throw RequestError("unknown request type: " + type);
+	}
+}
+
+utils::sensitive_string Host::handle(std::string_view message) {
+	nlohmann::json response = nlohmann::json::object();
+
+	try {
+		auto request = nlohmann::json::parse(message.begin(), message.end());
+		if (!request.is_object()) throw RequestError("request is not an object");
+		if (request.contains("id")) response["id"] = request["id"];
+
+		dispatch(request, response);
+	} catch (const std::exception &e) {
+		auto id = response.find("id");
+		nlohmann::json error = {{"type", "error"}, {"error", e.what()}};
+		if (id != response.end()) error["id"] = *id;
+		response = std::move(error);
+	}
+
+	std::string serialized = response.dump();
+	utils::sensitive_string rv(serialized.data(), serialized.size());
+
+	utils::secure_zero_string(std::move(serialized));
+	if (auto secret = response.find("secret"); secret != response.end()) {
+		utils::secure_zero_string(std::move(secret->get_ref<std::string &>()));
+	}
+	return rv;
+}
+
+} // namespace nmhost
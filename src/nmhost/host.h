@@ -0,0 +1,68 @@
+/*
+
+Copyright (C) 2019 Mateusz Morusiewicz
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#pragma once
+
+#include <src/agent/client.h>
+#include <src/nmhost/origin_index.h>
+
+#include <src/crypto/utils.h>
+
+#include <external/nlohmann/json_fwd.hpp>
+
+#include <filesystem>
+#include <memory>
+#include <string_view>
+
+namespace nmhost {
+
+/* Answers browser requests, one JSON object in and one out:
+ *
+ *   {"type": "ping"}                          -> {"type": "pong", "entries": n}
+ *   {"type": "lookup", "origin": o}           -> {"type": "lookup", "matches": [{"path": p}]}
+ *   {"type": "fill", "origin": o, "path": p?} -> {"type": "fill", "path": p, "secret": s}
+ *   {"type": "refresh"}                       -> {"type": "refresh", "entries": n}
+ *
+ * Failures come back as {"type": "error", "error": message} and an "id" member, if present, is
+ * echoed. Secrets are only handed out for entries matching the requesting origin; the path can be
+ * omitted when exactly one entry matches.
+ *
+ * The agent connection and the origin index are set up on first use and thrown away when the
+ * agent goes away, so the host outlives agent restarts. */
+class Host {
+	std::filesystem::path socket_path;
+	std::unique_ptr<agent::Client> client;
+	OriginIndex index;
+
+	agent::Client &connect();
+	agent::Response round_trip(agent::Request request);
+
+	void dispatch(const nlohmann::json &request, nlohmann::json &response);
+
+  public:
+	explicit Host(std::filesystem::path socket_path = agent::default_socket_path());
+	~Host();
+
+	/* never throws for bad input, the response is kept in locked memory as it may carry a secret */
+	utils::sensitive_string handle(std::string_view message);
+
+	const OriginIndex &origin_index() const { return index; }
+};
+
+} // namespace nmhost
@@ -0,0 +1,65 @@
+/*
+
+Copyright (C) 2019 Mateusz Morusiewicz
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#include <src/nmhost/host.h>
+#include <src/nmhost/messaging.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+
+#include <unistd.h>
+
+/* Started by the browser for the lifetime of the extension's native port. Talks to a running
+ * hdpwm-agent, so it never needs to ask for the encryption phrase itself.
+ *
+ * Setting HDPWM_NM_TRACE to a file records every request, one per line, for bench/nm_replay. */
+int main(int argc, const char *argv[]) {
+	/* browsers pass the caller's origin (and a window handle on Windows), nothing to configure */
+	(void)argc;
+	(void)argv;
+
+	std::ofstream trace;
+	if (const char *trace_path = std::getenv("HDPWM_NM_TRACE"); trace_path && *trace_path) {
+		trace.open(trace_path, std::ios::app);
+	}
+
+	nmhost::Host host;
+
+	try {
+		while (auto message = nmhost::read_message(STDIN_FILENO)) {
+			if (trace.is_open()) {
+				/* raw newlines can only be insignificant whitespace in JSON */
+				std::string line = *message;
+				std::replace(line.begin(), line.end(), '\n', ' ');
+				trace << line << std::endl;
+			}
+
+			auto response = host.handle(*message);
+			nmhost::write_message(STDOUT_FILENO, {response.c_str(), response.size()});
+		}
+	} catch (const std::exception &e) {
+		/* stderr ends up in the browser's log */
+		std::cerr << "hdpwm-nm-host: " << e.what() << std::endl;
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,86 @@
+/*
+
+Copyright (C) 2019 Mateusz Morusiewicz
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#include <src/nmhost/messaging.h>
+
+#include <src/crypto/utils.h>
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+#include <unistd.h>
+
+namespace nmhost {
+
+namespace {
+
+/* false if the stream ended before the first byte */
+bool read_exact(int fd, char *data, size_t size) {
+	size_t offset = 0;
+	while (offset < size) {
+		ssize_t n = read(fd, data + offset, size - offset);
+		if (n < 0 && errno == EINTR) continue;
+		if (n < 0) throw std::runtime_error(std::string("read failed: ") + std::strerror(errno));
+		if (n == 0) {
+			if (offset == 0) return false;
+			throw std::runtime_error("truncated message");
+		}
+		offset += n;
+	}
+	return true;
+}
+
+void write_exact(int fd, const char *data, size_t size) {
+	size_t offset = 0;
+	while (offset < size) {
+		ssize_t n = write(fd, data + offset, size - offset);
+		if (n < 0 && errno == EINTR) continue;
+		if (n < 0) throw std::runtime_error(std::string("write failed: ") + std::strerror(errno));
+		offset += n;
+	}
+}
+
+} // namespace
+
+std::optional<std::string> read_message(int fd) {
+	uint32_t size;
+	if (!read_exact(fd, reinterpret_cast<char *>(&size), sizeof(size))) return std::nullopt;
+	if (size > MAX_MESSAGE_SIZE) throw std::runtime_error("message too large");
+
+	std::string message(size, '\0');
+	if (size > 0 && !read_exact(fd, message.data(), size)) {
+		throw std::runtime_error("truncated message");
+	}
+	return message;
+}
+
+void write_message(int fd, std::string_view message) {
+	if (message.size() > MAX_MESSAGE_SIZE) throw std::runtime_error("message too large");
+
+	/* one write for small messages, so that the browser never sees a lone header */
+	const uint32_t size = message.size();
+	std::string frame(sizeof(size) + message.size(), '\0');
+	std::memcpy(frame.data(), &size, sizeof(size));
+	std::memcpy(frame.data() + sizeof(size), message.data(), message.size());
+	write_exact(fd, frame.data(), frame.size());
+	utils::secure_zero(frame.data(), frame.size());
+}
+
+} // namespace nmhost
@@ -0,0 +1,39 @@
+/*
+
+Copyright (C) 2019 Mateusz Morusiewicz
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+
+/* Native messaging framing used by browsers: a u32 length in native byte order followed by that
+ * many bytes of UTF-8 JSON */
+namespace nmhost {
+
+/* browsers refuse larger messages from the host, requests are capped the same way */
+constexpr uint32_t MAX_MESSAGE_SIZE = 1024 * 1024;
+
+/* blocks for a whole message, nullopt on a clean end of stream; throws std::runtime_error on
+ * truncated or oversized messages */
+std::optional<std::string> read_message(int fd);
+void write_message(int fd, std::string_view message);
+
+} // namespace nmhost
@@ -0,0 +1,116 @@
+/*
+
+Copyright (C) 2019 Mateusz Morusiewicz
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#include <src/nmhost/origin_index.h>
+
+#include <algorithm>
+#include <cctype>
+
+namespace nmhost {
+
+namespace {
+
+bool is_host_char(char c) {
+	return (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') || c == '-' || c == '.';
+}
+
+/* whitespace separated words of a free text field, stripped of surrounding punctuation */
+std::vector<std::string_view> words(std::string_view text) {
+	std::vector<std::string_view> rv;
+	size_t i = 0;
+	while (i < text.size()) {
+		while (i < text.size() && std::isspace(static_cast<unsigned char>(text[i]))) ++i;
+		size_t j = i;
+		while (j < text.size() && !std::isspace(static_cast<unsigned char>(text[j]))) ++j;
+
+		auto word = text.substr(i, j - i);
+		while (!word.empty() && std::string_view("(<\"'").find(word.front()) != word.npos) {
+			word.remove_prefix(1);
+		}
+		while (!word.empty() && std::string_view(")>\"',;").find(word.back()) != word.npos) {
+			word.remove_suffix(1);
+		}
+		if (!word.empty()) rv.push_back(word);
+		i = j;
+	}
+	return rv;
+}
+
+} // namespace
+
+std::optional<std::string> normalize_host(std::string_view origin) {
+	if (auto scheme = origin.find("://"); scheme != origin.npos) origin.remove_prefix(scheme + 3);
+	origin = origin.substr(0, origin.find_first_of("/?#"));
+	if (auto at = origin.rfind('@'); at != origin.npos) origin.remove_prefix(at + 1);
+	origin = origin.substr(0, origin.find(':'));
+	while (!origin.empty() && origin.back() == '.') origin.remove_suffix(1);
+
+	std::string host(origin);
+	std::transform(host.begin(), host.end(), host.begin(),
+	    [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+
+	if (host.rfind("www.", 0) == 0) host.erase(0, 4);
+	if (host.empty() || host.front() == '.' || host.find('.') == host.npos) return std::nullopt;
+	if (host.find("..") != host.npos) return std::nullopt;
+	if (!std::all_of(host.begin(), host.end(), is_host_char)) return std::nullopt;
+
+	return host;
+}
+
+OriginIndex::OriginIndex(const std::vector<agent::EntryInfo> &infos) {
+	entries.reserve(infos.size());
+	for (const auto &info : infos) {
+		const size_t index = entries.size();
+		entries.push_back({info.path, info.dpath});
+
+		const std::string_view path(info.path);
+		const std::string_view name = path.substr(path.rfind('/') + 1);
+
+		auto add = [this, index](std::string_view word) {
+			auto host = normalize_host(word);
+			if (!host) return;
+
+			auto &indices = by_host[*host];
+			if (indices.empty() || indices.back() != index) indices.push_back(index);
+		};
+
+		for (auto word : words(name)) add(word);
+		for (auto word : words(info.details)) add(word);
+	}
+}
+
+std::vector<const IndexedEntry *> OriginIndex::lookup(std::string_view origin) const {
+	std::vector<const IndexedEntry *> rv;
+
+	auto host = normalize_host(origin);
+	if (!host) return rv;
+
+	std::string_view candidate(*host);
+	while (candidate.find('.') != candidate.npos) {
+		if (auto it = by_host.find(std::string(candidate)); it != by_host.end()) {
+			for (size_t index : it->second) rv.push_back(&entries[index]);
+			return rv;
+		}
+		candidate.remove_prefix(candidate.find('.') + 1);
+	}
+
+	return rv;
+}
+
+} // namespace nmhost
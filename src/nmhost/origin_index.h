@@ -0,0 +1,60 @@
+/*
+
+Copyright (C) 2019 Mateusz Morusiewicz
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#pragma once
+
+#include <src/agent/protocol.h>
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace nmhost {
+
+/* Lower-cased host name of an origin, URL or bare domain with the scheme, credentials, port, path
+ * and a leading "www." stripped. Anything that doesn't look like a dotted host name is rejected. */
+std::optional<std::string> normalize_host(std::string_view origin);
+
+struct IndexedEntry {
+	std::string path;
+	uint32_t dpath;
+};
+
+/* Maps host names mentioned in entry names and details to the entries. Built once from the
+ * agent's entry listing, so that autofill lookups are a couple of hash probes. */
+class OriginIndex {
+	std::vector<IndexedEntry> entries;
+	std::unordered_map<std::string, std::vector<size_t>> by_host;
+
+  public:
+	OriginIndex() = default;
+	explicit OriginIndex(const std::vector<agent::EntryInfo> &infos);
+
+	size_t size() const { return entries.size(); }
+	size_t hosts() const { return by_host.size(); }
+
+	/* entries for the host of origin, falling back to its parent domains (login.example.com
+	 * matches example.com entries) */
+	std::vector<const IndexedEntry *> lookup(std::string_view origin) const;
+};
+
+} // namespace nmhost
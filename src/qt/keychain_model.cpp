@@ -0,0 +1,122 @@
+/*
+
+Copyright (C) 2019 Mateusz Morusiewicz
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+
+#include <src/qt/keychain_model.h>
+
+#include <algorithm>
+
+KeychainModel::KeychainModel(QObject *parent) : QAbstractItemModel(parent) {}
+
+void KeychainModel::set_root(keychain::Directory::ptr root_dir) {
+	beginResetModel();
+	root.reset();
+	if (root_dir) root.reset(new Node{nullptr, 0, std::move(root_dir), {}});
+	endResetModel();
+}
+
+KeychainModel::Node *KeychainModel::node_of(const QModelIndex &index) const {
+	return index.isValid() ? static_cast<Node *>(index.internalPointer()) : root.get();
+}
+
+/* directories first, then entries, as in the TUI */
+int KeychainModel::total_children(const Node &node) {
+	auto dir = std::get_if<keychain::Directory::ptr>(&node.item);
+	return dir ? (*dir)->dirs.size() + (*dir)->entries.size() : 0;
+}
+
+std::optional<crypto::DerivationPath> KeychainModel::dpath(const QModelIndex &index) const {
+	const Node *node = index.isValid() ? node_of(index) : nullptr;
+	if (!node) return std::nullopt;
+	if (auto entry = std::get_if<keychain::Entry::ptr>(&node->item)) return (*entry)->meta.dpath;
+	return std::nullopt;
+}
+
+QModelIndex KeychainModel::index(int row, int column, const QModelIndex &parent) const {
+	const Node *node = node_of(parent);
+	if (!node || row < 0 || row >= static_cast<int>(node->children.size()) || column < 0 ||
+	    column >= N_COLUMNS) {
+		return {};
+	}
+	return createIndex(row, column, node->children[row].get());
+}
+
+QModelIndex KeychainModel::parent(const QModelIndex &index) const {
+	const Node *node = index.isValid() ? node_of(index) : nullptr;
+	if (!node || node->parent == root.get()) return {};
+	return createIndex(node->parent->row, 0, node->parent);
+}
+
+int KeychainModel::rowCount(const QModelIndex &parent) const {
+	if (parent.column() > 0) return 0;
+	const Node *node = node_of(parent);
+	return node ? node->children.size() : 0;
+}
+
+int KeychainModel::columnCount(const QModelIndex &) const { return N_COLUMNS; }
+
+bool KeychainModel::hasChildren(const QModelIndex &parent) const {
+	if (parent.column() > 0) return false;
+	const Node *node = node_of(parent);
+	return node && total_children(*node) > 0;
+}
+
+QVariant KeychainModel::data(const QModelIndex &index, int role) const {
+	if (!index.isValid() || role != Qt::DisplayRole) return {};
+
+	const auto &meta = std::visit(
+	    [](const auto &item) -> std::pair<const std::string &, const std::string &> {
+		    return {item->meta.name, item->meta.details};
+	    },
+	    node_of(index)->item);
+	return QString::fromStdString(index.column() == Name ? meta.first : meta.second);
+}
+
+QVariant KeychainModel::headerData(int section, Qt::Orientation orientation, int role) const {
+	if (orientation != Qt::Horizontal || role != Qt::DisplayRole) return {};
+	return section == Name ? tr("Name") : tr("Details");
+}
+
+bool KeychainModel::canFetchMore(const QModelIndex &parent) const {
+	const Node *node = node_of(parent);
+	return node && static_cast<int>(node->children.size()) < total_children(*node);
+}
+
+void KeychainModel::fetchMore(const QModelIndex &parent) {
+	Node *node = node_of(parent);
+	if (!node) return;
+
+	const auto &dir = std::get<keychain::Directory::ptr>(node->item);
+	const int first = node->children.size();
+	const int last = std::min(first + FETCH_BATCH, total_children(*node)) - 1;
+	if (last < first) return;
+
+	beginInsertRows(parent, first, last);
+	const int n_dirs = dir->dirs.size();
+	for (int row = first; row <= last; ++row) {
+		keychain::AnyKeychainPtr item;
+		if (row < n_dirs) {
+			item = dir->dirs[row];
+		} else {
+			item = dir->entries[row - n_dirs];
+		}
+		node->children.push_back(std::unique_ptr<Node>(new Node{node, row, std::move(item), {}}));
+	}
+	endInsertRows();
+}
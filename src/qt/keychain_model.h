@@ -0,0 +1,73 @@
+/*
+
+Copyright (C) 2019 Mateusz Morusiewicz
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+
+#pragma once
+
+#include <src/keychain/keychain_entry.h>
+
+#include <QAbstractItemModel>
+
+#include <memory>
+#include <optional>
+#include <vector>
+
+/* The keychain tree as a two-column (name, details) item model. Rows are created lazily, at most
+ * FETCH_BATCH at a time as the view scrolls to them, so a directory of a million entries costs a
+ * screenful of rows until someone scrolls through it. The tree has to be a published snapshot,
+ * nothing may change it under the model; set_root() swaps in a new one. */
+class KeychainModel : public QAbstractItemModel {
+	Q_OBJECT
+
+	struct Node {
+		Node *parent;
+		int row;
+		keychain::AnyKeychainPtr item;
+		std::vector<std::unique_ptr<Node>> children; // the first rows, as far as fetched
+	};
+
+	std::unique_ptr<Node> root;
+
+	Node *node_of(const QModelIndex &index) const;
+	static int total_children(const Node &node);
+
+  public:
+	static constexpr int FETCH_BATCH = 1024;
+
+	enum Column { Name, Details, N_COLUMNS };
+
+	explicit KeychainModel(QObject *parent = nullptr);
+
+	void set_root(keychain::Directory::ptr root_dir);
+
+	/* nullopt for directories */
+	std::optional<crypto::DerivationPath> dpath(const QModelIndex &index) const;
+
+	QModelIndex index(int row, int column, const QModelIndex &parent = {}) const override;
+	QModelIndex parent(const QModelIndex &index) const override;
+	int rowCount(const QModelIndex &parent = {}) const override;
+	int columnCount(const QModelIndex &parent = {}) const override;
+	bool hasChildren(const QModelIndex &parent = {}) const override;
+	QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+	QVariant headerData(
+	    int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
+
+	bool canFetchMore(const QModelIndex &parent) const override;
+	void fetchMore(const QModelIndex &parent) override;
+};
@@ -0,0 +1,84 @@
+/*
+
+Copyright (C) 2019 Mateusz Morusiewicz
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+
+#include <src/qt/keychain_session.h>
+
+#include <src/crypto/crypto.h>
+#include <src/utils/thread_pool.h>
+
+#include <QMetaObject>
+
+#include <exception>
+
+KeychainSession::KeychainSession(QObject *parent) :
+    QObject(parent), mailbox(std::make_shared<Mailbox>()) {
+	mailbox->session = this;
+}
+
+KeychainSession::~KeychainSession() {
+	/* work still running finishes, its results are dropped */
+	std::unique_lock<std::mutex> lk(mailbox->mutex);
+	mailbox->session = nullptr;
+}
+
+template <typename Work, typename Done> void KeychainSession::run(Work work, Done done) {
+	utils::default_pool().submit([mailbox = mailbox, work, done]() {
+		std::function<void(KeychainSession *)> report;
+		try {
+			auto result = std::make_shared<decltype(work())>(work());
+			report = [done, result](KeychainSession *session) {
+				done(session, std::move(*result));
+			};
+		} catch (const std::exception &e) {
+			const QString message = QString::fromUtf8(e.what());
+			report = [message](KeychainSession *session) { emit session->failed(message); };
+		}
+
+		/* posting is thread-safe, events of a deleted object are never delivered */
+		std::unique_lock<std::mutex> lk(mailbox->mutex);
+		if (!mailbox->session) return;
+		KeychainSession *session = mailbox->session;
+		QMetaObject::invokeMethod(
+		    session, [session, report]() { report(session); }, Qt::QueuedConnection);
+	});
+}
+
+void KeychainSession::unlock(std::filesystem::path path, utils::sensitive_string password) {
+	run(
+	    [path, password]() {
+		    std::shared_ptr<keychain::Keychain> opened =
+		        keychain::Keychain::open(path, crypto::hash_password(password));
+		    /* decrypting and parsing the tree is slow as well */
+		    opened->snapshot();
+		    return opened;
+	    },
+	    [](KeychainSession *session, std::shared_ptr<keychain::Keychain> opened) {
+		    session->kc = std::move(opened);
+		    emit session->unlocked();
+	    });
+}
+
+void KeychainSession::derive(crypto::DerivationPath dpath) {
+	if (!kc) return;
+	run([kc = kc, dpath]() { return kc->derive_secret(dpath); },
+	    [dpath](KeychainSession *session, utils::sensitive_string secret) {
+		    emit session->derived(dpath, QString::fromUtf8(secret.c_str(), secret.size()));
+	    });
+}
@@ -0,0 +1,67 @@
+/*
+
+Copyright (C) 2019 Mateusz Morusiewicz
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+
+#pragma once
+
+#include <src/keychain/keychain.h>
+
+#include <src/crypto/utils.h>
+
+#include <QObject>
+#include <QString>
+
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <mutex>
+
+/* Runs the keychain's slow operations (unlocking, deriving) on utils::default_pool() and
+ * reports back with signals on the GUI thread, which never waits for them. */
+class KeychainSession : public QObject {
+	Q_OBJECT
+
+	/* how workers get back to the session, which may be gone by the time they are done */
+	struct Mailbox {
+		std::mutex mutex;
+		KeychainSession *session;
+	};
+	std::shared_ptr<Mailbox> mailbox;
+
+	std::shared_ptr<keychain::Keychain> kc;
+
+	/* runs work on the pool and then done (or failed) on the GUI thread with its result */
+	template <typename Work, typename Done> void run(Work work, Done done);
+
+  public:
+	explicit KeychainSession(QObject *parent = nullptr);
+	~KeychainSession();
+
+	/* the encryption phrase is hashed on the pool as well */
+	void unlock(std::filesystem::path path, utils::sensitive_string password);
+	void derive(crypto::DerivationPath dpath);
+
+	/* null until unlocked */
+	std::shared_ptr<keychain::Keychain> keychain() const { return kc; }
+
+  signals:
+	void unlocked();
+	void derived(crypto::DerivationPath dpath, QString secret);
+	void failed(QString message);
+};
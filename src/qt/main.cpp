@@ -1,11 +1,22 @@
 #include "mainwindow.h"
 
+#include <src/keychain/utils.h>
+
 #include <QApplication>
+#include <QCommandLineParser>
 
 int main(int argc, char *argv[])
 {
     QApplication a(argc, argv);
-    MainWindow w;
+
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    QCommandLineOption path_option(
+        {"p", "path"}, "path to keychain data directory", "path", "~/.hdpwm");
+    parser.addOption(path_option);
+    parser.process(a);
+
+    MainWindow w(keychain::expand_path(parser.value(path_option).toStdString()));
     w.show();
     return a.exec();
 }
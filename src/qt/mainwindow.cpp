@@ -1,21 +1,122 @@
 #include "mainwindow.h"
 #include "./ui_mainwindow.h"
 
-MainWindow::MainWindow(QWidget *parent)
+#include <src/qt/keychain_model.h>
+#include <src/qt/keychain_session.h>
+
+#include <QInputDialog>
+#include <QLineEdit>
+#include <QMessageBox>
+#include <QStatusBar>
+#include <QTimer>
+#include <QToolButton>
+
+namespace {
+
+/* derived secrets are cleared from the status bar after this long */
+constexpr int SECRET_TIMEOUT_MS = 30000;
+
+}
+
+MainWindow::MainWindow(std::filesystem::path kc_path, QWidget *parent)
     : QMainWindow(parent)
     , ui(new Ui::MainWindow)
+    , model(new KeychainModel(this))
+    , session(new KeychainSession(this))
+    , kc_path(std::move(kc_path))
+    , secret_field(new QLineEdit(this))
+    , reveal_button(new QToolButton(this))
+    , secret_timer(new QTimer(this))
 {
     ui->setupUi(this);
+
+    secret_field->setReadOnly(true);
+    secret_field->setEchoMode(QLineEdit::Password);
+    reveal_button->setText(tr("Show"));
+    reveal_button->setCheckable(true);
+    secret_timer->setSingleShot(true);
+    statusBar()->addPermanentWidget(secret_field);
+    statusBar()->addPermanentWidget(reveal_button);
+    clear_secret();
+
+    connect(reveal_button, &QToolButton::toggled, this, [this](bool revealed) {
+        secret_field->setEchoMode(revealed ? QLineEdit::Normal : QLineEdit::Password);
+    });
+    connect(secret_timer, &QTimer::timeout, this, &MainWindow::clear_secret);
+
+    /* lets the view lay out only the rows it shows, whatever the size of the keychain */
+    ui->treeView->setUniformRowHeights(true);
+    ui->treeView->setModel(model);
+
+    connect(session, &KeychainSession::unlocked, this, [this]() {
+        model->set_root(session->keychain()->snapshot()->root);
+        statusBar()->showMessage(
+            tr("Unlocked %1").arg(QString::fromStdString(this->kc_path.string())));
+    });
+    connect(session, &KeychainSession::derived, this,
+        [this](crypto::DerivationPath, QString secret) {
+            statusBar()->clearMessage();
+            show_secret(secret);
+        });
+    connect(session, &KeychainSession::failed, this, [this](QString message) {
+        statusBar()->clearMessage();
+        clear_secret();
+        QMessageBox::warning(this, windowTitle(), message);
+        if (!session->keychain()) ask_password();
+    });
+
+    /* once the window is up */
+    QTimer::singleShot(0, this, &MainWindow::ask_password);
 }
 
 MainWindow::~MainWindow()
 {
+    clear_secret();
     delete ui;
 }
 
+void MainWindow::show_secret(const QString &secret)
+{
+    reveal_button->setChecked(false);
+    secret_field->setText(secret);
+    secret_field->show();
+    reveal_button->show();
+    secret_timer->start(SECRET_TIMEOUT_MS);
+}
 
-void MainWindow::on_treeView_clicked(const QModelIndex &index)
+void MainWindow::clear_secret()
+{
+    secret_timer->stop();
+    secret_field->clear();
+    reveal_button->setChecked(false);
+    secret_field->hide();
+    reveal_button->hide();
+}
+
+void MainWindow::ask_password()
 {
+    bool ok = false;
+    QString password = QInputDialog::getText(this, tr("Unlock"),
+        tr("Encryption phrase for %1:").arg(QString::fromStdString(kc_path.string())),
+        QLineEdit::Password, QString(), &ok);
+    if (!ok) {
+        close();
+        return;
+    }
+
+    QByteArray utf8 = password.toUtf8();
+    session->unlock(kc_path, utils::sensitive_string(utf8.constData(), utf8.size()));
+    utf8.fill('\0');
+    password.fill(QChar(0));
 
+    statusBar()->showMessage(tr("Unlocking..."));
 }
 
+void MainWindow::on_treeView_clicked(const QModelIndex &index)
+{
+    if (auto dpath = model->dpath(index)) {
+        clear_secret();
+        session->derive(*dpath);
+        statusBar()->showMessage(tr("Deriving..."));
+    }
+}
@@ -3,6 +3,14 @@
 
 #include <QMainWindow>
 
+#include <filesystem>
+
+class KeychainModel;
+class KeychainSession;
+class QLineEdit;
+class QTimer;
+class QToolButton;
+
 QT_BEGIN_NAMESPACE
 namespace Ui { class MainWindow; }
 QT_END_NAMESPACE
@@ -12,7 +20,7 @@ class MainWindow : public QMainWindow
     Q_OBJECT
 
 public:
-    MainWindow(QWidget *parent = nullptr);
+    MainWindow(std::filesystem::path kc_path, QWidget *parent = nullptr);
     ~MainWindow();
 
 private slots:
@@ -20,5 +28,17 @@ private slots:
 
 private:
     Ui::MainWindow *ui;
+    KeychainModel *model;
+    KeychainSession *session;
+    std::filesystem::path kc_path;
+
+    /* the last derived secret, masked unless reveal_button is down */
+    QLineEdit *secret_field;
+    QToolButton *reveal_button;
+    QTimer *secret_timer;
+
+    void ask_password();
+    void show_secret(const QString &secret);
+    void clear_secret();
 };
 #endif // MAINWINDOW_H
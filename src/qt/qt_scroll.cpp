@@ -0,0 +1,101 @@
+/*
+
+Copyright (C) 2019 Mateusz Morusiewicz
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+
+#include <src/qt/keychain_model.h>
+
+#include <src/keychain/synthetic.h>
+
+#include <bench/percentile.h>
+
+#include <QApplication>
+#include <QCommandLineParser>
+#include <QScrollBar>
+#include <QTreeView>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+/* Scrolls a tree view through a synthetic keychain, a fixed number of rows per frame, and reports
+ * how long the frames took. Fails if the 99th percentile misses 60 fps. Runs with the offscreen
+ * platform plugin unless QT_QPA_PLATFORM says otherwise. */
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr double FRAME_BUDGET_MS = 1000.0 / 60;
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+	if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM")) qputenv("QT_QPA_PLATFORM", "offscreen");
+	QApplication app(argc, argv);
+
+	QCommandLineParser parser;
+	parser.addHelpOption();
+	QCommandLineOption entries_option({"e", "entries"}, "entries in the keychain", "n", "1000000");
+	QCommandLineOption frames_option({"f", "frames"}, "frames to scroll for", "n", "2000");
+	QCommandLineOption rows_option({"r", "rows-per-frame"}, "rows scrolled per frame", "n", "500");
+	parser.addOption(entries_option);
+	parser.addOption(frames_option);
+	parser.addOption(rows_option);
+	parser.process(app);
+
+	/* all entries in one directory, the worst case for a view */
+	keychain::KeychainShape shape;
+	shape.n_entries = parser.value(entries_option).toULongLong();
+	shape.depth = 0;
+
+	KeychainModel model;
+	model.set_root(keychain::generate_tree(shape));
+
+	QTreeView view;
+	view.setUniformRowHeights(true);
+	view.setVerticalScrollMode(QAbstractItemView::ScrollPerItem);
+	view.setModel(&model);
+	view.resize(800, 600);
+	view.show();
+	app.processEvents();
+
+	QScrollBar *scroll_bar = view.verticalScrollBar();
+	const int frames = parser.value(frames_option).toInt();
+	const int rows_per_frame = parser.value(rows_option).toInt();
+	std::vector<double> frame_ms;
+	frame_ms.reserve(frames);
+
+	for (int frame = 0; frame < frames; ++frame) {
+		const auto start = Clock::now();
+		/* the view fetches more rows whenever the scroll bar hits the bottom */
+		scroll_bar->setValue(scroll_bar->value() + rows_per_frame);
+		view.viewport()->repaint();
+		app.processEvents();
+		frame_ms.push_back(std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+	}
+
+	std::sort(frame_ms.begin(), frame_ms.end());
+	const double p99 = bench::percentile(frame_ms, 0.99);
+	std::printf("%d frames, %d of %zu rows fetched, p50 %.2fms, p99 %.2fms, max %.2fms\n", frames,
+	    model.rowCount(), shape.n_entries, bench::percentile(frame_ms, 0.50), p99,
+	    frame_ms.empty() ? 0 : frame_ms.back());
+
+	return p99 <= FRAME_BUDGET_MS ? 0 : 1;
+}
@@ -0,0 +1,112 @@
+/*
+
+Copyright (C) 2019 Mateusz Morusiewicz
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+
+#include <src/tui/debug_screen.h>
+
+#include <src/utils/memory.h>
+#include <src/utils/trace.h>
+
+#include <curses.h>
+
+#include <cstdio>
+#include <exception>
+#include <iterator>
+#include <string>
+
+namespace {
+
+double to_ms(std::chrono::nanoseconds ns) { return ns.count() / 1e6; }
+
+std::string human_bytes(size_t bytes) {
+	constexpr const char *UNITS[] = {"B", "KiB", "MiB", "GiB"};
+	double value = bytes;
+	size_t unit = 0;
+	for (; value >= 1024 && unit + 1 < std::size(UNITS); ++unit) {
+		value /= 1024;
+	}
+
+	char rv[32];
+	std::snprintf(rv, sizeof(rv), unit ? "%.1f %s" : "%.0f %s", value, UNITS[unit]);
+	return rv;
+}
+
+} // namespace
+
+DebugScreen::DebugScreen(WindowManager *wmanager) : ScreenController(wmanager) {}
+
+void DebugScreen::m_draw() {
+	curs_set(0);
+	erase();
+	mvaddstr(0, 0, "Background tasks");
+
+	char line[256];
+	std::snprintf(line, sizeof(line), "%-24s %4s %-11s %7s %9s %9s %11s %9s", "task", "prio",
+	    "state", "steps", "cpu ms", "wall ms", "longest ms", "preempted");
+	mvaddstr(2, 2, line);
+
+	int row = 3;
+	for (const auto &stats : wmanager->idle().stats()) {
+		if (row >= LINES - 2) break;
+		std::snprintf(line, sizeof(line), "%-24.24s %4d %-11s %7llu %9.2f %9.2f %11.3f %9llu",
+		    stats.name.c_str(), stats.priority, to_string(stats.state),
+		    static_cast<unsigned long long>(stats.steps), to_ms(stats.cpu_time),
+		    to_ms(stats.wall_time), to_ms(stats.longest_step),
+		    static_cast<unsigned long long>(stats.preempted));
+		mvaddstr(row++, 2, line);
+		if (!stats.error.empty() && row < LINES - 2) mvaddstr(row++, 4, stats.error.c_str());
+	}
+
+	/* memory goes below the tasks as long as it fits, it's the lower priority of the two */
+	if (row + 4 + static_cast<int>(utils::memory::N_CATEGORIES) < LINES - 2) {
+		mvaddstr(++row, 0, "Memory");
+		++row;
+		std::snprintf(line, sizeof(line), "%-24s %12s %12s", "category", "current", "peak");
+		mvaddstr(++row, 2, line);
+		auto add_usage_line = [&](const char *name, utils::memory::Usage usage) {
+			std::snprintf(line, sizeof(line), "%-24s %12s %12s", name,
+			    human_bytes(usage.current).c_str(), human_bytes(usage.peak).c_str());
+			mvaddstr(++row, 2, line);
+		};
+		for (auto category : utils::memory::CATEGORIES) {
+			add_usage_line(utils::memory::to_string(category), utils::memory::usage(category));
+		}
+		add_usage_line("process_rss", utils::memory::process_rss());
+	}
+
+	if (!trace_status.empty()) mvaddstr(LINES - 2, 2, trace_status.c_str());
+	mvaddstr(LINES - 1, 2,
+	    utils::trace::output().empty()
+	        ? "<r> to refresh, any other key to go back."
+	        : "<r> to refresh, <t> to write the trace, any other key to go back.");
+	refresh();
+}
+
+void DebugScreen::m_on_key(int key) {
+	if (key == 't' && !utils::trace::output().empty()) {
+		try {
+			utils::trace::dump();
+			trace_status = "Trace written to " + utils::trace::output().string();
+		} catch (const std::exception &e) {
+			trace_status = e.what();
+		}
+		return;
+	}
+	if (key != 'r') wmanager->pop_controller();
+}
@@ -0,0 +1,37 @@
+/*
+
+Copyright (C) 2019 Mateusz Morusiewicz
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+
+#pragma once
+
+#include <src/tui/screen_controller.h>
+
+#include <string>
+
+/* Timing counters of the idle tasks and memory held per category, <F12> from any screen. The
+ * trace started with --trace can be written from here as well. */
+class DebugScreen : public ScreenController {
+	std::string trace_status;
+
+	void m_draw() override;
+	void m_on_key(int key) override;
+
+  public:
+	explicit DebugScreen(WindowManager *wmanager);
+};
@@ -23,6 +23,8 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include <src/tui/screen_controller.h>
 #include <src/tui/utils.h>
 
+#include <string>
+
 class ErrorScreen : public ScreenController {
 	Point origin;
 	std::string msg;
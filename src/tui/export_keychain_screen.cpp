@@ -24,6 +24,7 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include <src/tui/input.h>
 #include <src/tui/menu.h>
 #include <src/tui/open_keychain_screen.h>
+#include <src/tui/operation_screen.h>
 
 #include <src/keychain/utils.h>
 
@@ -45,13 +46,24 @@ ExportKeychainScreen::ExportKeychainScreen(
 	result->kc = std::move(kc);
 
 	FormController::on_done = [this, result]() {
-		try {
-			result->kc->export_to_uri(result->uri_locator);
-			this->wmanager->pop_controller();
-		} catch (const std::exception &e) {
-			this->wmanager->set_controller(
-			    std::make_shared<ErrorScreen>(this->wmanager, Point{2, 5}, e.what()));
-		}
+		auto start = [result](utils::OperationOptions options) {
+			return result->kc->export_to_uri_async(result->uri_locator, std::move(options));
+		};
+
+		/* keeps the keychain alive until the export is done */
+		auto wmanager = this->wmanager;
+		auto on_finished = [wmanager, result](std::future<void> &future) {
+			try {
+				future.get();
+				wmanager->pop_controller();
+			} catch (const std::exception &e) {
+				wmanager->set_controller(
+				    std::make_shared<ErrorScreen>(wmanager, Point{2, 5}, e.what()));
+			}
+		};
+
+		this->wmanager->set_controller(std::make_shared<OperationScreen>(this->wmanager,
+		    "Exporting keychain " + result->kc->get_data_dir_path(), start, on_finished));
 	};
 
 	FormController::on_cancel = [this]() { this->wmanager->pop_controller(); };
@@ -42,7 +42,8 @@ void FormController::m_cleanup() {
 
 void FormController::m_draw() {
 	curs_set(2);
-	wclear(window);
+	/* not wclear, which would have the whole terminal repainted on every key */
+	werase(window);
 
 	if (parent) parent->draw();
 
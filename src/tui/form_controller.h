@@ -53,6 +53,8 @@ class FormController : public ScreenController {
 
 	void m_draw() override;
 	void m_on_key(int key) override;
+	/* whatever is typed into a field may be a secret, e.g. notes or a phrase */
+	bool m_takes_secrets() const override { return current_input < fields.size(); }
 
 	void advance_form();
 
@@ -0,0 +1,144 @@
+/*
+
+Copyright (C) 2019 Mateusz Morusiewicz
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+
+#include <src/tui/headless.h>
+
+#include <src/tui/screen_controller.h>
+
+#include <curses.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstdlib>
+#include <stdexcept>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+} // namespace
+
+HeadlessTerminal::HeadlessTerminal(int lines, int cols) {
+	if (pipe(key_pipe) != 0) throw std::runtime_error("could not create the key pipe");
+	input = fdopen(key_pipe[0], "r");
+	output = std::tmpfile();
+	if (!input || !output) throw std::runtime_error("could not open the headless terminal");
+
+	wm = std::make_unique<WindowManager>(input, output, TERM);
+	/* keys are written whole, there is no need to wait for the rest of an escape sequence */
+	set_escdelay(0);
+	resizeterm(lines, cols);
+}
+
+HeadlessTerminal::~HeadlessTerminal() {
+	wm.reset();
+	if (output) std::fclose(output);
+	if (input) std::fclose(input);
+	close(key_pipe[1]);
+}
+
+void HeadlessTerminal::start(std::shared_ptr<ScreenController> initial_screen) {
+	wm->start(std::move(initial_screen));
+	running = true;
+}
+
+void HeadlessTerminal::press(int key) {
+	if (key >= 0 && key < KEY_MIN) {
+		const char byte = key;
+		return type({&byte, 1});
+	}
+
+	char *sequence = keybound(key, 0);
+	if (!sequence) throw std::runtime_error(TERM + std::string(" has no sequence for ") +
+	                                        keyname(key));
+	type(sequence);
+	std::free(sequence);
+}
+
+void HeadlessTerminal::type(std::string_view text) {
+	if (write(key_pipe[1], text.data(), text.size()) != static_cast<ssize_t>(text.size())) {
+		throw std::runtime_error("could not write to the key pipe");
+	}
+}
+
+bool HeadlessTerminal::settle(std::chrono::milliseconds quiet, std::chrono::milliseconds timeout) {
+	const auto deadline = Clock::now() + timeout;
+	do {
+		if (!running) return false;
+		running = wm->step(quiet.count());
+	} while (running && wm->busy() && Clock::now() < deadline);
+
+	recycle_output();
+	return running;
+}
+
+bool HeadlessTerminal::wait_for(std::string_view text, std::chrono::milliseconds timeout) {
+	constexpr std::chrono::milliseconds POLL_INTERVAL(10);
+
+	const auto deadline = Clock::now() + timeout;
+	while (!shows(text)) {
+		if (!running || Clock::now() > deadline) return false;
+		running = wm->step(POLL_INTERVAL.count());
+	}
+	return true;
+}
+
+std::vector<std::string> HeadlessTerminal::screen() const {
+	/* curscr's cursor is where curses believes the terminal's is, it has to stay there */
+	int cursor_y, cursor_x;
+	getyx(curscr, cursor_y, cursor_x);
+
+	std::vector<std::string> rv;
+	std::vector<char> line(COLS + 1);
+	for (int y = 0; y < LINES; ++y) {
+		const int n = mvwinnstr(curscr, y, 0, line.data(), COLS);
+		rv.emplace_back(line.data(), n > 0 ? n : 0);
+	}
+
+	wmove(curscr, cursor_y, cursor_x);
+	return rv;
+}
+
+bool HeadlessTerminal::shows(std::string_view text) const {
+	for (const auto &line : screen()) {
+		if (line.find(text) != std::string::npos) return true;
+	}
+	return false;
+}
+
+/* only the size of the output matters, long sessions shouldn't fill the disk */
+void HeadlessTerminal::recycle_output() {
+	constexpr off_t MAX_OUTPUT_SIZE = 1 << 20;
+
+	std::fflush(output);
+	struct stat st;
+	if (fstat(fileno(output), &st) != 0 || st.st_size < MAX_OUTPUT_SIZE) return;
+
+	flushed_bytes += st.st_size;
+	if (ftruncate(fileno(output), 0) != 0) throw std::runtime_error("could not truncate output");
+	std::rewind(output);
+}
+
+uint64_t HeadlessTerminal::bytes_written() const {
+	std::fflush(output);
+	struct stat st;
+	if (fstat(fileno(output), &st) != 0) return flushed_bytes;
+	return flushed_bytes + st.st_size;
+}
@@ -0,0 +1,79 @@
+/*
+
+Copyright (C) 2019 Mateusz Morusiewicz
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+
+#pragma once
+
+#include <src/tui/manager.h>
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/* A WindowManager on a terminal that only exists in memory: keys go in through a pipe, what
+ * curses writes is counted and thrown away and the screen is read back from curses' own copy of
+ * it. The loop runs on the caller's thread, as far as each settle() takes it. */
+class HeadlessTerminal {
+	int key_pipe[2] = {-1, -1};
+	FILE *input = nullptr;
+	FILE *output = nullptr;
+	uint64_t flushed_bytes = 0;
+	bool running = false;
+
+	std::unique_ptr<WindowManager> wm;
+
+	void recycle_output();
+
+  public:
+	static constexpr const char *TERM = "xterm-256color";
+
+	HeadlessTerminal(int lines = 24, int cols = 80);
+	~HeadlessTerminal();
+
+	HeadlessTerminal(const HeadlessTerminal &) = delete;
+	HeadlessTerminal &operator=(const HeadlessTerminal &) = delete;
+
+	WindowManager &manager() { return *wm; }
+
+	void start(std::shared_ptr<ScreenController> initial_screen);
+	bool is_running() const { return running; }
+
+	/* queues what the terminal sends for a curses key code */
+	void press(int key);
+	void type(std::string_view text);
+
+	/* Steps the loop until it has nothing left to do and nothing came up for quiet, or until
+	 * timeout. False once the loop is over. */
+	bool settle(std::chrono::milliseconds quiet = std::chrono::milliseconds(0),
+	    std::chrono::milliseconds timeout = std::chrono::seconds(10));
+	/* for screens waiting on background work, false if text didn't show up in time */
+	bool wait_for(std::string_view text,
+	    std::chrono::milliseconds timeout = std::chrono::seconds(10));
+
+	/* what the terminal shows, one string per line */
+	std::vector<std::string> screen() const;
+	bool shows(std::string_view text) const;
+
+	/* everything curses has written so far */
+	uint64_t bytes_written() const;
+};
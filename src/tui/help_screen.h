@@ -19,6 +19,8 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
 #include <src/tui/screen_controller.h>
 
+#include <vector>
+
 class HelpScreen : public ScreenController {
 	std::vector<const char *> opts;
 
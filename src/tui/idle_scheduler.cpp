@@ -0,0 +1,161 @@
+/*
+
+Copyright (C) 2019 Mateusz Morusiewicz
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+
+#include <src/tui/idle_scheduler.h>
+
+#include <src/utils/trace.h>
+
+#include <algorithm>
+#include <ctime>
+#include <exception>
+
+namespace {
+
+std::chrono::nanoseconds thread_cpu_time() {
+	timespec ts;
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+	return std::chrono::seconds(ts.tv_sec) + std::chrono::nanoseconds(ts.tv_nsec);
+}
+
+} // namespace
+
+bool IdleContext::should_yield() {
+	const auto now = std::chrono::steady_clock::now();
+	if (now >= slice_end) return true;
+	if (now < next_input_check) return false;
+
+	next_input_check = now + INPUT_CHECK_INTERVAL;
+	if (input_pending && input_pending()) {
+		preempted = true;
+		return true;
+	}
+	return false;
+}
+
+const char *to_string(IdleTaskState state) {
+	switch (state) {
+	case IdleTaskState::Waiting:
+		return "waiting";
+	case IdleTaskState::Done:
+		return "done";
+	case IdleTaskState::Cancelled:
+		return "cancelled";
+	case IdleTaskState::OverBudget:
+		return "over budget";
+	case IdleTaskState::Failed:
+		return "failed";
+	}
+	return "";
+}
+
+IdleScheduler::IdleScheduler(
+    std::function<bool()> input_pending, std::function<void(std::function<void()>)> post) :
+    input_pending(std::move(input_pending)),
+    post(std::move(post)) {}
+
+IdleScheduler::TaskId IdleScheduler::submit(Task task) {
+	const TaskId id = next_id++;
+	IdleTaskStats stats;
+	stats.id = id;
+	stats.name = task.name;
+	stats.priority = task.priority;
+	stats.state = IdleTaskState::Waiting;
+	tasks.push_back(Entry{std::move(task), std::move(stats)});
+	return id;
+}
+
+void IdleScheduler::cancel(TaskId id) {
+	auto it = std::find_if(
+	    tasks.begin(), tasks.end(), [id](const Entry &e) { return e.stats.id == id; });
+	if (it == tasks.end()) return;
+
+	/* a task cancelling itself is retired once its step returns */
+	if (id == running) {
+		running_cancelled = true;
+	} else {
+		retire(it, IdleTaskState::Cancelled);
+	}
+}
+
+void IdleScheduler::retire(std::list<Entry>::iterator it, IdleTaskState state) {
+	it->stats.state = state;
+	finished.push_back(std::move(it->stats));
+	if (finished.size() > MAX_FINISHED_STATS) finished.erase(finished.begin());
+
+	auto on_done = std::move(it->task.on_done);
+	tasks.erase(it);
+
+	if (state == IdleTaskState::Done && on_done && post) post(std::move(on_done));
+}
+
+bool IdleScheduler::run_once() {
+	if (tasks.empty()) return false;
+
+	/* lowest priority value, then the one that waited longest */
+	auto it = std::min_element(tasks.begin(), tasks.end(), [](const Entry &lhs, const Entry &rhs) {
+		if (lhs.task.priority != rhs.task.priority) return lhs.task.priority < rhs.task.priority;
+		return lhs.last_run < rhs.last_run;
+	});
+	Entry &entry = *it;
+	entry.last_run = ++runs;
+	running = entry.stats.id;
+	running_cancelled = false;
+
+	const auto wall_start = std::chrono::steady_clock::now();
+	const auto cpu_start = thread_cpu_time();
+	IdleContext context(wall_start + entry.task.slice, input_pending);
+
+	bool more = false;
+	std::string error;
+	try {
+		TRACE_SPAN("tui", "idle step");
+		more = entry.task.step(context);
+	} catch (const std::exception &e) {
+		error = e.what();
+	}
+	running = 0;
+
+	const auto wall = std::chrono::steady_clock::now() - wall_start;
+	auto &stats = entry.stats;
+	++stats.steps;
+	stats.cpu_time += thread_cpu_time() - cpu_start;
+	stats.wall_time += wall;
+	stats.longest_step = std::max<std::chrono::nanoseconds>(stats.longest_step, wall);
+	if (context.preempted) ++stats.preempted;
+
+	if (running_cancelled) {
+		retire(it, IdleTaskState::Cancelled);
+	} else if (!error.empty()) {
+		stats.error = std::move(error);
+		retire(it, IdleTaskState::Failed);
+	} else if (!more) {
+		retire(it, IdleTaskState::Done);
+	} else if (entry.task.budget.count() > 0 && stats.cpu_time >= entry.task.budget) {
+		retire(it, IdleTaskState::OverBudget);
+	}
+	return true;
+}
+
+std::vector<IdleTaskStats> IdleScheduler::stats() const {
+	std::vector<IdleTaskStats> rv;
+	for (const auto &entry : tasks) rv.push_back(entry.stats);
+	rv.insert(rv.end(), finished.rbegin(), finished.rend());
+	return rv;
+}
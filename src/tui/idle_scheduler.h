@@ -0,0 +1,124 @@
+/*
+
+Copyright (C) 2019 Mateusz Morusiewicz
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <string>
+#include <vector>
+
+/* Handed to every step of an idle task, which should return as soon as should_yield() says so */
+class IdleContext {
+	std::chrono::steady_clock::time_point slice_end;
+	std::chrono::steady_clock::time_point next_input_check{};
+	const std::function<bool()> &input_pending;
+	bool preempted = false;
+
+	friend class IdleScheduler;
+
+  public:
+	IdleContext(std::chrono::steady_clock::time_point slice_end,
+	    const std::function<bool()> &input_pending) :
+	    slice_end(slice_end),
+	    input_pending(input_pending) {}
+
+	/* polling for input is a syscall, steps that ask once per item only poll this often */
+	static constexpr std::chrono::microseconds INPUT_CHECK_INTERVAL{250};
+
+	/* the slice is used up or the user pressed a key */
+	bool should_yield();
+};
+
+enum class IdleTaskState { Waiting, Done, Cancelled, OverBudget, Failed };
+
+const char *to_string(IdleTaskState state);
+
+struct IdleTaskStats {
+	uint64_t id;
+	std::string name;
+	int priority;
+	IdleTaskState state;
+	std::string error;                      // what the step threw, for Failed
+	uint64_t steps = 0;
+	uint64_t preempted = 0;                 // steps cut short by input
+	std::chrono::nanoseconds cpu_time{0};   // of the loop thread while in the task
+	std::chrono::nanoseconds wall_time{0};
+	std::chrono::nanoseconds longest_step{0};
+};
+
+/* Cooperative scheduler for low-priority work on the UI thread. Tasks run in slices whenever the
+ * loop has nothing else to do, most urgent (lowest priority value) first and round-robin within a
+ * priority. A pending key ends the slice early. A task that uses up its CPU budget is stopped. */
+class IdleScheduler {
+  public:
+	using TaskId = uint64_t;
+
+	struct Task {
+		std::string name;
+		int priority = 0;
+		std::chrono::microseconds slice{2000};
+		std::chrono::milliseconds budget{0}; // CPU time over the whole run, 0 for no limit
+		std::function<bool(IdleContext &)> step; // true while there is more to do
+		std::function<void()> on_done{};         // posted to the loop once the task is done
+	};
+
+	static constexpr size_t MAX_FINISHED_STATS = 32;
+
+  private:
+	struct Entry {
+		Task task;
+		IdleTaskStats stats;
+		uint64_t last_run = 0;
+	};
+
+	std::function<bool()> input_pending;
+	std::function<void(std::function<void()>)> post;
+
+	/* a list, so that steps can submit and cancel tasks while one is running */
+	std::list<Entry> tasks;
+	std::vector<IdleTaskStats> finished; // oldest first
+	TaskId next_id = 1;
+	uint64_t runs = 0;
+	TaskId running = 0;
+	bool running_cancelled = false;
+
+	void retire(std::list<Entry>::iterator it, IdleTaskState state);
+
+  public:
+	/* input_pending tells whether the loop has something to handle, post hands a callback to it */
+	IdleScheduler(std::function<bool()> input_pending,
+	    std::function<void(std::function<void()>)> post);
+
+	TaskId submit(Task task);
+
+	/* nothing happens if the task is done already */
+	void cancel(TaskId id);
+
+	bool has_work() const { return !tasks.empty(); }
+
+	/* runs one slice of the most urgent task, false if there was none */
+	bool run_once();
+
+	/* waiting tasks first, then the most recently finished ones */
+	std::vector<IdleTaskStats> stats() const;
+};
@@ -24,17 +24,23 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include <src/tui/input.h>
 #include <src/tui/keychain_main_screen.h>
 #include <src/tui/menu.h>
+#include <src/tui/operation_screen.h>
+#include <src/tui/recover_mnemonic_screen.h>
 
 #include <src/crypto/mnemonic.h>
+#include <src/crypto/mnemonic_recovery.h>
 #include <src/crypto/structs.h>
 #include <src/crypto/utils.h>
 #include <src/keychain/keychain.h>
 #include <src/keychain/utils.h>
 
 #include <cassert>
+#include <filesystem>
+#include <future>
 #include <memory>
 #include <optional>
 #include <string>
+#include <vector>
 
 ImportKeychainScreen::ImportKeychainScreen(WindowManager *wmanager, std::filesystem::path kc_path) :
     FormController(wmanager) {
@@ -42,25 +48,78 @@ ImportKeychainScreen::ImportKeychainScreen(WindowManager *wmanager, std::filesys
 	struct FormResult {
 		keychain::UriLocator uri;
 		crypto::PasswordHash pw_hash;
-		crypto::Seed seed;
+		std::vector<utils::sensitive_string> mnemonic;
+		std::optional<utils::sensitive_string> incomplete_mnemonic{};
 	};
 
 	std::shared_ptr<FormResult> result = std::make_shared<FormResult>();
 
-	FormController::on_done = [this, result, kc_path]() {
+	/* captures no screen as it can outlive this one when the mnemonic has to be recovered */
+	auto import_keychain = [wmanager, result, kc_path]() {
+		auto imported = std::make_shared<std::unique_ptr<keychain::Keychain>>();
+
+		/* seed derivation, keychain creation and the import itself all run on the pool */
+		auto start = [result, kc_path, imported](utils::OperationOptions options) {
+			auto on_done = options.on_done;
+			return utils::run_async(
+			    [result, kc_path, imported, options = std::move(options)]() {
+				    try {
+					    utils::StageReporter stages(options, 1);
+					    stages.begin("Deriving seed");
+					    crypto::Seed seed = crypto::mnemonic_to_seed(result->mnemonic);
+
+					    *imported = keychain::Keychain::initialize_with_seed(
+					        kc_path, std::move(seed), std::move(result->pw_hash), options);
+					    (*imported)->import_from_uri(result->uri, options);
+				    } catch (const utils::OperationCancelled &) {
+					    /* nothing was imported, the half-made keychain is of no use */
+					    if (*imported) {
+						    imported->reset();
+						    std::filesystem::remove_all(kc_path);
+					    }
+					    throw;
+				    }
+			    },
+			    std::move(on_done));
+		};
+
+		auto on_finished = [wmanager, kc_path, imported](std::future<void> &future) {
+			try {
+				future.get();
+				wmanager->set_controller(
+				    std::make_shared<KeychainMainScreen>(wmanager, std::move(*imported)));
+			} catch (const utils::OperationCancelled &) {
+				wmanager->set_controller(std::make_shared<CreateKeychainScreen>(wmanager, kc_path));
+			} catch (const std::exception &e) {
+				std::string err_msg = e.what();
+				err_msg += ". Please remove ";
+				err_msg += kc_path.string();
+				err_msg += " directory manually before retrying";
+				wmanager->set_controller(
+				    std::make_shared<ErrorScreen>(wmanager, Point{2, 2}, err_msg));
+			}
+		};
+
+		wmanager->set_controller(std::make_shared<OperationScreen>(
+		    wmanager, "Importing keychain " + kc_path.string(), start, on_finished));
+	};
+
+	FormController::on_done = [this, result, import_keychain]() {
+		if (!result->incomplete_mnemonic) return import_keychain();
+
 		try {
-			auto kc = keychain::Keychain::initialize_with_seed(
-			    kc_path, std::move(result->seed), std::move(result->pw_hash));
-			kc->import_from_uri(std::move(result->uri));
-			this->wmanager->set_controller(
-			    std::make_shared<KeychainMainScreen>(this->wmanager, std::move(kc)));
+			auto on_recovered = [result, import_keychain](
+			                        std::vector<utils::sensitive_string> mnemonic) {
+				result->mnemonic = std::move(mnemonic);
+				import_keychain();
+			};
+
+			this->wmanager->set_controller(std::make_shared<RecoverMnemonicScreen>(this->wmanager,
+			    keychain::Keychain::export_seed_matcher(result->uri), on_recovered,
+			    std::move(result->incomplete_mnemonic)));
 		} catch (const std::exception &e) {
-			std::string err_msg = e.what();
-			err_msg += ". Please remove ";
-			err_msg += kc_path.string();
-			err_msg += " directory manually before retrying";
 			this->wmanager->set_controller(
-			    std::make_shared<ErrorScreen>(this->wmanager, Point{2, 2}, err_msg));
+			    std::make_shared<ErrorScreen>(this->wmanager, Point{2, 2}, e.what()));
 		}
 	};
 	FormController::on_cancel = [this, kc_path]() {
@@ -86,8 +145,13 @@ ImportKeychainScreen::ImportKeychainScreen(WindowManager *wmanager, std::filesys
 	};
 
 	auto on_accept_mnemonic = [result](const utils::sensitive_string &mnemonic) -> bool {
-		std::vector<utils::sensitive_string> words = crypto::split_mnemonic_words(mnemonic);
-		result->seed = crypto::mnemonic_to_seed(words);
+		auto words = crypto::split_mnemonic_words(mnemonic);
+		if (!crypto::is_mnemonic_complete(words)) {
+			result->incomplete_mnemonic = mnemonic;
+			return true;
+		}
+
+		result->mnemonic = std::vector<utils::sensitive_string>(words.begin(), words.end());
 		return true;
 	};
 
@@ -98,7 +162,7 @@ ImportKeychainScreen::ImportKeychainScreen(WindowManager *wmanager, std::filesys
 	    on_accept_pass, Point{4, 2}, "Encryption phrase for new keychain: ")
 	    ->set_visible(false);
 
-	FormController::add_field<SensitiveInputHandler>(
-	    on_accept_mnemonic, Point{6, 2}, "Mnemonic (space-separated words of the seed phrase): ")
+	FormController::add_field<MnemonicInputHandler>(on_accept_mnemonic, Point{6, 2},
+	    "Mnemonic (space-separated words of the seed phrase, ? if missing): ")
 	    ->set_visible(false);
 }
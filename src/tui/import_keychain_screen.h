@@ -24,6 +24,8 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include <filesystem>
 
 class ImportKeychainScreen : public FormController {
+	bool m_takes_secrets() const override { return true; }
+
   public:
 	ImportKeychainScreen(WindowManager *wmanager, std::filesystem::path kc_path);
 };
@@ -84,3 +84,71 @@ void SensitiveInputHandler::m_draw(WINDOW *window) {
 		waddch(window, '*');
 	}
 }
+
+MnemonicInputHandler::MnemonicInputHandler(const Point &origin, const std::string &title,
+    ValueCallback on_accept, crypto::Language language) :
+    ValueInputHandler<utils::sensitive_string>(std::move(on_accept)),
+    origin(origin), title(title), language(language) {}
+
+/* the unique completion of the word being typed, empty when there is none yet */
+static std::string_view completion_of(
+    const utils::sensitive_string &value, crypto::Language language) {
+	size_t start = value.size();
+	while (start > 0 && value[start - 1] != ' ') --start;
+
+	const std::string_view typed(value.c_str() + start, value.size() - start);
+	if (typed.size() < crypto::WORDLIST_UNIQUE_PREFIX) return {};
+
+	const crypto::Wordlist &words = crypto::wordlist(language);
+	if (auto index = words.complete(typed)) return words.at(*index).substr(typed.size());
+	return {};
+}
+
+void MnemonicInputHandler::complete_current_word() {
+	for (char c : completion_of(this->value, language)) {
+		this->value.push_back(c);
+	}
+}
+
+void MnemonicInputHandler::on_accept() {
+	complete_current_word();
+	ValueInputHandler<utils::sensitive_string>::on_accept();
+}
+
+void MnemonicInputHandler::on_char(char c) {
+	if (c != ' ' && c != KEY_TAB) return this->value.push_back(c);
+
+	complete_current_word();
+	if (this->value.size() > 0 && this->value[this->value.size() - 1] != ' ') {
+		this->value.push_back(' ');
+	}
+}
+
+void MnemonicInputHandler::on_backspace() {
+	if (this->value.size() > 0) this->value.pop_back();
+}
+
+void MnemonicInputHandler::m_draw(WINDOW *window) {
+	wmove(window, this->origin.row, 0);
+	wclrtoeol(window);
+
+	/* accepted words are masked like any secret, only the one being typed is shown */
+	size_t current_word = this->value.size();
+	while (current_word > 0 && this->value[current_word - 1] != ' ') --current_word;
+
+	mvwaddstr(window, this->origin.row, this->origin.col, this->title.c_str());
+	for (size_t i = 0; i < this->value.size(); ++i) {
+		const char c = this->value[i];
+		waddch(window, i < current_word && c != ' ' ? '*' : c);
+	}
+
+	int row, col;
+	getyx(window, row, col);
+
+	std::string_view hint = completion_of(this->value, language);
+	wattron(window, A_DIM);
+	waddnstr(window, hint.data(), hint.size());
+	wattroff(window, A_DIM);
+
+	wmove(window, row, col);
+}
@@ -23,6 +23,7 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include <src/tui/utils.h>
 
 #include <src/crypto/utils.h>
+#include <src/crypto/wordlist.h>
 
 #include <functional>
 #include <memory>
@@ -58,7 +59,7 @@ template <typename V> class ValueInputHandler : public BasicUserInputHandler {
 	V value{};
 	ValueCallback on_accept_cb;
 
-	void on_accept() final { on_accept_cb(value); }
+	void on_accept() override { on_accept_cb(value); }
 
   public:
 	ValueInputHandler(ValueCallback on_accept_cb) : on_accept_cb(on_accept_cb) {}
@@ -90,3 +91,22 @@ class SensitiveInputHandler : public ValueInputHandler<utils::sensitive_string>
   public:
 	SensitiveInputHandler(const Point &origin, const std::string &title, ValueCallback on_accept);
 };
+
+/* Space-separated mnemonic words, each one is completed from the wordlist on space, <TAB> or
+ * accept once it's long enough to be unambiguous */
+class MnemonicInputHandler : public ValueInputHandler<utils::sensitive_string> {
+	Point origin;
+	std::string title;
+	crypto::Language language;
+
+	void complete_current_word();
+
+	void on_accept() override;
+	void on_char(char c) override;
+	void on_backspace() override;
+	void m_draw(WINDOW *window) override;
+
+  public:
+	MnemonicInputHandler(const Point &origin, const std::string &title, ValueCallback on_accept,
+	    crypto::Language language = crypto::Language::English);
+};
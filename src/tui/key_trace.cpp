@@ -0,0 +1,102 @@
+/*
+
+Copyright (C) 2019 Mateusz Morusiewicz
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+
+#include <src/tui/key_trace.h>
+
+#include <src/tui/keychain_main_screen.h>
+
+#include <curses.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <fstream>
+#include <map>
+#include <stdexcept>
+
+std::string key_name(int key) {
+	const char *name = keyname(key);
+	return name ? name : "";
+}
+
+std::optional<int> key_code(std::string_view name) {
+	static const std::map<std::string, int, std::less<>> codes = []() {
+		std::map<std::string, int, std::less<>> rv;
+		for (int key = 0; key <= KEY_MAX; ++key) {
+			/* the first code wins where several share a name */
+			if (const char *name = keyname(key)) rv.emplace(name, key);
+		}
+		return rv;
+	}();
+
+	auto it = codes.find(name);
+	if (it == codes.end()) return std::nullopt;
+	return it->second;
+}
+
+std::vector<int> read_key_trace(const std::filesystem::path &path) {
+	std::ifstream in(path);
+	if (!in) throw std::runtime_error("cannot read " + path.string());
+
+	std::vector<int> rv;
+	for (std::string line; std::getline(in, line);) {
+		/* a space is a line of its own, nothing is trimmed */
+		if (line.empty()) continue;
+		auto key = key_code(line);
+		if (!key) throw std::runtime_error("unknown key " + line + " in " + path.string());
+		rv.push_back(*key);
+	}
+	return rv;
+}
+
+KeyRecorder::KeyRecorder(const std::filesystem::path &path) :
+    fd(::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0600)) {
+	/* traces left by older versions may be readable by others */
+	if (fd < 0 || ::fchmod(fd, 0600) != 0) {
+		if (fd >= 0) ::close(fd);
+		throw std::runtime_error("cannot write the key trace to " + path.string());
+	}
+}
+
+KeyRecorder::~KeyRecorder() {
+	::close(fd);
+}
+
+void KeyRecorder::on_key(int key, const ScreenController &screen) {
+	if (!started) started = dynamic_cast<const KeychainMainScreen *>(&screen) != nullptr;
+	if (!started || key == KEY_RESIZE) return;
+
+	/* getch hands out UTF-8 byte by byte: a lead byte stands for the whole character and the
+	 * continuation bytes are dropped. Controls, DEL and curses' own codes are not typed text. */
+	if (screen.takes_secrets() && ((key >= 0x20 && key < 0x7f) || (key >= 0x80 && key <= 0xff))) {
+		if (key >= 0x80 && key < 0xc0) return;
+		key = SECRET_PLACEHOLDER;
+	}
+
+	/* a short write is finished rather than leaving half a key name */
+	const std::string line = key_name(key) + "\n";
+	for (size_t written = 0; written < line.size();) {
+		const ssize_t n = ::write(fd, line.data() + written, line.size() - written);
+		if (n < 0 && errno == EINTR) continue;
+		if (n <= 0) return;
+		written += n;
+	}
+}
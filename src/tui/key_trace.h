@@ -0,0 +1,62 @@
+/*
+
+Copyright (C) 2019 Mateusz Morusiewicz
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+
+#pragma once
+
+#include <src/tui/manager.h>
+
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/* Key traces are sessions of the TUI, one key per line as curses' keyname() spells it, e.g. "a",
+ * "^J" or "KEY_DOWN". Setting HDPWM_KEY_TRACE to a file records one for bench/tui_replay. */
+
+std::string key_name(int key);
+/* the inverse of key_name, curses must be initialized */
+std::optional<int> key_code(std::string_view name);
+
+/* throws std::runtime_error on names key_code doesn't know */
+std::vector<int> read_key_trace(const std::filesystem::path &path);
+
+/* Recording starts with the first key that reaches a keychain's main screen, which is where the
+ * replay starts as well. Characters typed into screens taking secrets, forms among them, are
+ * written as SECRET_PLACEHOLDER, one per character; control and navigation keys are written as
+ * they are, so that the replay leaves those screens where the session did. The trace is only
+ * readable by its owner. */
+class KeyRecorder : public WindowObserver {
+  public:
+	static constexpr int SECRET_PLACEHOLDER = 'x';
+
+  private:
+	int fd = -1;
+	bool started = false;
+
+  public:
+	explicit KeyRecorder(const std::filesystem::path &path);
+	~KeyRecorder() override;
+
+	KeyRecorder(const KeyRecorder &) = delete;
+	KeyRecorder &operator=(const KeyRecorder &) = delete;
+
+	void on_key(int key, const ScreenController &screen) override;
+};
@@ -25,11 +25,15 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
 #include <curses.h>
 
+#include <algorithm>
 #include <list>
+#include <optional>
+#include <unordered_map>
 
 struct EntryFormResult {
 	std::string name;
 	std::string details;
+	std::vector<std::string> tags;
 };
 
 struct DirectoryFormResult {
@@ -39,12 +43,56 @@ struct DirectoryFormResult {
 KeychainMainScreen::KeychainMainScreen(
     WindowManager *wmanager, std::shared_ptr<keychain::Keychain> kc) :
     ScreenController(wmanager),
-    m_keychain(std::move(kc)) {
-	keychain_root_dir = this->m_keychain->get_root_dir();
-	flat_entries_cache = flatten_dirs(keychain_root_dir);
+    m_keychain(std::move(kc)), prefetcher(m_keychain),
+    writer(m_keychain, keychain::DEFAULT_WRITE_DELAY, keychain::DEFAULT_MAX_STALENESS,
+        writer_callbacks()),
+    keychain_root_dir(writer.root()) {
+	refresh_flat_entries();
+	prefetch_around_cursor();
+	schedule_integrity_check();
+}
+
+keychain::WriterCallbacks KeychainMainScreen::writer_callbacks() {
+	keychain::WriterCallbacks rv;
+	rv.on_rebased = [news = writer_news, redraw = wmanager->redraw_handle()]() {
+		news->rebased = true;
+		redraw->request();
+	};
+	rv.on_failure = [news = writer_news,
+	                    redraw = wmanager->redraw_handle()](std::exception_ptr error) {
+		std::string what = "unknown error";
+		try {
+			std::rethrow_exception(error);
+		} catch (const std::exception &e) {
+			what = e.what();
+		} catch (...) {
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(news->mutex);
+			news->failures.push_back("Could not save the entries: " + what);
+		}
+		redraw->request();
+	};
+	return rv;
+}
+
+void KeychainMainScreen::take_writer_news() {
+	if (writer_news->rebased.exchange(false)) refresh_flat_entries();
+
+	std::vector<std::string> failures;
+	{
+		std::lock_guard<std::mutex> lock(writer_news->mutex);
+		failures.swap(writer_news->failures);
+	}
+	for (auto &failure : failures) {
+		wmanager->push_controller(
+		    std::make_shared<ErrorScreen>(wmanager, Point{2, 2}, std::move(failure)));
+	}
 }
 
 KeychainMainScreen::~KeychainMainScreen() {
+	wmanager->idle().cancel(integrity_task);
 	cleanup();
 	if (keychain_root_dir) keychain_root_dir.reset();
 }
@@ -78,9 +126,10 @@ void KeychainMainScreen::m_init() {
 	/* footer */
 
 	this->footer = newwin(1, this->maxcols / 5 * 3, this->maxlines - 1, 0);
-	mvwaddstr(this->footer, 0, 2, "<?> for help");
+	draw_footer();
 
-	wrefresh(this->footer);
+	entries_rows.invalidate();
+	details_rows.invalidate();
 }
 
 void KeychainMainScreen::m_cleanup() {
@@ -92,65 +141,106 @@ void KeychainMainScreen::m_cleanup() {
 	header = main = details = footer = nullptr;
 }
 
+void KeychainMainScreen::draw_footer() {
+	if (!this->footer) return;
+
+	werase(this->footer);
+	mvwaddstr(this->footer, 0, 2, "<?> for help");
+	if (!tag_filter.empty()) {
+		waddstr(this->footer, ("  filter: " + tag_filter).c_str());
+	}
+	/* not a warning, copying an entry is how the same secret is used in two places */
+	if (n_sharing_secrets > 0) {
+		std::string note =
+		    "  " + std::to_string(n_sharing_secrets) + " entries are copies sharing a secret";
+		waddstr(this->footer, note.c_str());
+	}
+	wrefresh(this->footer);
+}
+
 namespace {
 
-auto draw_keychain_directory(WINDOW *win, int row, keychain::Directory::ptr dir) {
-	std::string to_print = dir->is_open ? "-" : "+";
-	to_print += dir->meta.name;
-	mvwaddstr(win, row + 1, 1 + dir->dir_level, to_print.c_str());
+/* filtered views show directories open whether they are or not */
+RowRenderer::Row directory_row(keychain::Directory::ptr dir, bool selected, bool shown_open) {
+	std::string text = shown_open ? "-" : "+";
+	text += dir->meta.name;
+	return {1 + dir->dir_level, std::move(text), selected};
 }
 
-auto draw_keychain_entry(WINDOW *win, int row, keychain::Entry::ptr entry) {
+RowRenderer::Row entry_row(keychain::Entry::ptr entry, bool selected) {
 	if (auto pd = entry->parent_dir.lock()) {
-		mvwaddstr(win, row + 1, 2 + pd->dir_level, entry->meta.name.c_str());
+		return {2 + pd->dir_level, entry->meta.name, selected};
 	}
+	return {};
 }
 
 } // namespace
 
 void KeychainMainScreen::draw_entries_box() {
-	wclear(this->main);
+	entries_rows.begin_frame(getmaxy(this->main));
 
 	int max_entries = this->maxlines - 4;
 	int n_to_skip = std::max(0, this->c_selected_index - max_entries + 1);
 
 	for (int i = 0; i < std::min(max_entries, static_cast<int>(flat_entries_cache.size())); ++i) {
-		if (state == State::Browsing && i + n_to_skip == this->c_selected_index) {
-			wattron(this->main, A_STANDOUT);
-		}
+		bool selected = state == State::Browsing && i + n_to_skip == this->c_selected_index;
 
 		std::visit(
 		    overloaded{
-		        [this, i](
-		            keychain::Directory::ptr dir) { draw_keychain_directory(this->main, i, dir); },
-		        [this, i](
-		            keychain::Entry::ptr entry) { draw_keychain_entry(this->main, i, entry); },
+		        [this, i, selected](keychain::Directory::ptr dir) {
+			        const bool shown_open = dir->is_open || !tag_filter.empty();
+			        entries_rows.set_row(i + 1, directory_row(dir, selected, shown_open));
+		        },
+		        [this, i, selected](keychain::Entry::ptr entry) {
+			        entries_rows.set_row(i + 1, entry_row(entry, selected));
+		        },
 		    },
 		    flat_entries_cache[i + n_to_skip]);
-
-		if (state == State::Browsing && i + n_to_skip == this->c_selected_index) {
-			wattroff(this->main, A_STANDOUT);
-		}
 	}
+
+	entries_rows.commit(this->main);
 }
 
 void KeychainMainScreen::draw_details_box() {
-	wclear(this->details);
+	details_rows.begin_frame(getmaxy(this->details));
 
 	std::visit(
 	    overloaded{
 	        [](keychain::Directory::ptr) { /* TODO (notes? derivation path?) */ },
 	        [this](keychain::Entry::ptr entry) {
-		        mvwaddstr(this->details, 1, 0, entry->meta.details.c_str());
+		        auto lines = wrap_lines(entry->meta.details, getmaxx(this->details));
+		        if (!entry->meta.tags.empty()) {
+			        const auto tags = "Tags: " + keychain::join_tags(entry->meta.tags);
+			        lines.push_back("");
+			        for (auto &line : wrap_lines(tags, getmaxx(this->details))) {
+				        lines.push_back(std::move(line));
+			        }
+		        }
+		        for (size_t i = 0; i < lines.size(); ++i) {
+			        details_rows.set_row(i + 1, {0, lines[i], false});
+		        }
 	        },
 	    },
 	    flat_entries_cache[this->c_selected_index]);
+
+	details_rows.commit(this->details);
 }
 
 void KeychainMainScreen::m_draw() {
+	take_writer_news();
 
-	if (state != State::CreatingOrDeleting) draw_entries_box();
-	if (state == State::Browsing) draw_details_box();
+	/* forms draw into these windows while they are up */
+	if (state != State::CreatingOrDeleting) {
+		draw_entries_box();
+	} else {
+		entries_rows.invalidate();
+	}
+
+	if (state == State::Browsing) {
+		draw_details_box();
+	} else {
+		details_rows.invalidate();
+	}
 
 	wrefresh(this->main);
 	wrefresh(this->details);
@@ -160,18 +250,25 @@ void KeychainMainScreen::m_on_key(int key) {
 	switch (key) {
 	case KEY_DOWN:
 		this->c_selected_index = (this->c_selected_index + 1) % flat_entries_cache.size();
+		prefetch_around_cursor();
 		break;
 	case KEY_UP:
 		this->c_selected_index = this->c_selected_index <= 0 ? flat_entries_cache.size() - 1
 		                                                     : this->c_selected_index - 1;
+		prefetch_around_cursor();
 		break;
 	case KEY_ENTER:
 	case KEY_RETURN:
 		std::visit(
 		    overloaded{
 		        [this](keychain::Directory::ptr dir) {
-			        dir->is_open ^= 0x1;
-			        flat_entries_cache = flatten_dirs(keychain_root_dir);
+			        if (!tag_filter.empty()) return;
+			        {
+				        auto tree_lock = writer.lock_tree();
+				        dir->is_open ^= 0x1;
+			        }
+			        refresh_flat_entries();
+			        prefetch_around_cursor();
 		        },
 		        [this](keychain::Entry::ptr entry) { post_entry_view(entry); },
 		    },
@@ -213,35 +310,124 @@ void KeychainMainScreen::m_on_key(int key) {
 		    },
 		    flat_entries_cache[this->c_selected_index]);
 		break;
+	case '/':
+		post_filter_form();
+		break;
 	case 'q':
+		try {
+			writer.flush();
+		} catch (const std::exception &) {
+			return; // the writer's news tell what failed
+		}
 		wmanager->pop_controller();
 		break;
 	case '?':
 		std::vector<const char *> help{"<↑↓> to navigate", "<↲> to view",
 		    "<n/N> to add new entry/group", "<e> to edit",
-		    "<c|p|x/d> to copy|paste|cut/delete entry or group", "<q> to quit"};
+		    "<c|p|x/d> to copy|paste|cut/delete entry or group",
+		    "</> to filter by tags, e.g. prod & !legacy", "<F12> for background tasks",
+		    "<q> to quit"};
 		wmanager->push_controller(std::make_shared<HelpScreen>(wmanager, std::move(help)));
 		break;
 	}
 }
 
+void KeychainMainScreen::refresh_flat_entries() {
+	/* the writer's index has the edits that are not written yet */
+	std::optional<utils::RoaringBitmap> ids;
+	if (!tag_filter.empty()) ids = writer.tags()->query(tag_filter);
+
+	/* the writer's thread adds and removes nodes when it rebases */
+	auto tree_lock = writer.lock_tree();
+	if (ids) {
+		flat_entries_cache = keychain::flatten_filtered(keychain_root_dir, *ids);
+	} else {
+		flat_entries_cache = flatten_dirs(keychain_root_dir);
+	}
+	c_selected_index = std::min<int>(c_selected_index, flat_entries_cache.size() - 1);
+	flat_entries_accounted.set(flat_entries_cache.capacity() * sizeof(keychain::AnyKeychainPtr));
+}
+
+void KeychainMainScreen::prefetch_around_cursor() {
+	std::vector<crypto::DerivationPath> dpaths;
+	const int n_entries = flat_entries_cache.size();
+
+	/* the selected entry first, then outwards */
+	for (int distance = 0; distance <= PREFETCH_RADIUS; ++distance) {
+		for (int index : {c_selected_index + distance, c_selected_index - distance}) {
+			if (index < 0 || index >= n_entries) continue;
+			if (auto entry = std::get_if<keychain::Entry::ptr>(&flat_entries_cache[index])) {
+				dpaths.push_back((*entry)->meta.dpath);
+			}
+			if (distance == 0) break;
+		}
+	}
+
+	prefetcher.prefetch(std::move(dpaths));
+}
+
+void KeychainMainScreen::schedule_integrity_check() {
+	struct Walk {
+		std::vector<keychain::Directory::ptr> to_visit;
+		std::unordered_map<int, int> entries_per_dpath;
+	};
+	auto walk = std::make_shared<Walk>();
+	walk->to_visit.push_back(keychain_root_dir);
+
+	IdleScheduler::Task task;
+	task.name = "integrity check";
+	task.priority = 10;
+	task.budget = std::chrono::milliseconds(500);
+	task.step = [this, walk](IdleContext &context) {
+		auto tree_lock = writer.lock_tree();
+		while (!walk->to_visit.empty() && !context.should_yield()) {
+			auto dir = std::move(walk->to_visit.back());
+			walk->to_visit.pop_back();
+
+			for (const auto &entry : dir->entries)
+				++walk->entries_per_dpath[entry->meta.dpath.seed];
+			walk->to_visit.insert(walk->to_visit.end(), dir->dirs.begin(), dir->dirs.end());
+		}
+		return !walk->to_visit.empty();
+	};
+	task.on_done = [this, walk]() {
+		n_sharing_secrets = 0;
+		for (const auto &[dpath, n_entries] : walk->entries_per_dpath) {
+			if (n_entries > 1) n_sharing_secrets += n_entries;
+		}
+		draw_footer();
+	};
+
+	wmanager->idle().cancel(integrity_task);
+	integrity_task = wmanager->idle().submit(std::move(task));
+}
+
 void KeychainMainScreen::paste_into_dir(keychain::Directory::ptr parent_dir) {
 	if (!clipboard) return;
 
-	std::visit(
-		overloaded{
-			[this, parent_dir](keychain::Directory::ptr dir) {
-				parent_dir->dirs.push_back(deep_copy_directory(dir, parent_dir));
-			},
-			[this, parent_dir](keychain::Entry::ptr entry) {
-				auto copied_entry = std::make_shared<keychain::Entry>(entry->meta, parent_dir);
-				parent_dir->entries.push_back(copied_entry);
-			}
-		},
-		clipboard.value());
+	writer.modify([this, parent_dir](keychain::EntryChanges &changes) {
+		/* copies share the secret, but are entries of their own with ids of their own */
+		std::visit(
+		    overloaded{
+		        [this, parent_dir, &changes](keychain::Directory::ptr dir) {
+			        auto copied_dir = deep_copy_directory(dir, parent_dir);
+			        keychain::renumber_entries(copied_dir, *keychain_root_dir);
+			        parent_dir->dirs.push_back(copied_dir);
+			        changes.changed(*copied_dir);
+		        },
+		        [this, parent_dir, &changes](keychain::Entry::ptr entry) {
+			        auto meta = entry->meta;
+			        meta.id = keychain::new_entry_id(*keychain_root_dir);
+			        auto copied_entry = std::make_shared<keychain::Entry>(meta, parent_dir);
+			        parent_dir->entries.push_back(copied_entry);
+			        changes.changed(*copied_entry);
+		        },
+		    },
+		    clipboard.value());
+	});
 
-	m_keychain->save_entries(keychain_root_dir);
-	flat_entries_cache = flatten_dirs(keychain_root_dir);
+	refresh_flat_entries();
+	schedule_integrity_check();
 }
 
 void KeychainMainScreen::post_entry_form() {
@@ -257,26 +443,30 @@ void KeychainMainScreen::post_entry_form() {
 
 		// TODO(mmorusiewicz): generate entry using keychain
 		auto dpath = m_keychain->get_next_derivation_path();
-		keychain::EntryMeta new_entry{entry_result->name, entry_result->details, dpath};
-
-		std::visit(
-		    overloaded{
-		        [this, &new_entry](keychain::Directory::ptr dir) {
-			        dir->is_open = true;
-			        dir->entries.push_back(std::make_shared<keychain::Entry>(new_entry, dir));
-		        },
-		        [this, &new_entry](keychain::Entry::ptr entry) {
-			        if (auto pd = entry->parent_dir.lock()) {
-				        pd->entries.push_back(std::make_shared<keychain::Entry>(new_entry, pd));
-			        }
-		        },
-		    },
-		    flat_entries_cache[this->c_selected_index]);
-
-		m_keychain->save_entries(keychain_root_dir);
+		keychain::EntryMeta new_entry{
+		    entry_result->name, entry_result->details, dpath, entry_result->tags};
+
+		writer.modify([this, &new_entry](keychain::EntryChanges &changes) {
+			new_entry.id = keychain::new_entry_id(*keychain_root_dir);
+			std::visit(
+			    overloaded{
+			        [&new_entry, &changes](keychain::Directory::ptr dir) {
+				        dir->is_open = true;
+				        dir->entries.push_back(std::make_shared<keychain::Entry>(new_entry, dir));
+				        changes.changed(*dir->entries.back());
+			        },
+			        [&new_entry, &changes](keychain::Entry::ptr entry) {
+				        if (auto pd = entry->parent_dir.lock()) {
+					        pd->entries.push_back(std::make_shared<keychain::Entry>(new_entry, pd));
+					        changes.changed(*pd->entries.back());
+				        }
+			        },
+			    },
+			    flat_entries_cache[this->c_selected_index]);
+		});
 
 		state = State::Browsing;
-		flat_entries_cache = flatten_dirs(keychain_root_dir);
+		refresh_flat_entries();
 	};
 
 	auto on_form_cancel = [this]() {
@@ -299,8 +489,18 @@ void KeychainMainScreen::post_entry_form() {
 
 	entry_form_controller->add_field<StringInputHandler>(
 	    on_name_accept, Point{2, 2}, "Entry name: ");
+	auto on_tags_accept = [entry_result](const std::string &tags) -> bool {
+		try {
+			entry_result->tags = keychain::parse_tags(tags);
+		} catch (const std::runtime_error &) {
+			return false;
+		}
+		return true;
+	};
+
 	entry_form_controller->add_field<StringInputHandler>(
 	    on_details_accept, Point{4, 2}, "Details: ");
+	entry_form_controller->add_field<StringInputHandler>(on_tags_accept, Point{6, 2}, "Tags: ");
 
 	state = State::CreatingOrDeleting;
 	wmanager->push_controller(std::move(entry_form_controller));
@@ -320,23 +520,24 @@ void KeychainMainScreen::post_directory_form() {
 		// TODO(mmorusiewicz): generate entry using keychain
 		keychain::DirectoryMeta new_dir{dir_result->name, ""};
 
-		std::visit(
-		    overloaded{
-		        [this, &new_dir](keychain::Directory::ptr dir) {
-			        dir->is_open = true;
-			        dir->dirs.push_back(std::make_shared<keychain::Directory>(new_dir, dir));
-		        },
-		        [this, &new_dir](keychain::Entry::ptr entry) {
-			        if (auto pd = entry->parent_dir.lock()) {
-				        pd->dirs.push_back(std::make_shared<keychain::Directory>(new_dir, pd));
-			        }
-		        },
-		    },
-		    flat_entries_cache[this->c_selected_index]);
+		writer.modify([this, &new_dir](keychain::EntryChanges &) {
+			std::visit(
+			    overloaded{
+			        [&new_dir](keychain::Directory::ptr dir) {
+				        dir->is_open = true;
+				        dir->dirs.push_back(std::make_shared<keychain::Directory>(new_dir, dir));
+			        },
+			        [&new_dir](keychain::Entry::ptr entry) {
+				        if (auto pd = entry->parent_dir.lock()) {
+					        pd->dirs.push_back(std::make_shared<keychain::Directory>(new_dir, pd));
+				        }
+			        },
+			    },
+			    flat_entries_cache[this->c_selected_index]);
+		});
 
-		m_keychain->save_entries(keychain_root_dir);
 		state = State::Browsing;
-		flat_entries_cache = flatten_dirs(keychain_root_dir);
+		refresh_flat_entries();
 	};
 
 	auto on_form_cancel = [this]() {
@@ -359,6 +560,38 @@ void KeychainMainScreen::post_directory_form() {
 	wmanager->push_controller(std::move(directory_form_controller));
 }
 
+void KeychainMainScreen::post_filter_form() {
+	auto on_form_done = [this]() {
+		state = State::Browsing;
+		this->wmanager->pop_controller();
+		draw_footer();
+	};
+
+	auto filter_form =
+	    std::make_unique<FormController>(wmanager, this, this->footer, on_form_done, on_form_done);
+
+	/* a filter that doesn't parse keeps the form up */
+	auto on_filter_accept = [this](const std::string &filter) {
+		try {
+			m_keychain->snapshot()->tags->query(filter);
+		} catch (const std::runtime_error &) {
+			return false;
+		}
+		tag_filter = filter.find_first_not_of(" \t") == std::string::npos ? "" : filter;
+		c_selected_index = 0;
+		refresh_flat_entries();
+		prefetch_around_cursor();
+		return true;
+	};
+
+	auto filter_input =
+	    filter_form->add_field<StringInputHandler>(on_filter_accept, Point{0, 0}, "Filter: ");
+	filter_input->set_value(tag_filter);
+
+	state = State::Editing;
+	wmanager->push_controller(std::move(filter_form));
+}
+
 void KeychainMainScreen::post_entry_view(keychain::Entry::ptr entry) {
 	auto on_form_done = [this]() {
 		state = State::Browsing;
@@ -372,9 +605,11 @@ void KeychainMainScreen::post_entry_view(keychain::Entry::ptr entry) {
 
 	entry_view_form->add_label(Point{2, 0}, "Secret: ");
 	entry_view_form->add_output(std::make_unique<SensitiveOutputHandler>(
-	    Point{2, 8}, m_keychain->derive_secret(entry->meta.dpath)));
+	    Point{2, 8}, prefetcher.get(entry->meta.dpath)));
+	m_keychain->access_log().record(entry->meta.dpath, keychain::path_of(entry));
 
 	entry_view_form->add_label(Point{3, 0}, "Details: " + entry->meta.details);
+	entry_view_form->add_label(Point{4, 0}, "Tags: " + keychain::join_tags(entry->meta.tags));
 
 	state = State::Editing;
 	wmanager->push_controller(std::move(entry_view_form));
@@ -389,9 +624,9 @@ void KeychainMainScreen::post_dir_edit(keychain::Directory::ptr dir) {
 	auto dir_edit_form =
 	    std::make_unique<FormController>(wmanager, this, this->details, on_form_done, on_form_done);
 
-	auto on_name_change_accept = [dir](const std::string &new_name) {
+	auto on_name_change_accept = [this, dir](const std::string &new_name) {
 		if (new_name.empty()) return false;
-		dir->meta.name = new_name;
+		writer.modify([&](keychain::EntryChanges &) { dir->meta.name = new_name; });
 		return true;
 	};
 
@@ -412,15 +647,15 @@ void KeychainMainScreen::post_entry_edit(keychain::Entry::ptr entry) {
 	auto entry_edit_form =
 	    std::make_unique<FormController>(wmanager, this, this->details, on_form_done, on_form_done);
 
-	auto on_name_change_accept = [entry](const std::string &new_name) {
+	auto on_name_change_accept = [this, entry](const std::string &new_name) {
 		if (new_name.empty()) return false;
-		entry->meta.name = new_name;
+		writer.modify([&](keychain::EntryChanges &) { entry->meta.name = new_name; });
 		return true;
 	};
 
-	auto on_details_change_accept = [entry](const std::string &new_details) {
+	auto on_details_change_accept = [this, entry](const std::string &new_details) {
 		if (new_details.empty()) return false;
-		entry->meta.details = new_details;
+		writer.modify([&](keychain::EntryChanges &) { entry->meta.details = new_details; });
 		return true;
 	};
 
@@ -432,10 +667,29 @@ void KeychainMainScreen::post_entry_edit(keychain::Entry::ptr entry) {
 	entry_edit_form->add_output(std::make_unique<SensitiveOutputHandler>(
 	    Point{2, 8}, utils::sensitive_string("somesecret")));
 
+	auto on_tags_change_accept = [this, entry](const std::string &new_tags) {
+		std::vector<std::string> tags;
+		try {
+			tags = keychain::parse_tags(new_tags);
+		} catch (const std::runtime_error &) {
+			return false;
+		}
+		writer.modify([&](keychain::EntryChanges &changes) {
+			entry->meta.tags = std::move(tags);
+			changes.changed(*entry);
+		});
+		refresh_flat_entries();
+		return true;
+	};
+
 	auto details_input = entry_edit_form->add_field<StringInputHandler>(
 	    on_details_change_accept, Point{3, 0}, "Details: ");
 	details_input->set_value(entry->meta.details);
 
+	auto tags_input = entry_edit_form->add_field<StringInputHandler>(
+	    on_tags_change_accept, Point{4, 0}, "Tags: ");
+	tags_input->set_value(keychain::join_tags(entry->meta.tags));
+
 	state = State::Editing;
 	wmanager->push_controller(std::move(entry_edit_form));
 }
@@ -447,11 +701,13 @@ void KeychainMainScreen::post_dir_delete(keychain::Directory::ptr dir) {
 		state = State::Browsing;
 
 		if (*confirm_result == "y") {
-			auto &parent_dirs = dir->parent_dir.lock()->dirs;
-			parent_dirs.erase(std::remove(parent_dirs.begin(), parent_dirs.end(), dir));
-
-			m_keychain->save_entries(keychain_root_dir);
-			flat_entries_cache = flatten_dirs(keychain_root_dir);
+			writer.modify([&dir](keychain::EntryChanges &changes) {
+				auto &parent_dirs = dir->parent_dir.lock()->dirs;
+				parent_dirs.erase(
+				    std::remove(parent_dirs.begin(), parent_dirs.end(), dir), parent_dirs.end());
+				changes.removed(*dir);
+			});
+			refresh_flat_entries();
 		}
 
 		this->wmanager->pop_controller();
@@ -486,11 +742,14 @@ void KeychainMainScreen::post_entry_delete(keychain::Entry::ptr entry) {
 		state = State::Browsing;
 
 		if (*confirm_result == "y") {
-			auto &parent_entries = entry->parent_dir.lock()->entries;
-			parent_entries.erase(std::remove(parent_entries.begin(), parent_entries.end(), entry));
-
-			m_keychain->save_entries(keychain_root_dir);
-			flat_entries_cache = flatten_dirs(keychain_root_dir);
+			writer.modify([&entry](keychain::EntryChanges &changes) {
+				auto &parent_entries = entry->parent_dir.lock()->entries;
+				parent_entries.erase(
+				    std::remove(parent_entries.begin(), parent_entries.end(), entry),
+				    parent_entries.end());
+				changes.removed(*entry);
+			});
+			refresh_flat_entries();
 		}
 
 		this->wmanager->pop_controller();
@@ -20,27 +20,66 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #pragma once
 
 #include <src/tui/fwd.h>
+#include <src/tui/idle_scheduler.h>
+#include <src/tui/row_renderer.h>
 #include <src/tui/screen_controller.h>
 
 #include <src/keychain/keychain.h>
+#include <src/keychain/persistence_writer.h>
+#include <src/keychain/secret_prefetcher.h>
+#include <src/keychain/tag_index.h>
 
+#include <src/utils/memory.h>
+
+#include <atomic>
 #include <memory>
+#include <mutex>
+#include <string>
 #include <vector>
 
 class KeychainMainScreen : public ScreenController {
 	enum class State { Browsing, CreatingOrDeleting, Editing } state = State::Browsing;
 
 	std::shared_ptr<keychain::Keychain> m_keychain;
+	keychain::SecretPrefetcher prefetcher;
+
+	/* left by the writer's thread for the next frame, it may outlive this screen */
+	struct WriterNews {
+		std::atomic<bool> rebased{false};
+		std::mutex mutex;
+		std::vector<std::string> failures; // under mutex
+	};
+	std::shared_ptr<WriterNews> writer_news = std::make_shared<WriterNews>();
+	keychain::WriterCallbacks writer_callbacks();
+	void take_writer_news();
+
+	keychain::PersistenceWriter writer; // every change to the tree goes through it
 	keychain::Directory::ptr keychain_root_dir;
 	std::vector<keychain::AnyKeychainPtr> flat_entries_cache;
+	utils::memory::Accounted flat_entries_accounted{utils::memory::Category::Caches};
+	void refresh_flat_entries();
 	int c_selected_index = 0;
 
+	/* while set only the entries matching it are listed, by the tag index of the writer */
+	std::string tag_filter;
+	void post_filter_form();
+
 	int maxlines, maxcols;
-	WINDOW *header, *main, *details, *footer;
+	WINDOW *header = nullptr, *main = nullptr, *details = nullptr, *footer = nullptr;
+	RowRenderer entries_rows, details_rows;
 
 	std::optional<keychain::AnyKeychainPtr> clipboard;
 	void paste_into_dir(keychain::Directory::ptr parent_dir);
 
+	/* secrets of the entries this close to the cursor are derived in the background */
+	static constexpr int PREFETCH_RADIUS = 2;
+	void prefetch_around_cursor();
+
+	/* pasted entries keep their derivation path and so share the secret with the original */
+	IdleScheduler::TaskId integrity_task = 0;
+	int n_sharing_secrets = 0;
+	void schedule_integrity_check();
+
 	void post_entry_form();
 	void post_directory_form();
 
@@ -50,6 +89,7 @@ class KeychainMainScreen : public ScreenController {
 	void post_dir_delete(keychain::Directory::ptr dir);
 	void post_entry_delete(keychain::Entry::ptr entry);
 
+	void draw_footer();
 	void draw_entries_box();
 	void draw_details_box();
 
@@ -20,51 +20,119 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include <src/tui/manager.h>
 
 #include <src/tui/color.h>
+#include <src/tui/debug_screen.h>
 #include <src/tui/error_screen.h>
 #include <src/tui/screen_controller.h>
 #include <src/tui/utils.h>
 
+#include <src/utils/metrics.h>
+
 #include <curses.h>
+#include <fcntl.h>
 #include <locale.h>
+#include <poll.h>
 #include <signal.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <sys/eventfd.h>
+#endif
 
-#include <chrono>
-#include <stack>
-#include <thread>
+#include <cassert>
+#include <cerrno>
+#include <cstdint>
+#include <stdexcept>
 
 namespace {
 
 WindowManager *g_manager;
 
+/* available on every screen */
+constexpr int KEY_DEBUG_SCREEN = KEY_F(12);
+
 void resizeHandler(int) {
 	if (g_manager) g_manager->on_resize();
 }
 
 } // namespace
 
-WindowManager::WindowManager() {
+WindowManager::WindowManager() :
+    scheduler([this]() { return input_pending(); },
+        [this](std::function<void()> callback) {
+	        push_event({EVT::EV_CALLBACK, {std::move(callback)}});
+        }) {
+	init_wakeups();
+
 	setlocale(LC_ALL, "");
 	initscr();
-	noecho();
-	cbreak();
-	keypad(stdscr, TRUE);
-	nodelay(stdscr, TRUE);
-	curs_set(0);
-	init_colors();
+	input_fd = STDIN_FILENO;
+	init_curses();
 
 	g_manager = this;
 	signal(SIGWINCH, resizeHandler);
 }
 
+WindowManager::WindowManager(FILE *input, FILE *output, const char *term) :
+    scheduler([this]() { return input_pending(); },
+        [this](std::function<void()> callback) {
+	        push_event({EVT::EV_CALLBACK, {std::move(callback)}});
+        }) {
+	init_wakeups();
+
+	terminal = newterm(term, output, input);
+	if (!terminal) throw std::runtime_error(std::string("unknown terminal type ") + term);
+	input_fd = fileno(input);
+	init_curses();
+}
+
 WindowManager::~WindowManager() {
-	g_manager = nullptr;
+	{
+		/* waits for a request being made right now */
+		std::lock_guard<std::mutex> lock(m_redraw_handle->mutex);
+		m_redraw_handle->wmanager = nullptr;
+	}
+	if (g_manager == this) g_manager = nullptr;
+	/* a loop that was stepped may still have screens, they go while curses is still there */
+	quit();
 	endwin();
+	if (terminal) delscreen(terminal);
+
+	close(wake_read_fd);
+	if (wake_write_fd != wake_read_fd) close(wake_write_fd);
+}
+
+void WindowManager::init_wakeups() {
+#ifdef __linux__
+	wake_read_fd = wake_write_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (wake_read_fd < 0) throw std::runtime_error("could not create eventfd");
+#else
+	int fds[2];
+	if (pipe(fds) < 0) throw std::runtime_error("could not create wakeup pipe");
+	for (int fd : fds) {
+		fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+		fcntl(fd, F_SETFD, FD_CLOEXEC);
+	}
+	wake_read_fd = fds[0];
+	wake_write_fd = fds[1];
+#endif
+}
+
+void WindowManager::init_curses() {
+	noecho();
+	cbreak();
+	keypad(stdscr, TRUE);
+	nodelay(stdscr, TRUE);
+	curs_set(0);
+	init_colors();
 }
 
 void WindowManager::push_event(WindowEvent ev) {
-	std::unique_lock<std::mutex> lk(ev_mutex);
-	ev_queue.push(std::move(ev));
-	ev_cv.notify_one();
+	/* the queue has a single producer: screens post from the loop thread only */
+	assert(loop_thread == std::thread::id() || loop_thread == std::this_thread::get_id());
+
+	if (!ev_queue.try_push(std::move(ev))) {
+		throw std::runtime_error("too many pending window events");
+	}
 }
 
 void WindowManager::set_controller(std::shared_ptr<ScreenController> new_controller) {
@@ -79,105 +147,176 @@ void WindowManager::pop_controller() { push_event({EVT::EV_POP_CONTROLLER, {}});
 
 void WindowManager::stop() { push_event({EVT::EV_QUIT, {}}); }
 
-void WindowManager::on_resize() { push_event({EVT::EV_RESIZE, {}}); }
+void WindowManager::wake() {
+	/* write() is async-signal-safe, a full pipe means a wakeup is pending anyway */
+	uint64_t one = 1;
+#ifdef __linux__
+	[[maybe_unused]] auto rv = write(wake_write_fd, &one, sizeof(one));
+#else
+	[[maybe_unused]] auto rv = write(wake_write_fd, &one, 1);
+#endif
+}
+
+void WindowManager::drain_wakeups() {
+	uint64_t buf[16];
+	while (read(wake_read_fd, buf, sizeof(buf)) > 0) {
+	}
+}
 
-void WindowManager::getch_loop() {
+/* whether a key, a wakeup or a resize is waiting */
+bool WindowManager::input_pending() const {
+	if (resize_pending) return true;
+	pollfd fds[2] = {{input_fd, POLLIN, 0}, {wake_read_fd, POLLIN, 0}};
+	return poll(fds, 2, 0) > 0;
+}
 
-	for (; should_getch;) {
-		int ch = getch();
+void WindowManager::on_resize() {
+	resize_pending.store(true);
+	wake();
+}
+
+void WindowManager::request_redraw() {
+	/* one wakeup covers any number of requests made before the next frame */
+	if (!redraw_requested.exchange(true)) wake();
+}
+
+void RedrawHandle::request() {
+	std::lock_guard<std::mutex> lock(mutex);
+	if (wmanager) wmanager->request_redraw();
+}
 
-		if (ch == ERR) {
-			using namespace std::chrono_literals;
-			std::this_thread::sleep_for(10ms);
-			continue;
-		} else if (ch == KEY_RAW_ALT) {
+void WindowManager::run(std::shared_ptr<ScreenController> initial_screen) {
+	start(std::move(initial_screen));
+	while (step(-1)) {
+	}
+}
+
+void WindowManager::start(std::shared_ptr<ScreenController> initial_screen) {
+	loop_thread = std::this_thread::get_id();
+
+	controller_stack.push(initial_screen);
+	initial_screen->init();
+}
+
+/* always false, for returning from the loop */
+bool WindowManager::quit() {
+	while (!controller_stack.empty()) {
+		controller_stack.pop();
+	}
+	loop_thread = std::thread::id();
+	return false;
+}
+
+/* false once there is nothing left to run */
+bool WindowManager::apply_events() {
+	WindowEvent ev;
+	while (ev_queue.try_pop(ev)) {
+		TRACE_SPAN("tui", "event");
+		std::shared_ptr<ScreenController> current_controller = controller_stack.top();
+
+		switch (ev.code) {
+		case EVT::EV_SET_CONTROLLER:
+			current_controller->cleanup();
+			controller_stack.pop();
+			controller_stack.push(std::get<std::shared_ptr<ScreenController>>(ev.data));
+			controller_stack.top()->init();
+			break;
+		case EVT::EV_PUSH_CONTROLLER:
+			current_controller->cleanup();
+			controller_stack.push(std::move(std::get<std::shared_ptr<ScreenController>>(ev.data)));
+			controller_stack.top()->init();
+			break;
+		case EVT::EV_POP_CONTROLLER:
+			current_controller->cleanup();
+			controller_stack.pop();
+			if (controller_stack.empty()) return false;
+			controller_stack.top()->init();
+			break;
+		case EVT::EV_CALLBACK:
+			std::get<std::function<void()>>(ev.data)();
+			break;
+		case EVT::EV_QUIT:
+			return false;
+		}
+	}
+	return true;
+}
+
+/* every key that is already there is handled before the next frame is drawn */
+bool WindowManager::handle_input() {
+	for (int ch; (ch = getch()) != ERR;) {
+		TRACE_SPAN("tui", "key");
+		if (ch == KEY_RAW_ALT) {
 			// will return immediately
 			int ch2 = getch();
-			if (ch2 == ERR) {
-				push_event({EVT::EV_KEY, {KEY_ESC}});
-			} else {
-				// TODO: add alt-key handling
-				push_event({EVT::EV_KEY, {ch2}});
-			}
+			// TODO: add alt-key handling
+			ch = ch2 == ERR ? KEY_ESC : ch2;
+		}
+
+		if (observer) observer->on_key(ch, *controller_stack.top());
+
+		if (ch == KEY_RESIZE) {
+			controller_stack.top()->on_resize();
+		} else if (ch == KEY_DEBUG_SCREEN) {
+			push_controller(std::make_shared<DebugScreen>(this));
 		} else {
-			push_event({EVT::EV_KEY, {ch}});
+			controller_stack.top()->on_key(ch);
 		}
+
+		/* the next key goes to whichever screen this one switched to */
+		if (!apply_events()) return false;
 	}
+	return true;
 }
 
-void WindowManager::run(std::shared_ptr<ScreenController> initial_screen) {
-	auto getch_thread = std::thread([this]() { this->getch_loop(); });
+bool WindowManager::busy() const {
+	return !ev_queue.empty() || scheduler.has_work() || input_pending();
+}
 
-	std::stack<std::shared_ptr<ScreenController>> controller_stack;
-	controller_stack.push(initial_screen);
-	initial_screen->init();
+bool WindowManager::step(int timeout_ms) {
+	try {
+		if (!apply_events()) return quit();
+		if (resize_pending.exchange(false)) controller_stack.top()->on_resize();
+		if (!handle_input()) return quit();
 
-	auto m_stop = [this, &getch_thread, &controller_stack]() {
-		should_getch = false;
-		while (!controller_stack.empty()) {
-			controller_stack.pop();
+		redraw_requested = false;
+		{
+			METRICS_LATENCY("frame");
+			controller_stack.top()->draw();
 		}
-		getch_thread.join();
-	};
-
-	for (;;) {
-		try {
-			if (controller_stack.empty()) return m_stop();
-
-			std::shared_ptr<ScreenController> current_controller = controller_stack.top();
-			current_controller->draw();
-
-			WindowEvent ev;
-
-			{
-				std::unique_lock<std::mutex> lk(ev_mutex);
-				while (ev_queue.empty()) ev_cv.wait(lk);
-
-				if (ev_queue.empty()) continue;
-
-				ev = std::move(ev_queue.front());
-				ev_queue.pop();
-			}
-
-			switch (ev.code) {
-			case EVT::EV_KEY:
-				current_controller->on_key(std::get<int>(ev.data));
-				break;
-			case EVT::EV_RESIZE:
-				current_controller->on_resize();
-				break;
-			case EVT::EV_SET_CONTROLLER:
-				current_controller->cleanup();
-				controller_stack.pop();
-				controller_stack.push(std::get<std::shared_ptr<ScreenController>>(ev.data));
-				current_controller = controller_stack.top();
-				current_controller->init();
-				break;
-			case EVT::EV_PUSH_CONTROLLER:
-				current_controller->cleanup();
-				controller_stack.push(
-				    std::move(std::get<std::shared_ptr<ScreenController>>(ev.data)));
-				current_controller = controller_stack.top();
-				current_controller->init();
-				break;
-			case EVT::EV_POP_CONTROLLER:
-				current_controller->cleanup();
-				controller_stack.pop();
-				if (controller_stack.empty()) {
-					return m_stop();
-				}
-				controller_stack.top()->init();
-				break;
-			case EVT::EV_QUIT:
-				return m_stop();
-			}
-		} catch (const std::exception &e) {
-			if (!controller_stack.empty()) {
-				controller_stack.top()->cleanup();
-				controller_stack.top()->init();
-			}
-
-			controller_stack.push(std::make_shared<ErrorScreen>(this, Point{2, 2}, e.what()));
+		if (observer) observer->on_frame();
+
+		/* drawing may have switched screens, that is drawn right away */
+		if (!ev_queue.empty()) return true;
+
+		while (ev_queue.empty() && scheduler.has_work() && !input_pending()) {
+			scheduler.run_once();
+		}
+		if (!ev_queue.empty()) return true;
+
+		pollfd fds[2] = {{input_fd, POLLIN, 0}, {wake_read_fd, POLLIN, 0}};
+		if (poll(fds, 2, timeout_ms) < 0 && errno != EINTR) {
+			throw std::runtime_error("poll failed");
 		}
+		if (fds[1].revents & POLLIN) drain_wakeups();
+
+		/* the terminal is gone, nothing more will ever be read */
+		if (fds[0].revents & (POLLHUP | POLLERR | POLLNVAL)) return quit();
+	} catch (const std::exception &e) {
+		if (!controller_stack.empty()) {
+			controller_stack.top()->cleanup();
+			controller_stack.top()->init();
+		}
+
+		controller_stack.push(std::make_shared<ErrorScreen>(this, Point{2, 2}, e.what()));
 	}
+	return true;
+}
+
+void ThrottledRedraw::request() {
+	using namespace std::chrono;
+	const int64_t now = duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count();
+	int64_t last = last_ms.load();
+	if (now - last < interval.count()) return;
+	if (last_ms.compare_exchange_strong(last, now)) wmanager->request_redraw();
 }
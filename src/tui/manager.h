@@ -19,48 +19,138 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
 #pragma once
 
-#include <condition_variable>
+#include <src/tui/idle_scheduler.h>
+
+#include <src/utils/spsc_queue.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
 #include <memory>
 #include <mutex>
-#include <queue>
+#include <stack>
+#include <thread>
 #include <variant>
 
 class ScreenController;
+struct screen; // curses' SCREEN
 
-enum class EVT {
-	EV_KEY,
-	EV_RESIZE,
-	EV_SET_CONTROLLER,
-	EV_PUSH_CONTROLLER,
-	EV_POP_CONTROLLER,
-	EV_QUIT
-};
+enum class EVT { EV_SET_CONTROLLER, EV_PUSH_CONTROLLER, EV_POP_CONTROLLER, EV_CALLBACK, EV_QUIT };
 
 struct WindowEvent {
 	EVT code;
-	std::variant<int, std::shared_ptr<ScreenController>> data; // TODO: should be unique_ptr
+	// TODO: should be unique_ptr
+	std::variant<int, std::shared_ptr<ScreenController>, std::function<void()>> data;
+};
+
+/* Told about every key and frame on the loop thread, e.g. to record or time a session */
+class WindowObserver {
+  public:
+	virtual ~WindowObserver() = default;
+
+	/* screen is the one the key goes to */
+	virtual void on_key(int /* key */, const ScreenController & /* screen */) {}
+	virtual void on_frame() {}
+};
+
+class WindowManager;
+
+/* Asks a manager for a redraw, and may outlive it: requests made once the manager is gone are
+ * dropped. For callbacks that can still run after the screen that set them up was destroyed. */
+class RedrawHandle {
+	friend class WindowManager;
+
+	std::mutex mutex;
+	WindowManager *wmanager;
+
+  public:
+	explicit RedrawHandle(WindowManager *wmanager) : wmanager(wmanager) {}
+
+	void request(); // safe to call from any thread
 };
 
+/* Single-threaded loop: poll() waits on the terminal and a wakeup fd, then every pending key is
+ * handled and the screen is drawn once. Controller changes are posted by screens from the loop
+ * thread and applied between keys; other threads can only ask for a redraw. Idle tasks run in the
+ * gaps, until there is something to handle again. */
 class WindowManager {
-	std::mutex ev_mutex;
-	std::condition_variable ev_cv;
-	std::queue<WindowEvent> ev_queue;
+	static constexpr size_t MAX_PENDING_EVENTS = 64;
 
-	bool should_getch = true;
-	void getch_loop();
+	utils::SpscQueue<WindowEvent, MAX_PENDING_EVENTS> ev_queue;
+	std::thread::id loop_thread;
+
+	/* the process' terminal unless the manager was given another one */
+	struct screen *terminal = nullptr;
+	int input_fd = -1;
+
+	/* eventfd, or both ends of a self-pipe where there is none */
+	int wake_read_fd = -1;
+	int wake_write_fd = -1;
+	std::atomic<bool> redraw_requested{false};
+	std::atomic<bool> resize_pending{false};
+
+	IdleScheduler scheduler;
+	std::shared_ptr<RedrawHandle> m_redraw_handle = std::make_shared<RedrawHandle>(this);
+
+	std::stack<std::shared_ptr<ScreenController>> controller_stack;
+	WindowObserver *observer = nullptr;
+
+	void init_wakeups();
+	void init_curses();
 
 	void push_event(WindowEvent ev);
+	void wake();
+	void drain_wakeups();
+	bool input_pending() const;
+
+	bool apply_events();
+	bool handle_input();
+	bool quit();
 
   public:
 	WindowManager();
+	/* draws to output and reads keys from input as a terminal of the given terminfo type would */
+	WindowManager(FILE *input, FILE *output, const char *term);
 	~WindowManager();
 
 	void run(std::shared_ptr<ScreenController> initial_screen);
 
+	/* run() in pieces: step() handles whatever is pending, draws a frame and runs idle tasks,
+	 * then waits up to timeout_ms (-1 for ever) for something new. False once the loop is over. */
+	void start(std::shared_ptr<ScreenController> initial_screen);
+	bool step(int timeout_ms);
+	/* whether a step would have anything to do right away */
+	bool busy() const;
+
+	/* loop thread only, nullptr to stop observing */
+	void set_observer(WindowObserver *new_observer) { observer = new_observer; }
+
 	void set_controller(std::shared_ptr<ScreenController> new_controller);
 	void push_controller(std::shared_ptr<ScreenController> new_controller);
 	void pop_controller(); // or do delete_controller(ScreenController*) if needed
 	void stop();
 
-	void on_resize();
+	/* loop thread only, like the controller changes */
+	IdleScheduler &idle() { return scheduler; }
+
+	void on_resize();      // async-signal-safe
+	void request_redraw(); // safe to call from any thread
+	std::shared_ptr<RedrawHandle> redraw_handle() const { return m_redraw_handle; }
+};
+
+/* For progress reported from worker threads: asks for at most one redraw per interval, so that
+ * the loop isn't kept busy drawing every step */
+class ThrottledRedraw {
+	WindowManager *wmanager;
+	const std::chrono::milliseconds interval;
+	std::atomic<int64_t> last_ms{0};
+
+  public:
+	explicit ThrottledRedraw(WindowManager *wmanager,
+	    std::chrono::milliseconds interval = std::chrono::milliseconds(100)) :
+	    wmanager(wmanager), interval(interval) {}
+
+	void request(); // safe to call from any thread
 };
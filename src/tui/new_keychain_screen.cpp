@@ -23,6 +23,7 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include <src/tui/form_controller.h>
 #include <src/tui/input.h>
 #include <src/tui/keychain_main_screen.h>
+#include <src/tui/operation_screen.h>
 
 #include <src/crypto/crypto.h>
 #include <src/crypto/mnemonic.h>
@@ -32,6 +33,7 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include <curses.h>
 
 #include <filesystem>
+#include <future>
 #include <memory>
 #include <optional>
 #include <string>
@@ -41,23 +43,52 @@ struct DBInputResult {
 	std::optional<crypto::PasswordHash> pw_hash{};
 };
 
+/* The seed is derived in the background while the user writes the mnemonic down */
 class GenerateKeychainScreen : public ScreenController {
 	std::filesystem::path db_path;
 	crypto::PasswordHash pw_hash;
-	crypto::Seed seed;
+	std::future<crypto::Seed> seed;
 	std::vector<std::unique_ptr<StringOutputHandler>> outputs;
 
 	void m_draw() override {
 		for (auto &output : outputs) {
 			output->draw();
 		}
+
+		mvaddstr(6, 5,
+		    utils::is_ready(seed) ? "Press any key to continue." : "Deriving seed...          ");
 	}
 
 	void m_on_key(int) override {
-		auto keychain = keychain::Keychain::initialize_with_seed(
-		    this->db_path, std::move(this->seed), std::move(this->pw_hash));
-		this->wmanager->set_controller(
-		    std::make_shared<KeychainMainScreen>(this->wmanager, std::move(keychain)));
+		if (!utils::is_ready(seed)) return;
+
+		auto created = std::make_shared<std::unique_ptr<keychain::Keychain>>();
+		auto start = [db_path = this->db_path,
+		                 seed = std::make_shared<crypto::Seed>(this->seed.get()),
+		                 pw_hash = this->pw_hash, created](utils::OperationOptions options) {
+			auto on_done = options.on_done;
+			return utils::run_async(
+			    [db_path, seed, pw_hash, created, options = std::move(options)]() {
+				    *created = keychain::Keychain::initialize_with_seed(
+				        db_path, std::move(*seed), pw_hash, options);
+			    },
+			    std::move(on_done));
+		};
+
+		auto wmanager = this->wmanager;
+		auto on_finished = [wmanager, created](std::future<void> &future) {
+			try {
+				future.get();
+				wmanager->set_controller(
+				    std::make_shared<KeychainMainScreen>(wmanager, std::move(*created)));
+			} catch (const std::exception &e) {
+				wmanager->set_controller(
+				    std::make_shared<ErrorScreen>(wmanager, Point{2, 5}, e.what()));
+			}
+		};
+
+		this->wmanager->set_controller(std::make_shared<OperationScreen>(
+		    wmanager, "Creating keychain " + db_path.string(), start, on_finished));
 	}
 
   public:
@@ -76,12 +107,18 @@ class GenerateKeychainScreen : public ScreenController {
 			}
 		}
 
-		seed = crypto::mnemonic_to_seed(std::move(mnemonic));
+		utils::OperationOptions options;
+		options.on_done = [redraw = wmanager->redraw_handle()]() { redraw->request(); };
+		seed = crypto::mnemonic_to_seed_async(std::move(mnemonic), std::move(options));
 
 		outputs.push_back(std::make_unique<StringOutputHandler>(Point{3, 5},
-		    "Please write down the following mnemonic and press any key to continue."));
+		    "Please write down the following mnemonic."));
 		outputs.push_back(std::make_unique<StringOutputHandler>(Point{4, 5}, combined_mnemonic));
 	}
+
+	~GenerateKeychainScreen() {
+		if (seed.valid()) seed.wait();
+	}
 };
 
 NewKeychainScreen::NewKeychainScreen(
@@ -35,6 +35,7 @@ class NewKeychainScreen : public ScreenController {
 	void m_init() override;
 	void m_draw() override;
 	void m_on_key(int key) override;
+	bool m_takes_secrets() const override { return true; }
 
   public:
 	NewKeychainScreen(WindowManager *wmanager, const std::filesystem::path &kc_path);
@@ -25,6 +25,8 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include <src/tui/input.h>
 #include <src/tui/keychain_main_screen.h>
 #include <src/tui/menu.h>
+#include <src/tui/quick_open_screen.h>
+#include <src/tui/recover_mnemonic_screen.h>
 
 #include <src/crypto/crypto.h>
 #include <src/crypto/utils.h>
@@ -37,10 +39,10 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include <optional>
 #include <string>
 
-OpenKeychainScreen::OpenKeychainScreen(
-    WindowManager *wmanager, const std::filesystem::path &kc_path) :
+OpenKeychainScreen::OpenKeychainScreen(WindowManager *wmanager,
+    const std::filesystem::path &kc_path, std::chrono::seconds cache_timeout) :
     ScreenController(wmanager),
-    window(stdscr), kc_path(kc_path) {}
+    window(stdscr), kc_path(kc_path), unlock_cache(cache_timeout) {}
 
 void OpenKeychainScreen::post_pass_form() {
 	using FormResult = std::optional<crypto::PasswordHash>;
@@ -48,7 +50,7 @@ void OpenKeychainScreen::post_pass_form() {
 
 	auto on_form_done = [this, result]() {
 		try {
-			this->kc = keychain::Keychain::open(this->kc_path, result->value());
+			this->kc = this->unlock_cache.open(this->kc_path, result->value());
 			post_action_form();
 		} catch (const std::exception &e) {
 			this->wmanager->set_controller(
@@ -77,7 +79,7 @@ void OpenKeychainScreen::post_pass_form() {
 void OpenKeychainScreen::post_action_form() {
 	struct ActionMenuEntry {
 		std::string title;
-		enum Action { Open, Export, Exit } action;
+		enum Action { Open, Export, Recover, Exit } action;
 	};
 
 	std::shared_ptr<ActionMenuEntry::Action> result =
@@ -87,13 +89,27 @@ void OpenKeychainScreen::post_action_form() {
 		try {
 			switch (*result) {
 			case ActionMenuEntry::Action::Open:
-				this->wmanager->push_controller(
-				    std::make_shared<KeychainMainScreen>(this->wmanager, this->kc));
+				/* entries used before are offered first, the tree loads meanwhile */
+				if (this->kc->access_log().top().empty()) {
+					this->wmanager->push_controller(
+					    std::make_shared<KeychainMainScreen>(this->wmanager, this->kc));
+				} else {
+					this->wmanager->push_controller(
+					    std::make_shared<QuickOpenScreen>(this->wmanager, this->kc));
+				}
 				break;
 			case ActionMenuEntry::Action::Export:
 				this->wmanager->push_controller(
 				    std::make_shared<ExportKeychainScreen>(this->wmanager, this->kc));
 				break;
+			case ActionMenuEntry::Action::Recover: {
+				auto kc = this->kc;
+				auto matcher = [kc, matches = kc->seed_matcher()](
+				                   const crypto::Seed &seed) { return matches(seed); };
+				this->wmanager->push_controller(
+				    std::make_shared<RecoverMnemonicScreen>(this->wmanager, matcher, nullptr));
+				break;
+			}
 			case ActionMenuEntry::Action::Exit:
 				this->wmanager->stop();
 				break;
@@ -123,6 +139,7 @@ void OpenKeychainScreen::post_action_form() {
 	std::vector<ActionMenuEntry> menu_entries{
 	    {std::string{"Open keychain"}, ActionMenuEntry::Action::Open},
 	    {std::string{"Export keychain"}, ActionMenuEntry::Action::Export},
+	    {std::string{"Recover mnemonic"}, ActionMenuEntry::Action::Recover},
 	    {std::string{"Exit"}, ActionMenuEntry::Action::Exit},
 	};
 
@@ -131,6 +148,15 @@ void OpenKeychainScreen::post_action_form() {
 }
 
 void OpenKeychainScreen::m_init() {
+	/* unlocked recently, no need to ask again */
+	if (!kc && !m_form) {
+		try {
+			kc = unlock_cache.open(kc_path);
+		} catch (const std::exception &) {
+			unlock_cache.forget(kc_path);
+		}
+	}
+
 	if (!m_form) {
 		if (kc /* and master seed decrypted */) {
 			post_action_form();
@@ -24,7 +24,9 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include <src/tui/screen_controller.h>
 
 #include <src/keychain/keychain.h>
+#include <src/keychain/unlock_cache.h>
 
+#include <chrono>
 #include <filesystem>
 
 class OpenKeychainScreen : public ScreenController {
@@ -32,6 +34,7 @@ class OpenKeychainScreen : public ScreenController {
 	const std::filesystem::path kc_path;
 
 	std::shared_ptr<keychain::Keychain> kc;
+	keychain::UnlockCache unlock_cache;
 
 	enum class State { Init, Pass, AwaitPassCleanup, Action } state = State::Init;
 	std::unique_ptr<FormController> m_form;
@@ -42,7 +45,9 @@ class OpenKeychainScreen : public ScreenController {
 	void m_cleanup() override;
 	void m_draw() override;
 	void m_on_key(int key) override;
+	bool m_takes_secrets() const override { return true; }
 
   public:
-	OpenKeychainScreen(WindowManager *wmanager, const std::filesystem::path &kc_path);
+	OpenKeychainScreen(WindowManager *wmanager, const std::filesystem::path &kc_path,
+	    std::chrono::seconds cache_timeout = keychain::DEFAULT_UNLOCK_CACHE_TIMEOUT);
 };
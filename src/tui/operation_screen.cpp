@@ -0,0 +1,73 @@
+/*
+
+Copyright (C) 2019 Mateusz Morusiewicz
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#include <src/tui/operation_screen.h>
+
+#include <src/tui/utils.h>
+
+#include <curses.h>
+
+#include <algorithm>
+
+OperationScreen::OperationScreen(
+    WindowManager *wmanager, std::string title, const Start &start, OnFinished on_finished) :
+    ScreenController(wmanager),
+    window(stdscr), title(std::move(title)), on_finished(std::move(on_finished)),
+    progress_redraw(wmanager) {
+	utils::OperationOptions options;
+	options.cancel_token = cancel_token;
+	options.progress = &progress;
+	options.on_progress = [this]() { progress_redraw.request(); };
+	/* runs after the future is ready, so this screen and even the manager may be gone by then */
+	options.on_done = [redraw = wmanager->redraw_handle()]() { redraw->request(); };
+
+	future = start(std::move(options));
+}
+
+OperationScreen::~OperationScreen() {
+	cancel_token.cancel();
+	if (future.valid()) future.wait();
+}
+
+void OperationScreen::m_draw() {
+	if (!finished && utils::is_ready(future)) {
+		finished = true;
+		return on_finished(future);
+	}
+
+	curs_set(0);
+	werase(window);
+	mvwaddstr(window, 0, 0, title.c_str());
+
+	/* the pool may still be busy with something else */
+	const int total = std::max(progress.total.load(), 1);
+	const std::string stage = progress.stage.load();
+	std::string status = (stage.empty() ? "Waiting" : stage) + " (" +
+	                     std::to_string(std::min(progress.done.load() + 1, total)) + "/" +
+	                     std::to_string(total) + ")";
+	mvwaddstr(window, 2, 2, status.c_str());
+	mvwaddstr(
+	    window, 4, 2, cancel_token.is_cancelled() ? "Cancelling..." : "Press <ESC> to cancel.");
+
+	wrefresh(window);
+}
+
+void OperationScreen::m_on_key(int key) {
+	if (key == KEY_ESC) cancel_token.cancel();
+}
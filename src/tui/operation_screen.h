@@ -0,0 +1,58 @@
+/*
+
+Copyright (C) 2019 Mateusz Morusiewicz
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#pragma once
+
+#include <src/tui/fwd.h>
+#include <src/tui/manager.h>
+#include <src/tui/screen_controller.h>
+
+#include <src/utils/async.h>
+
+#include <atomic>
+#include <functional>
+#include <future>
+#include <string>
+
+/* Shows the stages of a background operation and lets the user cancel it with <ESC> */
+class OperationScreen : public ScreenController {
+  public:
+	using Start = std::function<std::future<void>(utils::OperationOptions options)>;
+	/* called on the ui thread, future.get() rethrows whatever the operation threw */
+	using OnFinished = std::function<void(std::future<void> &future)>;
+
+  private:
+	WINDOW *window;
+	std::string title;
+	OnFinished on_finished;
+
+	utils::OperationProgress progress;
+	utils::CancellationToken cancel_token;
+	ThrottledRedraw progress_redraw;
+	std::future<void> future;
+	bool finished = false;
+
+	void m_draw() override;
+	void m_on_key(int key) override;
+
+  public:
+	OperationScreen(WindowManager *wmanager, std::string title, const Start &start,
+	    OnFinished on_finished);
+	~OperationScreen();
+};
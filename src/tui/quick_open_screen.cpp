@@ -0,0 +1,188 @@
+/*
+
+Copyright (C) 2019 Mateusz Morusiewicz
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#include <src/tui/quick_open_screen.h>
+
+#include <src/tui/error_screen.h>
+#include <src/tui/form_controller.h>
+#include <src/tui/help_screen.h>
+#include <src/tui/keychain_main_screen.h>
+
+#include <src/utils/async.h>
+
+#include <curses.h>
+
+#include <algorithm>
+#include <string>
+
+QuickOpenScreen::QuickOpenScreen(WindowManager *wmanager, std::shared_ptr<keychain::Keychain> kc) :
+    ScreenController(wmanager), m_keychain(std::move(kc)), prefetcher(m_keychain),
+    top(m_keychain->access_log().top()) {
+	prefetch_around_cursor();
+
+	auto on_loaded = [redraw = wmanager->redraw_handle(), loaded = tree_loaded]() {
+		*loaded = true;
+		redraw->request();
+	};
+	tree_loading = utils::run_async(
+	    [kc = m_keychain]() { kc->access_log().reconcile(kc->snapshot()->root); }, on_loaded);
+}
+
+QuickOpenScreen::~QuickOpenScreen() {
+	cleanup();
+	/* the load is not cancellable, it is waited for rather than left running on its own */
+	if (tree_loading.valid()) tree_loading.wait();
+}
+
+void QuickOpenScreen::m_init() {
+	clear();
+	refresh();
+
+	getmaxyx(stdscr, this->maxlines, this->maxcols);
+
+	this->header = newwin(1, this->maxcols, 0, 0);
+	mvwaddstr(this->header, 0, 0, "Frequently used in ");
+	waddstr(this->header, this->m_keychain->get_data_dir_path().c_str());
+	wrefresh(this->header);
+
+	this->main = newwin(this->maxlines - 2, this->maxcols / 5 * 3, 1, 0);
+	this->details = newwin(
+	    this->maxlines - 2, this->maxcols - (this->maxcols / 5 * 3), 1, this->maxcols / 5 * 3);
+	this->footer = newwin(1, this->maxcols, this->maxlines - 1, 0);
+	draw_footer();
+
+	rows.invalidate();
+}
+
+void QuickOpenScreen::m_cleanup() {
+	for (WINDOW *win : {header, main, details, footer}) {
+		if (!win) continue;
+		wclear(win);
+		wrefresh(win);
+		delwin(win);
+	}
+	header = main = details = footer = nullptr;
+}
+
+void QuickOpenScreen::draw_footer() {
+	if (!this->footer) return;
+
+	werase(this->footer);
+	mvwaddstr(this->footer, 0, 2, "<?> for help");
+	if (tree_requested && !*tree_loaded) waddstr(this->footer, "  loading all entries...");
+	wrefresh(this->footer);
+}
+
+void QuickOpenScreen::open_tree_when_loaded() {
+	if (!tree_requested || !*tree_loaded) return;
+
+	tree_requested = false;
+	try {
+		tree_loading.get(); // rethrows what failed the load
+		wmanager->set_controller(std::make_shared<KeychainMainScreen>(wmanager, m_keychain));
+	} catch (const std::exception &e) {
+		wmanager->set_controller(std::make_shared<ErrorScreen>(wmanager, Point{2, 5}, e.what()));
+	}
+}
+
+void QuickOpenScreen::prefetch_around_cursor() {
+	std::vector<crypto::DerivationPath> dpaths;
+	const int n_records = top.size();
+
+	/* the selected entry first, then outwards */
+	for (int distance = 0; distance <= PREFETCH_RADIUS; ++distance) {
+		for (int index : {c_selected_index + distance, c_selected_index - distance}) {
+			if (index >= 0 && index < n_records) dpaths.push_back({top[index].dpath});
+			if (distance == 0) break;
+		}
+	}
+
+	prefetcher.prefetch(std::move(dpaths));
+}
+
+void QuickOpenScreen::m_draw() {
+	if (*tree_loaded) {
+		/* paths as they are in the tree now */
+		top = m_keychain->access_log().top();
+		c_selected_index = std::min<int>(c_selected_index, top.size() - 1);
+		if (top.empty()) tree_requested = true;
+	}
+	open_tree_when_loaded();
+	draw_footer();
+
+	if (!this->main) return;
+	rows.begin_frame(getmaxy(this->main));
+	const int max_rows = getmaxy(this->main) - 2;
+	for (int i = 0; i < std::min<int>(max_rows, top.size()); ++i) {
+		const auto &record = top[i];
+		std::string text = record.path.empty() ? "#" + std::to_string(record.dpath) : record.path;
+		text += "  (" + std::to_string(record.count) + ")";
+		rows.set_row(i + 1, {2, std::move(text), i == c_selected_index});
+	}
+	rows.commit(this->main);
+	wrefresh(this->main);
+}
+
+void QuickOpenScreen::post_entry_view(const keychain::AccessRecord &record) {
+	auto on_form_done = [this]() { this->wmanager->pop_controller(); };
+
+	auto entry_view_form =
+	    std::make_unique<FormController>(wmanager, this, this->details, on_form_done, on_form_done);
+
+	entry_view_form->add_label(Point{1, 0}, "Name: " + record.path);
+	entry_view_form->add_label(Point{2, 0}, "Secret: ");
+	entry_view_form->add_output(std::make_unique<SensitiveOutputHandler>(
+	    Point{2, 8}, prefetcher.get({record.dpath})));
+	m_keychain->access_log().record({record.dpath}, record.path);
+
+	wmanager->push_controller(std::move(entry_view_form));
+}
+
+void QuickOpenScreen::m_on_key(int key) {
+	switch (key) {
+	case KEY_DOWN:
+		if (!top.empty()) c_selected_index = (c_selected_index + 1) % top.size();
+		prefetch_around_cursor();
+		break;
+	case KEY_UP:
+		if (!top.empty()) {
+			c_selected_index = c_selected_index <= 0 ? top.size() - 1 : c_selected_index - 1;
+		}
+		prefetch_around_cursor();
+		break;
+	case KEY_ENTER:
+	case KEY_RETURN:
+		if (!top.empty()) post_entry_view(top[c_selected_index]);
+		break;
+	case KEY_TAB:
+	case 'a':
+		tree_requested = true;
+		open_tree_when_loaded();
+		draw_footer();
+		break;
+	case 'q':
+		wmanager->pop_controller();
+		break;
+	case '?':
+		std::vector<const char *> help{"<↑↓> to navigate", "<↲> to view",
+		    "<TAB|a> for all entries", "<q> to go back"};
+		wmanager->push_controller(std::make_shared<HelpScreen>(wmanager, std::move(help)));
+		break;
+	}
+}
@@ -0,0 +1,67 @@
+/*
+
+Copyright (C) 2019 Mateusz Morusiewicz
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#pragma once
+
+#include <src/tui/fwd.h>
+#include <src/tui/row_renderer.h>
+#include <src/tui/screen_controller.h>
+
+#include <src/keychain/keychain.h>
+#include <src/keychain/secret_prefetcher.h>
+
+#include <atomic>
+#include <future>
+#include <memory>
+#include <vector>
+
+/* The most frecent entries, listed as soon as the keychain is unlocked. Their secrets are
+ * prefetched straight from the derivation paths the access log keeps, while the tree is loaded in
+ * the background for when all entries are asked for. */
+class QuickOpenScreen : public ScreenController {
+	std::shared_ptr<keychain::Keychain> m_keychain;
+	keychain::SecretPrefetcher prefetcher;
+	std::vector<keychain::AccessRecord> top;
+	int c_selected_index = 0;
+
+	static constexpr int PREFETCH_RADIUS = 2;
+	void prefetch_around_cursor();
+
+	/* stale paths are fixed and removed entries dropped once the tree is there */
+	std::shared_ptr<std::atomic<bool>> tree_loaded = std::make_shared<std::atomic<bool>>(false);
+	std::future<void> tree_loading;
+	bool tree_requested = false;
+	void open_tree_when_loaded();
+
+	int maxlines, maxcols;
+	WINDOW *header = nullptr, *main = nullptr, *details = nullptr, *footer = nullptr;
+	RowRenderer rows;
+
+	void post_entry_view(const keychain::AccessRecord &record);
+	void draw_footer();
+
+	void m_init() override;
+	void m_cleanup() override;
+	void m_draw() override;
+	void m_on_key(int key) override;
+
+  public:
+	QuickOpenScreen(WindowManager *wmanager, std::shared_ptr<keychain::Keychain> kc);
+	~QuickOpenScreen();
+};
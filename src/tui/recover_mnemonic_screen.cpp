@@ -0,0 +1,158 @@
+/*
+
+Copyright (C) 2019 Mateusz Morusiewicz
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#include <src/tui/recover_mnemonic_screen.h>
+
+#include <src/tui/input.h>
+
+#include <src/crypto/mnemonic.h>
+
+#include <curses.h>
+
+#include <string>
+
+RecoverMnemonicScreen::RecoverMnemonicScreen(WindowManager *wmanager,
+    crypto::SeedMatcher matcher, OnRecovered on_recovered,
+    std::optional<utils::sensitive_string> mnemonic) :
+    ScreenController(wmanager),
+    window(stdscr), matcher(std::move(matcher)), on_recovered(std::move(on_recovered)),
+    progress_redraw(wmanager) {
+	if (mnemonic) {
+		this->mnemonic = std::move(*mnemonic);
+		start_search();
+	}
+}
+
+RecoverMnemonicScreen::~RecoverMnemonicScreen() {
+	cancel_token.cancel();
+	if (search_thread.joinable()) search_thread.join();
+}
+
+void RecoverMnemonicScreen::post_mnemonic_form() {
+	auto on_form_done = [this]() { start_search(); };
+	auto on_form_cancel = [this]() { this->wmanager->pop_controller(); };
+
+	m_form.reset(new FormController(wmanager, nullptr, window, on_form_done, on_form_cancel));
+
+	m_form->add_label(Point{0, 0}, "Recovering mnemonic");
+	m_form->add_label(Point{2, 2},
+	    "Use ? for missing words, misspelled words are corrected. "
+	    "<TAB> completes a word.");
+
+	auto on_accept_mnemonic = [this](const utils::sensitive_string &mnemonic) -> bool {
+		this->mnemonic = mnemonic;
+		return this->mnemonic.size() > 0;
+	};
+
+	m_form->add_field<MnemonicInputHandler>(on_accept_mnemonic, Point{4, 2}, "Mnemonic: ");
+}
+
+void RecoverMnemonicScreen::start_search() {
+	state = State::Searching;
+
+	search_thread = std::thread([this]() {
+		const auto words = crypto::split_mnemonic_words(mnemonic);
+
+		crypto::RecoveryOptions options;
+		options.cancel_token = cancel_token;
+		options.progress = &progress;
+		options.on_progress = [this]() { progress_redraw.request(); };
+
+		try {
+			result = crypto::recover_mnemonic(words, matcher, options);
+		} catch (const std::exception &e) {
+			search_error = e.what();
+		}
+
+		search_finished = true;
+		wmanager->request_redraw();
+	});
+}
+
+void RecoverMnemonicScreen::collect_search() {
+	if (state != State::Searching || !search_finished) return;
+
+	search_thread.join();
+	state = State::Done;
+}
+
+void RecoverMnemonicScreen::m_init() {
+	if (state == State::Input && !m_form) post_mnemonic_form();
+	if (m_form) m_form->init();
+}
+
+void RecoverMnemonicScreen::m_cleanup() {
+	if (m_form) m_form->cleanup();
+}
+
+void RecoverMnemonicScreen::m_draw() {
+	collect_search();
+
+	if (state == State::Input) {
+		if (m_form) m_form->draw();
+		return;
+	}
+
+	curs_set(0);
+	werase(window);
+	mvwaddstr(window, 0, 0, "Recovering mnemonic");
+
+	if (state == State::Searching) {
+		std::string status = "Checked " + std::to_string(progress.checked.load()) + " of " +
+		                     std::to_string(progress.total.load()) + " candidates, derived " +
+		                     std::to_string(progress.derived.load()) + " seeds";
+		mvwaddstr(window, 2, 2, status.c_str());
+		mvwaddstr(window, 4, 2,
+		    cancel_token.is_cancelled() ? "Cancelling..." : "Press <ESC> to cancel.");
+	} else if (result) {
+		mvwaddstr(window, 2, 2, "Recovered mnemonic:");
+		wmove(window, 3, 2);
+		for (const auto &word : *result) {
+			for (size_t i = 0; i < word.size(); ++i) {
+				waddch(window, word[i]);
+			}
+			waddch(window, ' ');
+		}
+		mvwaddstr(window, 5, 2, "Please write it down and press any key to continue.");
+	} else {
+		mvwaddstr(window, 2, 2,
+		    search_error.empty() ? "No matching mnemonic found." : search_error.c_str());
+		mvwaddstr(window, 4, 2, "Press any key to go back.");
+	}
+
+	wrefresh(window);
+}
+
+void RecoverMnemonicScreen::m_on_key(int key) {
+	switch (state) {
+	case State::Input:
+		if (m_form) m_form->on_key(key);
+		break;
+	case State::Searching:
+		if (key == KEY_ESC) cancel_token.cancel();
+		break;
+	case State::Done:
+		if (result && on_recovered) {
+			on_recovered(std::move(*result));
+		} else {
+			wmanager->pop_controller();
+		}
+		break;
+	}
+}
@@ -0,0 +1,75 @@
+/*
+
+Copyright (C) 2019 Mateusz Morusiewicz
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#pragma once
+
+#include <src/tui/form_controller.h>
+#include <src/tui/fwd.h>
+#include <src/tui/manager.h>
+#include <src/tui/screen_controller.h>
+
+#include <src/crypto/mnemonic_recovery.h>
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+class RecoverMnemonicScreen : public ScreenController {
+  public:
+	using OnRecovered = std::function<void(std::vector<utils::sensitive_string>)>;
+
+  private:
+	WINDOW *window;
+	crypto::SeedMatcher matcher;
+	OnRecovered on_recovered;
+
+	enum class State { Input, Searching, Done } state = State::Input;
+	std::unique_ptr<FormController> m_form;
+
+	crypto::RecoveryProgress progress;
+	utils::CancellationToken cancel_token;
+	ThrottledRedraw progress_redraw;
+	std::atomic<bool> search_finished{false};
+	std::thread search_thread;
+
+	std::optional<std::vector<utils::sensitive_string>> result;
+	std::string search_error;
+
+	void post_mnemonic_form();
+	utils::sensitive_string mnemonic;
+
+	void start_search();
+	void collect_search();
+
+	void m_init() override;
+	void m_cleanup() override;
+	void m_draw() override;
+	void m_on_key(int key) override;
+	bool m_takes_secrets() const override { return true; }
+
+  public:
+	/* mnemonic is searched right away if given, otherwise the user is asked for it */
+	RecoverMnemonicScreen(WindowManager *wmanager, crypto::SeedMatcher matcher,
+	    OnRecovered on_recovered, std::optional<utils::sensitive_string> mnemonic = std::nullopt);
+	~RecoverMnemonicScreen();
+};
@@ -0,0 +1,107 @@
+/*
+
+Copyright (C) 2019 Mateusz Morusiewicz
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+
+#include <src/tui/row_renderer.h>
+
+#include <curses.h>
+
+#include <algorithm>
+
+namespace {
+
+bool is_continuation_byte(char c) { return (static_cast<unsigned char>(c) & 0xc0) == 0x80; }
+
+/* bytes of the longest piece of text[from, to) that fits max_bytes without cutting a UTF-8
+ * sequence */
+size_t clip(const std::string &text, size_t from, size_t to, size_t max_bytes) {
+	if (to - from <= max_bytes) return to - from;
+
+	size_t n = max_bytes;
+	while (n > 0 && is_continuation_byte(text[from + n])) --n;
+	return n;
+}
+
+} // namespace
+
+void RowRenderer::begin_frame(size_t n_lines) { current.assign(n_lines, Row{}); }
+
+void RowRenderer::set_row(size_t line, Row row) {
+	if (line < current.size()) current[line] = std::move(row);
+}
+
+std::vector<size_t> RowRenderer::damaged() const {
+	std::vector<size_t> rv;
+	for (size_t line = 0; line < current.size(); ++line) {
+		if (!valid || line >= previous.size() || current[line] != previous[line]) {
+			rv.push_back(line);
+		}
+	}
+	return rv;
+}
+
+size_t RowRenderer::commit(WINDOW *window) {
+	const auto lines = damaged();
+	const int width = getmaxx(window);
+
+	for (size_t line : lines) {
+		const Row &row = current[line];
+		wmove(window, line, 0);
+		wclrtoeol(window);
+
+		if (row.text.empty() || row.col >= width) continue;
+
+		if (row.highlighted) wattron(window, A_STANDOUT);
+		mvwaddnstr(window, line, row.col, row.text.c_str(),
+		    clip(row.text, 0, row.text.size(), width - row.col));
+		if (row.highlighted) wattroff(window, A_STANDOUT);
+	}
+
+	previous.swap(current);
+	valid = true;
+	return lines.size();
+}
+
+void RowRenderer::invalidate() { valid = false; }
+
+std::vector<std::string> wrap_lines(const std::string &text, int width) {
+	std::vector<std::string> rv;
+	const size_t max_bytes = std::max(width, 1);
+
+	size_t begin = 0;
+	while (begin <= text.size()) {
+		size_t end = std::min(text.find('\n', begin), text.size());
+
+		/* an empty line still takes a row, as it does with waddstr */
+		size_t from = begin;
+		do {
+			size_t n = clip(text, from, end, max_bytes);
+			/* a single character wider than the window still goes on its own line */
+			if (n == 0 && from < end) {
+				for (n = 1; from + n < end && is_continuation_byte(text[from + n]);) ++n;
+			}
+			rv.push_back(text.substr(from, n));
+			from += n;
+		} while (from < end);
+
+		begin = end + 1;
+	}
+
+	return rv;
+}
@@ -0,0 +1,69 @@
+/*
+
+Copyright (C) 2019 Mateusz Morusiewicz
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+
+#pragma once
+
+#include <src/tui/fwd.h>
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+/* Row model of a window. Every frame is compared with the previous one and only the lines that
+ * changed are sent to curses, so e.g. moving the selection touches exactly two lines */
+class RowRenderer {
+  public:
+	struct Row {
+		int col = 0;
+		std::string text;
+		bool highlighted = false;
+
+		bool operator==(const Row &other) const {
+			return col == other.col && highlighted == other.highlighted && text == other.text;
+		}
+		bool operator!=(const Row &other) const { return !(*this == other); }
+	};
+
+  private:
+	std::vector<Row> previous, current;
+	bool valid = false;
+
+  public:
+	/* starts a frame of n_lines blank lines */
+	void begin_frame(size_t n_lines);
+
+	/* lines outside of the frame are ignored */
+	void set_row(size_t line, Row row);
+
+	/* lines of the current frame that differ from the previous one */
+	std::vector<size_t> damaged() const;
+
+	/* redraws the damaged lines and makes the current frame the previous one, returns the number
+	 * of lines redrawn */
+	size_t commit(WINDOW *window);
+
+	/* to be called whenever something else has drawn into the window, the next frame is redrawn
+	 * in full */
+	void invalidate();
+};
+
+/* Splits text on newlines and into lines of at most width bytes, never inside of a UTF-8
+ * sequence */
+std::vector<std::string> wrap_lines(const std::string &text, int width);
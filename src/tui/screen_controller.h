@@ -21,6 +21,8 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
 #include <src/tui/manager.h>
 
+#include <src/utils/trace.h>
+
 class ScreenController {
   private:
 	virtual void m_init() {}
@@ -36,6 +38,8 @@ class ScreenController {
 	 */
 	virtual void m_on_key(int key) = 0;
 
+	virtual bool m_takes_secrets() const { return false; }
+
   protected:
 	WindowManager *wmanager;
 
@@ -45,9 +49,15 @@ class ScreenController {
 
 	void init() { this->m_init(); }
 	void cleanup() { this->m_cleanup(); }
-	void draw() { this->m_draw(); }
+	void draw() {
+		TRACE_SPAN("tui", "draw");
+		this->m_draw();
+	}
 
 	void on_resize() { this->m_on_resize(); }
 
 	void on_key(int key) { this->m_on_key(key); }
+
+	/* keys typed here may be passwords or mnemonics, which are never recorded */
+	bool takes_secrets() const { return this->m_takes_secrets(); }
 };
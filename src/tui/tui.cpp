@@ -18,17 +18,26 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 */
 
 #include <src/tui/create_keychain_screen.h>
+#include <src/tui/key_trace.h>
 #include <src/tui/manager.h>
 #include <src/tui/open_keychain_screen.h>
 
+#include <src/cli/commands.h>
+#include <src/keychain/unlock_cache.h>
 #include <src/keychain/utils.h>
 
+#include <src/utils/diagnostics.h>
+
 #include <external/p-ranav/argparse/include/argparse.hpp>
 
+#include <chrono>
+#include <cstdlib>
 #include <filesystem>
+#include <memory>
 
 struct KCConfig {
 	std::filesystem::path kc_path;
+	std::chrono::seconds cache_timeout;
 };
 
 KCConfig process_cmd_line(int argc, const char *argv[]) {
@@ -37,6 +46,10 @@ KCConfig process_cmd_line(int argc, const char *argv[]) {
 	program.add_argument("-p", "--path")
 	    .help("path to keychain data directory")
 	    .default_value(std::string{"~/.hdpwm"});
+	program.add_argument("--cache-timeout")
+	    .help("seconds the unlocked keychain is remembered for, 0 disables it")
+	    .default_value(static_cast<int>(keychain::DEFAULT_UNLOCK_CACHE_TIMEOUT.count()))
+	    .action([](const std::string &value) { return std::stoi(value); });
 
 	try {
 		program.parse_args(argc, argv);
@@ -53,17 +66,32 @@ KCConfig process_cmd_line(int argc, const char *argv[]) {
 	}
 
 	std::string user_provided_path = program.get<std::string>("--path");
-	return {keychain::expand_path(user_provided_path)};
+	return {keychain::expand_path(user_provided_path),
+	    std::chrono::seconds(program.get<int>("--cache-timeout"))};
 }
 
 int main(int argc, const char *argv[]) {
+	utils::Diagnostics diagnostics(
+	    argc, argv, [](std::string_view arg) { return cli::find_command(arg).has_value(); });
+
+	/* commands run without ever touching curses */
+	if (argc > 1) {
+		if (auto command = cli::find_command(argv[1])) return (*command)(argc - 1, argv + 1);
+	}
 
 	auto config = process_cmd_line(argc, argv);
 
 	WindowManager wm;
+
+	std::unique_ptr<KeyRecorder> recorder;
+	if (const char *trace_path = std::getenv("HDPWM_KEY_TRACE"); trace_path && *trace_path) {
+		recorder = std::make_unique<KeyRecorder>(trace_path);
+		wm.set_observer(recorder.get());
+	}
+
 	if (keychain::can_import_db_from_path(config.kc_path)) {
 		// OpenOrExportScreen
-		wm.run(std::make_shared<OpenKeychainScreen>(&wm, config.kc_path));
+		wm.run(std::make_shared<OpenKeychainScreen>(&wm, config.kc_path, config.cache_timeout));
 	} else if (keychain::can_create_db_at_path(config.kc_path)) {
 		// CreateOrImportScreen
 		wm.run(std::make_shared<CreateKeychainScreen>(&wm, config.kc_path));
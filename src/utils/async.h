@@ -0,0 +1,137 @@
+/*
+
+Copyright (C) 2019 Mateusz Morusiewicz
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#pragma once
+
+#include <src/utils/thread_pool.h>
+#include <src/utils/trace.h>
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <future>
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+namespace utils {
+
+/* Thrown by a long-running operation that noticed its token being cancelled */
+class OperationCancelled : public std::runtime_error {
+  public:
+	OperationCancelled() : std::runtime_error("operation cancelled") {}
+};
+
+struct OperationProgress {
+	std::atomic<int> done{0};            // stages finished so far
+	std::atomic<int> total{0};           // stages of the whole operation
+	std::atomic<const char *> stage{""}; // static description of the stage being run
+};
+
+struct OperationOptions {
+	CancellationToken cancel_token{};
+	OperationProgress *progress = nullptr;
+	std::function<void()> on_progress{}; // called from the running thread whenever a stage starts
+	std::function<void()> on_done{};     // async variants only: called once the future is ready
+};
+
+/* Walks an operation through its stages, checking for cancellation before each one */
+class StageReporter {
+	const OperationOptions &options;
+	int started = 0;
+	bool committed = false;
+
+	/* every stage is traced as a span of its own */
+	const char *stage_name = nullptr;
+	int64_t stage_start_ns = -1;
+
+	void end_stage() {
+		if (stage_start_ns >= 0)
+			trace::record("stage", stage_name, stage_start_ns, trace::now_ns());
+		stage_start_ns = -1;
+	}
+
+  public:
+	StageReporter(const OperationOptions &options, int total) : options(options) {
+		if (options.progress) {
+			options.progress->done = 0;
+			options.progress->total = total;
+		}
+	}
+	~StageReporter() { end_stage(); }
+
+	StageReporter(const StageReporter &) = delete;
+	StageReporter &operator=(const StageReporter &) = delete;
+
+	void begin(const char *stage) {
+		if (!committed && options.cancel_token.is_cancelled()) throw OperationCancelled();
+
+		end_stage();
+		if (trace::enabled()) {
+			stage_name = stage;
+			stage_start_ns = trace::now_ns();
+		}
+
+		if (options.progress) {
+			options.progress->done = started;
+			options.progress->stage = stage;
+		}
+		++started;
+		if (options.on_progress) options.on_progress();
+	}
+
+	/* past this point the operation can't be undone, so cancelling it has no effect */
+	void commit() { committed = true; }
+
+	void finish() {
+		end_stage();
+		if (options.progress) options.progress->done = started;
+	}
+};
+
+/* Runs fn on the pool, on_done (if any) is called after the returned future becomes ready. Whoever
+ * waited for the future may be gone by then, so on_done must only use what it owns. */
+template <typename Fn>
+std::future<std::invoke_result_t<Fn>> run_async(
+    WorkStealingPool &pool, Fn fn, std::function<void()> on_done = {}) {
+	using Result = std::invoke_result_t<Fn>;
+
+	/* packaged_task is move-only and pool tasks have to be copyable */
+	auto task = std::make_shared<std::packaged_task<Result()>>(std::move(fn));
+	auto rv = task->get_future();
+	pool.submit([task, on_done = std::move(on_done)]() {
+		(*task)();
+		if (on_done) on_done();
+	});
+	return rv;
+}
+
+template <typename Fn>
+std::future<std::invoke_result_t<Fn>> run_async(Fn fn, std::function<void()> on_done = {}) {
+	return run_async(default_pool(), std::move(fn), std::move(on_done));
+}
+
+/* Whether the future has a result (or an exception) to be collected without blocking */
+template <typename T> bool is_ready(const std::future<T> &future) {
+	return future.valid() &&
+	       future.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+}
+
+} // namespace utils
@@ -0,0 +1,64 @@
+/*
+
+Copyright (C) 2019 Mateusz Morusiewicz
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+
+#include <src/utils/diagnostics.h>
+
+#include <src/utils/trace.h>
+#include <src/utils/utils.h>
+
+#include <chrono>
+#include <exception>
+#include <iostream>
+#include <string>
+
+namespace utils {
+
+constexpr std::chrono::seconds DEFAULT_STATS_INTERVAL{10};
+
+Diagnostics::Diagnostics(int &argc, const char *argv[], const CommandMatcher &is_command) {
+	if (auto trace_path = take_option(argc, argv, "--trace", is_command)) {
+#ifndef HDPWM_TRACING
+		std::cerr << "built without HDPWM_TRACING, the trace will be empty" << std::endl;
+#endif
+		trace::set_output(*trace_path);
+	}
+
+	std::chrono::seconds interval = DEFAULT_STATS_INTERVAL;
+	if (auto seconds = take_option(argc, argv, "--stats-interval", is_command)) {
+		interval = std::chrono::seconds(std::stoi(*seconds));
+	}
+	if (auto stats_path = take_option(argc, argv, "--stats-file", is_command)) {
+		reporter = std::make_unique<metrics::FileReporter>(*stats_path, interval);
+	}
+	print_stats = take_flag(argc, argv, "--stats", is_command);
+}
+
+Diagnostics::~Diagnostics() {
+	reporter.reset();
+	if (print_stats) metrics::write_prometheus(std::cerr);
+
+	try {
+		trace::dump();
+	} catch (const std::exception &e) {
+		std::cerr << e.what() << std::endl;
+	}
+}
+
+} // namespace utils
@@ -0,0 +1,47 @@
+/*
+
+Copyright (C) 2019 Mateusz Morusiewicz
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+
+#pragma once
+
+#include <src/utils/metrics.h>
+#include <src/utils/utils.h>
+
+#include <memory>
+
+namespace utils {
+
+/* --trace=file, --stats, --stats-file=file and --stats-interval=seconds, understood by every
+ * binary and command. They are taken out of the command line before anything else parses it.
+ * The trace and the --stats report are written when this goes away, --stats-file is rewritten
+ * every interval and on SIGUSR1 until then. Anything after "--" or a subcommand name is left to
+ * the subcommand. */
+class Diagnostics {
+	bool print_stats = false;
+	std::unique_ptr<metrics::FileReporter> reporter;
+
+  public:
+	Diagnostics(int &argc, const char *argv[], const CommandMatcher &is_command = {});
+	~Diagnostics();
+
+	Diagnostics(const Diagnostics &) = delete;
+	Diagnostics &operator=(const Diagnostics &) = delete;
+};
+
+} // namespace utils
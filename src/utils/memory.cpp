@@ -0,0 +1,122 @@
+/*
+
+Copyright (C) 2019 Mateusz Morusiewicz
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+
+#include <src/utils/memory.h>
+
+#include <atomic>
+#include <fstream>
+
+namespace utils::memory {
+
+namespace {
+
+struct Counters {
+	std::atomic<size_t> current{0};
+	std::atomic<size_t> peak{0};
+};
+
+Counters counters[N_CATEGORIES];
+
+size_t read_status_kb(const std::string &field) {
+	std::ifstream status("/proc/self/status");
+	for (std::string line; std::getline(status, line);) {
+		if (line.compare(0, field.size() + 1, field + ":") == 0) {
+			return std::stoull(line.substr(field.size() + 1));
+		}
+	}
+	return 0;
+}
+
+} // namespace
+
+const char *to_string(Category category) {
+	switch (category) {
+	case Category::TreeNodes: return "tree_nodes";
+	case Category::Serialization: return "serialization";
+	case Category::LockedSecrets: return "locked_secrets";
+	case Category::StorageCache: return "storage_cache";
+	case Category::Caches: return "caches";
+	}
+	return "unknown";
+}
+
+Usage usage(Category category) {
+	const auto &c = counters[static_cast<size_t>(category)];
+	return {c.current.load(std::memory_order_relaxed), c.peak.load(std::memory_order_relaxed)};
+}
+
+void add(Category category, size_t bytes) {
+	auto &c = counters[static_cast<size_t>(category)];
+	const size_t current = c.current.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+
+	size_t peak = c.peak.load(std::memory_order_relaxed);
+	while (current > peak && !c.peak.compare_exchange_weak(peak, current)) {
+	}
+}
+
+void sub(Category category, size_t bytes) {
+	counters[static_cast<size_t>(category)].current.fetch_sub(bytes, std::memory_order_relaxed);
+}
+
+size_t heap_bytes(const std::string &s) {
+	const char *inline_buffer = reinterpret_cast<const char *>(&s);
+	const bool is_inline = s.data() >= inline_buffer && s.data() < inline_buffer + sizeof(s);
+	return is_inline ? 0 : s.capacity() + 1;
+}
+
+Accounted::Accounted(Category category, size_t bytes) : category(category), bytes(bytes) {
+	add(category, bytes);
+}
+
+Accounted::~Accounted() { sub(category, bytes); }
+
+Accounted::Accounted(const Accounted &other) : Accounted(other.category, other.bytes) {}
+
+Accounted::Accounted(Accounted &&other) noexcept : category(other.category), bytes(other.bytes) {
+	other.bytes = 0;
+}
+
+Accounted &Accounted::operator=(const Accounted &other) {
+	if (this == &other) return *this;
+	sub(category, bytes);
+	category = other.category;
+	bytes = other.bytes;
+	add(category, bytes);
+	return *this;
+}
+
+Accounted &Accounted::operator=(Accounted &&other) noexcept {
+	if (this == &other) return *this;
+	sub(category, bytes);
+	category = other.category;
+	bytes = other.bytes;
+	other.bytes = 0;
+	return *this;
+}
+
+void Accounted::set(size_t new_bytes) {
+	if (new_bytes > bytes) add(category, new_bytes - bytes);
+	if (new_bytes < bytes) sub(category, bytes - new_bytes);
+	bytes = new_bytes;
+}
+
+Usage process_rss() { return {read_status_kb("VmRSS") * 1024, read_status_kb("VmHWM") * 1024}; }
+
+} // namespace utils::memory
@@ -0,0 +1,81 @@
+/*
+
+Copyright (C) 2019 Mateusz Morusiewicz
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+/* Bytes attributed to what a session keeps in memory, current and peak per category. The
+ * numbers are what the owners account for, not what the allocator hands out, so they are
+ * estimates; categories may overlap where a cache holds locked secrets. */
+namespace utils::memory {
+
+enum class Category {
+	TreeNodes,     // Directory and Entry nodes with their names and details
+	Serialization, // JSON text of the tree while it's loaded, saved, exported or imported
+	LockedSecrets, // secure_alloc allocations: sensitive_string, seeds and keys
+	StorageCache,  // LevelDB memtables and block cache
+	Caches,        // prefetched secrets, listings and tag indexes
+};
+
+constexpr size_t N_CATEGORIES = 5;
+constexpr Category CATEGORIES[N_CATEGORIES] = {Category::TreeNodes, Category::Serialization,
+    Category::LockedSecrets, Category::StorageCache, Category::Caches};
+
+/* snake_case, fit for metric labels */
+const char *to_string(Category category);
+
+struct Usage {
+	size_t current = 0;
+	size_t peak = 0;
+};
+
+Usage usage(Category category);
+
+void add(Category category, size_t bytes);
+void sub(Category category, size_t bytes);
+
+/* heap bytes of a string, none while it fits into the string itself */
+size_t heap_bytes(const std::string &s);
+
+/* Bytes accounted to a category for as long as this lives. Copies account for themselves,
+ * moves take the bytes over. */
+class Accounted {
+	Category category;
+	size_t bytes = 0;
+
+  public:
+	explicit Accounted(Category category, size_t bytes = 0);
+	~Accounted();
+
+	Accounted(const Accounted &other);
+	Accounted(Accounted &&other) noexcept;
+	Accounted &operator=(const Accounted &other);
+	Accounted &operator=(Accounted &&other) noexcept;
+
+	void set(size_t bytes);
+	size_t get() const { return bytes; }
+};
+
+/* resident and peak resident set size of the process, 0 where /proc is not available */
+Usage process_rss();
+
+} // namespace utils::memory
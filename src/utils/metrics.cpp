@@ -0,0 +1,251 @@
+/*
+
+Copyright (C) 2019 Mateusz Morusiewicz
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+
+#include <src/utils/metrics.h>
+
+#include <src/utils/memory.h>
+
+#include <pthread.h>
+#include <signal.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+
+namespace utils::metrics {
+
+namespace {
+
+/* prometheus buckets, at powers of two between ~1us and ~17s */
+constexpr int FIRST_EXPORTED_EXPONENT = 10;
+constexpr int LAST_EXPORTED_EXPONENT = 34;
+
+constexpr double QUANTILES[] = {0.5, 0.9, 0.99, 0.999};
+
+struct NamedCounter {
+	const char *help;
+	Counter counter;
+};
+
+struct Registry {
+	std::mutex mutex;
+	std::map<std::string, std::unique_ptr<Histogram>> latencies;
+	std::map<std::string, std::unique_ptr<NamedCounter>> counters;
+};
+
+/* never destroyed, metrics may still be recorded during static destruction */
+Registry &registry() {
+	static Registry *rv = new Registry();
+	return *rv;
+}
+
+std::string seconds(uint64_t ns) {
+	char buf[32];
+	std::snprintf(buf, sizeof(buf), "%.9g", ns / 1e9);
+	return buf;
+}
+
+} // namespace
+
+size_t Histogram::bucket_of(uint64_t ns) {
+	if (ns < SUB_BUCKETS) return ns;
+	if (ns >> MAX_EXPONENT) return BUCKETS - 1;
+
+	const int exponent = 63 - __builtin_clzll(ns);
+	const uint64_t sub_bucket = (ns >> (exponent - SUB_BUCKET_BITS)) & (SUB_BUCKETS - 1);
+	return (exponent - SUB_BUCKET_BITS + 1) * SUB_BUCKETS + sub_bucket;
+}
+
+uint64_t Histogram::lower_bound(size_t bucket) {
+	if (bucket < SUB_BUCKETS) return bucket;
+
+	const int exponent = bucket / SUB_BUCKETS + SUB_BUCKET_BITS - 1;
+	const uint64_t sub_bucket = bucket % SUB_BUCKETS;
+	return (SUB_BUCKETS + sub_bucket) << (exponent - SUB_BUCKET_BITS);
+}
+
+Histogram::Snapshot Histogram::snapshot() const {
+	Snapshot rv;
+	rv.buckets.resize(BUCKETS);
+	for (size_t i = 0; i < BUCKETS; ++i) {
+		rv.buckets[i] = buckets[i].load(std::memory_order_relaxed);
+		rv.count += rv.buckets[i];
+	}
+	rv.sum_ns = sum_ns.load(std::memory_order_relaxed);
+	return rv;
+}
+
+uint64_t Histogram::Snapshot::quantile(double q) const {
+	if (count == 0) return 0;
+
+	const uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(q * count + 0.5));
+	uint64_t seen = 0;
+	for (size_t i = 0; i < buckets.size(); ++i) {
+		seen += buckets[i];
+		if (seen >= rank) return i + 1 < buckets.size() ? lower_bound(i + 1) : lower_bound(i);
+	}
+	return lower_bound(buckets.size() - 1);
+}
+
+Histogram &latency(const char *op) {
+	Registry &r = registry();
+	std::unique_lock<std::mutex> lk(r.mutex);
+	auto &histogram = r.latencies[op];
+	if (!histogram) histogram = std::make_unique<Histogram>();
+	return *histogram;
+}
+
+Counter &counter(const char *name, const char *help) {
+	Registry &r = registry();
+	std::unique_lock<std::mutex> lk(r.mutex);
+	auto &named = r.counters[name];
+	if (!named) named.reset(new NamedCounter{help, {}});
+	return named->counter;
+}
+
+void write_prometheus(std::ostream &out) {
+	Registry &r = registry();
+	std::unique_lock<std::mutex> lk(r.mutex);
+
+	for (const auto &[name, named] : r.counters) {
+		out << "# HELP hdpwm_" << name << "_total " << named->help << "\n";
+		out << "# TYPE hdpwm_" << name << "_total counter\n";
+		out << "hdpwm_" << name << "_total " << named->counter.get() << "\n";
+	}
+
+	std::vector<std::pair<std::string, Histogram::Snapshot>> snapshots;
+	for (const auto &[op, histogram] : r.latencies) {
+		snapshots.emplace_back(op, histogram->snapshot());
+	}
+
+	out << "# HELP hdpwm_operation_duration_seconds Latency of keychain, database, key derivation "
+	       "and rendering operations\n";
+	out << "# TYPE hdpwm_operation_duration_seconds histogram\n";
+	for (const auto &[op, s] : snapshots) {
+		const std::string labels = "op=\"" + op + "\"";
+
+		/* every exported bound is where one of the fine buckets starts */
+		uint64_t cumulative = 0;
+		size_t bucket = 0;
+		for (int e = FIRST_EXPORTED_EXPONENT; e <= LAST_EXPORTED_EXPONENT; ++e) {
+			const uint64_t bound = uint64_t{1} << e;
+			for (; bucket < s.buckets.size() && Histogram::lower_bound(bucket) < bound; ++bucket) {
+				cumulative += s.buckets[bucket];
+			}
+			out << "hdpwm_operation_duration_seconds_bucket{" << labels << ",le=\""
+			    << seconds(bound) << "\"} " << cumulative << "\n";
+		}
+		out << "hdpwm_operation_duration_seconds_bucket{" << labels << ",le=\"+Inf\"} " << s.count
+		    << "\n";
+		out << "hdpwm_operation_duration_seconds_sum{" << labels << "} " << seconds(s.sum_ns)
+		    << "\n";
+		out << "hdpwm_operation_duration_seconds_count{" << labels << "} " << s.count << "\n";
+	}
+
+	out << "# HELP hdpwm_operation_duration_quantile_seconds Upper bounds of latency quantiles, "
+	       "within 12.5%\n";
+	out << "# TYPE hdpwm_operation_duration_quantile_seconds gauge\n";
+	for (const auto &[op, s] : snapshots) {
+		for (double q : QUANTILES) {
+			out << "hdpwm_operation_duration_quantile_seconds{op=\"" << op << "\",quantile=\"" << q
+			    << "\"} " << seconds(s.quantile(q)) << "\n";
+		}
+	}
+
+	out << "# HELP hdpwm_memory_bytes Bytes held per category, estimated by their owners\n";
+	out << "# TYPE hdpwm_memory_bytes gauge\n";
+	for (auto category : memory::CATEGORIES) {
+		out << "hdpwm_memory_bytes{category=\"" << memory::to_string(category) << "\"} "
+		    << memory::usage(category).current << "\n";
+	}
+	out << "# HELP hdpwm_memory_peak_bytes Highest hdpwm_memory_bytes seen so far\n";
+	out << "# TYPE hdpwm_memory_peak_bytes gauge\n";
+	for (auto category : memory::CATEGORIES) {
+		out << "hdpwm_memory_peak_bytes{category=\"" << memory::to_string(category) << "\"} "
+		    << memory::usage(category).peak << "\n";
+	}
+
+	const auto rss = memory::process_rss();
+	out << "# HELP hdpwm_process_resident_bytes Resident set size of the process\n";
+	out << "# TYPE hdpwm_process_resident_bytes gauge\n";
+	out << "hdpwm_process_resident_bytes " << rss.current << "\n";
+	out << "# HELP hdpwm_process_resident_peak_bytes Peak resident set size of the process\n";
+	out << "# TYPE hdpwm_process_resident_peak_bytes gauge\n";
+	out << "hdpwm_process_resident_peak_bytes " << rss.peak << "\n";
+	out.flush();
+}
+
+void write_prometheus(const std::filesystem::path &path) {
+	auto temporary = path;
+	temporary += ".tmp";
+	{
+		std::ofstream out(temporary);
+		if (!out) throw std::runtime_error("cannot write the stats to " + temporary.string());
+		write_prometheus(out);
+	}
+	std::filesystem::rename(temporary, path);
+}
+
+void block_report_signal() {
+	sigset_t set;
+	sigemptyset(&set);
+	sigaddset(&set, SIGUSR1);
+	pthread_sigmask(SIG_BLOCK, &set, nullptr);
+}
+
+FileReporter::FileReporter(std::filesystem::path path, std::chrono::seconds interval) :
+    path(std::move(path)), interval(std::max(interval, std::chrono::seconds(1))) {
+	block_report_signal();
+	thread = std::thread([this]() { run(); });
+}
+
+FileReporter::~FileReporter() {
+	stopping = true;
+	pthread_kill(thread.native_handle(), SIGUSR1);
+	thread.join();
+}
+
+void FileReporter::run() {
+	sigset_t set;
+	sigemptyset(&set);
+	sigaddset(&set, SIGUSR1);
+
+	const timespec timeout{static_cast<time_t>(interval.count()), 0};
+	for (;;) {
+		/* woken up by the interval running out or by SIGUSR1, either way it's time to write */
+		if (sigtimedwait(&set, nullptr, &timeout) < 0 && errno == EINTR) continue;
+
+		try {
+			write_prometheus(path);
+		} catch (const std::exception &e) {
+			std::cerr << e.what() << std::endl;
+		}
+		if (stopping) return;
+	}
+}
+
+} // namespace utils::metrics
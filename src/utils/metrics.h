@@ -0,0 +1,139 @@
+/*
+
+Copyright (C) 2019 Mateusz Morusiewicz
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <ostream>
+#include <thread>
+#include <vector>
+
+/* Always-on counters and latency histograms, written out in the Prometheus text format. Metrics
+ * are registered on first use and live until the process exits. Names have to be string literals,
+ * they are kept as pointers. */
+
+#define METRICS_CONCAT_(a, b) a##b
+#define METRICS_CONCAT(a, b) METRICS_CONCAT_(a, b)
+
+/* times the rest of the scope into the latency histogram of op */
+#define METRICS_LATENCY(op)                                                                        \
+	static utils::metrics::Histogram &METRICS_CONCAT(metrics_histogram_, __LINE__) =             \
+	    utils::metrics::latency(op);                                                               \
+	utils::metrics::ScopedTimer METRICS_CONCAT(metrics_timer_, __LINE__)(                          \
+	    METRICS_CONCAT(metrics_histogram_, __LINE__))
+
+namespace utils::metrics {
+
+/* HDR-style log-linear buckets of nanoseconds: 8 per power of two, so every value is within
+ * 12.5% of its bucket's bounds. Values of 2^40ns (~18 minutes) and more share the last one. */
+class Histogram {
+  public:
+	static constexpr int SUB_BUCKET_BITS = 3;
+	static constexpr int SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+	static constexpr int MAX_EXPONENT = 40;
+	static constexpr size_t BUCKETS = (MAX_EXPONENT - SUB_BUCKET_BITS + 1) * SUB_BUCKETS;
+
+	static size_t bucket_of(uint64_t ns);
+	static uint64_t lower_bound(size_t bucket);
+
+	struct Snapshot {
+		uint64_t count = 0;
+		uint64_t sum_ns = 0;
+		std::vector<uint64_t> buckets;
+
+		/* upper bound of the bucket holding the q-th quantile, 0 when nothing was recorded */
+		uint64_t quantile(double q) const;
+	};
+
+  private:
+	std::array<std::atomic<uint64_t>, BUCKETS> buckets{};
+	std::atomic<uint64_t> sum_ns{0}; // the count is the sum of the buckets
+
+  public:
+	void record(uint64_t ns) {
+		buckets[bucket_of(ns)].fetch_add(1, std::memory_order_relaxed);
+		sum_ns.fetch_add(ns, std::memory_order_relaxed);
+	}
+
+	Snapshot snapshot() const;
+};
+
+class Counter {
+	std::atomic<uint64_t> value{0};
+
+  public:
+	void add(uint64_t n = 1) { value.fetch_add(n, std::memory_order_relaxed); }
+	uint64_t get() const { return value.load(std::memory_order_relaxed); }
+};
+
+class ScopedTimer {
+	Histogram &histogram;
+	std::chrono::steady_clock::time_point start;
+
+  public:
+	explicit ScopedTimer(Histogram &histogram) :
+	    histogram(histogram), start(std::chrono::steady_clock::now()) {}
+	~ScopedTimer() {
+		const auto elapsed = std::chrono::steady_clock::now() - start;
+		histogram.record(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+	}
+
+	ScopedTimer(const ScopedTimer &) = delete;
+	ScopedTimer &operator=(const ScopedTimer &) = delete;
+};
+
+/* the histogram of hdpwm_operation_duration_seconds{op="..."} */
+Histogram &latency(const char *op);
+
+/* hdpwm_<name>_total */
+Counter &counter(const char *name, const char *help);
+
+void write_prometheus(std::ostream &out);
+
+/* through a temporary file, so that a scraper never reads half of it */
+void write_prometheus(const std::filesystem::path &path);
+
+/* SIGUSR1 asks a FileReporter for a report, it has to be blocked before any other thread is
+ * started so that it is never delivered anywhere else */
+void block_report_signal();
+
+/* Writes the metrics to path every interval, whenever the process gets SIGUSR1 and once more
+ * when destroyed */
+class FileReporter {
+	std::filesystem::path path;
+	std::chrono::seconds interval;
+	std::atomic<bool> stopping{false};
+	std::thread thread;
+
+	void run();
+
+  public:
+	FileReporter(std::filesystem::path path, std::chrono::seconds interval);
+	~FileReporter();
+
+	FileReporter(const FileReporter &) = delete;
+	FileReporter &operator=(const FileReporter &) = delete;
+};
+
+} // namespace utils::metrics
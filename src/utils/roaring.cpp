@@ -0,0 +1,337 @@
+/*
+
+Copyright (C) 2019 Mateusz Morusiewicz
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#include <src/utils/roaring.h>
+
+#include <algorithm>
+#include <functional>
+#include <iterator>
+#include <stdexcept>
+
+namespace utils {
+
+namespace {
+
+template <typename T> void put(std::string &out, T v) {
+	for (int shift = 8 * (sizeof(T) - 1); shift >= 0; shift -= 8) {
+		out.push_back(static_cast<char>((v >> shift) & 0xff));
+	}
+}
+
+template <typename T> T take(std::string_view &data) {
+	if (data.size() < sizeof(T)) throw std::runtime_error("truncated bitmap");
+	T rv = 0;
+	for (size_t i = 0; i < sizeof(T); ++i) {
+		rv = (rv << 8) | static_cast<uint8_t>(data[i]);
+	}
+	data.remove_prefix(sizeof(T));
+	return rv;
+}
+
+} // namespace
+
+bool RoaringBitmap::Container::contains(uint16_t low) const {
+	if (is_bitset()) return (bitset[low / 64] >> (low % 64)) & 1;
+	return std::binary_search(array.begin(), array.end(), low);
+}
+
+bool RoaringBitmap::Container::add(uint16_t low) {
+	if (is_bitset()) {
+		const uint64_t bit = uint64_t{1} << (low % 64);
+		if (bitset[low / 64] & bit) return false;
+		bitset[low / 64] |= bit;
+		++cardinality;
+		return true;
+	}
+
+	auto it = std::lower_bound(array.begin(), array.end(), low);
+	if (it != array.end() && *it == low) return false;
+	array.insert(it, low);
+	++cardinality;
+	normalize();
+	return true;
+}
+
+bool RoaringBitmap::Container::remove(uint16_t low) {
+	if (is_bitset()) {
+		const uint64_t bit = uint64_t{1} << (low % 64);
+		if (!(bitset[low / 64] & bit)) return false;
+		bitset[low / 64] &= ~bit;
+		--cardinality;
+		normalize();
+		return true;
+	}
+
+	auto it = std::lower_bound(array.begin(), array.end(), low);
+	if (it == array.end() || *it != low) return false;
+	array.erase(it);
+	--cardinality;
+	return true;
+}
+
+void RoaringBitmap::Container::normalize() {
+	if (is_bitset() && cardinality <= ARRAY_MAX) {
+		std::vector<uint16_t> values;
+		values.reserve(cardinality);
+		for (size_t word = 0; word < BITSET_WORDS; ++word) {
+			for (uint64_t bits = bitset[word]; bits; bits &= bits - 1) {
+				values.push_back(word * 64 + __builtin_ctzll(bits));
+			}
+		}
+		array = std::move(values);
+		bitset = {};
+	} else if (!is_bitset() && cardinality > ARRAY_MAX) {
+		bitset.assign(BITSET_WORDS, 0);
+		for (uint16_t low : array) bitset[low / 64] |= uint64_t{1} << (low % 64);
+		array = {};
+	}
+}
+
+std::vector<RoaringBitmap::Container>::iterator RoaringBitmap::lower_bound(uint16_t key) {
+	return std::lower_bound(containers.begin(), containers.end(), key,
+	    [](const Container &container, uint16_t key) { return container.key < key; });
+}
+
+RoaringBitmap::Container *RoaringBitmap::find(uint16_t key) {
+	auto it = lower_bound(key);
+	return it != containers.end() && it->key == key ? &*it : nullptr;
+}
+
+const RoaringBitmap::Container *RoaringBitmap::find(uint16_t key) const {
+	return const_cast<RoaringBitmap *>(this)->find(key);
+}
+
+bool RoaringBitmap::add(uint32_t value) {
+	const uint16_t key = value >> 16;
+	auto it = lower_bound(key);
+	if (it == containers.end() || it->key != key) {
+		it = containers.insert(it, Container{});
+		it->key = key;
+	}
+	return it->add(value & 0xffff);
+}
+
+bool RoaringBitmap::remove(uint32_t value) {
+	const uint16_t key = value >> 16;
+	auto it = lower_bound(key);
+	if (it == containers.end() || it->key != key || !it->remove(value & 0xffff)) return false;
+
+	if (it->cardinality == 0) containers.erase(it);
+	return true;
+}
+
+bool RoaringBitmap::contains(uint32_t value) const {
+	auto container = find(value >> 16);
+	return container && container->contains(value & 0xffff);
+}
+
+uint64_t RoaringBitmap::cardinality() const {
+	uint64_t rv = 0;
+	for (const auto &container : containers) rv += container.cardinality;
+	return rv;
+}
+
+RoaringBitmap::Container RoaringBitmap::combine(
+    const Container &lhs, const Container &rhs, Op op) {
+	Container rv;
+	rv.key = lhs.key;
+
+	if (!lhs.is_bitset() && !rhs.is_bitset()) {
+		auto out = std::back_inserter(rv.array);
+		const auto &l = lhs.array, &r = rhs.array;
+		switch (op) {
+		case Op::And:
+			std::set_intersection(l.begin(), l.end(), r.begin(), r.end(), out);
+			break;
+		case Op::Or:
+			std::set_union(l.begin(), l.end(), r.begin(), r.end(), out);
+			break;
+		case Op::AndNot:
+			std::set_difference(l.begin(), l.end(), r.begin(), r.end(), out);
+			break;
+		}
+		rv.cardinality = rv.array.size();
+		rv.normalize();
+		return rv;
+	}
+
+	/* a sparse side only needs looking up in the dense one, and stays sparse */
+	const Container *sparse = !lhs.is_bitset()                       ? &lhs
+	                          : !rhs.is_bitset() && op == Op::And ? &rhs
+	                                                              : nullptr;
+	if (sparse && op != Op::Or) {
+		const Container &dense = sparse == &lhs ? rhs : lhs;
+		const bool keep_contained = op == Op::And;
+		for (uint16_t low : sparse->array) {
+			if (dense.contains(low) == keep_contained) rv.array.push_back(low);
+		}
+		rv.cardinality = rv.array.size();
+		return rv;
+	}
+
+	rv.bitset = lhs.bitset;
+	if (!lhs.is_bitset()) {
+		rv.bitset.assign(BITSET_WORDS, 0);
+		for (uint16_t low : lhs.array) rv.bitset[low / 64] |= uint64_t{1} << (low % 64);
+	}
+
+	if (!rhs.is_bitset()) {
+		/* only Or and AndNot of a bitset get here */
+		for (uint16_t low : rhs.array) {
+			const uint64_t bit = uint64_t{1} << (low % 64);
+			if (op == Op::Or) {
+				rv.bitset[low / 64] |= bit;
+			} else {
+				rv.bitset[low / 64] &= ~bit;
+			}
+		}
+	} else {
+		for (size_t word = 0; word < BITSET_WORDS; ++word) {
+			switch (op) {
+			case Op::And:
+				rv.bitset[word] &= rhs.bitset[word];
+				break;
+			case Op::Or:
+				rv.bitset[word] |= rhs.bitset[word];
+				break;
+			case Op::AndNot:
+				rv.bitset[word] &= ~rhs.bitset[word];
+				break;
+			}
+		}
+	}
+
+	for (uint64_t word : rv.bitset) rv.cardinality += __builtin_popcountll(word);
+	rv.normalize();
+	return rv;
+}
+
+RoaringBitmap RoaringBitmap::combine(const RoaringBitmap &lhs, const RoaringBitmap &rhs, Op op) {
+	RoaringBitmap rv;
+	auto l = lhs.containers.begin(), r = rhs.containers.begin();
+	const auto l_end = lhs.containers.end(), r_end = rhs.containers.end();
+
+	while (l != l_end || r != r_end) {
+		if (r == r_end || (l != l_end && l->key < r->key)) {
+			if (op != Op::And) rv.containers.push_back(*l);
+			++l;
+		} else if (l == l_end || r->key < l->key) {
+			if (op == Op::Or) rv.containers.push_back(*r);
+			++r;
+		} else {
+			auto container = combine(*l, *r, op);
+			if (container.cardinality > 0) rv.containers.push_back(std::move(container));
+			++l;
+			++r;
+		}
+	}
+
+	return rv;
+}
+
+RoaringBitmap RoaringBitmap::operator&(const RoaringBitmap &other) const {
+	return combine(*this, other, Op::And);
+}
+
+RoaringBitmap RoaringBitmap::operator|(const RoaringBitmap &other) const {
+	return combine(*this, other, Op::Or);
+}
+
+RoaringBitmap RoaringBitmap::andnot(const RoaringBitmap &other) const {
+	return combine(*this, other, Op::AndNot);
+}
+
+bool RoaringBitmap::operator==(const RoaringBitmap &other) const {
+	/* containers are always normalized, so equal sets are stored the same way */
+	return std::equal(containers.begin(), containers.end(), other.containers.begin(),
+	    other.containers.end(), [](const Container &lhs, const Container &rhs) {
+		    return lhs.key == rhs.key && lhs.cardinality == rhs.cardinality &&
+		           lhs.array == rhs.array && lhs.bitset == rhs.bitset;
+	    });
+}
+
+std::vector<uint32_t> RoaringBitmap::to_vector() const {
+	std::vector<uint32_t> rv;
+	rv.reserve(cardinality());
+	for_each([&rv](uint32_t value) { rv.push_back(value); });
+	return rv;
+}
+
+void RoaringBitmap::serialize(std::string &out) const {
+	put<uint32_t>(out, containers.size());
+	for (const auto &container : containers) {
+		/* the representation follows from the cardinality */
+		put<uint16_t>(out, container.key);
+		put<uint32_t>(out, container.cardinality);
+		if (container.is_bitset()) {
+			for (uint64_t word : container.bitset) put<uint64_t>(out, word);
+		} else {
+			for (uint16_t low : container.array) put<uint16_t>(out, low);
+		}
+	}
+}
+
+RoaringBitmap RoaringBitmap::deserialize(std::string_view &data) {
+	RoaringBitmap rv;
+	const uint32_t n_containers = take<uint32_t>(data);
+	if (n_containers > 65536) throw std::runtime_error("bad bitmap");
+	rv.containers.reserve(n_containers);
+
+	for (uint32_t i = 0; i < n_containers; ++i) {
+		Container container;
+		container.key = take<uint16_t>(data);
+		container.cardinality = take<uint32_t>(data);
+		if (container.cardinality == 0 || container.cardinality > 65536 ||
+		    (!rv.containers.empty() && rv.containers.back().key >= container.key)) {
+			throw std::runtime_error("bad bitmap");
+		}
+
+		if (container.cardinality > ARRAY_MAX) {
+			container.bitset.resize(BITSET_WORDS);
+			uint32_t n_set = 0;
+			for (auto &word : container.bitset) {
+				word = take<uint64_t>(data);
+				n_set += __builtin_popcountll(word);
+			}
+			if (n_set != container.cardinality) throw std::runtime_error("bad bitmap");
+		} else {
+			container.array.resize(container.cardinality);
+			for (auto &low : container.array) low = take<uint16_t>(data);
+			if (std::adjacent_find(container.array.begin(), container.array.end(),
+			        std::greater_equal<uint16_t>()) != container.array.end()) {
+				throw std::runtime_error("bad bitmap");
+			}
+		}
+
+		rv.containers.push_back(std::move(container));
+	}
+
+	return rv;
+}
+
+size_t RoaringBitmap::heap_bytes() const {
+	size_t rv = containers.capacity() * sizeof(Container);
+	for (const auto &container : containers) {
+		rv += container.array.capacity() * sizeof(uint16_t);
+		rv += container.bitset.capacity() * sizeof(uint64_t);
+	}
+	return rv;
+}
+
+} // namespace utils
@@ -0,0 +1,110 @@
+/*
+
+Copyright (C) 2019 Mateusz Morusiewicz
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace utils {
+
+/* Compressed set of 32-bit integers in the style of Roaring bitmaps: values are grouped by their
+ * high 16 bits, each group kept as a sorted array of the low bits while it is sparse and as a
+ * 65536-bit bitset once it is not. Set operations work a group at a time. */
+class RoaringBitmap {
+  public:
+	/* arrays are turned into bitsets above this, where they would take more space */
+	static constexpr size_t ARRAY_MAX = 4096;
+	static constexpr size_t BITSET_WORDS = 65536 / 64;
+
+  private:
+	struct Container {
+		uint16_t key;
+		uint32_t cardinality = 0;
+		std::vector<uint16_t> array;  // sorted, while sparse
+		std::vector<uint64_t> bitset; // BITSET_WORDS words, or empty
+
+		bool is_bitset() const { return !bitset.empty(); }
+		bool contains(uint16_t low) const;
+		bool add(uint16_t low);
+		bool remove(uint16_t low);
+
+		/* array or bitset, whichever fits the cardinality */
+		void normalize();
+	};
+
+	std::vector<Container> containers; // sorted by key
+
+	std::vector<Container>::iterator lower_bound(uint16_t key);
+	Container *find(uint16_t key);
+	const Container *find(uint16_t key) const;
+
+	enum class Op { And, Or, AndNot };
+	static RoaringBitmap combine(const RoaringBitmap &lhs, const RoaringBitmap &rhs, Op op);
+	static Container combine(const Container &lhs, const Container &rhs, Op op);
+
+  public:
+	/* whether value was not there before */
+	bool add(uint32_t value);
+	/* whether value was there */
+	bool remove(uint32_t value);
+	bool contains(uint32_t value) const;
+
+	uint64_t cardinality() const;
+	bool empty() const { return containers.empty(); }
+	void clear() { containers.clear(); }
+
+	RoaringBitmap operator&(const RoaringBitmap &other) const;
+	RoaringBitmap operator|(const RoaringBitmap &other) const;
+	/* values in this and not in other */
+	RoaringBitmap andnot(const RoaringBitmap &other) const;
+
+	bool operator==(const RoaringBitmap &other) const;
+	bool operator!=(const RoaringBitmap &other) const { return !(*this == other); }
+
+	/* calls f with every value, in ascending order */
+	template <typename F> void for_each(F &&f) const {
+		for (const auto &container : containers) {
+			const uint32_t high = uint32_t{container.key} << 16;
+			if (!container.is_bitset()) {
+				for (uint16_t low : container.array) f(high | low);
+				continue;
+			}
+			for (size_t word = 0; word < BITSET_WORDS; ++word) {
+				for (uint64_t bits = container.bitset[word]; bits; bits &= bits - 1) {
+					f(high | (word * 64 + __builtin_ctzll(bits)));
+				}
+			}
+		}
+	}
+
+	std::vector<uint32_t> to_vector() const;
+
+	/* big-endian and self-delimiting; deserialize throws std::runtime_error on bad input and
+	 * takes the bytes it consumed off the front of data */
+	void serialize(std::string &out) const;
+	static RoaringBitmap deserialize(std::string_view &data);
+
+	size_t heap_bytes() const;
+};
+
+} // namespace utils
@@ -0,0 +1,69 @@
+/*
+
+Copyright (C) 2019 Mateusz Morusiewicz
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <utility>
+
+namespace utils {
+
+/* Bounded lock-free queue for exactly one producer and one consumer thread (which may be the same
+ * one). Head and tail live on separate cache lines, each written by one side only. */
+template <typename T, size_t Capacity> class SpscQueue {
+	static_assert(
+	    Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "capacity must be a power of two");
+
+	static constexpr size_t CACHE_LINE = 64;
+
+	alignas(CACHE_LINE) std::atomic<size_t> head{0}; // next slot to pop, written by the consumer
+	alignas(CACHE_LINE) std::atomic<size_t> tail{0}; // next slot to push, written by the producer
+	alignas(CACHE_LINE) std::array<T, Capacity> slots{};
+
+  public:
+	/* producer side, false if the queue is full */
+	bool try_push(T value) {
+		const size_t t = tail.load(std::memory_order_relaxed);
+		if (t - head.load(std::memory_order_acquire) == Capacity) return false;
+
+		slots[t & (Capacity - 1)] = std::move(value);
+		tail.store(t + 1, std::memory_order_release);
+		return true;
+	}
+
+	/* consumer side, false if the queue is empty */
+	bool try_pop(T &value) {
+		const size_t h = head.load(std::memory_order_relaxed);
+		if (h == tail.load(std::memory_order_acquire)) return false;
+
+		/* moved out and reset, so the slot does not keep the value alive */
+		value = std::move(slots[h & (Capacity - 1)]);
+		slots[h & (Capacity - 1)] = T{};
+		head.store(h + 1, std::memory_order_release);
+		return true;
+	}
+
+	bool empty() const {
+		return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire);
+	}
+};
+
+} // namespace utils
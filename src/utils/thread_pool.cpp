@@ -0,0 +1,178 @@
+/*
+
+Copyright (C) 2019 Mateusz Morusiewicz
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#include <src/utils/thread_pool.h>
+
+#include <algorithm>
+#include <chrono>
+
+namespace utils {
+
+namespace {
+
+constexpr size_t NOT_A_WORKER = static_cast<size_t>(-1);
+
+thread_local const WorkStealingPool *tl_pool = nullptr;
+thread_local size_t tl_worker_index = NOT_A_WORKER;
+
+size_t current_worker_index(const WorkStealingPool *pool) {
+	return tl_pool == pool ? tl_worker_index : NOT_A_WORKER;
+}
+
+} // namespace
+
+WorkStealingPool::WorkStealingPool(size_t n_threads) {
+	if (n_threads == 0) n_threads = std::max(1u, std::thread::hardware_concurrency());
+
+	workers.reserve(n_threads);
+	for (size_t i = 0; i < n_threads; ++i) {
+		workers.push_back(std::make_unique<Worker>());
+	}
+
+	threads.reserve(n_threads);
+	for (size_t i = 0; i < n_threads; ++i) {
+		threads.emplace_back([this, i]() { this->worker_loop(i); });
+	}
+}
+
+WorkStealingPool::~WorkStealingPool() {
+	{
+		std::unique_lock<std::mutex> lk(idle_mutex);
+		stopping = true;
+	}
+	idle_cv.notify_all();
+
+	for (auto &thread : threads) {
+		thread.join();
+	}
+}
+
+void WorkStealingPool::submit(Task task) {
+	size_t index = current_worker_index(this);
+	if (index == NOT_A_WORKER) index = next_worker++ % workers.size();
+
+	/* counted before it becomes visible so that a thief can never drive the counter below zero */
+	{
+		std::unique_lock<std::mutex> lk(idle_mutex);
+		++queued;
+	}
+
+	{
+		std::unique_lock<std::mutex> lk(workers[index]->mutex);
+		workers[index]->tasks.push_back(std::move(task));
+	}
+	idle_cv.notify_one();
+}
+
+bool WorkStealingPool::pop_task(size_t worker_index, Task &task) {
+	if (worker_index != NOT_A_WORKER) {
+		Worker &own = *workers[worker_index];
+		std::unique_lock<std::mutex> lk(own.mutex);
+		if (!own.tasks.empty()) {
+			task = std::move(own.tasks.back());
+			own.tasks.pop_back();
+			--queued;
+			return true;
+		}
+	}
+
+	const size_t n_workers = workers.size();
+	const size_t start = worker_index == NOT_A_WORKER ? 0 : worker_index + 1;
+	for (size_t i = 0; i < n_workers; ++i) {
+		Worker &victim = *workers[(start + i) % n_workers];
+		std::unique_lock<std::mutex> lk(victim.mutex);
+		if (!victim.tasks.empty()) {
+			task = std::move(victim.tasks.front());
+			victim.tasks.pop_front();
+			--queued;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void WorkStealingPool::worker_loop(size_t worker_index) {
+	tl_pool = this;
+	tl_worker_index = worker_index;
+
+	for (;;) {
+		Task task;
+		if (pop_task(worker_index, task)) {
+			task();
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lk(idle_mutex);
+		idle_cv.wait(lk, [this]() { return stopping || queued.load() > 0; });
+		if (stopping && queued.load() == 0) return;
+	}
+}
+
+void WorkStealingPool::parallel_for(
+    size_t begin, size_t end, size_t grain, const std::function<void(size_t, size_t)> &fn) {
+	if (begin >= end) return;
+	grain = std::max<size_t>(grain, 1);
+
+	struct Latch {
+		std::mutex mutex;
+		std::condition_variable cv;
+		size_t remaining;
+	};
+
+	auto latch = std::make_shared<Latch>();
+	latch->remaining = (end - begin + grain - 1) / grain;
+
+	for (size_t chunk_begin = begin; chunk_begin < end; chunk_begin += grain) {
+		size_t chunk_end = std::min(end, chunk_begin + grain);
+		submit([latch, &fn, chunk_begin, chunk_end]() {
+			fn(chunk_begin, chunk_end);
+
+			std::unique_lock<std::mutex> lk(latch->mutex);
+			if (--latch->remaining == 0) latch->cv.notify_all();
+		});
+	}
+
+	/* the calling thread helps out instead of sleeping, which also keeps nested calls
+	 * deadlock-free */
+	const size_t own_index = current_worker_index(this);
+	for (;;) {
+		{
+			std::unique_lock<std::mutex> lk(latch->mutex);
+			if (latch->remaining == 0) return;
+		}
+
+		Task task;
+		if (pop_task(own_index, task)) {
+			task();
+			continue;
+		}
+
+		using namespace std::chrono_literals;
+		std::unique_lock<std::mutex> lk(latch->mutex);
+		latch->cv.wait_for(lk, 1ms, [&latch]() { return latch->remaining == 0; });
+	}
+}
+
+WorkStealingPool &default_pool() {
+	static WorkStealingPool pool;
+	return pool;
+}
+
+} // namespace utils
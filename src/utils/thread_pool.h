@@ -0,0 +1,83 @@
+/*
+
+Copyright (C) 2019 Mateusz Morusiewicz
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace utils {
+
+/* Shared flag checked by long-running jobs, copies observe the same state */
+class CancellationToken {
+	std::shared_ptr<std::atomic<bool>> cancelled = std::make_shared<std::atomic<bool>>(false);
+
+  public:
+	void cancel() const { cancelled->store(true); }
+	bool is_cancelled() const { return cancelled->load(std::memory_order_relaxed); }
+};
+
+/* Each worker owns a deque; it pops its own tasks LIFO and steals FIFO from the others when idle */
+class WorkStealingPool {
+	using Task = std::function<void()>;
+
+	struct Worker {
+		std::mutex mutex;
+		std::deque<Task> tasks;
+	};
+
+	std::vector<std::unique_ptr<Worker>> workers;
+	std::vector<std::thread> threads;
+
+	std::mutex idle_mutex;
+	std::condition_variable idle_cv;
+	std::atomic<size_t> queued{0};
+	std::atomic<size_t> next_worker{0};
+	bool stopping = false;
+
+	bool pop_task(size_t worker_index, Task &task);
+	void worker_loop(size_t worker_index);
+
+  public:
+	explicit WorkStealingPool(size_t n_threads = 0);
+	~WorkStealingPool();
+
+	WorkStealingPool(const WorkStealingPool &) = delete;
+	WorkStealingPool &operator=(const WorkStealingPool &) = delete;
+
+	size_t size() const { return threads.size(); }
+
+	void submit(Task task);
+
+	/* Splits [begin, end) into chunks of at most grain and blocks until all of them are done */
+	void parallel_for(size_t begin, size_t end, size_t grain,
+	    const std::function<void(size_t, size_t)> &fn);
+};
+
+/* The process-wide pool background operations run on, started on first use */
+WorkStealingPool &default_pool();
+
+} // namespace utils
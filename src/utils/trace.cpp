@@ -0,0 +1,179 @@
+/*
+
+Copyright (C) 2019 Mateusz Morusiewicz
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+
+#include <src/utils/trace.h>
+
+#include <external/nlohmann/json_single_include.h>
+
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+namespace utils::trace {
+
+namespace {
+
+struct Event {
+	const char *category;
+	const char *name;
+	int64_t start_ns;
+	int64_t duration_ns;
+};
+
+/* written by its own thread, read by dumps; the lock is uncontended but for them */
+struct ThreadBuffer {
+	std::mutex mutex;
+	uint64_t tid;
+	std::vector<Event> events;
+	size_t next = 0;
+	bool wrapped = false;
+};
+
+struct Registry {
+	std::atomic<bool> enabled{false};
+	std::mutex mutex;
+	std::vector<std::shared_ptr<ThreadBuffer>> buffers; // kept after their threads exit
+	std::filesystem::path output;
+};
+
+/* never destroyed, threads may still be recording during static destruction */
+Registry &registry() {
+	static Registry *rv = new Registry();
+	return *rv;
+}
+
+const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+
+ThreadBuffer &thread_buffer() {
+	thread_local std::shared_ptr<ThreadBuffer> buffer = []() {
+		auto rv = std::make_shared<ThreadBuffer>();
+		rv->events.resize(BUFFER_EVENTS);
+
+		Registry &r = registry();
+		std::unique_lock<std::mutex> lk(r.mutex);
+		rv->tid = r.buffers.size() + 1;
+		r.buffers.push_back(rv);
+		return rv;
+	}();
+	return *buffer;
+}
+
+} // namespace
+
+#ifdef HDPWM_TRACING
+bool enabled() { return registry().enabled.load(std::memory_order_relaxed); }
+#endif
+
+void set_enabled(bool enabled) { registry().enabled = enabled; }
+
+void set_output(std::filesystem::path path) {
+	Registry &r = registry();
+	{
+		std::unique_lock<std::mutex> lk(r.mutex);
+		r.output = std::move(path);
+	}
+	set_enabled(true);
+}
+
+std::filesystem::path output() {
+	Registry &r = registry();
+	std::unique_lock<std::mutex> lk(r.mutex);
+	return r.output;
+}
+
+int64_t now_ns() {
+	using namespace std::chrono;
+	return duration_cast<nanoseconds>(steady_clock::now() - epoch).count();
+}
+
+void record(const char *category, const char *name, int64_t start_ns, int64_t end_ns) {
+	ThreadBuffer &buffer = thread_buffer();
+	std::unique_lock<std::mutex> lk(buffer.mutex);
+	buffer.events[buffer.next] = Event{category, name, start_ns, end_ns - start_ns};
+	if (++buffer.next == buffer.events.size()) {
+		buffer.next = 0;
+		buffer.wrapped = true;
+	}
+}
+
+void write_chrome_trace(std::ostream &out) {
+	Registry &r = registry();
+	std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+	{
+		std::unique_lock<std::mutex> lk(r.mutex);
+		buffers = r.buffers;
+	}
+
+	const auto pid = getpid();
+	nlohmann::json events = nlohmann::json::array();
+	for (const auto &buffer : buffers) {
+		std::unique_lock<std::mutex> lk(buffer->mutex);
+		const size_t n = buffer->wrapped ? buffer->events.size() : buffer->next;
+		const size_t first = buffer->wrapped ? buffer->next : 0;
+
+		for (size_t i = 0; i < n; ++i) {
+			const Event &e = buffer->events[(first + i) % buffer->events.size()];
+			events.push_back({
+			    {"name", e.name},
+			    {"cat", e.category},
+			    {"ph", "X"},
+			    {"ts", e.start_ns / 1000.0},
+			    {"dur", e.duration_ns / 1000.0},
+			    {"pid", pid},
+			    {"tid", buffer->tid},
+			});
+		}
+	}
+
+	out << nlohmann::json{{"traceEvents", std::move(events)}, {"displayTimeUnit", "ms"}}.dump()
+	    << std::endl;
+}
+
+void dump() {
+	std::filesystem::path path;
+	{
+		Registry &r = registry();
+		std::unique_lock<std::mutex> lk(r.mutex);
+		path = r.output;
+	}
+	if (path.empty()) return;
+
+	std::ofstream out(path);
+	if (!out) throw std::runtime_error("cannot write the trace to " + path.string());
+	write_chrome_trace(out);
+}
+
+void clear() {
+	Registry &r = registry();
+	std::unique_lock<std::mutex> lk(r.mutex);
+	for (const auto &buffer : r.buffers) {
+		std::unique_lock<std::mutex> buffer_lk(buffer->mutex);
+		buffer->next = 0;
+		buffer->wrapped = false;
+	}
+}
+
+} // namespace utils::trace
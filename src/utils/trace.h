@@ -0,0 +1,88 @@
+/*
+
+Copyright (C) 2019 Mateusz Morusiewicz
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <ostream>
+
+/* Scoped spans recorded into per-thread ring buffers and written out as Chrome trace-event JSON
+ * (chrome://tracing, Perfetto). Recording is off until enabled at run time; building without
+ * HDPWM_TRACING removes the spans altogether. Names and categories have to be string literals. */
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+
+#ifdef HDPWM_TRACING
+#define TRACE_SPAN(category, name) \
+	utils::trace::Span TRACE_CONCAT(trace_span_, __LINE__)(category, name)
+#else
+#define TRACE_SPAN(category, name) \
+	do {                           \
+	} while (0)
+#endif
+
+namespace utils::trace {
+
+/* events kept per thread, older ones are overwritten */
+constexpr size_t BUFFER_EVENTS = 8192;
+
+#ifdef HDPWM_TRACING
+bool enabled();
+#else
+constexpr bool enabled() { return false; }
+#endif
+
+void set_enabled(bool enabled);
+
+/* where dump() writes to, recording is enabled along with it */
+void set_output(std::filesystem::path path);
+std::filesystem::path output();
+
+int64_t now_ns();
+void record(const char *category, const char *name, int64_t start_ns, int64_t end_ns);
+
+/* events of every thread, oldest first */
+void write_chrome_trace(std::ostream &out);
+
+/* to the output set before, nothing happens without one */
+void dump();
+
+/* drops the recorded events */
+void clear();
+
+class Span {
+	const char *category;
+	const char *name;
+	int64_t start_ns;
+
+  public:
+	Span(const char *category, const char *name) :
+	    category(category), name(name), start_ns(enabled() ? now_ns() : -1) {}
+	~Span() {
+		if (start_ns >= 0) record(category, name, start_ns, now_ns());
+	}
+
+	Span(const Span &) = delete;
+	Span &operator=(const Span &) = delete;
+};
+
+} // namespace utils::trace
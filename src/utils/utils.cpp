@@ -43,4 +43,50 @@ void print_bytes(void *buffer, int size) {
 	std::cout << std::endl;
 }
 
+namespace {
+
+void remove_arguments(int &argc, const char *argv[], int first, int n) {
+	/* argv[argc] is the terminating nullptr, it moves along */
+	for (int i = first + n; i <= argc; ++i) argv[i - n] = argv[i];
+	argc -= n;
+}
+
+bool ends_options(std::string_view arg, const CommandMatcher &is_command) {
+	return arg == "--" || (is_command && is_command(arg));
+}
+
+} // namespace
+
+std::optional<std::string> take_option(
+    int &argc, const char *argv[], std::string_view name, const CommandMatcher &is_command) {
+	for (int i = 1; i < argc; ++i) {
+		const std::string_view arg = argv[i];
+		if (ends_options(arg, is_command)) break;
+		if (arg.substr(0, name.size()) != name) continue;
+
+		if (arg.size() > name.size() && arg[name.size()] == '=') {
+			std::string rv(arg.substr(name.size() + 1));
+			remove_arguments(argc, argv, i, 1);
+			return rv;
+		}
+		if (arg.size() == name.size() && i + 1 < argc) {
+			std::string rv(argv[i + 1]);
+			remove_arguments(argc, argv, i, 2);
+			return rv;
+		}
+	}
+	return std::nullopt;
+}
+
+bool take_flag(
+    int &argc, const char *argv[], std::string_view name, const CommandMatcher &is_command) {
+	for (int i = 1; i < argc; ++i) {
+		if (ends_options(argv[i], is_command)) break;
+		if (argv[i] != name) continue;
+		remove_arguments(argc, argv, i, 1);
+		return true;
+	}
+	return false;
+}
+
 } // namespace utils
@@ -19,8 +19,10 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
 #pragma once
 
+#include <functional>
 #include <optional>
 #include <string>
+#include <string_view>
 #include <vector>
 
 namespace utils {
@@ -29,6 +31,17 @@ std::vector<std::string> split_string(std::string str);
 
 void print_bytes(void *buffer, int size);
 
+/* tells the name of a subcommand, whose arguments are its own */
+using CommandMatcher = std::function<bool(std::string_view)>;
+
+/* Takes --name=value or --name value out of the command line, for options that every command
+ * understands and that are handled before any of them parses its arguments. Looks no further
+ * than "--" or the first argument is_command accepts. */
+std::optional<std::string> take_option(
+    int &argc, const char *argv[], std::string_view name, const CommandMatcher &is_command = {});
+bool take_flag(
+    int &argc, const char *argv[], std::string_view name, const CommandMatcher &is_command = {});
+
 template <typename T = void> struct Result {
 	std::optional<T> _value;
 	std::string_view _reason;
@@ -0,0 +1,200 @@
+/*
+
+Copyright (C) 2019 Mateusz Morusiewicz
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#include <src/agent/client.h>
+#include <src/agent/protocol.h>
+#include <src/agent/server.h>
+
+#include <src/keychain/keychain.h>
+
+#include <external/catch2/catch.hpp>
+
+#include <cstdio>
+#include <filesystem>
+#include <string>
+#include <thread>
+
+namespace {
+
+agent::Request derive_request(uint32_t id, uint32_t dpath) {
+	agent::Request request;
+	request.id = id;
+	request.type = agent::RequestType::Derive;
+	request.dpath = dpath;
+	return request;
+}
+
+/* keychain with dir1/entry1 (dpath 6) and entry2 (dpath 7) in a fresh temporary directory */
+std::unique_ptr<keychain::Keychain> sample_keychain(const std::filesystem::path &path) {
+	crypto::Seed seed;
+	for (size_t i = 0; i < seed.size(); ++i) seed[i] = i * 7;
+
+	auto kc = keychain::Keychain::initialize_with_seed(path, seed, crypto::hash_password("pw"));
+	auto root = kc->get_root_dir();
+	auto dir = std::make_shared<keychain::Directory>(keychain::DirectoryMeta{"dir1", ""}, root);
+	dir->entries.push_back(std::make_shared<keychain::Entry>(keychain::EntryMeta{"entry1", "", {6}}, dir));
+	root->dirs.push_back(dir);
+	root->entries.push_back(std::make_shared<keychain::Entry>(keychain::EntryMeta{"entry2", "", {7}}, root));
+	kc->save_entries(root);
+	return kc;
+}
+
+} // namespace
+
+TEST_CASE( "agent messages survive encoding", "[agent_protocol]" ) {
+	std::vector<char> stream;
+	agent::encode(derive_request(1, 42), stream);
+	agent::encode(agent::Request{2, agent::RequestType::Lookup, "dir1/entry1", 0}, stream);
+
+	agent::Response listing;
+	listing.id = 3;
+	listing.type = agent::RequestType::List;
+	listing.items = {{true, "dir1"}, {false, "entry2"}};
+	agent::encode(listing, stream);
+
+	/* fed one byte at a time, frames have to come out whole */
+	agent::FrameReader reader;
+	std::vector<std::string> payloads;
+	for (char c : stream) {
+		reader.feed(&c, 1);
+		while (auto payload = reader.next()) payloads.emplace_back(*payload);
+	}
+
+	REQUIRE( payloads.size() == 3 );
+
+	auto derive = agent::decode_request(payloads[0]);
+	REQUIRE( derive.id == 1 );
+	REQUIRE( derive.type == agent::RequestType::Derive );
+	REQUIRE( derive.dpath == 42 );
+
+	auto lookup = agent::decode_request(payloads[1]);
+	REQUIRE( lookup.type == agent::RequestType::Lookup );
+	REQUIRE( lookup.path == "dir1/entry1" );
+
+	auto decoded_listing = agent::decode_response(payloads[2]);
+	REQUIRE( decoded_listing.id == 3 );
+	REQUIRE( decoded_listing.items == listing.items );
+
+	REQUIRE_THROWS_AS( agent::decode_request(payloads[0].substr(0, 6)), agent::ProtocolError );
+
+	agent::Response long_name;
+	long_name.type = agent::RequestType::List;
+	long_name.items = {{false, std::string(70000, 'x')}};
+	std::vector<char> out{'a'};
+	REQUIRE_THROWS_AS( agent::encode(long_name, out), agent::ProtocolError );
+	REQUIRE( out == std::vector<char>{'a'} );
+
+	agent::FrameReader oversized;
+	const char header[] = {0x7f, 0, 0, 0};
+	oversized.feed(header, sizeof(header));
+	REQUIRE_THROWS_AS( oversized.next(), agent::ProtocolError );
+}
+
+TEST_CASE( "agent serves secrets of an unlocked keychain", "[agent_server]" ) {
+	const std::filesystem::path dir = std::tmpnam(nullptr);
+	std::filesystem::create_directory(dir);
+
+	{
+		auto kc = sample_keychain(dir / "kc");
+		const auto entry1_secret = kc->derive_secret({6});
+		const auto dpath_secret = kc->derive_secret({1234});
+
+		agent::ServerOptions options;
+		options.socket_path = dir / "agent.sock";
+		options.n_workers = 2;
+
+		agent::Server server(std::move(kc), options);
+		std::thread reactor([&server]() { server.run(); });
+
+		{
+			agent::Client client(options.socket_path);
+			REQUIRE( client.lookup("dir1/entry1") == entry1_secret );
+			REQUIRE( client.derive(1234) == dpath_secret );
+
+			auto items = client.list("/");
+			REQUIRE( items == std::vector<agent::ListItem>{{true, "dir1"}, {false, "entry2"}} );
+
+			auto entries = client.entries();
+			REQUIRE( entries == std::vector<agent::EntryInfo>{{"entry2", "", 7}, {"dir1/entry1", "", 6}} );
+
+			REQUIRE_THROWS( client.lookup("dir1/missing") );
+			REQUIRE_THROWS( client.lookup("dir1") );
+
+			/* pipelined, answers may come back in any order */
+			std::vector<uint32_t> ids;
+			for (uint32_t i = 0; i < 64; ++i) {
+				ids.push_back(client.send(derive_request(0, i % 2 ? 1234 : 6)));
+			}
+			for (size_t i = ids.size(); i-- > 0;) {
+				auto response = client.receive(ids[i]);
+				REQUIRE( response.status == agent::Status::Ok );
+				REQUIRE( response.secret == (i % 2 ? dpath_secret : entry1_secret) );
+			}
+		}
+
+		server.stop();
+		reactor.join();
+	}
+
+	/* derivations are logged under the entry they belong to, other paths not at all */
+	{
+		auto kc = keychain::Keychain::open(dir / "kc", crypto::hash_password("pw"));
+		const auto top = kc->access_log().top();
+		REQUIRE( top.size() == 1 );
+		REQUIRE( top[0].dpath == 6 );
+		REQUIRE( top[0].path == "dir1/entry1" );
+		REQUIRE( top[0].count == 33 );
+	}
+
+	std::filesystem::remove_all(dir);
+}
+
+TEST_CASE( "agent answers replies too large for a frame with an error", "[agent_server]" ) {
+	const std::filesystem::path dir = std::tmpnam(nullptr);
+	std::filesystem::create_directory(dir);
+
+	{
+		auto kc = sample_keychain(dir / "kc");
+		kc->update([](keychain::Directory::ptr root) {
+			for (int i = 0; i < 3; ++i) {
+				keychain::add_entry(root, "big" + std::to_string(i), std::string(500000, 'd'), {i});
+			}
+		});
+		const auto entry1_secret = kc->derive_secret({6});
+
+		agent::ServerOptions options;
+		options.socket_path = dir / "agent.sock";
+		options.n_workers = 1;
+
+		agent::Server server(std::move(kc), options);
+		std::thread reactor([&server]() { server.run(); });
+
+		{
+			agent::Client client(options.socket_path);
+			REQUIRE_THROWS( client.entries() );
+			REQUIRE( client.lookup("dir1/entry1") == entry1_secret );
+		}
+
+		server.stop();
+		reactor.join();
+	}
+
+	REQUIRE( !std::filesystem::exists(dir / "agent.sock") );
+	std::filesystem::remove_all(dir);
+}
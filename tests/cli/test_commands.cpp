@@ -0,0 +1,113 @@
+/*
+
+Copyright (C) 2019 Mateusz Morusiewicz
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#include <src/cli/commands.h>
+
+#include <src/keychain/keychain.h>
+
+#include <external/catch2/catch.hpp>
+#include <external/nlohmann/json_single_include.h>
+
+#include <cstdio>
+#include <filesystem>
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+#include <unistd.h>
+
+namespace {
+
+/* runs a command with the phrase on a pipe and returns its stdout */
+std::string run(std::vector<std::string> args, int expected_exit_code = 0) {
+	int password_pipe[2];
+	REQUIRE( pipe(password_pipe) == 0 );
+	REQUIRE( write(password_pipe[1], "pw\n", 3) == 3 );
+	close(password_pipe[1]);
+
+	/* nothing is left behind in the unlock cache */
+	args.insert(args.begin() + 1,
+	    {"--password-fd", std::to_string(password_pipe[0]), "--cache-timeout", "0"});
+	std::vector<const char *> argv;
+	for (const auto &arg : args) argv.push_back(arg.c_str());
+
+	std::ostringstream out;
+	auto *old_buf = std::cout.rdbuf(out.rdbuf());
+	int exit_code = (*cli::find_command(args[0]))(argv.size(), argv.data());
+	std::cout.rdbuf(old_buf);
+	close(password_pipe[0]);
+
+	REQUIRE( exit_code == expected_exit_code );
+	return out.str();
+}
+
+} // namespace
+
+TEST_CASE( "keychain commands run without the TUI", "[cli_commands]" ) {
+	REQUIRE( cli::find_command("ls") );
+	REQUIRE_FALSE( cli::find_command("-p") );
+
+	const std::filesystem::path dir = std::tmpnam(nullptr);
+	std::filesystem::create_directory(dir);
+
+	{
+		crypto::Seed seed;
+		for (size_t i = 0; i < seed.size(); ++i) seed[i] = i * 5;
+		auto kc = keychain::Keychain::initialize_with_seed(dir / "kc", seed, crypto::hash_password("pw"));
+		kc.reset(); // the commands open it themselves
+	}
+	const std::string kc_path = (dir / "kc").string();
+
+	run({"add", "-p", kc_path, "--dir", "web"});
+	run({"add", "-p", kc_path, "-d", "line1\nline2", "web/github.com"});
+	run({"add", "-p", kc_path, "web/github.com"}, 1);
+
+	REQUIRE( run({"ls", "-p", kc_path, "-r"}) == "dir\tweb\t\t\nentry\tweb/github.com\t1\tline1\\nline2\n" );
+
+	auto listed = nlohmann::json::parse(run({"ls", "-p", kc_path, "-f", "json", "/web"}));
+	REQUIRE( listed.size() == 1 );
+	REQUIRE( listed[0]["path"] == "web/github.com" );
+	REQUIRE( listed[0]["dpath"] == 1 );
+
+	const std::string secret = run({"get", "-p", kc_path, "web/github.com"});
+	REQUIRE( secret.size() == 11 );
+	REQUIRE( nlohmann::json::parse(run({"get", "-p", kc_path, "-f", "json", "web/github.com"}))["secret"] == secret.substr(0, 10) );
+
+	run({"add", "-p", kc_path, "-t", "prod, db", "web/postgres"});
+	run({"add", "-p", kc_path, "-t", "a&b", "web/bad"}, 1);
+	run({"add", "-p", kc_path, "-t", "prod", "--dir", "servers"}, 1);
+	REQUIRE( run({"ls", "-p", kc_path, "--filter", "db & !legacy"}) == "entry\tweb/postgres\t3\t\n" );
+	REQUIRE( nlohmann::json::parse(run({"ls", "-p", kc_path, "-f", "json", "web/postgres"}))[0]["tags"] == nlohmann::json{"db", "prod"} );
+	REQUIRE( run({"ls", "-p", kc_path, "--filter", "nosuchtag"}).empty() );
+	run({"ls", "-p", kc_path, "--filter", "prod &"}, 1);
+	run({"rm", "-p", kc_path, "web/postgres"});
+
+	run({"mv", "-p", kc_path, "web/github.com", "github"});
+	REQUIRE( run({"get", "-p", kc_path, "github"}) == secret );
+
+	run({"export", "-p", kc_path, (dir / "export").string()});
+	run({"rm", "-p", kc_path, "web"});
+	run({"rm", "-p", kc_path, "github"});
+	REQUIRE( run({"ls", "-p", kc_path}).empty() );
+
+	run({"import", "-p", kc_path, (dir / "export").string()});
+	REQUIRE( run({"get", "-p", kc_path, "github"}) == secret );
+
+	std::filesystem::remove_all(dir);
+}
@@ -0,0 +1,100 @@
+/*
+
+Copyright (C) 2019 Mateusz Morusiewicz
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#include <src/cli/derive.h>
+
+#include <src/keychain/keychain.h>
+
+#include <external/catch2/catch.hpp>
+
+#include <cstdio>
+#include <filesystem>
+#include <sstream>
+
+TEST_CASE( "derive streams records in input order", "[cli_derive]" ) {
+	const std::filesystem::path dir = std::tmpnam(nullptr);
+	std::filesystem::create_directory(dir);
+
+	{
+		crypto::Seed seed;
+		for (size_t i = 0; i < seed.size(); ++i) seed[i] = i * 3;
+		auto kc = keychain::Keychain::initialize_with_seed(dir / "kc", seed, crypto::hash_password("pw"));
+		auto root = kc->get_root_dir();
+		auto dir1 = std::make_shared<keychain::Directory>(keychain::DirectoryMeta{"dir1", ""}, root);
+		dir1->entries.push_back(std::make_shared<keychain::Entry>(keychain::EntryMeta{"entry1", "", {6}}, dir1));
+		root->dirs.push_back(dir1);
+		root->entries.push_back(std::make_shared<keychain::Entry>(keychain::EntryMeta{"42", "", {7}}, root));
+
+		auto secret = [&kc](int dpath) { return static_cast<std::string>(kc->derive_secret({dpath})); };
+
+		const std::string expected = "dir1/entry1\t" + secret(6) + "\n" + "42\t" + secret(42) + "\n" +
+		                             "/42\t" + secret(7) + "\n";
+
+		cli::DeriveOptions options;
+		for (bool batch : {false, true}) {
+			options.batch = batch;
+			options.n_threads = 2;
+			options.chunk_size = 2;
+
+			std::istringstream in("dir1/entry1\n42\nmissing\ndir1\r\n/42\n");
+			std::ostringstream out, err;
+			auto stats = cli::derive_stream(*kc, root, in, out, err, options);
+
+			REQUIRE( out.str() == expected );
+			REQUIRE( stats.records == 3 );
+			REQUIRE( stats.errors == 2 );
+			REQUIRE( err.str() == "item 3 (missing): no such entry\nitem 4 (dir1): not an entry\n" );
+		}
+
+		SECTION( "NUL-delimited" ) {
+			options.delimiter = '\0';
+			std::istringstream in(std::string("dir1/entry1\0" "5\0", 14));
+			std::ostringstream out, err;
+			cli::derive_stream(*kc, root, in, out, err, options);
+
+			REQUIRE( out.str() == "dir1/entry1\t" + secret(6) + std::string(1, '\0') + "5\t" + secret(5) + std::string(1, '\0') );
+		}
+
+		SECTION( "many chunks come back in order" ) {
+			std::string input, expected_many;
+			for (int i = 0; i < 5000; ++i) {
+				input += std::to_string(i) + "\n";
+			}
+			const auto secrets = kc->derive_secrets([] {
+				std::vector<crypto::DerivationPath> dpaths;
+				for (int i = 0; i < 5000; ++i) dpaths.push_back({i});
+				return dpaths;
+			}());
+			for (int i = 0; i < 5000; ++i) {
+				expected_many += std::to_string(i) + "\t" + static_cast<std::string>(secrets[i]) + "\n";
+			}
+
+			options.batch = true;
+			options.chunk_size = 7;
+			std::istringstream in(input);
+			std::ostringstream out, err;
+			auto stats = cli::derive_stream(*kc, root, in, out, err, options);
+
+			REQUIRE( stats.records == 5000 );
+			REQUIRE( out.str() == expected_many );
+		}
+	}
+
+	std::filesystem::remove_all(dir);
+}
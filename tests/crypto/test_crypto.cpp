@@ -157,3 +157,22 @@ TEST_CASE( "children are derived properly", "[derive_child]" ) {
 	REQUIRE( seed._data == expected_seed._data );
 }
 
+
+TEST_CASE( "password checks tell the right phrase apart without revealing it", "[password_check]" ) {
+	const auto right = crypto::hash_password("right");
+	const auto wrong = crypto::hash_password("wrong");
+
+	const std::string check = crypto::make_password_check(right, 1000);
+	REQUIRE( check.rfind("pbkdf2-sha256:1000:", 0) == 0 );
+	REQUIRE( check.find(serialize(right)) == std::string::npos );
+	/* salted, so the same phrase never gives the same check twice */
+	REQUIRE( crypto::make_password_check(right, 1000) != check );
+
+	REQUIRE( crypto::verify_password_check(right, check) == true );
+	REQUIRE( crypto::verify_password_check(wrong, check) == false );
+
+	REQUIRE( !crypto::verify_password_check(right, "") );
+	REQUIRE( !crypto::verify_password_check(right, check.substr(0, check.size() - 2)) );
+	REQUIRE( !crypto::verify_password_check(right, "sha256:1:00:00") );
+	REQUIRE( !crypto::verify_password_check(right, std::string(64, 'a')) );
+}
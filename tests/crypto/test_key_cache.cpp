@@ -0,0 +1,119 @@
+/*
+
+Copyright (C) 2019 Mateusz Morusiewicz
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#include <src/crypto/key_cache.h>
+
+#include <external/catch2/catch.hpp>
+
+#include <sys/stat.h>
+
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <optional>
+#include <thread>
+
+namespace {
+
+crypto::CachedKey sample_key(unsigned char fill) {
+	crypto::CachedKey rv;
+	for (size_t i = 0; i < rv.pw_hash.size(); ++i) rv.pw_hash[i] = fill + i;
+	for (size_t i = 0; i < rv.check_tag.size(); ++i) rv.check_tag[i] = fill * 3 + i;
+	return rv;
+}
+
+bool same_key(const std::optional<crypto::CachedKey> &lhs, const crypto::CachedKey &rhs) {
+	return lhs && lhs->pw_hash == rhs.pw_hash && lhs->check_tag == rhs.check_tag;
+}
+
+void check_round_trip(crypto::KeyCache &cache, const std::string &id) {
+	using namespace std::chrono_literals;
+
+	REQUIRE( !cache.load(id) );
+
+	cache.store(id, sample_key(1), 60s);
+	auto loaded = cache.load(id);
+	REQUIRE( loaded );
+	REQUIRE( same_key(loaded, sample_key(1)) );
+	REQUIRE( !cache.load(id + "-other") );
+
+	/* storing again replaces */
+	cache.store(id, sample_key(2), 60s);
+	REQUIRE( same_key(cache.load(id), sample_key(2)) );
+
+	cache.forget(id);
+	REQUIRE( !cache.load(id) );
+
+	/* a zero timeout caches nothing */
+	cache.store(id, sample_key(3), 0s);
+	REQUIRE( !cache.load(id) );
+}
+
+} // namespace
+
+TEST_CASE( "runtime directory cache keeps hashes until they expire", "[key_cache_runtime_dir]" ) {
+	const std::filesystem::path dir = std::tmpnam(nullptr);
+	auto cache = crypto::make_runtime_dir_cache(dir);
+
+	check_round_trip(*cache, "/some/keychain");
+
+	/* the directory is private and so is every record in it */
+	cache->store("/some/keychain", sample_key(4), std::chrono::seconds(60));
+	struct stat st;
+	REQUIRE( ::stat(dir.c_str(), &st) == 0 );
+	REQUIRE( (st.st_mode & 077) == 0 );
+
+	/* loading never writes, records would be replaced by new files */
+	const auto record_path = std::filesystem::directory_iterator(dir)->path();
+	struct stat before;
+	REQUIRE( ::stat(record_path.c_str(), &before) == 0 );
+	REQUIRE( same_key(cache->load("/some/keychain"), sample_key(4)) );
+	REQUIRE( ::stat(record_path.c_str(), &st) == 0 );
+	REQUIRE( st.st_ino == before.st_ino );
+	REQUIRE( st.st_mtime == before.st_mtime );
+
+	for (const auto &record : std::filesystem::directory_iterator(dir)) {
+		REQUIRE( ::stat(record.path().c_str(), &st) == 0 );
+		REQUIRE( (st.st_mode & 077) == 0 );
+
+		/* a record readable by others is not trusted */
+		std::filesystem::permissions(record.path(), std::filesystem::perms::group_read,
+		    std::filesystem::perm_options::add);
+	}
+	REQUIRE( !cache->load("/some/keychain") );
+
+	std::filesystem::remove_all(dir);
+}
+
+TEST_CASE( "kernel keyring cache keeps hashes until they expire", "[key_cache_kernel]" ) {
+	auto cache = crypto::make_kernel_keyring_cache();
+	if (!cache) {
+		WARN( "no kernel keyring support, skipped" );
+		return;
+	}
+
+	check_round_trip(*cache, std::string("test:") + std::tmpnam(nullptr));
+
+	/* the kernel drops the key once its timeout passes */
+	const std::string id = std::string("test:") + std::tmpnam(nullptr);
+	cache->store(id, sample_key(5), std::chrono::seconds(1));
+	REQUIRE( cache->load(id) );
+	std::this_thread::sleep_for(std::chrono::milliseconds(2100));
+	REQUIRE( !cache->load(id) );
+}
@@ -0,0 +1,138 @@
+/*
+
+Copyright (C) 2019 Mateusz Morusiewicz
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#include <src/crypto/crypto.h>
+#include <src/crypto/locked_memory.h>
+#include <src/crypto/utils.h>
+#include <src/keychain/keychain.h>
+
+#include <external/catch2/catch.hpp>
+
+#include <limits>
+#include <vector>
+
+namespace {
+
+/* restores the rlimit based budget even if a test fails */
+struct LockLimitGuard {
+	LockLimitGuard(size_t limit) { crypto::set_locked_memory_limit(limit); }
+	~LockLimitGuard() { crypto::set_locked_memory_limit(0); }
+};
+
+} // namespace
+
+TEST_CASE( "small sensitive strings share locked pages", "[locked_memory_pool]" ) {
+	const auto before = crypto::locked_memory_stats();
+
+	std::vector<utils::sensitive_string> strings;
+	for (int i = 0; i < 256; ++i) {
+		strings.emplace_back(32);
+	}
+
+	const auto after = crypto::locked_memory_stats();
+	REQUIRE( after.pooled_bytes - before.pooled_bytes <= 3 * 4096 );
+}
+
+TEST_CASE( "exhausted budget degrades instead of throwing", "[locked_memory_budget]" ) {
+	LockLimitGuard guard(crypto::locked_memory_stats().locked_bytes);
+	const auto before = crypto::locked_memory_stats();
+
+	std::vector<utils::sensitive_string> strings;
+	for (int i = 0; i < 32; ++i) {
+		REQUIRE_NOTHROW( strings.emplace_back(8192) );
+		strings.back().push_back('x');
+	}
+
+	const auto after = crypto::locked_memory_stats();
+	REQUIRE( after.degraded_pages > before.degraded_pages );
+	REQUIRE( after.locked_bytes <= after.limit );
+}
+
+TEST_CASE( "freed pages don't pile up in the idle queue", "[locked_memory_budget]" ) {
+	LockLimitGuard guard(std::numeric_limits<size_t>::max());
+	const auto before = crypto::locked_memory_stats();
+
+	for (int i = 0; i < 10000; ++i) {
+		void *large = crypto::secure_alloc(3 * 4096);
+		void *small = crypto::secure_alloc(32);
+		crypto::secure_free(large, 3 * 4096);
+		crypto::secure_free(small, 32);
+	}
+
+	const auto after = crypto::locked_memory_stats();
+	REQUIRE( after.idle_pages <= before.idle_pages + 4 );
+	REQUIRE( after.locked_bytes <= before.locked_bytes + 4 * 4096 );
+}
+
+TEST_CASE( "memory locked for others is unlocked once released", "[locked_memory_budget]" ) {
+	LockLimitGuard guard(std::numeric_limits<size_t>::max());
+	const auto before = crypto::locked_memory_stats();
+
+	std::vector<char> buffer(3 * 4096);
+	crypto::lock_mem(buffer.data(), buffer.size());
+	crypto::lock_mem(buffer.data(), 1);
+	const auto locked = crypto::locked_memory_stats();
+	REQUIRE( (locked.locked_bytes > before.locked_bytes || locked.degraded_pages > before.degraded_pages) );
+
+	crypto::unlock_mem(buffer.data(), buffer.size());
+	crypto::unlock_mem(buffer.data(), 1);
+	const auto after = crypto::locked_memory_stats();
+	REQUIRE( after.locked_bytes == before.locked_bytes );
+	REQUIRE( after.idle_pages == before.idle_pages );
+}
+
+TEST_CASE( "released pool pages are reused", "[locked_memory_budget]" ) {
+	LockLimitGuard guard(std::numeric_limits<size_t>::max());
+
+	std::vector<void *> slots;
+	for (int i = 0; i < 100; ++i) slots.push_back(crypto::secure_alloc(1024));
+	const auto allocated = crypto::locked_memory_stats();
+
+	for (void *slot : slots) crypto::secure_free(slot, 1024);
+	const auto freed = crypto::locked_memory_stats();
+	REQUIRE( freed.idle_pages > allocated.idle_pages );
+	REQUIRE( freed.pooled_bytes < allocated.pooled_bytes );
+
+	for (void *&slot : slots) slot = crypto::secure_alloc(1024);
+	REQUIRE( crypto::locked_memory_stats().idle_pages < freed.idle_pages );
+	for (void *slot : slots) crypto::secure_free(slot, 1024);
+}
+
+TEST_CASE( "a million secrets are derived within a 64KB lock limit", "[locked_memory_stress]" ) {
+	constexpr size_t LOCK_LIMIT = 64 * 1024;
+	LockLimitGuard guard(LOCK_LIMIT);
+
+	const crypto::PasswordHash pw_hash = crypto::hash_password("password");
+	crypto::Seed seed;
+	for (size_t i = 0; i < seed.size(); ++i) seed[i] = i;
+	const crypto::EncryptedSeed encrypted_seed = crypto::encrypt_seed(seed, pw_hash);
+
+	std::vector<utils::sensitive_string> recent(64);
+	for (int i = 0; i < 1000000; ++i) {
+		crypto::Seed derived = crypto::derive_child(pw_hash, encrypted_seed, {i % 65536});
+		recent[i % recent.size()] = keychain::Keychain::encode_secret(derived.data(), derived.size(), 10);
+
+		if (i % 100000 == 0) {
+			REQUIRE( crypto::locked_memory_stats().locked_bytes <= LOCK_LIMIT );
+		}
+	}
+
+	REQUIRE( crypto::locked_memory_stats().locked_bytes <= LOCK_LIMIT );
+	REQUIRE( recent.back().size() == 10 );
+}
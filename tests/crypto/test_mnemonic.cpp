@@ -67,6 +67,18 @@ TEST_CASE( "seeds are calculated properly", "[seeds_vector]" ) {
 	}
 }
 
+TEST_CASE( "seeds are calculated asynchronously", "[seeds_vector_async]" ) {
+	for (auto &tc : mnemonic_test_vector) {
+		auto seed = crypto::mnemonic_to_seed_async(tc.mnemonic).get();
+		REQUIRE( seed._data == tc.expected_seed._data );
+	}
+
+	utils::OperationOptions options;
+	options.cancel_token.cancel();
+	auto cancelled = crypto::mnemonic_to_seed_async(mnemonic_test_vector[0].mnemonic, options);
+	REQUIRE_THROWS_AS( cancelled.get(), utils::OperationCancelled );
+}
+
 // TODO: Should throw on invalid seed
 TEST_CASE( "seed calculation throws on invalid word", "[seeds_vector_throws_on_invalid]" ) {
 	for (auto &im : invalid_mnemonic_test_vector) {
@@ -75,9 +87,15 @@ TEST_CASE( "seed calculation throws on invalid word", "[seeds_vector_throws_on_i
 }
 
 TEST_CASE( "mnemonic is split into words properly", "[split_mnemonic]" ) {
-	std::vector<utils::sensitive_string> split = crypto::split_mnemonic_words({"word1 word2 word3 word4 somereallylongword s word7 word8 word9 w10 w11 w12 salt"});
+	utils::sensitive_string mnemonic("word1 word2 word3 word4 somereallylongword s word7 word8 word9 w10 w11 w12 salt");
+	std::vector<utils::sensitive_string_view> split = crypto::split_mnemonic_words(mnemonic);
 	std::vector<utils::sensitive_string> expected = {
 		{"word1"}, {"word2"}, {"word3"}, {"word4"}, {"somereallylongword"}, {"s"}, {"word7"}, {"word8"}, {"word9"}, {"w10"}, {"w11"}, {"w12"}, {"salt"}
 	};
-	REQUIRE( split == expected );
+	REQUIRE( std::vector<utils::sensitive_string>(split.begin(), split.end()) == expected );
+
+	for (const auto &word : split) {
+		REQUIRE( word.data() >= mnemonic.data() );
+		REQUIRE( word.data() + word.size() <= mnemonic.data() + mnemonic.size() );
+	}
 }
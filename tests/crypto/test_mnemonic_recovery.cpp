@@ -0,0 +1,107 @@
+/*
+
+Copyright (C) 2019 Mateusz Morusiewicz
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#include <src/crypto/mnemonic.h>
+#include <src/crypto/mnemonic_recovery.h>
+
+#include <external/catch2/catch.hpp>
+
+namespace {
+
+template <typename Words> std::vector<int> to_indices(const Words &words) {
+	std::vector<int> rv;
+	for (const auto &word : words) rv.push_back(crypto::find_word_index(word));
+	return rv;
+}
+
+const utils::sensitive_string valid_mnemonic_text("abandon abandon abandon abandon abandon abandon abandon abandon abandon abandon abandon about");
+
+std::vector<utils::sensitive_string_view> valid_mnemonic() {
+	return crypto::split_mnemonic_words(valid_mnemonic_text);
+}
+
+std::vector<utils::sensitive_string_view> as_views(const std::vector<utils::sensitive_string> &words) {
+	return {words.begin(), words.end()};
+}
+
+} // namespace
+
+TEST_CASE( "checksum is verified", "[mnemonic_checksum]" ) {
+	REQUIRE( crypto::verify_mnemonic_checksum(to_indices(valid_mnemonic())) );
+
+	auto invalid = valid_mnemonic();
+	invalid.back() = invalid.front();
+	REQUIRE( !crypto::verify_mnemonic_checksum(to_indices(invalid)) );
+
+	REQUIRE( !crypto::verify_mnemonic_checksum({0, 0, 0}) );
+}
+
+TEST_CASE( "generated mnemonics pass the checksum", "[mnemonic_checksum_generated]" ) {
+	for (int entropy_size : {16, 20, 24, 28, 32}) {
+		auto words = crypto::generate_mnemonic(entropy_size);
+		words.pop_back(); // extra word is not checksummed
+		REQUIRE( crypto::verify_mnemonic_checksum(to_indices(words)) );
+	}
+}
+
+TEST_CASE( "candidates are found for unknown words", "[mnemonic_candidates]" ) {
+	const std::vector<utils::sensitive_string> words = {{"abandon"}, {"?"}, {"abandn"}, {"zzzzzzzzzzzz"}};
+	auto candidates = crypto::mnemonic_candidates(as_views(words), 1);
+
+	REQUIRE( candidates.size() == 4 );
+	REQUIRE( candidates[0] == std::vector<int>{0} );
+	REQUIRE( candidates[1].size() == crypto::MNEMONIC_DICTIONARY_SIZE );
+	REQUIRE( candidates[2].front() == 0 );
+	REQUIRE( candidates[3].size() == crypto::MNEMONIC_DICTIONARY_SIZE );
+
+	REQUIRE( crypto::is_mnemonic_complete(valid_mnemonic()) );
+	REQUIRE( !crypto::is_mnemonic_complete(as_views(words)) );
+}
+
+TEST_CASE( "missing and misspelled words are recovered", "[mnemonic_recovery]" ) {
+	const utils::sensitive_string text("legal winner thank year wave sausage worth useful legal winner thank yellow");
+	const auto mnemonic = crypto::split_mnemonic_words(text);
+	const crypto::Seed expected_seed = crypto::mnemonic_to_seed(mnemonic);
+	auto matcher = [&expected_seed](const crypto::Seed &seed) { return seed == expected_seed; };
+
+	auto damaged = mnemonic;
+	damaged[4] = {crypto::MNEMONIC_WILDCARD, 1};
+	damaged[5] = mnemonic[5].substr(0, 6); // "sausag"
+
+	crypto::RecoveryProgress progress;
+	crypto::RecoveryOptions options;
+	options.progress = &progress;
+
+	auto recovered = crypto::recover_mnemonic(damaged, matcher, options);
+	REQUIRE( recovered );
+	REQUIRE( as_views(*recovered) == mnemonic );
+	REQUIRE( progress.total >= crypto::MNEMONIC_DICTIONARY_SIZE );
+	REQUIRE( progress.derived < progress.checked );
+}
+
+TEST_CASE( "recovery can be cancelled", "[mnemonic_recovery_cancel]" ) {
+	auto damaged = valid_mnemonic();
+	damaged[0] = {crypto::MNEMONIC_WILDCARD, 1};
+
+	crypto::RecoveryOptions options;
+	options.cancel_token.cancel();
+
+	auto recovered = crypto::recover_mnemonic(damaged, [](const crypto::Seed &) { return true; }, options);
+	REQUIRE( !recovered );
+}
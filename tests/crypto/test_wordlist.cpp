@@ -0,0 +1,62 @@
+/*
+
+Copyright (C) 2019 Mateusz Morusiewicz
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#include <src/crypto/wordlist.h>
+
+#include <external/catch2/catch.hpp>
+
+TEST_CASE( "Every word is found at its own index", "[wordlist_find]" ) {
+	const crypto::Wordlist &words = crypto::wordlist(crypto::Language::English);
+	REQUIRE( words.size() == 2048 );
+	for (size_t i = 0; i < words.size(); ++i) {
+		REQUIRE( words.find(words.at(i)) == int(i) );
+	}
+}
+
+TEST_CASE( "Unknown words are not found", "[wordlist_find]" ) {
+	const crypto::Wordlist &words = crypto::wordlist();
+	REQUIRE_FALSE( words.find("") );
+	REQUIRE_FALSE( words.find("abandonn") );
+	REQUIRE_FALSE( words.find("aban") );
+	REQUIRE_FALSE( words.find("zzzzzzzzzzzz") );
+}
+
+TEST_CASE( "Prefix ranges cover words sharing the prefix", "[wordlist_prefix]" ) {
+	const crypto::Wordlist &words = crypto::wordlist();
+	REQUIRE( words.prefix_range("") == std::make_pair(0, 2048) );
+	REQUIRE( words.prefix_range("zo") == std::make_pair(2046, 2048) );
+	REQUIRE( words.prefix_range("qz").first == words.prefix_range("qz").second );
+
+	auto [lo, hi] = words.prefix_range("act");
+	REQUIRE( hi - lo == 5 ); // act, action, actor, actress, actual
+	REQUIRE( words.at(lo) == "act" );
+	REQUIRE( words.at(hi - 1) == "actual" );
+}
+
+TEST_CASE( "Four letters are enough to complete any word", "[wordlist_complete]" ) {
+	const crypto::Wordlist &words = crypto::wordlist();
+	for (size_t i = 0; i < words.size(); ++i) {
+		std::string_view word = words.at(i);
+		if (word.size() < crypto::WORDLIST_UNIQUE_PREFIX) continue; // may prefix longer words
+		REQUIRE( words.complete(word.substr(0, crypto::WORDLIST_UNIQUE_PREFIX)) == int(i) );
+	}
+
+	REQUIRE_FALSE( words.complete("ab") );
+	REQUIRE_FALSE( words.complete("xyz") );
+}
@@ -0,0 +1,195 @@
+/*
+
+Copyright (C) 2019 Mateusz Morusiewicz
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+
+#include <src/keychain/access_log.h>
+#include <src/keychain/keychain.h>
+
+#include <external/catch2/catch.hpp>
+
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+using keychain::AccessLog;
+
+namespace {
+
+constexpr int64_t DAY = 24 * 60 * 60;
+constexpr int64_t NOW = 1600000000;
+
+std::vector<std::string> paths(const std::vector<keychain::AccessRecord> &records) {
+	std::vector<std::string> rv;
+	for (const auto &record : records) rv.push_back(record.path);
+	return rv;
+}
+
+struct TemporaryKeychain {
+	const std::filesystem::path dir = std::tmpnam(nullptr);
+	std::unique_ptr<keychain::Keychain> kc;
+
+	TemporaryKeychain() {
+		std::filesystem::create_directory(dir);
+		kc = keychain::Keychain::initialize_with_seed(
+		    dir / "kc", crypto::Seed{}, crypto::hash_password("pw"));
+	}
+	~TemporaryKeychain() {
+		kc.reset();
+		std::filesystem::remove_all(dir);
+	}
+
+	void reopen() {
+		kc.reset();
+		kc = keychain::Keychain::open(dir / "kc", crypto::hash_password("pw"));
+	}
+};
+
+} // namespace
+
+TEST_CASE( "frecency heap keeps the highest ranks", "[access_log]" ) {
+	std::mt19937 rng(7);
+	std::uniform_real_distribution<double> rank_dist(0, 100);
+	std::uniform_int_distribution<int> id_dist(0, 200);
+
+	keychain::FrecencyHeap heap(10);
+	std::vector<double> ranks(201, -1);
+	for (int i = 0; i < 5000; ++i) {
+		/* ranks only grow */
+		const int id = id_dist(rng);
+		ranks[id] = std::max(ranks[id], rank_dist(rng));
+		heap.offer(id, ranks[id]);
+	}
+
+	std::vector<int> expected;
+	for (int id = 0; id < 201; ++id) {
+		if (ranks[id] >= 0) expected.push_back(id);
+	}
+	std::sort(expected.begin(), expected.end(),
+	    [&ranks](int lhs, int rhs) { return ranks[lhs] > ranks[rhs]; });
+	expected.resize(10);
+
+	REQUIRE( heap.size() == 10 );
+	REQUIRE( heap.ranked() == expected );
+	REQUIRE( heap.contains(expected.back()) );
+}
+
+TEST_CASE( "accesses are ranked by frecency", "[access_log]" ) {
+	TemporaryKeychain tmp;
+	AccessLog &log = tmp.kc->access_log();
+	REQUIRE( log.top().empty() );
+
+	for (int i = 0; i < 10; ++i) log.record({1}, "old/often", NOW - 30 * DAY);
+	log.record({2}, "just/now", NOW);
+	for (int i = 0; i < 5; ++i) log.record({3}, "yesterday", NOW - DAY);
+
+	const auto top = log.top();
+	REQUIRE( paths(top) == std::vector<std::string>{"yesterday", "just/now", "old/often"} );
+	REQUIRE( top[0].count == 5 );
+	REQUIRE( top[0].last_access == NOW - DAY );
+
+	/* a week halves the score */
+	REQUIRE( log.score(top[1], NOW) == Approx(1) );
+	REQUIRE( log.score(top[1], NOW + 7 * DAY) == Approx(0.5) );
+	REQUIRE( log.score(top[0], NOW - DAY) == Approx(5) );
+
+	/* an unknown path keeps the recorded one */
+	log.record({2}, "", NOW);
+	REQUIRE( log.top()[1].path == "just/now" );
+	REQUIRE( log.top()[1].count == 2 );
+}
+
+TEST_CASE( "accesses are kept across reopening", "[access_log]" ) {
+	TemporaryKeychain tmp;
+	tmp.kc->access_log().record({4}, "a", NOW);
+	tmp.kc->access_log().record({5}, "b", NOW);
+	tmp.kc->access_log().record({5}, "b", NOW);
+	tmp.kc->access_log().flush();
+
+	tmp.reopen();
+	auto top = tmp.kc->access_log().top();
+	REQUIRE( paths(top) == std::vector<std::string>{"b", "a"} );
+	REQUIRE( top[0].count == 2 );
+	REQUIRE( top[0].dpath == 5 );
+
+	/* pending accesses are written on close */
+	tmp.kc->access_log().record({4}, "a", NOW + DAY);
+	tmp.reopen();
+	REQUIRE( paths(tmp.kc->access_log().top()) == std::vector<std::string>{"a", "b"} );
+}
+
+TEST_CASE( "accesses are read without loading the tree", "[access_log]" ) {
+	TemporaryKeychain tmp;
+	tmp.kc->access_log().record({4}, "a", NOW);
+	tmp.kc.reset();
+
+	utils::OperationProgress progress;
+	std::vector<std::string> stages;
+	utils::OperationOptions options;
+	options.progress = &progress;
+	options.on_progress = [&]() { stages.push_back(progress.stage.load()); };
+
+	tmp.kc = keychain::Keychain::open(tmp.dir / "kc", crypto::hash_password("pw"), options);
+	REQUIRE( stages == std::vector<std::string>{"Opening database"} );
+	REQUIRE( paths(tmp.kc->access_log().top()) == std::vector<std::string>{"a"} );
+}
+
+TEST_CASE( "reconciling follows renames and forgets removed entries", "[access_log]" ) {
+	TemporaryKeychain tmp;
+	tmp.kc->update([](keychain::Directory::ptr root) {
+		keychain::add_directory(root, "web", "");
+		keychain::add_entry(root, "web/github", "", {1});
+		keychain::add_entry(root, "bank", "", {2});
+		keychain::add_entry(root, "alias", "", {1});
+	});
+
+	AccessLog &log = tmp.kc->access_log();
+	log.record({1}, "web/github", NOW);
+	log.record({2}, "bank", NOW - DAY);
+
+	/* the recorded one of entries sharing a derivation path stays */
+	log.reconcile(tmp.kc->snapshot()->root);
+	REQUIRE( paths(log.top()) == std::vector<std::string>{"web/github", "bank"} );
+
+	tmp.kc->update([](keychain::Directory::ptr root) {
+		keychain::remove_by_path(root, "alias", false);
+		keychain::move_by_path(root, "web/github", "gh");
+		keychain::remove_by_path(root, "bank", false);
+	});
+	log.reconcile(tmp.kc->snapshot()->root);
+
+	REQUIRE( paths(log.top()) == std::vector<std::string>{"gh"} );
+}
+
+TEST_CASE( "the least frecent accesses are forgotten", "[access_log]" ) {
+	TemporaryKeychain tmp;
+	AccessLog &log = tmp.kc->access_log();
+	for (int i = 0; i < int(keychain::MAX_ACCESS_RECORDS) + 5; ++i) {
+		log.record({i}, std::to_string(i), NOW + i);
+	}
+	log.record({0}, "0", NOW + 2 * DAY);
+
+	const auto top = paths(log.top());
+	REQUIRE( top.size() == keychain::DEFAULT_QUICK_ACCESS_SIZE );
+	REQUIRE( std::vector<std::string>(top.begin(), top.begin() + 3) ==
+	         std::vector<std::string>{"0", "1004", "1003"} );
+}
@@ -31,6 +31,8 @@ using json = nlohmann::json;
 
 #include <fstream>
 #include <cstdio>
+#include <filesystem>
+#include <future>
 
 class KeychainMock: public keychain::Keychain {
 public:
@@ -63,7 +65,7 @@ public:
 	}
 };
 
-json sample_entries = json::parse(R"({ "name": "dir1", "details": "details1", "dirs": [{"name": "dir2", "details": "details2", "dirs": [], "entries": [{"name": "entry1", "details": "entry_details1", "derivation_path": 6}]}], "entries": [{"name": "entry2", "details": "entry_details2", "derivation_path": 7}] })");
+json sample_entries = json::parse(R"({ "name": "dir1", "details": "details1", "dirs": [{"name": "dir2", "details": "details2", "dirs": [], "entries": [{"name": "entry1", "details": "entry_details1", "derivation_path": 6, "id": 2}]}], "entries": [{"name": "entry2", "details": "entry_details2", "derivation_path": 7, "id": 1}] })");
 
 crypto::PasswordHash sample_password_hash = crypto::deserialize<crypto::PasswordHash>("5e884898da28047151d0e56f8dc6292773603d0d6aabbdd62a11ef721d1542d8");
 
@@ -109,6 +111,28 @@ TEST_CASE( "secrets are derived properly", "[keychain_derive_secret]" ) {
 	REQUIRE( static_cast<std::string>(rv) == "MkAsM%uZXu" );
 }
 
+TEST_CASE( "batches of secrets load the seed once", "[keychain_derive_secret]" ) {
+	auto db = new DBMock();
+
+	db->Get_mock_fn = [](const leveldb::ReadOptions&, const leveldb::Slice& key, std::string* value) {
+		REQUIRE( key.ToString() == "seed" );
+		*value = sample_seed;
+		return leveldb::Status();
+	};
+
+	KeychainMock kc;
+	kc.set_db(std::unique_ptr<keychain::DB>(db));
+	kc.set_ec(sample_password_hash);
+
+	auto rv = kc.derive_secrets({ { 1 }, { 2 }, { 1 } });
+
+	REQUIRE( db->Get_call_count == 1 );
+	REQUIRE( rv.size() == 3 );
+	REQUIRE( static_cast<std::string>(rv[0]) == "MkAsM%uZXu" );
+	REQUIRE( rv[1] == kc.derive_secret({ 2 }) );
+	REQUIRE( rv[2] == rv[0] );
+}
+
 TEST_CASE( "entries are saved as expected", "[keychain_save_entries]" ) {
 	auto db = new DBMock();
 
@@ -182,7 +206,7 @@ TEST_CASE( "can export and import", "[keychain_export_import]" ) {
 		export_file >> fc;
 		export_file.close();
 
-		REQUIRE( fc == "T/CjXuX2Qa3cGUMS8PFQhUL7Jky7Dc+Wq19k/zCEy8HnymriHKnLed1FcDjS+PTR4m4dlZXLCORJBY40UKvcr7AxD+kZ2CH6N6LlM5TxLiTRBuXIA2lgj3rfOz3pBbqbf5qQUIflPUIVc1WgTtKBwzFot4BGn2EtpYIhox4utGGcPKTD00xmCL6I9ltdWoDRWw6bhPcM7evAgAJ5R5zyCeNATbAqmrLedNWd6Olrsiawi4cNESMeuWp9zkvnwhZf5Rk4awZ6KRHg/KGuLaP9sp3o/kp21VQwe5M+8v16eJFODwK75v4J7nEDB1qa6sVWNWQEXkWnYKMk15HZwbQj/plra76K6YMtKpSdZJ5YNC1m4VWjkZM0lWtFGuNH1VwV1DLjkcNCHJU0BTHL0p3huKOqC0b/JhMaRI8XwUHDKmce3UnSUMyw3A==" );
+		REQUIRE( fc == "T/CjXuX2Qa3cGUMS8PFQhUL7Jky7Dc+Wq19k/zCEy8HnymriHKnLed1FcDjS+PTR4m4dlZXLCORJBY40UKvcr7AxD+kZ2CH6N6LlM5TxLiTRBuXIA2lgj3rfOz3pBbqbf5qQUIflPUIVc1WgTtKBwzFot4BGn2EtpYIhox4utGGcPKTD00xmCL6I9ltdWoDRWw6bhPcM7evAgAJ5R5zyCeNATbUpjsqEcNaF6NFRwWLYQhF29uIY8iR8hSGLpMv6Gq/8QTXyBBPThIP0luZi4XYyocWlqg+auhQNc0RV/Vl7ArWv9UeZGz15gnivEsJ7BXfKITh7944Fv61MhtWWZo7Btm3T+xnhhnQBnjOF059/O+KFUEAXt9+LDr4jI1xjrhz7q6E71AVSCll6+eVYaM7eNuICBscyD431GY3emR0EnZ5UbALZKO6i+n+fvL5MDydCAOwp9sCuMf6t" );
 	}
 
 	{ /* import */
@@ -196,3 +220,89 @@ TEST_CASE( "can export and import", "[keychain_export_import]" ) {
 		REQUIRE( keychain::serialize_directory(kc.get_root_dir()) == sample_entries );
 	}
 }
+
+TEST_CASE( "export and import run asynchronously", "[keychain_export_import_async]" ) {
+	auto entries_Get_mock_fn = [](const leveldb::ReadOptions&, const leveldb::Slice& key, std::string* value) {
+		*value = key.ToString() == "entries" ? sample_entries.dump() : sample_seed;
+		return leveldb::Status();
+	};
+
+	const std::filesystem::path tmp_path = std::tmpnam(nullptr);
+
+	{ /* a cancelled export writes nothing */
+		KeychainMock kc;
+		auto db = new DBMock();
+		db->Get_mock_fn = entries_Get_mock_fn;
+		kc.set_db(std::unique_ptr<keychain::DB>(db));
+		kc.set_ec(sample_password_hash);
+
+		utils::OperationOptions options;
+		options.cancel_token.cancel();
+		REQUIRE_THROWS_AS( kc.export_to_uri_async(tmp_path, options).get(), utils::OperationCancelled );
+		REQUIRE( !std::filesystem::exists(tmp_path) );
+	}
+
+	{ /* export */
+		KeychainMock kc;
+		auto db = new DBMock();
+		db->Get_mock_fn = entries_Get_mock_fn;
+		kc.set_db(std::unique_ptr<keychain::DB>(db));
+		kc.set_ec(sample_password_hash);
+
+		utils::OperationProgress progress;
+		std::vector<std::string> stages;
+		utils::OperationOptions options;
+		options.progress = &progress;
+		options.on_progress = [&]() { stages.push_back(progress.stage.load()); };
+
+		kc.export_to_uri_async(tmp_path, options).get();
+		REQUIRE( stages == std::vector<std::string>{"Serializing entries", "Encrypting entries", "Writing export"} );
+		REQUIRE( progress.done == progress.total );
+	}
+
+	{ /* import, cancelled once the entries are decrypted */
+		KeychainMock kc;
+		auto db = new DBMock();
+		db->Get_mock_fn = entries_Get_mock_fn;
+		kc.set_db(std::unique_ptr<keychain::DB>(db));
+		kc.set_ec(sample_password_hash);
+
+		utils::OperationProgress progress;
+		utils::OperationOptions options;
+		options.progress = &progress;
+		options.on_progress = [&progress, token = options.cancel_token]() {
+			if (std::string(progress.stage.load()) == "Parsing entries") token.cancel();
+		};
+
+		REQUIRE_THROWS_AS( kc.import_from_uri_async(tmp_path, options).get(), utils::OperationCancelled );
+		REQUIRE( db->Put_call_count == 0 );
+
+		kc.import_from_uri_async(tmp_path).get();
+		REQUIRE( db->Put_call_count == 1 );
+		REQUIRE( keychain::serialize_directory(kc.snapshot()->root) == sample_entries );
+	}
+
+	std::filesystem::remove(tmp_path);
+}
+
+TEST_CASE( "asynchronous saves are applied in the order they were requested", "[keychain_save_entries_async]" ) {
+	auto db = new DBMock();
+
+	KeychainMock kc;
+	kc.set_db(std::unique_ptr<keychain::DB>(db));
+
+	auto root = keychain::deserialize_directory(sample_entries, 0);
+
+	std::vector<std::future<void>> saves;
+	for (int i = 0; i < 16; ++i) {
+		root->meta.details = "save" + std::to_string(i);
+		saves.push_back(kc.save_entries_async(root));
+	}
+	for (auto &save : saves) save.get();
+
+	/* the last requested tree wins no matter in which order the pool ran the saves */
+	REQUIRE( db->Put_call_count >= 1 );
+	const auto &last_put = std::get<1>(db->Put_calls.back());
+	REQUIRE( json::parse(last_put.second)["details"] == "save15" );
+	REQUIRE( kc.snapshot()->root->meta.details == "save15" );
+}
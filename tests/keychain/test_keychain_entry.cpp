@@ -161,3 +161,43 @@ TEST_CASE( "flattening works as intended", "[keychain_flatten]" ) {
 		REQUIRE( flattened_entry2->parent_dir.lock() == flattened_root );
 	}
 }
+
+TEST_CASE( "entries are edited by path", "[keychain_edit_by_path]" ) {
+	json data = json::parse(R"({ "name": "dir1", "details": "details1", "dirs": [{"name": "dir2", "details": "details2", "dirs": [], "entries": [{"name": "entry1", "details": "entry_details1", "derivation_path": 6}]}], "entries": [{"name": "entry2", "details": "entry_details2", "derivation_path": 7}] })");
+
+	auto root = deserialize_directory(data, 0);
+
+	auto entry3 = keychain::add_entry(root, "dir2/entry3", "details3", { 8 });
+	REQUIRE( entry3->parent_dir.lock() == root->dirs[0] );
+	REQUIRE( std::get<Entry::ptr>(*keychain::find_by_path(root, "/dir2/entry3")) == entry3 );
+	REQUIRE( keychain::path_of(entry3) == "dir2/entry3" );
+	REQUIRE_THROWS( keychain::add_entry(root, "dir2/entry3", "", { 9 }) );
+	REQUIRE_THROWS( keychain::add_entry(root, "missing/entry", "", { 9 }) );
+	REQUIRE_THROWS( keychain::add_directory(root, "entry2", "") );
+
+	auto dir3 = keychain::add_directory(root, "dir2/dir3/", "");
+	REQUIRE( dir3->dir_level == 2 );
+
+	/* into an existing directory, then renamed */
+	keychain::move_by_path(root, "entry2", "dir2/dir3");
+	REQUIRE( dir3->entries.size() == 1 );
+	REQUIRE( root->entries.empty() );
+	keychain::move_by_path(root, "dir2/dir3/entry2", "renamed");
+	REQUIRE( std::get<Entry::ptr>(*keychain::find_by_path(root, "renamed"))->meta.dpath.seed == 7 );
+
+	REQUIRE_THROWS( keychain::move_by_path(root, "dir2", "dir2/dir3") );
+	REQUIRE_THROWS( keychain::move_by_path(root, "renamed", "dir2/entry1") );
+
+	keychain::move_by_path(root, "dir2/dir3", "/");
+	auto moved = std::get<Directory::ptr>(*keychain::find_by_path(root, "dir3"));
+	REQUIRE( moved->dir_level == 1 );
+	REQUIRE( moved->parent_dir.lock() == root );
+
+	REQUIRE_THROWS( keychain::remove_by_path(root, "dir2", false) );
+	keychain::remove_by_path(root, "dir2", true);
+	keychain::remove_by_path(root, "renamed", false);
+	REQUIRE_THROWS( keychain::remove_by_path(root, "renamed", false) );
+	REQUIRE_THROWS( keychain::remove_by_path(root, "/", true) );
+
+	REQUIRE( serialize_directory(root) == json::parse(R"({ "name": "dir1", "details": "details1", "dirs": [{"name": "dir3", "details": "", "dirs": [], "entries": []}], "entries": [] })") );
+}
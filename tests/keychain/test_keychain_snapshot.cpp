@@ -0,0 +1,153 @@
+/*
+
+Copyright (C) 2019 Mateusz Morusiewicz
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#include <src/keychain/keychain.h>
+
+#include <external/catch2/catch.hpp>
+
+#include <atomic>
+#include <cstdio>
+#include <filesystem>
+#include <thread>
+#include <vector>
+
+TEST_CASE( "readers see consistent snapshots while a writer publishes", "[keychain_snapshot]" ) {
+	const std::filesystem::path dir = std::tmpnam(nullptr);
+	std::filesystem::create_directory(dir);
+
+	{
+		crypto::Seed seed;
+		for (size_t i = 0; i < seed.size(); ++i) seed[i] = i;
+		auto kc = keychain::Keychain::initialize_with_seed(dir / "kc", seed, crypto::hash_password("pw"));
+
+		const auto first = kc->snapshot();
+		REQUIRE( first->root->entries.empty() );
+		REQUIRE( kc->snapshot() == first ); // no reload while nothing changed
+
+		/* every update adds exactly one entry, so any snapshot has version - first version of them */
+		for (size_t n_readers : {1, 2, 4, 8, 16, 32, 64}) {
+			std::atomic<bool> done{false};
+			std::atomic<size_t> reads{0};
+			std::atomic<size_t> inconsistent{0};
+
+			std::vector<std::thread> readers;
+			for (size_t r = 0; r < n_readers; ++r) {
+				readers.emplace_back([&]() {
+					uint64_t last_version = 0;
+					do {
+						const auto snapshot = kc->snapshot();
+						const size_t expected = snapshot->version - first->version;
+						if (snapshot->version < last_version || snapshot->root->entries.size() != expected) {
+							++inconsistent;
+						}
+						last_version = snapshot->version;
+						++reads;
+					} while (!done);
+				});
+			}
+
+			for (int i = 0; i < 20; ++i) {
+				kc->update([](keychain::Directory::ptr root) {
+					const auto name = "entry" + std::to_string(root->entries.size());
+					keychain::add_entry(root, name, "", { static_cast<int>(root->entries.size()) });
+				});
+			}
+
+			done = true;
+			for (auto &reader : readers) reader.join();
+
+			REQUIRE( inconsistent == 0 );
+			REQUIRE( reads >= n_readers );
+		}
+
+		/* snapshots taken earlier are left alone */
+		REQUIRE( first->root->entries.empty() );
+		REQUIRE( kc->snapshot()->root->entries.size() == 140 );
+
+		/* concurrent writers are serialized, none of their changes get lost */
+		std::vector<std::thread> writers;
+		for (int w = 0; w < 8; ++w) {
+			writers.emplace_back([&kc, w]() {
+				for (int i = 0; i < 10; ++i) {
+					const auto dpath = kc->get_next_derivation_path();
+					kc->update([&](keychain::Directory::ptr root) {
+						keychain::add_entry(root, "w" + std::to_string(w) + "_" + std::to_string(i), "", dpath);
+					});
+				}
+			});
+		}
+		for (auto &writer : writers) writer.join();
+
+		REQUIRE( kc->snapshot()->root->entries.size() == 220 );
+		REQUIRE( kc->get_next_derivation_path().seed == 81 );
+
+		/* what was published is what was persisted */
+		kc.reset();
+		auto reopened = keychain::Keychain::open(dir / "kc", crypto::hash_password("pw"));
+		REQUIRE( reopened->snapshot()->root->entries.size() == 220 );
+	}
+
+	std::filesystem::remove_all(dir);
+}
+
+TEST_CASE( "saving a copy never undoes a newer version", "[keychain_snapshot]" ) {
+	const std::filesystem::path dir = std::tmpnam(nullptr);
+	std::filesystem::create_directory(dir);
+
+	{
+		auto kc = keychain::Keychain::initialize_with_seed(dir / "kc", crypto::Seed{}, crypto::hash_password("pw"));
+		const auto base = kc->snapshot();
+		auto copy = kc->get_root_dir();
+
+		keychain::add_entry(copy, "mine", "", {1});
+		const uint64_t saved = kc->save_entries(copy, base->version);
+		REQUIRE( saved == base->version + 1 );
+		REQUIRE( kc->snapshot()->version == saved );
+
+		kc->update([](keychain::Directory::ptr root) { keychain::add_entry(root, "theirs", "", {2}); });
+
+		keychain::add_entry(copy, "stale", "", {3});
+		REQUIRE_THROWS_AS( kc->save_entries(copy, saved), keychain::StaleTreeError );
+		REQUIRE( keychain::find_by_path(kc->snapshot()->root, "theirs") );
+		REQUIRE( !keychain::find_by_path(kc->snapshot()->root, "stale") );
+	}
+
+	std::filesystem::remove_all(dir);
+}
+
+TEST_CASE( "an asynchronous save requested earlier doesn't undo an update", "[keychain_snapshot]" ) {
+	const std::filesystem::path dir = std::tmpnam(nullptr);
+	std::filesystem::create_directory(dir);
+
+	{
+		auto kc = keychain::Keychain::initialize_with_seed(dir / "kc", crypto::Seed{}, crypto::hash_password("pw"));
+		auto old_copy = kc->get_root_dir();
+
+		/* the update goes in while the save is already queued */
+		utils::OperationOptions options;
+		options.on_progress = [&kc]() {
+			kc->update([](keychain::Directory::ptr root) { keychain::add_entry(root, "newer", "", {1}); });
+		};
+		kc->save_entries_async(old_copy, options).get();
+
+		REQUIRE( keychain::find_by_path(kc->snapshot()->root, "newer") );
+	}
+
+	std::filesystem::remove_all(dir);
+}
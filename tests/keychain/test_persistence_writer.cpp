@@ -0,0 +1,191 @@
+/*
+
+Copyright (C) 2019 Mateusz Morusiewicz
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+
+#include <src/keychain/persistence_writer.h>
+
+#include <external/catch2/catch.hpp>
+
+#include <cstdio>
+#include <filesystem>
+#include <string>
+#include <thread>
+#include <vector>
+
+TEST_CASE( "persistence writer coalesces edits", "[persistence_writer]" ) {
+	using namespace std::chrono_literals;
+
+	const std::filesystem::path dir = std::tmpnam(nullptr);
+	std::filesystem::create_directory(dir);
+
+	crypto::Seed seed;
+	std::shared_ptr<keychain::Keychain> kc = keychain::Keychain::initialize_with_seed(
+	    dir / "kc", seed, crypto::hash_password("pw"));
+
+	SECTION( "a burst is written once" ) {
+		keychain::PersistenceWriter writer(kc, 1s, 10s);
+		auto root = writer.root();
+		writer.flush();
+		REQUIRE( writer.writes() == 0 );
+
+		for (int i = 0; i < 100; ++i) {
+			writer.modify([&]() { keychain::add_entry(root, "entry" + std::to_string(i), "", { i }); });
+		}
+		writer.flush();
+		REQUIRE( writer.writes() == 1 );
+		REQUIRE( keychain::find_by_path(kc->snapshot()->root, "entry99") );
+
+		/* nothing left to write */
+		writer.flush();
+		REQUIRE( writer.writes() == 1 );
+	}
+
+	SECTION( "edits are written without a flush" ) {
+		keychain::PersistenceWriter writer(kc, 20ms, 10s);
+		auto root = writer.root();
+		writer.modify([&]() { keychain::add_entry(root, "entry", "", { 1 }); });
+
+		for (int i = 0; i < 200 && writer.writes() == 0; ++i) std::this_thread::sleep_for(10ms);
+		REQUIRE( writer.writes() == 1 );
+		REQUIRE( keychain::find_by_path(kc->snapshot()->root, "entry") );
+	}
+
+	SECTION( "a steady stream of edits is written within the staleness bound" ) {
+		keychain::PersistenceWriter writer(kc, 50ms, 100ms);
+		auto root = writer.root();
+		const auto end = std::chrono::steady_clock::now() + 500ms;
+		for (int i = 0; std::chrono::steady_clock::now() < end; ++i) {
+			writer.modify([&]() { root->meta.details = std::to_string(i); });
+			std::this_thread::sleep_for(5ms);
+		}
+		REQUIRE( writer.writes() >= 2 );
+	}
+
+	SECTION( "the tag index has the edits before they are written" ) {
+		keychain::PersistenceWriter writer(kc, 10s, 10s);
+		auto root = writer.root();
+		writer.modify([&](keychain::EntryChanges &changes) {
+			auto entry = keychain::add_entry(root, "told", "", { 1 });
+			entry->meta.tags = {"work"};
+			changes.changed(*entry);
+		});
+		REQUIRE( writer.tags()->query("work").cardinality() == 1 );
+
+		writer.modify([&]() { keychain::add_entry(root, "untold", "", { 2 })->meta.tags = {"work"}; });
+		REQUIRE( writer.tags()->query("work").cardinality() == 2 );
+		REQUIRE( writer.writes() == 0 );
+
+		writer.flush();
+		REQUIRE( kc->snapshot()->tags->query("work") == writer.tags()->query("work") );
+	}
+
+	SECTION( "pending edits are written on destruction" ) {
+		{
+			keychain::PersistenceWriter writer(kc, 10s, 10s);
+			auto root = writer.root();
+			writer.modify([&]() { keychain::add_entry(root, "entry", "", { 1 }); });
+		}
+		REQUIRE( keychain::find_by_path(kc->snapshot()->root, "entry") );
+	}
+
+	SECTION( "writes don't undo changes published meanwhile" ) {
+		int rebases = 0;
+		keychain::WriterCallbacks callbacks;
+		callbacks.on_rebased = [&rebases]() { ++rebases; };
+		keychain::PersistenceWriter writer(kc, 10s, 10s, callbacks);
+		auto root = writer.root();
+		kc->update([](keychain::Directory::ptr root) { keychain::add_entry(root, "other", "", { 2 }); });
+
+		writer.modify([&]() { keychain::add_entry(root, "entry", "", { 1 }); });
+		writer.flush();
+		REQUIRE( rebases == 1 );
+		REQUIRE( keychain::find_by_path(kc->snapshot()->root, "other") );
+		REQUIRE( keychain::find_by_path(kc->snapshot()->root, "entry") );
+		REQUIRE( keychain::find_by_path(root, "other") );
+	}
+
+	SECTION( "failed writes are reported, the last one too" ) {
+		std::vector<std::string> failures;
+		keychain::WriterCallbacks callbacks;
+		callbacks.on_failure = [&failures](std::exception_ptr error) {
+			try {
+				std::rethrow_exception(error);
+			} catch (const std::exception &e) {
+				failures.push_back(e.what());
+			}
+		};
+
+		{
+			keychain::PersistenceWriter writer(kc, 10s, 10s, callbacks);
+			auto root = writer.root();
+			/* an entry without an id, in a tree with none left to give */
+			writer.modify([&]() {
+				root->next_entry_id = 0;
+				root->entries.push_back(
+				    std::make_shared<keychain::Entry>(keychain::EntryMeta{"entry", "", { 1 }}, root));
+			});
+			REQUIRE_THROWS_WITH( writer.flush(), "out of entry ids" );
+			REQUIRE( failures == std::vector<std::string>{"out of entry ids"} );
+
+			writer.modify([&]() { root->meta.details = "again"; });
+		}
+		REQUIRE( failures.size() == 2 );
+	}
+
+	SECTION( "rebases take removals and edits of entries left alone" ) {
+		kc->update([](keychain::Directory::ptr root) {
+			keychain::add_entry(root, "kept", "", { 1 });
+			keychain::add_directory(root, "dir", "");
+			keychain::add_entry(root, "dir/edited", "", { 2 });
+			keychain::add_entry(root, "dir/removed", "", { 3 });
+			keychain::add_entry(root, "both", "", { 4 });
+		});
+
+		keychain::PersistenceWriter writer(kc, 10s, 10s);
+		auto root = writer.root();
+		kc->update([](keychain::Directory::ptr root) {
+			std::get<keychain::Entry::ptr>(*keychain::find_by_path(root, "dir/edited"))->meta.details = "theirs";
+			std::get<keychain::Entry::ptr>(*keychain::find_by_path(root, "both"))->meta.details = "theirs";
+			keychain::remove_by_path(root, "dir/removed", false);
+			keychain::add_directory(root, "new", "");
+			keychain::add_entry(root, "new/added", "", { 5 });
+		});
+
+		writer.modify([&]() {
+			std::get<keychain::Entry::ptr>(*keychain::find_by_path(root, "both"))->meta.details = "ours";
+			keychain::add_entry(root, "mine", "", { 6 });
+		});
+		writer.flush();
+
+		const auto published = kc->snapshot()->root;
+		auto details = [&published](std::string_view path) {
+			return std::get<keychain::Entry::ptr>(*keychain::find_by_path(published, path))->meta.details;
+		};
+		REQUIRE( keychain::find_by_path(published, "kept") );
+		REQUIRE( details("dir/edited") == "theirs" );
+		REQUIRE( details("both") == "ours" );
+		REQUIRE( !keychain::find_by_path(published, "dir/removed") );
+		REQUIRE( keychain::find_by_path(published, "new/added") );
+		REQUIRE( keychain::find_by_path(published, "mine") );
+		REQUIRE( !keychain::assign_entry_ids(deep_copy_directory(published, nullptr)) );
+	}
+
+	kc.reset();
+	std::filesystem::remove_all(dir);
+}
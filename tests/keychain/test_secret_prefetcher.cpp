@@ -0,0 +1,95 @@
+/*
+
+Copyright (C) 2019 Mateusz Morusiewicz
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+
+#include <src/keychain/secret_prefetcher.h>
+
+#include <external/catch2/catch.hpp>
+
+#include <cstdio>
+#include <filesystem>
+#include <thread>
+
+namespace {
+
+bool wait_until_cached(keychain::SecretPrefetcher &prefetcher, int dpath) {
+	for (int i = 0; i < 500 && !prefetcher.is_cached({ dpath }); ++i) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	}
+	return prefetcher.is_cached({ dpath });
+}
+
+} // namespace
+
+TEST_CASE( "secrets are prefetched, expire and are wiped", "[secret_prefetcher]" ) {
+	using namespace std::chrono_literals;
+
+	const std::filesystem::path dir = std::tmpnam(nullptr);
+	std::filesystem::create_directory(dir);
+
+	crypto::Seed seed;
+	for (size_t i = 0; i < seed.size(); ++i) seed[i] = i;
+	std::shared_ptr<keychain::Keychain> kc = keychain::Keychain::initialize_with_seed(
+	    dir / "kc", seed, crypto::hash_password("pw"));
+
+	SECTION( "prefetched secrets match derived ones" ) {
+		keychain::SecretPrefetcher prefetcher(kc, 60s, 4);
+		prefetcher.prefetch({ { 1 }, { 2 }, { 3 } });
+		REQUIRE( wait_until_cached(prefetcher, 3) );
+		REQUIRE( prefetcher.is_cached({ 1 }) );
+
+		for (int dpath : { 1, 2, 3 }) {
+			REQUIRE( prefetcher.get({ dpath }) == kc->derive_secret({ dpath }) );
+		}
+
+		/* not prefetched, derived on demand */
+		REQUIRE( !prefetcher.is_cached({ 7 }) );
+		REQUIRE( prefetcher.get({ 7 }) == kc->derive_secret({ 7 }) );
+		REQUIRE( prefetcher.is_cached({ 7 }) );
+
+		prefetcher.wipe();
+		REQUIRE( !prefetcher.is_cached({ 1 }) );
+		REQUIRE( !prefetcher.is_cached({ 7 }) );
+	}
+
+	SECTION( "the cache is bounded" ) {
+		keychain::SecretPrefetcher prefetcher(kc, 60s, 2);
+		prefetcher.prefetch({ { 1 }, { 2 }, { 3 } });
+		REQUIRE( wait_until_cached(prefetcher, 2) );
+		std::this_thread::sleep_for(50ms);
+		REQUIRE( !prefetcher.is_cached({ 3 }) );
+
+		/* retargeting keeps the newest secrets */
+		prefetcher.prefetch({ { 5 } });
+		REQUIRE( wait_until_cached(prefetcher, 5) );
+		REQUIRE( prefetcher.is_cached({ 2 }) );
+		REQUIRE( !prefetcher.is_cached({ 1 }) );
+	}
+
+	SECTION( "secrets expire" ) {
+		keychain::SecretPrefetcher prefetcher(kc, 100ms);
+		prefetcher.prefetch({ { 1 } });
+		REQUIRE( wait_until_cached(prefetcher, 1) );
+		std::this_thread::sleep_for(200ms);
+		REQUIRE( !prefetcher.is_cached({ 1 }) );
+	}
+
+	kc.reset();
+	std::filesystem::remove_all(dir);
+}
@@ -0,0 +1,89 @@
+/*
+
+Copyright (C) 2019 Mateusz Morusiewicz
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+
+#include <src/keychain/synthetic.h>
+
+#include <external/catch2/catch.hpp>
+#include <external/nlohmann/json_single_include.h>
+
+#include <set>
+#include <string>
+
+TEST_CASE( "synthetic trees follow their shape", "[synthetic]" ) {
+	keychain::KeychainShape shape;
+	shape.n_entries = 1000;
+	shape.depth = 2;
+	shape.fan_out = 3;
+	shape.name_length = keychain::LengthDistribution::uniform(4, 10);
+	shape.details_length = keychain::LengthDistribution::normal(30, 10);
+
+	const auto root = keychain::generate_tree(shape);
+	REQUIRE( root->dirs.size() == 3 );
+	REQUIRE( root->entries.empty() );
+
+	size_t n_entries = 0;
+	std::set<int> dpaths;
+	for (const auto &dir : root->dirs) {
+		REQUIRE( dir->dirs.size() == 3 );
+		REQUIRE( dir->entries.empty() );
+
+		for (const auto &leaf : dir->dirs) {
+			REQUIRE( leaf->dir_level == 2 );
+			REQUIRE( leaf->dirs.empty() );
+
+			std::set<std::string> names;
+			for (const auto &entry : leaf->entries) {
+				REQUIRE( entry->parent_dir.lock() == leaf );
+				REQUIRE( entry->meta.name.size() >= 4 );
+				REQUIRE( entry->meta.name.size() <= 10 );
+				REQUIRE( !entry->meta.details.empty() );
+				names.insert(entry->meta.name);
+				dpaths.insert(entry->meta.dpath.seed);
+			}
+			REQUIRE( names.size() == leaf->entries.size() );
+			n_entries += leaf->entries.size();
+		}
+	}
+	REQUIRE( n_entries == 1000 );
+	REQUIRE( dpaths.size() == 1000 );
+	REQUIRE( *dpaths.rbegin() == 999 );
+
+	/* the same seed, the same tree */
+	REQUIRE( keychain::serialize_directory(keychain::generate_tree(shape)) ==
+	         keychain::serialize_directory(root) );
+	shape.seed = 2;
+	REQUIRE( keychain::serialize_directory(keychain::generate_tree(shape)) !=
+	         keychain::serialize_directory(root) );
+}
+
+TEST_CASE( "synthetic names grow to stay unique", "[synthetic]" ) {
+	keychain::KeychainShape shape;
+	shape.n_entries = 1000;
+	shape.depth = 0;
+	shape.name_length = keychain::LengthDistribution::uniform(1, 1);
+
+	const auto root = keychain::generate_tree(shape);
+	REQUIRE( root->entries.size() == 1000 );
+
+	std::set<std::string> names;
+	for (const auto &entry : root->entries) names.insert(entry->meta.name);
+	REQUIRE( names.size() == 1000 );
+	REQUIRE( root->entries.front()->meta.name.size() == 3 );
+}
@@ -0,0 +1,286 @@
+/*
+
+Copyright (C) 2019 Mateusz Morusiewicz
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+
+#include <src/keychain/keychain.h>
+#include <src/keychain/tag_index.h>
+
+#include <leveldb/db.h>
+
+#include <external/catch2/catch.hpp>
+
+#include <cstdio>
+#include <filesystem>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using keychain::TagIndex;
+
+namespace {
+
+keychain::Entry::ptr add_tagged(keychain::Directory::ptr root, const std::string &path, int seed,
+    const std::string &tags) {
+	auto entry = keychain::add_entry(root, path, "", {seed});
+	entry->meta.tags = keychain::parse_tags(tags);
+	return entry;
+}
+
+/* ids in ascending order */
+std::vector<uint32_t> ids(const TagIndex &index, const std::string &expression) {
+	return index.query(expression).to_vector();
+}
+
+keychain::Directory::ptr example_tree() {
+	auto root = std::make_shared<keychain::Directory>(keychain::DirectoryMeta{"root", ""}, nullptr);
+	keychain::add_directory(root, "web", "");
+	keychain::add_directory(root, "servers", "");
+	add_tagged(root, "web/github", 1, "personal, dev");
+	add_tagged(root, "web/bank", 2, "personal finance");
+	add_tagged(root, "servers/db", 3, "prod dev");
+	add_tagged(root, "servers/legacy-db", 4, "prod legacy");
+	add_tagged(root, "wifi", 5, "");
+	return root;
+}
+
+} // namespace
+
+TEST_CASE( "tags are parsed, sorted and checked", "[tag_index]" ) {
+	REQUIRE( keychain::parse_tags(" prod,dev  prod,, owner:ops ") ==
+	         std::vector<std::string>{"dev", "owner:ops", "prod"} );
+	REQUIRE( keychain::parse_tags("").empty() );
+	REQUIRE( keychain::join_tags({"dev", "prod"}) == "dev prod" );
+
+	REQUIRE( keychain::is_valid_tag("rotation=90d") );
+	REQUIRE( keychain::is_valid_tag("zespół") );
+	REQUIRE_FALSE( keychain::is_valid_tag("") );
+	for (const char *tag : {"a&b", "a|b", "!a", "(a)"}) {
+		REQUIRE_THROWS_AS( keychain::parse_tags(tag), std::runtime_error );
+	}
+}
+
+TEST_CASE( "tag queries combine bitmaps", "[tag_index]" ) {
+	const auto index = TagIndex::build(example_tree());
+
+	REQUIRE( index.tags() == std::vector<std::string>{"dev", "finance", "legacy", "personal", "prod"} );
+	REQUIRE( index.entries().cardinality() == 5 );
+
+	REQUIRE( ids(index, "prod") == std::vector<uint32_t>{3, 4} );
+	REQUIRE( ids(index, "prod & dev") == std::vector<uint32_t>{3} );
+	REQUIRE( ids(index, "prod dev") == std::vector<uint32_t>{3} );
+	REQUIRE( ids(index, "prod | personal") == std::vector<uint32_t>{1, 2, 3, 4} );
+	REQUIRE( ids(index, "!prod") == std::vector<uint32_t>{1, 2, 5} );
+	REQUIRE( ids(index, "prod & !legacy") == std::vector<uint32_t>{3} );
+
+	/* ! binds tighter than &, which binds tighter than | */
+	REQUIRE( ids(index, "finance | prod & dev") == std::vector<uint32_t>{2, 3} );
+	REQUIRE( ids(index, "(finance | prod) & dev") == std::vector<uint32_t>{3} );
+	REQUIRE( ids(index, "!!legacy") == std::vector<uint32_t>{4} );
+	REQUIRE( ids(index, "!(dev | personal)") == std::vector<uint32_t>{4, 5} );
+
+	REQUIRE( ids(index, "nosuchtag").empty() );
+	REQUIRE( ids(index, "  ").size() == 5 );
+
+	for (const char *bad : {"prod &", "(prod", "prod)", "| dev", "prod && dev", "a,b"}) {
+		REQUIRE_THROWS_AS( index.query(bad), std::runtime_error );
+	}
+}
+
+TEST_CASE( "tag indexes follow edits of the tree", "[tag_index]" ) {
+	auto root = example_tree();
+	auto index = TagIndex::build(root);
+	const auto published = index;
+
+	auto entry_at = [&root](const std::string &path) {
+		return std::get<keychain::Entry::ptr>(*keychain::find_by_path(root, path));
+	};
+
+	/* retagged, added and removed entries */
+	keychain::EntryChanges changes;
+	entry_at("wifi")->meta.tags = {"home"};
+	changes.changed(*entry_at("wifi"));
+	entry_at("web/github")->meta.tags = {};
+	changes.changed(*entry_at("web/github"));
+	changes.changed(*add_tagged(root, "servers/cache", 6, "prod"));
+	changes.removed(*std::get<keychain::Entry::ptr>(
+	    keychain::remove_by_path(root, "servers/legacy-db", false)));
+	index.apply(changes);
+
+	REQUIRE( index == TagIndex::build(root) );
+	REQUIRE( ids(index, "prod") == std::vector<uint32_t>{3, 6} );
+	REQUIRE( ids(index, "home") == std::vector<uint32_t>{5} );
+	REQUIRE( ids(index, "dev") == std::vector<uint32_t>{3} );
+	REQUIRE( index.find("legacy") == nullptr );
+	REQUIRE( ids(index, "!prod") == std::vector<uint32_t>{1, 2, 5} );
+
+	/* the bitmaps of the copy it was taken from are left alone */
+	REQUIRE( published == TagIndex::build(example_tree()) );
+
+	/* a pasted copy shares the secret, but not the id or the tags */
+	auto meta = entry_at("web/bank")->meta;
+	meta.name = "bank-copy";
+	meta.tags = {"shared"};
+	meta.id = keychain::new_entry_id(*root);
+	root->entries.push_back(std::make_shared<keychain::Entry>(meta, root));
+	keychain::EntryChanges pasted;
+	pasted.changed(*root->entries.back());
+	index.apply(pasted);
+	REQUIRE( ids(index, "shared") == std::vector<uint32_t>{7} );
+	REQUIRE( ids(index, "shared & finance").empty() );
+	REQUIRE( ids(index, "finance") == std::vector<uint32_t>{2} );
+
+	/* later changes win when merged */
+	keychain::EntryChanges retagged, removed;
+	entry_at("bank-copy")->meta.tags = {"dev"};
+	retagged.changed(*entry_at("bank-copy"));
+	removed.removed(*std::get<keychain::Directory::ptr>(keychain::remove_by_path(root, "servers", true)));
+	removed.removed(*std::get<keychain::Entry::ptr>(keychain::remove_by_path(root, "bank-copy", false)));
+	retagged.merge(std::move(removed));
+	index.apply(retagged);
+	REQUIRE( index == TagIndex::build(root) );
+	REQUIRE( ids(index, "prod").empty() );
+	REQUIRE( ids(index, "dev").empty() );
+
+	REQUIRE_THROWS_AS( index.apply(keychain::EntryChanges::unknown()), std::runtime_error );
+}
+
+TEST_CASE( "entries get ids of their own", "[tag_index]" ) {
+	auto root = example_tree();
+	REQUIRE( root->next_entry_id == 6 );
+
+	/* as in trees saved before there were ids, or with a copy pasted in */
+	for (const auto &entry : root->entries) entry->meta.id = 0;
+	root->dirs[0]->entries[1]->meta.id = root->dirs[0]->entries[0]->meta.id;
+	REQUIRE( keychain::assign_entry_ids(root) );
+	REQUIRE( TagIndex::build(root).entries().cardinality() == 5 );
+	REQUIRE( root->entries[0]->meta.id == 6 );
+	REQUIRE( root->dirs[0]->entries[1]->meta.id == 7 );
+	REQUIRE_FALSE( keychain::assign_entry_ids(root) );
+
+	/* kept through copies, so moved entries keep them as well */
+	const auto copy = keychain::deep_copy_directory(root, nullptr);
+	REQUIRE( copy->next_entry_id == 8 );
+	REQUIRE( TagIndex::build(copy) == TagIndex::build(root) );
+	keychain::renumber_entries(copy->dirs[1], *copy);
+	REQUIRE( copy->dirs[1]->entries[0]->meta.id == 8 );
+}
+
+TEST_CASE( "tag indexes survive serialization", "[tag_index]" ) {
+	const auto index = TagIndex::build(example_tree());
+	const auto restored = TagIndex::deserialize(index.serialize());
+	REQUIRE( restored == index );
+	REQUIRE( ids(restored, "personal & !finance") == std::vector<uint32_t>{1} );
+
+	std::string truncated = index.serialize();
+	truncated.pop_back();
+	REQUIRE_THROWS_AS( TagIndex::deserialize(truncated), std::runtime_error );
+	REQUIRE_THROWS_AS( TagIndex::deserialize(index.serialize() + "x"), std::runtime_error );
+}
+
+TEST_CASE( "filtered listings keep the directories leading to matches", "[tag_index]" ) {
+	auto root = example_tree();
+	const auto index = TagIndex::build(root);
+
+	auto names = [&root](const utils::RoaringBitmap &ids) {
+		std::vector<std::string> rv;
+		for (const auto &node : keychain::flatten_filtered(root, ids)) {
+			std::visit([&rv](const auto &ptr) { rv.push_back(ptr->meta.name); }, node);
+		}
+		return rv;
+	};
+
+	REQUIRE( names(index.query("dev")) == std::vector<std::string>{"root", "web", "github", "servers", "db"} );
+	REQUIRE( names(index.query("finance")) == std::vector<std::string>{"root", "web", "bank"} );
+	REQUIRE( names(index.query("nosuchtag")) == std::vector<std::string>{"root"} );
+}
+
+TEST_CASE( "keychains keep their tag index across reopening", "[tag_index]" ) {
+	const std::filesystem::path dir = std::tmpnam(nullptr);
+	std::filesystem::create_directory(dir);
+
+	{
+		crypto::Seed seed;
+		for (size_t i = 0; i < seed.size(); ++i) seed[i] = i;
+		auto kc = keychain::Keychain::initialize_with_seed(dir / "kc", seed, crypto::hash_password("pw"));
+		REQUIRE( kc->snapshot()->tags->entries().empty() );
+
+		kc->update([](keychain::Directory::ptr root) {
+			add_tagged(root, "github", 1, "dev personal");
+			add_tagged(root, "db", 2, "dev prod");
+		});
+		REQUIRE( kc->snapshot()->tags->query("dev & !prod").to_vector() == std::vector<uint32_t>{1} );
+
+		kc->update([](keychain::Directory::ptr root) {
+			std::get<keychain::Entry::ptr>(*keychain::find_by_path(root, "github"))->meta.tags = {};
+		});
+		REQUIRE( kc->snapshot()->tags->query("dev").to_vector() == std::vector<uint32_t>{2} );
+	}
+
+	{
+		auto kc = keychain::Keychain::open(dir / "kc", crypto::hash_password("pw"));
+		const auto snapshot = kc->snapshot();
+		REQUIRE( *snapshot->tags == TagIndex::build(snapshot->root) );
+		REQUIRE( snapshot->tags->query("dev").to_vector() == std::vector<uint32_t>{2} );
+	}
+
+	std::filesystem::remove_all(dir);
+}
+
+TEST_CASE( "keychains saved before entries had ids get them on opening", "[tag_index]" ) {
+	const std::filesystem::path dir = std::tmpnam(nullptr);
+	std::filesystem::create_directory(dir);
+
+	{
+		crypto::Seed seed;
+		for (size_t i = 0; i < seed.size(); ++i) seed[i] = i;
+		keychain::Keychain::initialize_with_seed(dir / "kc", seed, crypto::hash_password("pw"));
+	}
+
+	/* a pasted copy, sharing the derivation path of the entry it was copied from */
+	{
+		leveldb::DB *raw;
+		REQUIRE( leveldb::DB::Open(leveldb::Options(), (dir / "kc" / "db").string(), &raw).ok() );
+		std::unique_ptr<leveldb::DB> db(raw);
+		const std::string entries = R"({"name": "", "details": "", "dirs": [], "entries": [)"
+		    R"({"name": "bank", "details": "", "derivation_path": 2, "tags": ["finance"]},)"
+		    R"({"name": "bank-copy", "details": "", "derivation_path": 2, "tags": ["shared"]}]})";
+		REQUIRE( db->Put(leveldb::WriteOptions(), "entries", entries).ok() );
+	}
+
+	{
+		auto kc = keychain::Keychain::open(dir / "kc", crypto::hash_password("pw"));
+		const auto snapshot = kc->snapshot();
+		REQUIRE( snapshot->tags->entries().cardinality() == 2 );
+		REQUIRE( snapshot->tags->query("finance & shared").empty() );
+
+		kc->update([](keychain::Directory::ptr root, keychain::EntryChanges &changes) {
+			changes.changed(*add_tagged(root, "wifi", 3, "home"));
+		});
+	}
+
+	{
+		auto kc = keychain::Keychain::open(dir / "kc", crypto::hash_password("pw"));
+		const auto snapshot = kc->snapshot();
+		REQUIRE( *snapshot->tags == TagIndex::build(snapshot->root) );
+		REQUIRE( snapshot->tags->query("finance | shared | home").cardinality() == 3 );
+	}
+
+	std::filesystem::remove_all(dir);
+}
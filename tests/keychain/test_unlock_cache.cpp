@@ -0,0 +1,146 @@
+/*
+
+Copyright (C) 2019 Mateusz Morusiewicz
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#include <src/keychain/unlock_cache.h>
+#include <src/utils/metrics.h>
+
+#include <leveldb/db.h>
+
+#include <external/catch2/catch.hpp>
+
+#include <cstdio>
+#include <filesystem>
+#include <memory>
+#include <optional>
+
+TEST_CASE( "unlocked keychains are reopened from the cache", "[unlock_cache]" ) {
+	using namespace std::chrono_literals;
+
+	const std::filesystem::path dir = std::tmpnam(nullptr);
+	std::filesystem::create_directory(dir);
+	const auto kc_path = dir / "kc";
+
+	crypto::Seed seed;
+	for (size_t i = 0; i < seed.size(); ++i) seed[i] = i;
+	std::string secret;
+	{
+		auto kc = keychain::Keychain::initialize_with_seed(kc_path, seed, crypto::hash_password("pw"));
+		REQUIRE( kc->check_password() == true );
+		secret = static_cast<std::string>(kc->derive_secret({ 1 }));
+	}
+
+	keychain::UnlockCache cache(60s, crypto::make_runtime_dir_cache(dir / "cache"));
+	REQUIRE( cache.backend() == std::string("runtime directory") );
+	REQUIRE( !cache.open(kc_path) );
+
+	/* a wrong phrase is refused instead of being remembered */
+	REQUIRE_THROWS_WITH( cache.open(kc_path, crypto::hash_password("typo")), "wrong encryption phrase" );
+	REQUIRE( !cache.open(kc_path) );
+
+	REQUIRE( cache.open(kc_path, crypto::hash_password("pw")) );
+	{
+		/* the same keychain through another path, without verifying the phrase again */
+		auto &verifications = utils::metrics::latency("crypto::verify_password_check");
+		const uint64_t before = verifications.snapshot().count;
+		auto kc = cache.open(dir / "." / "kc");
+		REQUIRE( kc );
+		REQUIRE( verifications.snapshot().count == before );
+		REQUIRE( static_cast<std::string>(kc->derive_secret({ 1 })) == secret );
+	}
+
+	cache.forget(kc_path);
+	REQUIRE( !cache.open(kc_path) );
+
+	keychain::UnlockCache disabled(0s, crypto::make_runtime_dir_cache(dir / "cache"));
+	REQUIRE( disabled.backend() == nullptr );
+	REQUIRE( disabled.open(kc_path, crypto::hash_password("pw")) );
+	REQUIRE( !disabled.open(kc_path) );
+	REQUIRE( !cache.open(kc_path) );
+
+	std::filesystem::remove_all(dir);
+}
+
+namespace {
+
+/* what keychains created before password checks, or with bare seed fingerprints, look like */
+void set_seed_check(const std::filesystem::path &kc_path, const std::optional<std::string> &value) {
+	leveldb::DB *raw;
+	leveldb::Options options;
+	REQUIRE( leveldb::DB::Open(options, (kc_path / "db").string(), &raw).ok() );
+	std::unique_ptr<leveldb::DB> db(raw);
+	if (value) {
+		REQUIRE( db->Put(leveldb::WriteOptions(), "seed_check", *value).ok() );
+	} else {
+		REQUIRE( db->Delete(leveldb::WriteOptions(), "seed_check").ok() );
+	}
+}
+
+std::string get_seed_check(const std::filesystem::path &kc_path) {
+	leveldb::DB *raw;
+	leveldb::Options options;
+	REQUIRE( leveldb::DB::Open(options, (kc_path / "db").string(), &raw).ok() );
+	std::unique_ptr<leveldb::DB> db(raw);
+	std::string value;
+	REQUIRE( db->Get(leveldb::ReadOptions(), "seed_check", &value).ok() );
+	return value;
+}
+
+} // namespace
+
+TEST_CASE( "phrases that can't be verified are not cached", "[unlock_cache]" ) {
+	using namespace std::chrono_literals;
+
+	const std::filesystem::path dir = std::tmpnam(nullptr);
+	std::filesystem::create_directory(dir);
+	const auto kc_path = dir / "kc";
+
+	crypto::Seed seed;
+	for (size_t i = 0; i < seed.size(); ++i) seed[i] = i;
+	keychain::Keychain::initialize_with_seed(kc_path, seed, crypto::hash_password("pw"));
+	REQUIRE( get_seed_check(kc_path).rfind("pbkdf2-sha256:", 0) == 0 );
+
+	keychain::UnlockCache cache(60s, crypto::make_runtime_dir_cache(dir / "cache"));
+
+	set_seed_check(kc_path, std::nullopt);
+	REQUIRE( cache.open(kc_path, crypto::hash_password("typo")) );
+	REQUIRE( !cache.open(kc_path) );
+	REQUIRE( cache.open(kc_path, crypto::hash_password("pw")) );
+	REQUIRE( !cache.open(kc_path) );
+
+	/* a bare fingerprint still refuses a typo, and is swapped for a salted check once it matches */
+	set_seed_check(kc_path, crypto::fingerprint_seed(seed));
+	REQUIRE_THROWS_WITH( cache.open(kc_path, crypto::hash_password("typo")), "wrong encryption phrase" );
+	REQUIRE( get_seed_check(kc_path) == crypto::fingerprint_seed(seed) );
+	REQUIRE( cache.open(kc_path, crypto::hash_password("pw")) );
+	REQUIRE( get_seed_check(kc_path).rfind("pbkdf2-sha256:", 0) == 0 );
+	REQUIRE( cache.open(kc_path) );
+
+	/* a cached phrase that no longer verifies is dropped instead of used */
+	set_seed_check(kc_path, std::nullopt);
+	REQUIRE( !cache.open(kc_path) );
+	set_seed_check(kc_path, crypto::make_password_check(crypto::hash_password("pw")));
+	REQUIRE( !cache.open(kc_path) );
+
+	/* disabling the cache doesn't stop forget from clearing what is left over */
+	REQUIRE( cache.open(kc_path, crypto::hash_password("pw")) );
+	keychain::UnlockCache(0s, crypto::make_runtime_dir_cache(dir / "cache")).forget(kc_path);
+	REQUIRE( !cache.open(kc_path) );
+
+	std::filesystem::remove_all(dir);
+}
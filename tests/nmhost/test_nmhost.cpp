@@ -0,0 +1,140 @@
+/*
+
+Copyright (C) 2019 Mateusz Morusiewicz
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#include <src/nmhost/host.h>
+#include <src/nmhost/origin_index.h>
+
+#include <src/agent/server.h>
+#include <src/keychain/keychain.h>
+
+#include <external/catch2/catch.hpp>
+#include <external/nlohmann/json_single_include.h>
+
+#include <cstdio>
+#include <filesystem>
+#include <thread>
+
+namespace {
+
+nlohmann::json ask(nmhost::Host &host, const nlohmann::json &request) {
+	auto response = host.handle(request.dump());
+	return nlohmann::json::parse(std::string(response.c_str(), response.size()));
+}
+
+} // namespace
+
+TEST_CASE( "origins are normalized to host names", "[nmhost]" ) {
+	REQUIRE( nmhost::normalize_host("https://www.GitHub.com/login?x=1") == "github.com" );
+	REQUIRE( nmhost::normalize_host("http://user:pw@mail.example.org:8080/") == "mail.example.org" );
+	REQUIRE( nmhost::normalize_host("example.com.") == "example.com" );
+	REQUIRE( nmhost::normalize_host("accounts.google.com") == "accounts.google.com" );
+
+	REQUIRE_FALSE( nmhost::normalize_host("localhost") );
+	REQUIRE_FALSE( nmhost::normalize_host("my password") );
+	REQUIRE_FALSE( nmhost::normalize_host("a..b") );
+	REQUIRE_FALSE( nmhost::normalize_host("") );
+}
+
+TEST_CASE( "origin index matches hosts and their parent domains", "[nmhost]" ) {
+	nmhost::OriginIndex index({
+	    {"web/github.com", "", 1},
+	    {"web/work mail", "login at https://mail.example.com/owa, see also (wiki.example.com)", 2},
+	    {"web/example", "example.com", 3},
+	    {"bank pin", "no url here", 4},
+	});
+
+	REQUIRE( index.size() == 4 );
+	REQUIRE( index.hosts() == 4 );
+
+	auto github = index.lookup("https://github.com/login");
+	REQUIRE( github.size() == 1 );
+	REQUIRE( github[0]->path == "web/github.com" );
+	REQUIRE( github[0]->dpath == 1 );
+
+	REQUIRE( index.lookup("https://mail.example.com")[0]->dpath == 2 );
+	REQUIRE( index.lookup("https://wiki.example.com")[0]->dpath == 2 );
+	REQUIRE( index.lookup("https://shop.example.com")[0]->dpath == 3 );
+	REQUIRE( index.lookup("https://a.b.example.com")[0]->dpath == 3 );
+	REQUIRE( index.lookup("https://gitlab.com").empty() );
+	REQUIRE( index.lookup("https://com").empty() );
+}
+
+TEST_CASE( "native messaging host fills secrets through the agent", "[nmhost]" ) {
+	const std::filesystem::path dir = std::tmpnam(nullptr);
+	std::filesystem::create_directory(dir);
+
+	{
+		nmhost::Host host(dir / "agent.sock");
+
+		/* no agent yet, the host has to survive that */
+		auto unavailable = ask(host, {{"type", "ping"}, {"id", 1}});
+		REQUIRE( unavailable["type"] == "error" );
+		REQUIRE( unavailable["id"] == 1 );
+
+		crypto::Seed seed;
+		for (size_t i = 0; i < seed.size(); ++i) seed[i] = i * 7;
+		auto kc = keychain::Keychain::initialize_with_seed(dir / "kc", seed, crypto::hash_password("pw"));
+		auto root = kc->get_root_dir();
+		auto web = std::make_shared<keychain::Directory>(keychain::DirectoryMeta{"web", ""}, root);
+		web->entries.push_back(std::make_shared<keychain::Entry>(keychain::EntryMeta{"github.com", "", {6}}, web));
+		web->entries.push_back(std::make_shared<keychain::Entry>(keychain::EntryMeta{"personal", "https://example.com", {7}}, web));
+		web->entries.push_back(std::make_shared<keychain::Entry>(keychain::EntryMeta{"work", "example.com", {8}}, web));
+		root->dirs.push_back(web);
+		kc->save_entries(root);
+		const auto github_secret = kc->derive_secret({6});
+		const auto work_secret = kc->derive_secret({8});
+
+		agent::ServerOptions options;
+		options.socket_path = dir / "agent.sock";
+		options.n_workers = 1;
+		agent::Server server(std::move(kc), options);
+		std::thread reactor([&server]() { server.run(); });
+
+		auto pong = ask(host, {{"type", "ping"}, {"id", 2}});
+		REQUIRE( pong["type"] == "pong" );
+		REQUIRE( pong["id"] == 2 );
+		REQUIRE( pong["entries"] == 3 );
+		REQUIRE( host.origin_index().size() == 3 );
+
+		auto lookup = ask(host, {{"type", "lookup"}, {"origin", "https://example.com"}, {"id", "x"}});
+		REQUIRE( lookup["id"] == "x" );
+		REQUIRE( lookup["matches"].size() == 2 );
+
+		auto github = ask(host, {{"type", "fill"}, {"origin", "https://www.github.com"}});
+		REQUIRE( github["path"] == "web/github.com" );
+		REQUIRE( github["secret"] == std::string(github_secret.c_str(), github_secret.size()) );
+
+		REQUIRE( ask(host, {{"type", "fill"}, {"origin", "https://example.com"}})["type"] == "error" );
+		auto work = ask(host, {{"type", "fill"}, {"origin", "https://example.com"}, {"path", "web/work"}});
+		REQUIRE( work["secret"] == std::string(work_secret.c_str(), work_secret.size()) );
+
+		/* an entry of another origin is never handed out */
+		auto stolen = ask(host, {{"type", "fill"}, {"origin", "https://evil.com"}, {"path", "web/github.com"}});
+		REQUIRE( stolen["type"] == "error" );
+
+		REQUIRE( ask(host, {{"type", "nope"}})["type"] == "error" );
+		auto malformed = host.handle("{not json");
+		REQUIRE( nlohmann::json::parse(std::string(malformed.c_str(), malformed.size()))["type"] == "error" );
+
+		server.stop();
+		reactor.join();
+	}
+
+	std::filesystem::remove_all(dir);
+}
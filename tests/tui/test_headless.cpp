@@ -0,0 +1,200 @@
+/*
+
+Copyright (C) 2019 Mateusz Morusiewicz
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+
+#include <src/tui/form_controller.h>
+#include <src/tui/headless.h>
+#include <src/tui/key_trace.h>
+#include <src/tui/keychain_main_screen.h>
+#include <src/tui/recover_mnemonic_screen.h>
+#include <src/tui/utils.h>
+
+#include <src/keychain/keychain.h>
+#include <src/keychain/synthetic.h>
+
+#include <external/catch2/catch.hpp>
+
+#include <curses.h>
+
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+class KeyLog : public WindowObserver {
+  public:
+	std::vector<int> keys;
+	int frames = 0;
+
+	void on_key(int key, const ScreenController &) override { keys.push_back(key); }
+	void on_frame() override { ++frames; }
+};
+
+class SecretScreen : public ScreenController {
+	void m_draw() override {}
+	void m_on_key(int) override {}
+	bool m_takes_secrets() const override { return true; }
+
+  public:
+	using ScreenController::ScreenController;
+};
+
+struct TemporaryKeychain {
+	const std::filesystem::path dir = std::tmpnam(nullptr);
+	std::shared_ptr<keychain::Keychain> kc;
+
+	explicit TemporaryKeychain(const keychain::KeychainShape &shape) {
+		std::filesystem::create_directories(dir);
+		kc = keychain::Keychain::initialize_with_seed(
+		    dir / "kc", crypto::Seed{}, crypto::hash_password(""));
+		kc->save_entries(keychain::generate_tree(shape));
+	}
+	~TemporaryKeychain() {
+		kc.reset();
+		std::filesystem::remove_all(dir);
+	}
+};
+
+keychain::KeychainShape small_shape() {
+	keychain::KeychainShape shape;
+	shape.n_entries = 20;
+	shape.depth = 1;
+	shape.fan_out = 2;
+	return shape;
+}
+
+} // namespace
+
+TEST_CASE( "redraw handles outlive their manager", "[headless]" ) {
+	std::shared_ptr<RedrawHandle> redraw;
+	{
+		HeadlessTerminal terminal;
+		redraw = terminal.manager().redraw_handle();
+		REQUIRE( !terminal.manager().busy() );
+		redraw->request();
+		REQUIRE( terminal.manager().busy() );
+	}
+	redraw->request();
+}
+
+TEST_CASE( "key names go both ways", "[headless]" ) {
+	HeadlessTerminal terminal;
+
+	for (int key : {int{'a'}, int{' '}, KEY_RETURN, KEY_ESC, KEY_DOWN, KEY_F(12), KEY_BACKSPACE}) {
+		REQUIRE( key_code(key_name(key)) == key );
+	}
+	REQUIRE( key_name(KEY_DOWN) == "KEY_DOWN" );
+	REQUIRE( !key_code("no such key") );
+}
+
+TEST_CASE( "the main screen runs on a headless terminal", "[headless]" ) {
+	TemporaryKeychain tmp(small_shape());
+	const auto root = tmp.kc->get_root_dir();
+	const std::string first_dir = root->dirs.at(0)->meta.name;
+	const std::string first_entry = root->dirs.at(0)->entries.at(0)->meta.name;
+
+	HeadlessTerminal terminal(30, 100);
+	KeyLog log;
+	terminal.manager().set_observer(&log);
+
+	terminal.start(std::make_shared<KeychainMainScreen>(&terminal.manager(), tmp.kc));
+	REQUIRE( terminal.settle() );
+	REQUIRE( terminal.screen().size() == 30 );
+	REQUIRE( terminal.screen()[0].size() == 100 );
+	const uint64_t first_screen_bytes = terminal.bytes_written();
+	REQUIRE( first_screen_bytes > 0 );
+	/* the resize to 30x100 came in as a key */
+	REQUIRE( log.keys == std::vector<int>{KEY_RESIZE} );
+	log.keys.clear();
+
+	/* the root is open and selected, its first directory comes right after it */
+	REQUIRE( terminal.shows(first_dir) );
+	REQUIRE( !terminal.shows(first_entry) );
+
+	terminal.press(KEY_DOWN);
+	terminal.press(KEY_RETURN);
+	REQUIRE( terminal.settle() );
+	REQUIRE( terminal.shows(first_entry) );
+	REQUIRE( terminal.bytes_written() > first_screen_bytes );
+
+	terminal.press(KEY_RETURN);
+	REQUIRE( terminal.settle() );
+	REQUIRE( !terminal.shows(first_entry) );
+
+	REQUIRE( log.keys == std::vector<int>{KEY_DOWN, KEY_RETURN, KEY_RETURN} );
+	REQUIRE( log.frames >= 3 );
+
+	terminal.press('q');
+	REQUIRE( !terminal.settle() );
+	REQUIRE( !terminal.is_running() );
+}
+
+TEST_CASE( "key traces start on the main screen and mask secrets", "[headless]" ) {
+	TemporaryKeychain tmp(small_shape());
+	const std::filesystem::path trace_path = std::tmpnam(nullptr);
+
+	{
+		HeadlessTerminal terminal;
+		SecretScreen secret(&terminal.manager());
+		KeychainMainScreen main(&terminal.manager(), tmp.kc);
+
+		WINDOW *window = stdscr;
+		FormController form(&terminal.manager(), &main, window, []() {}, []() {});
+		form.add_field<StringInputHandler>(
+		    [](const std::string &) { return true; }, Point{2, 2}, "Details: ");
+
+		KeyRecorder recorder(trace_path);
+		recorder.on_key('a', secret);
+		recorder.on_key('b', main);
+		recorder.on_key('c', secret);
+		recorder.on_key(KEY_DOWN, main);
+		recorder.on_key(KEY_RESIZE, main);
+		recorder.on_key('d', form);
+		recorder.on_key(0xc5, form); // U+017C in UTF-8
+		recorder.on_key(0xbc, form);
+		recorder.on_key(KEY_BACKSPACE, form);
+		recorder.on_key(KEY_LEFT, form);
+		recorder.on_key(KEY_RETURN, form);
+		recorder.on_key(' ', main);
+	}
+
+	const auto perms = std::filesystem::status(trace_path).permissions();
+	REQUIRE( (perms & (std::filesystem::perms::group_all | std::filesystem::perms::others_all)) ==
+	         std::filesystem::perms::none );
+
+	HeadlessTerminal terminal;
+	const int x = KeyRecorder::SECRET_PLACEHOLDER;
+	REQUIRE( read_key_trace(trace_path) == std::vector<int>{'b', x, KEY_DOWN, x, x, KEY_BACKSPACE,
+	                                                        KEY_LEFT, KEY_RETURN, ' '} );
+	std::filesystem::remove(trace_path);
+}
+
+TEST_CASE( "accepted mnemonic words are masked", "[headless]" ) {
+	HeadlessTerminal terminal;
+	auto never = [](const crypto::Seed &) { return false; };
+	terminal.start(std::make_shared<RecoverMnemonicScreen>(&terminal.manager(), never, nullptr));
+	REQUIRE( terminal.settle() );
+
+	terminal.type("abandon zoo aban");
+	REQUIRE( terminal.settle() );
+	REQUIRE( terminal.shows("Mnemonic: ******* *** abandon") );
+	REQUIRE( !terminal.shows("zoo") );
+}
@@ -0,0 +1,160 @@
+/*
+
+Copyright (C) 2019 Mateusz Morusiewicz
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+
+#include <src/tui/idle_scheduler.h>
+
+#include <external/catch2/catch.hpp>
+
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+namespace {
+
+/* a task that takes n_steps slices, recording each one in log */
+IdleScheduler::Task counting_task(std::string name, int priority, int n_steps, std::string &log) {
+	auto left = std::make_shared<int>(n_steps);
+
+	IdleScheduler::Task task;
+	task.name = name;
+	task.priority = priority;
+	task.step = [name, left, &log](IdleContext &) {
+		log += name;
+		return --*left > 0;
+	};
+	return task;
+}
+
+} // namespace
+
+TEST_CASE( "idle tasks run by priority, round-robin within one", "[idle_scheduler]" ) {
+	std::vector<std::function<void()>> posted;
+	IdleScheduler scheduler(nullptr, [&posted](std::function<void()> fn) { posted.push_back(fn); });
+
+	std::string log;
+	scheduler.submit(counting_task("a", 1, 2, log));
+	scheduler.submit(counting_task("b", 1, 2, log));
+	scheduler.submit(counting_task("c", 0, 2, log));
+
+	auto done = counting_task("d", 2, 1, log);
+	bool d_done = false;
+	done.on_done = [&d_done]() { d_done = true; };
+	scheduler.submit(std::move(done));
+
+	while (scheduler.run_once()) {
+	}
+	REQUIRE( log == "ccababd" );
+	REQUIRE( !scheduler.has_work() );
+
+	/* completion is reported through the loop, not from inside the scheduler */
+	REQUIRE( !d_done );
+	REQUIRE( posted.size() == 1 );
+	posted[0]();
+	REQUIRE( d_done );
+
+	const auto stats = scheduler.stats();
+	REQUIRE( stats.size() == 4 );
+	REQUIRE( stats[0].name == "d" );
+	REQUIRE( stats[0].state == IdleTaskState::Done );
+	REQUIRE( stats[3].name == "c" );
+	REQUIRE( stats[3].steps == 2 );
+}
+
+TEST_CASE( "idle tasks yield to input", "[idle_scheduler]" ) {
+	bool input = false;
+	int polls = 0;
+	IdleScheduler scheduler([&]() { ++polls; return input; }, nullptr);
+
+	int iterations = 0;
+	IdleScheduler::Task task;
+	task.name = "spin";
+	task.slice = std::chrono::seconds(10);
+	task.step = [&](IdleContext &context) {
+		while (!context.should_yield()) {
+			if (++iterations == 100) input = true;
+		}
+		return true;
+	};
+	scheduler.submit(std::move(task));
+
+	const auto start = std::chrono::steady_clock::now();
+	REQUIRE( scheduler.run_once() );
+	REQUIRE( std::chrono::steady_clock::now() - start < std::chrono::milliseconds(100) );
+	REQUIRE( iterations >= 100 );
+	/* not once per should_yield */
+	REQUIRE( polls < iterations / 10 );
+	REQUIRE( scheduler.stats()[0].preempted == 1 );
+	REQUIRE( scheduler.stats()[0].state == IdleTaskState::Waiting );
+}
+
+TEST_CASE( "idle tasks are stopped", "[idle_scheduler]" ) {
+	IdleScheduler scheduler(nullptr, nullptr);
+
+	SECTION( "over budget" ) {
+		IdleScheduler::Task task;
+		task.name = "busy";
+		task.slice = std::chrono::milliseconds(1);
+		task.budget = std::chrono::milliseconds(5);
+		task.step = [](IdleContext &context) {
+			while (!context.should_yield()) {
+			}
+			return true;
+		};
+		scheduler.submit(std::move(task));
+
+		int slices = 0;
+		while (scheduler.run_once()) ++slices;
+		REQUIRE( slices >= 5 );
+		REQUIRE( scheduler.stats()[0].state == IdleTaskState::OverBudget );
+		REQUIRE( scheduler.stats()[0].cpu_time >= std::chrono::milliseconds(5) );
+	}
+
+	SECTION( "on failure" ) {
+		IdleScheduler::Task task;
+		task.name = "broken";
+		task.step = [](IdleContext &) -> bool { throw std::runtime_error("broken index"); };
+		scheduler.submit(std::move(task));
+
+		REQUIRE( scheduler.run_once() );
+		REQUIRE( !scheduler.has_work() );
+		REQUIRE( scheduler.stats()[0].state == IdleTaskState::Failed );
+		REQUIRE( scheduler.stats()[0].error == "broken index" );
+	}
+
+	SECTION( "when cancelled, also from their own step" ) {
+		std::string log;
+		auto first = scheduler.submit(counting_task("a", 0, 10, log));
+
+		IdleScheduler::TaskId self = 0;
+		IdleScheduler::Task task = counting_task("b", 1, 10, log);
+		task.step = [&](IdleContext &) {
+			scheduler.cancel(self);
+			return true;
+		};
+		self = scheduler.submit(std::move(task));
+
+		scheduler.cancel(first);
+		REQUIRE( scheduler.run_once() );
+		REQUIRE( !scheduler.run_once() );
+		REQUIRE( log.empty() );
+		REQUIRE( scheduler.stats()[0].state == IdleTaskState::Cancelled );
+		REQUIRE( scheduler.stats()[1].state == IdleTaskState::Cancelled );
+	}
+}
@@ -0,0 +1,119 @@
+/*
+
+Copyright (C) 2019 Mateusz Morusiewicz
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+
+#include <src/tui/row_renderer.h>
+
+#include <external/catch2/catch.hpp>
+
+#include <curses.h>
+
+#include <cstdio>
+
+namespace {
+
+/* curses writing to /dev/null, enough for windows to be drawn into */
+struct NullScreen {
+	FILE *out = std::fopen("/dev/null", "w");
+	FILE *in = std::fopen("/dev/null", "r");
+	SCREEN *screen = newterm("vt100", out, in);
+	WINDOW *window = newwin(10, 20, 0, 0);
+
+	~NullScreen() {
+		delwin(window);
+		endwin();
+		delscreen(screen);
+		std::fclose(in);
+		std::fclose(out);
+	}
+};
+
+void draw_list(RowRenderer &renderer, int n_rows, int selected) {
+	renderer.begin_frame(10);
+	for (int i = 0; i < n_rows; ++i) {
+		renderer.set_row(i + 1, {1, "entry" + std::to_string(i), i == selected});
+	}
+}
+
+} // namespace
+
+TEST_CASE( "row renderer redraws everything on the first frame", "[row_renderer]" ) {
+	NullScreen screen;
+	RowRenderer renderer;
+
+	draw_list(renderer, 5, 0);
+	REQUIRE( renderer.commit(screen.window) == 10 );
+
+	char line[8] = {};
+	mvwinnstr(screen.window, 1, 1, line, 6);
+	REQUIRE( std::string(line) == "entry0" );
+}
+
+TEST_CASE( "row renderer redraws only the changed rows", "[row_renderer]" ) {
+	NullScreen screen;
+	RowRenderer renderer;
+
+	draw_list(renderer, 5, 0);
+	renderer.commit(screen.window);
+
+	draw_list(renderer, 5, 0);
+	REQUIRE( renderer.damaged().empty() );
+	REQUIRE( renderer.commit(screen.window) == 0 );
+
+	/* moving the selection */
+	draw_list(renderer, 5, 1);
+	REQUIRE( renderer.damaged() == std::vector<size_t>{1, 2} );
+	REQUIRE( renderer.commit(screen.window) == 2 );
+
+	/* a removed row is cleared */
+	draw_list(renderer, 4, 1);
+	REQUIRE( renderer.damaged() == std::vector<size_t>{5} );
+	renderer.commit(screen.window);
+	REQUIRE( (mvwinch(screen.window, 5, 1) & A_CHARTEXT) == ' ' );
+
+	renderer.invalidate();
+	draw_list(renderer, 4, 1);
+	REQUIRE( renderer.commit(screen.window) == 10 );
+}
+
+TEST_CASE( "row renderer clips rows to the window", "[row_renderer]" ) {
+	NullScreen screen;
+	RowRenderer renderer;
+
+	renderer.begin_frame(10);
+	renderer.set_row(0, {15, "0123456789", false});
+	renderer.set_row(12, {0, "out of the frame", false});
+	renderer.commit(screen.window);
+
+	char line[32] = {};
+	mvwinnstr(screen.window, 0, 15, line, 5);
+	REQUIRE( std::string(line) == "01234" );
+	REQUIRE( (mvwinch(screen.window, 1, 0) & A_CHARTEXT) == ' ' );
+}
+
+TEST_CASE( "wrap_lines splits on newlines and width", "[row_renderer]" ) {
+	REQUIRE( wrap_lines("", 10) == std::vector<std::string>{""} );
+	REQUIRE( wrap_lines("abc\n\ndef", 10) == std::vector<std::string>{"abc", "", "def"} );
+	REQUIRE( wrap_lines("abcdefgh", 3) == std::vector<std::string>{"abc", "def", "gh"} );
+
+	/* "zażółć" is 10 bytes, the multibyte letters are never cut */
+	REQUIRE( wrap_lines("zażółć", 4) == std::vector<std::string>{"zaż", "ół", "ć"} );
+	REQUIRE( wrap_lines("zażółć", 3) == std::vector<std::string>{"za", "ż", "ó", "ł", "ć"} );
+	REQUIRE( wrap_lines("ż", 1) == std::vector<std::string>{"ż"} );
+}
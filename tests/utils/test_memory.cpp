@@ -0,0 +1,92 @@
+/*
+
+Copyright (C) 2019 Mateusz Morusiewicz
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+
+#include <src/utils/memory.h>
+
+#include <src/keychain/keychain_entry.h>
+
+#include <external/catch2/catch.hpp>
+
+#include <string>
+#include <utility>
+
+using utils::memory::Accounted;
+using utils::memory::Category;
+
+namespace {
+
+size_t current(Category category) { return utils::memory::usage(category).current; }
+
+} // namespace
+
+TEST_CASE( "accounted bytes follow copies and moves", "[memory]" ) {
+	const size_t before = current(Category::Caches);
+	{
+		Accounted a(Category::Caches, 100);
+		REQUIRE( current(Category::Caches) == before + 100 );
+		REQUIRE( utils::memory::usage(Category::Caches).peak >= before + 100 );
+
+		Accounted copy = a;
+		REQUIRE( current(Category::Caches) == before + 200 );
+
+		Accounted moved = std::move(copy);
+		REQUIRE( current(Category::Caches) == before + 200 );
+		REQUIRE( moved.get() == 100 );
+
+		moved.set(40);
+		REQUIRE( current(Category::Caches) == before + 140 );
+
+		Accounted other(Category::Serialization, 10);
+		other = a;
+		REQUIRE( current(Category::Caches) == before + 240 );
+	}
+	REQUIRE( current(Category::Caches) == before );
+}
+
+TEST_CASE( "the peak stays after the bytes are gone", "[memory]" ) {
+	const size_t before = utils::memory::usage(Category::Serialization).peak;
+	{ Accounted a(Category::Serialization, before + 1000); }
+	REQUIRE( utils::memory::usage(Category::Serialization).peak >= before + 1000 );
+}
+
+TEST_CASE( "short strings take no heap bytes", "[memory]" ) {
+	REQUIRE( utils::memory::heap_bytes(std::string{"abc"}) == 0 );
+
+	const std::string long_string(1000, 'x');
+	REQUIRE( utils::memory::heap_bytes(long_string) == long_string.capacity() + 1 );
+}
+
+TEST_CASE( "tree nodes are accounted while the tree lives", "[memory]" ) {
+	const size_t before = current(Category::TreeNodes);
+	{
+		auto root = std::make_shared<keychain::Directory>(keychain::DirectoryMeta{}, nullptr);
+		for (int i = 0; i < 100; ++i) {
+			root->entries.push_back(std::make_shared<keychain::Entry>(
+			    keychain::EntryMeta{std::string(100, 'n'), "", {}}, root));
+		}
+		REQUIRE( current(Category::TreeNodes) >=
+		         before + sizeof(keychain::Directory) + 100 * (sizeof(keychain::Entry) + 100) );
+
+		auto copy = keychain::deep_copy_directory(root, nullptr);
+		REQUIRE( current(Category::TreeNodes) >=
+		         before + 2 * (sizeof(keychain::Directory) + 100 * sizeof(keychain::Entry)) );
+	}
+	REQUIRE( current(Category::TreeNodes) == before );
+}
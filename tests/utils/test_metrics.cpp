@@ -0,0 +1,104 @@
+/*
+
+Copyright (C) 2019 Mateusz Morusiewicz
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+
+#include <src/utils/metrics.h>
+
+#include <external/catch2/catch.hpp>
+
+#include <sstream>
+#include <string>
+
+TEST_CASE( "histogram buckets bound their values within 12.5%", "[metrics]" ) {
+	using H = utils::metrics::Histogram;
+
+	for (uint64_t v : {0ull, 1ull, 7ull, 8ull, 9ull, 15ull, 16ull, 1000ull, 123456789ull,
+	         (1ull << 40) - 1}) {
+		const size_t bucket = H::bucket_of(v);
+		REQUIRE( bucket < H::BUCKETS );
+		REQUIRE( H::lower_bound(bucket) <= v );
+		if (bucket + 1 < H::BUCKETS) {
+			REQUIRE( v < H::lower_bound(bucket + 1) );
+			REQUIRE( H::lower_bound(bucket + 1) - H::lower_bound(bucket) <=
+			         std::max<uint64_t>(1, H::lower_bound(bucket) / 8) );
+		}
+	}
+
+	REQUIRE( H::bucket_of(1ull << 40) == H::BUCKETS - 1 );
+	REQUIRE( H::bucket_of(~0ull) == H::BUCKETS - 1 );
+
+	for (size_t bucket = 1; bucket < H::BUCKETS; ++bucket) {
+		REQUIRE( H::lower_bound(bucket - 1) < H::lower_bound(bucket) );
+		REQUIRE( H::bucket_of(H::lower_bound(bucket)) == bucket );
+	}
+}
+
+TEST_CASE( "histogram quantiles", "[metrics]" ) {
+	utils::metrics::Histogram histogram;
+	REQUIRE( histogram.snapshot().quantile(0.5) == 0 );
+
+	for (uint64_t i = 1; i <= 1000; ++i) histogram.record(i * 1000);
+
+	const auto snapshot = histogram.snapshot();
+	REQUIRE( snapshot.count == 1000 );
+	REQUIRE( snapshot.sum_ns == 500500000 );
+
+	for (double q : {0.5, 0.9, 0.99}) {
+		const double exact = q * 1000 * 1000;
+		REQUIRE( snapshot.quantile(q) >= exact );
+		REQUIRE( snapshot.quantile(q) <= exact * 1.125 + 1 );
+	}
+}
+
+TEST_CASE( "metrics are written in the prometheus text format", "[metrics]" ) {
+	auto &histogram = utils::metrics::latency("test_op");
+	auto &counter = utils::metrics::counter("test_things", "Things counted by the test");
+	REQUIRE( &histogram == &utils::metrics::latency("test_op") );
+
+	const uint64_t before = histogram.snapshot().count;
+	histogram.record(500);         // below the first exported bucket
+	histogram.record(3000000);     // 3ms
+	histogram.record(100000000000); // past the last one
+	counter.add(3);
+
+	std::stringstream ss;
+	utils::metrics::write_prometheus(ss);
+	const std::string text = ss.str();
+
+	REQUIRE( text.find("# TYPE hdpwm_test_things_total counter\n") != std::string::npos );
+	REQUIRE( text.find("hdpwm_test_things_total " + std::to_string(counter.get()) + "\n") !=
+	         std::string::npos );
+	REQUIRE( text.find("# TYPE hdpwm_operation_duration_seconds histogram\n") != std::string::npos );
+	REQUIRE( text.find("hdpwm_operation_duration_seconds_count{op=\"test_op\"} " +
+	                   std::to_string(before + 3) + "\n") != std::string::npos );
+
+	/* cumulative, and capped by the count */
+	std::istringstream lines(text);
+	uint64_t last = 0;
+	int n_buckets = 0;
+	for (std::string line; std::getline(lines, line);) {
+		if (line.find("_bucket{op=\"test_op\"") == std::string::npos) continue;
+		const uint64_t value = std::stoull(line.substr(line.rfind(' ') + 1));
+		REQUIRE( value >= last );
+		last = value;
+		++n_buckets;
+	}
+	REQUIRE( n_buckets > 2 );
+	REQUIRE( last == before + 3 );
+}
@@ -0,0 +1,151 @@
+/*
+
+Copyright (C) 2019 Mateusz Morusiewicz
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+
+#include <src/utils/roaring.h>
+
+#include <external/catch2/catch.hpp>
+
+#include <algorithm>
+#include <iterator>
+#include <random>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using utils::RoaringBitmap;
+
+namespace {
+
+/* values spread over a few high keys, dense enough that some groups turn into bitsets */
+std::set<uint32_t> random_set(std::mt19937 &rng, size_t n, uint32_t span) {
+	std::uniform_int_distribution<uint32_t> value(0, span - 1);
+	std::set<uint32_t> rv;
+	while (rv.size() < n) rv.insert(value(rng));
+	return rv;
+}
+
+RoaringBitmap to_bitmap(const std::set<uint32_t> &values) {
+	RoaringBitmap rv;
+	for (uint32_t v : values) rv.add(v);
+	return rv;
+}
+
+std::vector<uint32_t> to_vector(const std::set<uint32_t> &values) {
+	return std::vector<uint32_t>(values.begin(), values.end());
+}
+
+} // namespace
+
+TEST_CASE( "bitmaps add, remove and look up values", "[roaring]" ) {
+	RoaringBitmap bitmap;
+	REQUIRE( bitmap.empty() );
+
+	REQUIRE( bitmap.add(7) );
+	REQUIRE_FALSE( bitmap.add(7) );
+	REQUIRE( bitmap.add(0xffffffff) );
+	REQUIRE( bitmap.add(1 << 16) );
+
+	REQUIRE( bitmap.contains(7) );
+	REQUIRE( bitmap.contains(0xffffffff) );
+	REQUIRE_FALSE( bitmap.contains(8) );
+	REQUIRE( bitmap.cardinality() == 3 );
+	REQUIRE( bitmap.to_vector() == std::vector<uint32_t>{7, 1 << 16, 0xffffffff} );
+
+	REQUIRE( bitmap.remove(1 << 16) );
+	REQUIRE_FALSE( bitmap.remove(1 << 16) );
+	REQUIRE( bitmap.cardinality() == 2 );
+
+	/* through the array to bitset switch and back */
+	RoaringBitmap dense;
+	for (uint32_t v = 0; v < 10000; ++v) dense.add(v * 3);
+	REQUIRE( dense.cardinality() == 10000 );
+	for (uint32_t v = 0; v < 10000; ++v) REQUIRE( dense.contains(v * 3) );
+	REQUIRE_FALSE( dense.contains(1) );
+	for (uint32_t v = 0; v < 10000; v += 2) dense.remove(v * 3);
+	REQUIRE( dense.cardinality() == 5000 );
+	for (uint32_t v = 1; v < 10000; v += 2) dense.remove(v * 3);
+	REQUIRE( dense.empty() );
+	REQUIRE( dense == RoaringBitmap{} );
+}
+
+TEST_CASE( "bitmap set operations agree with std::set", "[roaring]" ) {
+	std::mt19937 rng(49);
+
+	/* sparse and dense groups, in all combinations */
+	for (auto [n_lhs, n_rhs] : {std::pair<size_t, size_t>{100, 100}, {100, 60000}, {60000, 100},
+	         {60000, 60000}, {5000, 3000}, {0, 1000}}) {
+		const auto lhs = random_set(rng, n_lhs, 3 << 16);
+		const auto rhs = random_set(rng, n_rhs, 3 << 16);
+		const auto lhs_bitmap = to_bitmap(lhs), rhs_bitmap = to_bitmap(rhs);
+
+		std::set<uint32_t> expected_and, expected_or, expected_andnot;
+		std::set_intersection(lhs.begin(), lhs.end(), rhs.begin(), rhs.end(),
+		    std::inserter(expected_and, expected_and.end()));
+		std::set_union(lhs.begin(), lhs.end(), rhs.begin(), rhs.end(),
+		    std::inserter(expected_or, expected_or.end()));
+		std::set_difference(lhs.begin(), lhs.end(), rhs.begin(), rhs.end(),
+		    std::inserter(expected_andnot, expected_andnot.end()));
+
+		const auto got_and = lhs_bitmap & rhs_bitmap;
+		const auto got_or = lhs_bitmap | rhs_bitmap;
+		const auto got_andnot = lhs_bitmap.andnot(rhs_bitmap);
+
+		REQUIRE( got_and.to_vector() == to_vector(expected_and) );
+		REQUIRE( got_or.to_vector() == to_vector(expected_or) );
+		REQUIRE( got_andnot.to_vector() == to_vector(expected_andnot) );
+		REQUIRE( got_and.cardinality() == expected_and.size() );
+		REQUIRE( got_or.cardinality() == expected_or.size() );
+		REQUIRE( got_andnot.cardinality() == expected_andnot.size() );
+
+		/* results are stored the same way as bitmaps built value by value */
+		REQUIRE( got_and == to_bitmap(expected_and) );
+		REQUIRE( got_or == to_bitmap(expected_or) );
+		REQUIRE( got_andnot == to_bitmap(expected_andnot) );
+	}
+}
+
+TEST_CASE( "bitmaps survive serialization", "[roaring]" ) {
+	std::mt19937 rng(7);
+	const auto sparse = to_bitmap(random_set(rng, 1000, 1 << 24));
+	const auto dense = to_bitmap(random_set(rng, 50000, 1 << 17));
+
+	std::string data;
+	sparse.serialize(data);
+	dense.serialize(data);
+	RoaringBitmap{}.serialize(data);
+
+	std::string_view view = data;
+	REQUIRE( RoaringBitmap::deserialize(view) == sparse );
+	REQUIRE( RoaringBitmap::deserialize(view) == dense );
+	REQUIRE( RoaringBitmap::deserialize(view).empty() );
+	REQUIRE( view.empty() );
+
+	std::string truncated;
+	dense.serialize(truncated);
+	truncated.pop_back();
+	std::string_view truncated_view = truncated;
+	REQUIRE_THROWS_AS( RoaringBitmap::deserialize(truncated_view), std::runtime_error );
+
+	/* one container holding 2 and 1, out of order */
+	const std::string unsorted("\0\0\0\1\0\0\0\0\0\2\0\2\0\1", 14);
+	std::string_view unsorted_view = unsorted;
+	REQUIRE_THROWS_AS( RoaringBitmap::deserialize(unsorted_view), std::runtime_error );
+}
@@ -0,0 +1,79 @@
+/*
+
+Copyright (C) 2019 Mateusz Morusiewicz
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#include <src/utils/spsc_queue.h>
+
+#include <external/catch2/catch.hpp>
+
+#include <memory>
+#include <thread>
+
+TEST_CASE( "spsc queue is bounded and keeps order", "[spsc_queue]" ) {
+	utils::SpscQueue<int, 4> queue;
+	REQUIRE( queue.empty() );
+
+	for (int i = 0; i < 4; ++i) REQUIRE( queue.try_push(i) );
+	REQUIRE( !queue.try_push(4) );
+
+	int value;
+	for (int i = 0; i < 4; ++i) {
+		REQUIRE( queue.try_pop(value) );
+		REQUIRE( value == i );
+	}
+	REQUIRE( !queue.try_pop(value) );
+	REQUIRE( queue.empty() );
+}
+
+TEST_CASE( "spsc queue releases popped values", "[spsc_queue]" ) {
+	utils::SpscQueue<std::shared_ptr<int>, 2> queue;
+	auto shared = std::make_shared<int>(1);
+
+	REQUIRE( queue.try_push(shared) );
+	std::shared_ptr<int> popped;
+	REQUIRE( queue.try_pop(popped) );
+	popped.reset();
+	REQUIRE( shared.use_count() == 1 );
+}
+
+TEST_CASE( "spsc queue hands values between two threads", "[spsc_queue_threads]" ) {
+	constexpr size_t N = 1000000;
+	utils::SpscQueue<size_t, 256> queue;
+
+	std::thread producer([&queue]() {
+		for (size_t i = 0; i < N; ++i) {
+			while (!queue.try_push(i)) std::this_thread::yield();
+		}
+	});
+
+	size_t expected = 0;
+	bool in_order = true;
+	while (expected < N) {
+		size_t value;
+		if (!queue.try_pop(value)) {
+			std::this_thread::yield();
+			continue;
+		}
+		in_order = in_order && value == expected;
+		++expected;
+	}
+	producer.join();
+
+	REQUIRE( in_order );
+	REQUIRE( queue.empty() );
+}
@@ -0,0 +1,110 @@
+/*
+
+Copyright (C) 2019 Mateusz Morusiewicz
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#include <src/utils/async.h>
+#include <src/utils/thread_pool.h>
+
+#include <external/catch2/catch.hpp>
+
+#include <atomic>
+#include <future>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+TEST_CASE( "parallel_for visits every index once", "[thread_pool_parallel_for]" ) {
+	utils::WorkStealingPool pool(4);
+	std::vector<std::atomic<int>> visits(10007);
+
+	pool.parallel_for(0, visits.size(), 13, [&visits](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; ++i) ++visits[i];
+	});
+
+	for (const auto &v : visits) REQUIRE( v == 1 );
+}
+
+TEST_CASE( "nested parallel_for does not deadlock", "[thread_pool_nested]" ) {
+	utils::WorkStealingPool pool(2);
+	std::atomic<int> sum{0};
+
+	pool.parallel_for(0, 8, 1, [&pool, &sum](size_t, size_t) {
+		pool.parallel_for(0, 100, 10, [&sum](size_t begin, size_t end) { sum += end - begin; });
+	});
+
+	REQUIRE( sum == 800 );
+}
+
+TEST_CASE( "cancellation token is shared between copies", "[cancellation_token]" ) {
+	utils::CancellationToken token;
+	auto copy = token;
+	REQUIRE( !copy.is_cancelled() );
+	token.cancel();
+	REQUIRE( copy.is_cancelled() );
+}
+
+TEST_CASE( "run_async delivers results and exceptions", "[run_async]" ) {
+	auto future = std::make_shared<std::future<int>>();
+	std::promise<bool> ready_in_on_done;
+	std::promise<void> handed_over;
+
+	/* the task waits until its future is stored, so that on_done can look at it */
+	auto gate = handed_over.get_future().share();
+	*future = utils::run_async([gate]() { gate.wait(); return 42; },
+	    [future, &ready_in_on_done]() { ready_in_on_done.set_value(utils::is_ready(*future)); });
+	handed_over.set_value();
+
+	REQUIRE( ready_in_on_done.get_future().get() );
+	REQUIRE( future->get() == 42 );
+
+	auto failing = utils::run_async([]() -> std::string { throw std::runtime_error("boom"); });
+	REQUIRE_THROWS_WITH( failing.get(), "boom" );
+}
+
+TEST_CASE( "stages report progress and stop on cancellation", "[stage_reporter]" ) {
+	utils::OperationProgress progress;
+	std::vector<std::string> seen;
+
+	utils::OperationOptions options;
+	options.progress = &progress;
+	options.on_progress = [&]() { seen.push_back(progress.stage.load()); };
+
+	{
+		utils::StageReporter stages(options, 2);
+		REQUIRE( progress.total == 2 );
+		stages.begin("first");
+		stages.begin("second");
+		REQUIRE( progress.done == 1 );
+		stages.finish();
+		REQUIRE( progress.done == 2 );
+		REQUIRE( seen == std::vector<std::string>{"first", "second"} );
+	}
+
+	options.cancel_token.cancel();
+	{
+		utils::StageReporter stages(options, 2);
+		REQUIRE_THROWS_AS( stages.begin("first"), utils::OperationCancelled );
+	}
+
+	{
+		utils::StageReporter stages(options, 2);
+		stages.commit();
+		REQUIRE_NOTHROW( stages.begin("past the point of no return") );
+	}
+}
@@ -0,0 +1,96 @@
+/*
+
+Copyright (C) 2019 Mateusz Morusiewicz
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+
+#include <src/utils/trace.h>
+
+#include <external/catch2/catch.hpp>
+#include <external/nlohmann/json_single_include.h>
+
+#include <set>
+#include <sstream>
+#include <string>
+#include <thread>
+
+namespace {
+
+nlohmann::json test_events() {
+	std::stringstream ss;
+	utils::trace::write_chrome_trace(ss);
+
+	const auto trace = nlohmann::json::parse(ss.str());
+	nlohmann::json rv = nlohmann::json::array();
+	for (const auto &event : trace["traceEvents"]) {
+		if (event["cat"] == "test") rv.push_back(event);
+	}
+	return rv;
+}
+
+} // namespace
+
+TEST_CASE( "trace spans are written as chrome trace events", "[trace]" ) {
+	utils::trace::clear();
+
+	utils::trace::set_enabled(false);
+	{ utils::trace::Span span("test", "disabled"); }
+	REQUIRE( test_events().empty() );
+
+	utils::trace::set_enabled(true);
+	{
+		utils::trace::Span outer("test", "outer");
+		utils::trace::Span inner("test", "inner");
+	}
+	std::thread([]() { utils::trace::Span span("test", "other thread"); }).join();
+	utils::trace::set_enabled(false);
+
+	const auto events = test_events();
+	REQUIRE( events.size() == 3 );
+
+	/* inner closes first */
+	REQUIRE( events[0]["name"] == "inner" );
+	REQUIRE( events[1]["name"] == "outer" );
+	REQUIRE( events[0]["ph"] == "X" );
+	REQUIRE( events[0]["ts"].get<double>() >= events[1]["ts"].get<double>() );
+	REQUIRE( events[0]["dur"].get<double>() <= events[1]["dur"].get<double>() );
+	REQUIRE( events[0]["tid"] == events[1]["tid"] );
+
+	REQUIRE( events[2]["name"] == "other thread" );
+	REQUIRE( events[2]["tid"] != events[0]["tid"] );
+}
+
+TEST_CASE( "trace buffers keep the latest events", "[trace]" ) {
+	utils::trace::clear();
+
+	const size_t n = utils::trace::BUFFER_EVENTS + 10;
+	static const std::string names[] = {"first", "later"};
+	for (size_t i = 0; i < n; ++i) {
+		utils::trace::record("test", names[i >= 10].c_str(), static_cast<int64_t>(i), i + 1);
+	}
+
+	const auto events = test_events();
+	REQUIRE( events.size() == utils::trace::BUFFER_EVENTS );
+
+	std::set<std::string> seen;
+	for (const auto &event : events) seen.insert(event["name"].get<std::string>());
+	REQUIRE( seen == std::set<std::string>{"later"} );
+	REQUIRE( events.front()["ts"].get<double>() < events.back()["ts"].get<double>() );
+
+	utils::trace::clear();
+	REQUIRE( test_events().empty() );
+}
@@ -0,0 +1,70 @@
+/*
+
+Copyright (C) 2019 Mateusz Morusiewicz
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+
+#include <src/utils/utils.h>
+
+#include <external/catch2/catch.hpp>
+
+#include <string>
+#include <vector>
+
+TEST_CASE( "common options are taken out of the command line", "[utils]" ) {
+	const char *argv[] = {"hdpmanager", "--trace=t.json", "ls", "--stats", "--stats-file", "s.prom",
+	    "-r", "--statsx", nullptr};
+	int argc = 8;
+
+	REQUIRE( utils::take_option(argc, argv, "--trace") == std::string("t.json") );
+	REQUIRE( utils::take_option(argc, argv, "--stats-file") == std::string("s.prom") );
+	REQUIRE( !utils::take_option(argc, argv, "--stats-interval") );
+	REQUIRE( utils::take_flag(argc, argv, "--stats") );
+	REQUIRE( !utils::take_flag(argc, argv, "--stats") );
+
+	REQUIRE( argc == 4 );
+	REQUIRE( std::vector<std::string>(argv, argv + argc) ==
+	         std::vector<std::string>{"hdpmanager", "ls", "-r", "--statsx"} );
+	REQUIRE( argv[argc] == nullptr );
+
+	/* a trailing option without its value is left for the command to complain about */
+	const char *incomplete[] = {"hdpmanager", "--trace", nullptr};
+	int incomplete_argc = 2;
+	REQUIRE( !utils::take_option(incomplete_argc, incomplete, "--trace") );
+	REQUIRE( incomplete_argc == 2 );
+}
+
+TEST_CASE( "common options after the subcommand or -- are left alone", "[utils]" ) {
+	const auto is_command = [](std::string_view arg) { return arg == "ls" || arg == "add"; };
+
+	const char *argv[] = {"hdpmanager", "--stats", "--trace", "ls", "add", "--trace=t.json",
+	    "--stats", nullptr};
+	int argc = 7;
+
+	/* the value of an option is never taken for a subcommand */
+	REQUIRE( utils::take_option(argc, argv, "--trace", is_command) == std::string("ls") );
+	REQUIRE( !utils::take_option(argc, argv, "--trace", is_command) );
+	REQUIRE( utils::take_flag(argc, argv, "--stats", is_command) );
+	REQUIRE( !utils::take_flag(argc, argv, "--stats", is_command) );
+	REQUIRE( std::vector<std::string>(argv, argv + argc) ==
+	         std::vector<std::string>{"hdpmanager", "add", "--trace=t.json", "--stats"} );
+
+	const char *separated[] = {"hdpmanager", "--", "--stats", nullptr};
+	int separated_argc = 3;
+	REQUIRE( !utils::take_flag(separated_argc, separated, "--stats") );
+	REQUIRE( separated_argc == 3 );
+}